@@ -29,6 +29,7 @@
 #include "Log.h"
 
 static const int CONNECTION_READBUFFER_SIZE = 1024;
+static const int CONNECTION_BLOCKBUFFER_SIZE = 64 * 1024;
 #ifndef HAVE_GETADDRINFO
 #ifndef HAVE_GETHOSTBYNAME_R
 Mutex* Connection::m_mutexGetHostByName = NULL;
@@ -137,6 +138,7 @@ Connection::Connection(const char* host, int port, bool tls)
 	m_timeout = 60;
 	m_suppressErrors = true;
 	m_readBuf = (char*)malloc(CONNECTION_READBUFFER_SIZE + 1);
+	m_readBufSize = CONNECTION_READBUFFER_SIZE;
 	m_totalBytesRead = 0;
 	m_broken = false;
 	m_gracefull = false;
@@ -165,6 +167,7 @@ Connection::Connection(SOCKET socket, bool tls)
 	m_timeout			= 60;
 	m_suppressErrors	= true;
 	m_readBuf			= (char*)malloc(CONNECTION_READBUFFER_SIZE + 1);
+	m_readBufSize		= CONNECTION_READBUFFER_SIZE;
 #ifndef DISABLE_TLS
 	m_tlsSocket		= NULL;
 	m_tlsError			= false;
@@ -409,7 +412,7 @@ char* Connection::ReadLine(char* buffer, int size, int* bytesReadOut)
 	{
 		if (!bufAvail)
 		{
-			bufAvail = recv(m_socket, m_readBuf, CONNECTION_READBUFFER_SIZE, 0);
+			bufAvail = recv(m_socket, m_readBuf, m_readBufSize, 0);
 			if (bufAvail < 0)
 			{
 				ReportError("Could not receive data on socket", NULL, true, 0);
@@ -840,6 +843,75 @@ void Connection::ReadBuffer(char** buffer, int *bufLen)
 	m_bufAvail = 0;
 };
 
+char* Connection::ReadBlock(int* bufLen, bool more)
+{
+	if (m_status != csConnected)
+	{
+		return NULL;
+	}
+
+	if (m_bufAvail > 0 && !more)
+	{
+		*bufLen = m_bufAvail;
+		return m_bufPtr;
+	}
+
+	if (m_readBufSize < CONNECTION_BLOCKBUFFER_SIZE)
+	{
+		// block-wise reading is used for large amounts of data, larger buffer
+		// means less receive calls
+		char* readBuf = (char*)malloc(CONNECTION_BLOCKBUFFER_SIZE + 1);
+		if (m_bufAvail > 0)
+		{
+			memcpy(readBuf, m_bufPtr, m_bufAvail);
+		}
+		free(m_readBuf);
+		m_readBuf = readBuf;
+		m_bufPtr = readBuf;
+		m_readBufSize = CONNECTION_BLOCKBUFFER_SIZE;
+	}
+
+	// keep not yet processed data at the beginning of the buffer
+	int bufAvail = m_bufAvail > 0 ? m_bufAvail : 0;
+	if (bufAvail > 0 && m_bufPtr != m_readBuf)
+	{
+		memmove(m_readBuf, m_bufPtr, bufAvail);
+	}
+	m_bufPtr = m_readBuf;
+	m_bufAvail = bufAvail;
+
+	if (bufAvail == m_readBufSize)
+	{
+		// the caller can't process a full buffer
+		return NULL;
+	}
+
+	int received = recv(m_socket, m_readBuf + bufAvail, m_readBufSize - bufAvail, 0);
+	if (received < 0)
+	{
+		ReportError("Could not receive data on socket", NULL, true, 0);
+		m_broken = true;
+		return NULL;
+	}
+	else if (received == 0)
+	{
+		return NULL;
+	}
+
+	m_bufAvail += received;
+	m_readBuf[m_bufAvail] = '\0';
+
+	*bufLen = m_bufAvail;
+	return m_readBuf;
+}
+
+void Connection::SkipBlock(int len)
+{
+	m_bufPtr += len;
+	m_bufAvail -= len;
+	m_totalBytesRead += len;
+}
+
 void Connection::Cancel()
 {
 	debug("Cancelling connection");
@@ -54,6 +54,7 @@ protected:
 	bool				m_tls;
 	char*				m_cipher;
 	char*				m_readBuf;
+	int					m_readBufSize;
 	int					m_bufAvail;
 	char*				m_bufPtr;
 	EStatus				m_status;
@@ -124,6 +125,16 @@ public:
 	int					TryRecv(char* buffer, int size);
 	char*				ReadLine(char* buffer, int size, int* bytesRead);
 	void				ReadBuffer(char** buffer, int *bufLen);
+	/*
+	 * Block-wise reading: returns the data available in the read buffer,
+	 * receives more data from the socket if the buffer is empty or if
+	 * parameter "more" is set. The data not yet released with "SkipBlock"
+	 * is kept at the beginning of the buffer. The caller may modify
+	 * the released data until the next read operation.
+	 * Returns NULL on errors or if the connection was closed.
+	 */
+	char*				ReadBlock(int* bufLen, bool more);
+	void				SkipBlock(int len);
 	int					WriteLine(const char* buffer);
 	Connection*			Accept();
 	void				Cancel();
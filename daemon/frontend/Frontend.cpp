@@ -33,6 +33,7 @@
 #include "RemoteClient.h"
 #include "Util.h"
 #include "StatMeter.h"
+#include "QueueCoordinator.h"
 
 Frontend::Frontend()
 {
@@ -153,6 +154,7 @@ void Frontend::ServerPauseUnpause(bool pause)
 	{
 		g_Options->SetResumeTime(0);
 		g_Options->SetPauseDownload(pause);
+		g_QueueCoordinator->WakeUp();
 	}
 }
 
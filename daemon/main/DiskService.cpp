@@ -29,6 +29,7 @@
 #include "StatMeter.h"
 #include "Log.h"
 #include "Util.h"
+#include "QueueCoordinator.h"
 
 DiskService::DiskService()
 {
@@ -110,5 +111,6 @@ void DiskService::CheckRequiredDir()
 
 	g_Options->SetTempPauseDownload(false);
 	g_Options->SetTempPausePostprocess(false);
+	g_QueueCoordinator->WakeUp();
 	m_waitingRequiredDir = false;
 }
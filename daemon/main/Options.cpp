@@ -1253,8 +1253,12 @@ void Options::InitServers()
 		sprintf(optname, "Server%i.Retention", n);
 		const char* nretention = GetOption(optname);
 
+		sprintf(optname, "Server%i.Pipelining", n);
+		const char* npipelining = GetOption(optname);
+
 		bool definition = nactive || nname || nlevel || ngroup || nhost || nport ||
-			nusername || npassword || nconnections || njoingroup || ntls || ncipher || nretention;
+			nusername || npassword || nconnections || njoingroup || ntls || ncipher || nretention ||
+			npipelining;
 		bool completed = nhost && nport && nconnections;
 
 		if (!definition)
@@ -1273,6 +1277,7 @@ void Options::InitServers()
 					joinGroup, tls, ncipher,
 					nconnections ? atoi(nconnections) : 1,
 					nretention ? atoi(nretention) : 0,
+					npipelining ? atoi(npipelining) : 1,
 					nlevel ? atoi(nlevel) : 0,
 					ngroup ? atoi(ngroup) : 0);
 			}
@@ -1818,7 +1823,7 @@ bool Options::ValidateOptionName(const char* optname, const char* optvalue)
 			!strcasecmp(p, ".password") || !strcasecmp(p, ".joingroup") ||
 			!strcasecmp(p, ".encryption") || !strcasecmp(p, ".connections") ||
 			!strcasecmp(p, ".cipher") || !strcasecmp(p, ".group") ||
-			!strcasecmp(p, ".retention")))
+			!strcasecmp(p, ".retention") || !strcasecmp(p, ".pipelining")))
 		{
 			return true;
 		}
@@ -160,7 +160,7 @@ public:
 		virtual void	AddNewsServer(int id, bool active, const char* name, const char* host,
 							int port, const char* user, const char* pass, bool joinGroup,
 							bool tls, const char* cipher, int maxConnections, int retention,
-							int level, int group) = 0;
+							int pipelining, int level, int group) = 0;
 		virtual void	AddFeed(int id, const char* name, const char* url, int interval,
 							const char* filter, bool backlog, bool pauseNzb, const char* category,
 							int priority, const char* feedScript) {}
@@ -32,6 +32,7 @@
 #include "FeedInfo.h"
 #include "FeedCoordinator.h"
 #include "SchedulerScript.h"
+#include "QueueCoordinator.h"
 
 Scheduler::Task::Task(int id, int hours, int minutes, int weekDaysBits, ECommand command, const char* param)
 {
@@ -219,6 +220,7 @@ void Scheduler::ExecuteTask(Task* task)
 		case scUnpauseDownload:
 			g_Options->SetPauseDownload(task->m_command == scPauseDownload);
 			m_pauseDownloadChanged = true;
+			g_QueueCoordinator->WakeUp();
 			break;
 
 		case scPausePostProcess:
@@ -359,5 +361,6 @@ void Scheduler::CheckScheduledResume()
 		g_Options->SetPauseDownload(false);
 		g_Options->SetPausePostProcess(false);
 		g_Options->SetPauseScan(false);
+		g_QueueCoordinator->WakeUp();
 	}
 }
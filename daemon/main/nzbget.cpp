@@ -497,10 +497,10 @@ protected:
 	virtual void		AddNewsServer(int id, bool active, const char* name, const char* host,
 							int port, const char* user, const char* pass, bool joinGroup,
 							bool tls, const char* cipher, int maxConnections, int retention,
-							int level, int group)
+							int pipelining, int level, int group)
 	{
 		g_ServerPool->AddServer(new NewsServer(id, active, name, host, port, user, pass, joinGroup,
-							tls, cipher, maxConnections, retention, level, group));
+							tls, cipher, maxConnections, retention, pipelining, level, group));
 	}
 
 	virtual void		AddFeed(int id, const char* name, const char* url, int interval,
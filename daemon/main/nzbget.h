@@ -155,6 +155,11 @@ using namespace MSXML;
 #include <sys/resource.h>
 #include <sys/statvfs.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
+#if defined(__linux__) || defined(__FreeBSD__)
+#define HAVE_PWRITEV
+#include <sys/uio.h>
+#endif
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <stdint.h>
@@ -225,6 +230,24 @@ using namespace MSXML;
 #include <zlib.h>
 #endif
 
+// SIMD-optimized routines are compiled in always and selected at runtime
+// depending on the features of the CPU, define DISABLE_SIMD to use portable code only
+#ifndef DISABLE_SIMD
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define HAVE_X86_SIMD
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+#if defined(__GNUC__) && defined(__aarch64__)
+#define HAVE_ARM_SIMD
+#include <arm_neon.h>
+#include <arm_acle.h>
+#ifdef __linux__
+#include <sys/auxv.h>
+#endif
+#endif
+#endif /* NOT DISABLE_SIMD */
+
 #ifndef DISABLE_PARCHECK
 #include <assert.h>
 #include <iomanip>
@@ -30,6 +30,7 @@
 #include "Decoder.h"
 #include "Log.h"
 #include "Options.h"
+#include "QueueCoordinator.h"
 #include "ServerPool.h"
 #include "StatMeter.h"
 #include "Util.h"
@@ -45,8 +46,15 @@ ArticleDownloader::ArticleDownloader()
 	m_format = Decoder::efUnknown;
 	m_articleFilename = NULL;
 	m_downloadedSize = 0;
+	m_ticket = -1;
+	m_waitingTurn = false;
+	m_pipelineLost = false;
 	m_articleWriter.SetOwner(this);
 	SetLastUpdateTimeNow();
+
+	// a download doesn't need much stack; with hundreds of connections
+	// the default stack size (several megabytes) would waste memory
+	SetStackSize(512 * 1024);
 }
 
 ArticleDownloader::~ArticleDownloader()
@@ -159,6 +167,7 @@ void ArticleDownloader::Run()
 			NewsServer* newsServer = m_connection->GetNewsServer();
 
 			// Download article
+			m_pipelineLost = false;
 			status = Download();
 
 			if (status == adFinished || status == adFailed || status == adNotFound || status == adCrcError)
@@ -188,7 +197,9 @@ void ArticleDownloader::Run()
 			remainedRetries--;
 		}
 
-		if (!connected && m_connection && !IsStopped())
+		// if the connection was closed by another download sharing it (pipelining),
+		// the server isn't at fault
+		if (!connected && m_connection && !IsStopped() && !m_pipelineLost)
 		{
 			g_ServerPool->BlockServer(lastServer);
 		}
@@ -331,18 +342,32 @@ ArticleDownloader::EStatus ArticleDownloader::Download()
 	snprintf(tmp, 1024, "ARTICLE %s\r\n", m_articleInfo->GetMessageId());
 	tmp[1024-1] = '\0';
 
-	for (int retry = 3; retry > 0; retry--)
+	if (m_connection->GetNewsServer()->GetPipelining() > 1)
 	{
-		response = m_connection->Request(tmp);
-		if ((response && !strncmp(response, "2", 1)) || m_connection->GetAuthError())
+		response = RequestPipelined(tmp);
+		if (m_pipelineLost)
 		{
-			break;
+			detail("Article %s @ %s interrupted: connection was closed by other download", m_infoName, m_connectionName);
+			return adConnectError;
+		}
+	}
+	else
+	{
+		for (int retry = 3; retry > 0; retry--)
+		{
+			response = m_connection->Request(tmp);
+			if ((response && !strncmp(response, "2", 1)) || m_connection->GetAuthError())
+			{
+				break;
+			}
 		}
 	}
 
 	status = CheckResponse(response, "could not fetch article");
 	if (status != adFinished)
 	{
+		// error responses consist of one line only
+		FinishRequest(response && !m_connection->GetAuthError());
 		return status;
 	}
 
@@ -355,6 +380,8 @@ ArticleDownloader::EStatus ArticleDownloader::Download()
 
 	bool body = false;
 	bool end = false;
+	bool stream = false;
+	bool moreData = false;
 	const int LineBufSize = 1024*10;
 	char* lineBuf = (char*)malloc(LineBufSize);
 	status = adRunning;
@@ -377,6 +404,53 @@ ArticleDownloader::EStatus ArticleDownloader::Download()
 			usleep(10 * 1000);
 		}
 
+		if (m_ticket > -1)
+		{
+			m_connection->FlushRequests();
+		}
+
+		if (stream)
+		{
+			// the body of yEnc-article is decoded block-wise directly in the
+			// read buffer of connection instead of reading it line by line
+			int len = 0;
+			char* buffer = m_connection->ReadBlock(&len, moreData);
+			if (!buffer)
+			{
+				if (!IsStopped())
+				{
+					detail("Article %s @ %s failed: Unexpected end of article", m_infoName, m_connectionName);
+				}
+				status = adFailed;
+				break;
+			}
+
+			int consumed = 0;
+			int decodedLen = m_yDecoder.DecodeStream(buffer, len, &consumed);
+			m_connection->SkipBlock(consumed);
+			moreData = true;
+
+			g_StatMeter->AddSpeedReading(consumed);
+			if (g_Options->GetAccurateRate())
+			{
+				AddServerData();
+			}
+
+			if (!WriteDecoded(buffer, decodedLen))
+			{
+				status = adFatalError;
+				break;
+			}
+
+			if (m_yDecoder.GetEof())
+			{
+				end = true;
+				break;
+			}
+
+			continue;
+		}
+
 		int len = 0;
 		char* line = m_connection->ReadLine(lineBuf, LineBufSize, &len);
 
@@ -450,10 +524,14 @@ ArticleDownloader::EStatus ArticleDownloader::Download()
 			status = adFatalError;
 			break;
 		}
+
+		stream = body && m_format == Decoder::efYenc && g_Options->GetDecode() && m_yDecoder.GetBody();
 	}
 
 	free(lineBuf);
 
+	FinishRequest(end);
+
 	if (!end && status == adRunning && !IsStopped())
 	{
 		detail("Article %s @ %s failed: article incomplete", m_infoName, m_connectionName);
@@ -484,6 +562,70 @@ ArticleDownloader::EStatus ArticleDownloader::Download()
 	return status;
 }
 
+/*
+ * Sends the request via pipeline of the connection and waits until the
+ * responses to previous requests are received by other downloads.
+ */
+const char* ArticleDownloader::RequestPipelined(const char* request)
+{
+	// the flag must be set before the request is queued, see "Stop"
+	m_connectionMutex.Lock();
+	m_waitingTurn = true;
+	m_connectionMutex.Unlock();
+
+	m_ticket = m_connection->SendRequest(request);
+
+	NntpConnection::ETurn turn;
+	while ((turn = m_connection->WaitTurn(m_ticket, 100)) == NntpConnection::ptWait && !IsStopped())
+	{
+		SetLastUpdateTimeNow();
+	}
+
+	m_connectionMutex.Lock();
+	m_waitingTurn = false;
+	m_connectionMutex.Unlock();
+
+	if (turn == NntpConnection::ptLost)
+	{
+		m_ticket = -1;
+		m_pipelineLost = true;
+		return NULL;
+	}
+
+	if (turn != NntpConnection::ptReady)
+	{
+		// stopped while waiting, the response will be discarded
+		m_connection->FinishResponse(m_ticket);
+		m_ticket = -1;
+		return NULL;
+	}
+
+	return m_connection->ReadResponse();
+}
+
+/*
+ * Gives the turn to the next request in the pipeline. If the response
+ * wasn't read completely the connection can't be used anymore.
+ */
+void ArticleDownloader::FinishRequest(bool complete)
+{
+	if (m_ticket < 0)
+	{
+		return;
+	}
+
+	if (complete)
+	{
+		m_connection->FinishResponse(m_ticket);
+	}
+	else
+	{
+		m_connection->Disconnect();
+	}
+
+	m_ticket = -1;
+}
+
 ArticleDownloader::EStatus ArticleDownloader::CheckResponse(const char* response, const char* comment)
 {
 	if (!response)
@@ -519,6 +661,28 @@ ArticleDownloader::EStatus ArticleDownloader::CheckResponse(const char* response
 }
 
 bool ArticleDownloader::Write(char* line, int len)
+{
+	if (g_Options->GetDecode())
+	{
+		if (m_format == Decoder::efYenc)
+		{
+			len = m_yDecoder.DecodeBuffer(line, len);
+		}
+		else if (m_format == Decoder::efUx)
+		{
+			len = m_uDecoder.DecodeBuffer(line, len);
+		}
+		else
+		{
+			detail("Decoding %s failed: unsupported encoding", m_infoName);
+			return false;
+		}
+	}
+
+	return WriteDecoded(line, len);
+}
+
+bool ArticleDownloader::WriteDecoded(char* buffer, int len)
 {
 	const char* articleFilename = NULL;
 	int64 articleFileSize = 0;
@@ -529,20 +693,13 @@ bool ArticleDownloader::Write(char* line, int len)
 	{
 		if (m_format == Decoder::efYenc)
 		{
-			len = m_yDecoder.DecodeBuffer(line, len);
 			articleFilename = m_yDecoder.GetArticleFilename();
 			articleFileSize = m_yDecoder.GetSize();
 		}
 		else if (m_format == Decoder::efUx)
 		{
-			len = m_uDecoder.DecodeBuffer(line, len);
 			articleFilename = m_uDecoder.GetArticleFilename();
 		}
-		else
-		{
-			detail("Decoding %s failed: unsupported encoding", m_infoName);
-			return false;
-		}
 
 		if (len > 0 && m_format == Decoder::efYenc)
 		{
@@ -564,7 +721,7 @@ bool ArticleDownloader::Write(char* line, int len)
 		m_writingStarted = true;
 	}
 
-	bool ok = len == 0 || m_articleWriter.Write(line, len);
+	bool ok = len == 0 || m_articleWriter.Write(buffer, len);
 
 	return ok;
 }
@@ -654,7 +811,9 @@ void ArticleDownloader::Stop()
 	debug("Trying to stop ArticleDownloader");
 	Thread::Stop();
 	m_connectionMutex.Lock();
-	if (m_connection)
+	// a download waiting for its turn in pipeline doesn't use the connection yet,
+	// cancelling it would break the downloads sharing the connection
+	if (m_connection && !m_waitingTurn)
 	{
 		m_connection->SetSuppressErrors(true);
 		m_connection->Cancel();
@@ -685,7 +844,9 @@ void ArticleDownloader::FreeConnection(bool keepConnected)
 	{
 		debug("Releasing connection");
 		m_connectionMutex.Lock();
-		if (!keepConnected || m_connection->GetStatus() == Connection::csCancelled)
+		// shared connections (pipelining) are kept unless broken, see "FinishRequest"
+		if ((!keepConnected && m_connection->GetNewsServer()->GetPipelining() == 1) ||
+			m_connection->GetStatus() == Connection::csCancelled)
 		{
 			m_connection->Disconnect();
 		}
@@ -693,6 +854,7 @@ void ArticleDownloader::FreeConnection(bool keepConnected)
 		g_ServerPool->FreeConnection(m_connection, true);
 		m_connection = NULL;
 		m_connectionMutex.Unlock();
+		g_QueueCoordinator->WakeUp();
 	}
 }
 
@@ -78,13 +78,19 @@ private:
 	ServerStatList		m_serverStats;
 	bool				m_writingStarted;
 	int					m_downloadedSize;
+	int					m_ticket;
+	bool				m_waitingTurn;
+	bool				m_pipelineLost;
 
 	EStatus				Download();
 	EStatus				DecodeCheck();
 	void				FreeConnection(bool keepConnected);
 	EStatus				CheckResponse(const char* response, const char* comment);
+	const char*			RequestPipelined(const char* request);
+	void				FinishRequest(bool complete);
 	void				SetStatus(EStatus status) { m_status = status; }
 	bool				Write(char* line, int len);
+	bool				WriteDecoded(char* buffer, int len);
 	void				AddServerData();
 
 public:
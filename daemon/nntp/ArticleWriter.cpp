@@ -54,8 +54,7 @@ ArticleWriter::~ArticleWriter()
 
 	if (m_articleData)
 	{
-		free(m_articleData);
-		g_ArticleCache->Free(m_articleSize);
+		g_ArticleCache->Free(m_articleData, m_articleSize);
 	}
 
 	if (m_flushing)
@@ -139,8 +138,7 @@ bool ArticleWriter::Start(Decoder::EFormat format, const char* filename, int64 f
 	{
 		if (m_articleData)
 		{
-			free(m_articleData);
-			g_ArticleCache->Free(m_articleSize);
+			g_ArticleCache->Free(m_articleData, m_articleSize);
 		}
 
 		m_articleData = (char*)g_ArticleCache->Alloc(m_articleSize);
@@ -243,6 +241,7 @@ void ArticleWriter::Finish(bool success)
 			g_ArticleCache->LockContent();
 			m_articleInfo->AttachSegment(m_articleData, m_articleOffset, m_articlePtr);
 			m_fileInfo->SetCachedArticles(m_fileInfo->GetCachedArticles() + 1);
+			m_fileInfo->AddCachedSegment(m_articleOffset, m_articlePtr);
 			g_ArticleCache->UnlockContent();
 			m_articleData = NULL;
 		}
@@ -351,6 +350,8 @@ void ArticleWriter::CompleteFileParts()
 	DownloadQueue::Lock();
 	strncpy(nzbName, m_fileInfo->GetNzbInfo()->GetName(), 1024);
 	strncpy(nzbDestDir, m_fileInfo->GetNzbInfo()->GetDestDir(), 1024);
+	// only damaged files are verified using the segments
+	int64 parBlockSize = m_fileInfo->GetFailedArticles() > 0 ? m_fileInfo->GetNzbInfo()->GetParBlockSize() : 0;
 	DownloadQueue::Unlock();
 	nzbName[1024-1] = '\0';
 	nzbDestDir[1024-1] = '\0';
@@ -469,6 +470,7 @@ void ArticleWriter::CompleteFileParts()
 		{
 			fseek(outfile, pa->GetSegmentOffset(), SEEK_SET);
 			fwrite(pa->GetSegmentContent(), 1, pa->GetSegmentSize(), outfile);
+			SplitSegment(pa, parBlockSize);
 			pa->DiscardSegment();
 			SetLastUpdateTimeNow();
 		}
@@ -516,6 +518,13 @@ void ArticleWriter::CompleteFileParts()
 		}
 	}
 
+	if (cached)
+	{
+		g_ArticleCache->LockContent();
+		m_fileInfo->ClearCachedSegments();
+		g_ArticleCache->UnlockContent();
+	}
+
 	free(buffer);
 
 	if (cached)
@@ -610,8 +619,12 @@ void ArticleWriter::CompleteFileParts()
 
 	// the locking is needed for accessing the members of NZBInfo
 	DownloadQueue::Lock();
-	m_fileInfo->GetNzbInfo()->GetCompletedFiles()->push_back(new CompletedFile(
-		m_fileInfo->GetId(), Util::BaseFileName(ofn), fileStatus, crc));
+	CompletedFile* completedFile = new CompletedFile(m_fileInfo->GetId(), Util::BaseFileName(ofn), fileStatus, crc);
+	if (fileStatus == CompletedFile::cfPartial)
+	{
+		completedFile->GetSegmentSplits()->swap(*m_fileInfo->GetSegmentSplits());
+	}
+	m_fileInfo->GetNzbInfo()->GetCompletedFiles()->push_back(completedFile);
 	if (strcmp(m_fileInfo->GetNzbInfo()->GetDestDir(), nzbDestDir))
 	{
 		// destination directory was changed during completion, need to move the file
@@ -620,18 +633,27 @@ void ArticleWriter::CompleteFileParts()
 	DownloadQueue::Unlock();
 }
 
+static bool CompareSegmentOffsets(ArticleInfo* article1, ArticleInfo* article2)
+{
+	return article1->GetSegmentOffset() < article2->GetSegmentOffset();
+}
+
 void ArticleWriter::FlushCache()
 {
 	detail("Flushing cache for %s", m_infoName);
 
 	bool directWrite = g_Options->GetDirectWrite() && m_fileInfo->GetOutputInitialized();
 	FILE* outfile = NULL;
-	bool needBufFile = false;
 	char destFile[1024];
 	char errBuf[256];
 	int flushedArticles = 0;
 	int64 flushedSize = 0;
 
+	// the locking is needed for accessing the members of NZBInfo
+	DownloadQueue::Lock();
+	int64 parBlockSize = m_fileInfo->GetFailedArticles() > 0 ? m_fileInfo->GetNzbInfo()->GetParBlockSize() : 0;
+	DownloadQueue::Unlock();
+
 	g_ArticleCache->LockFlush();
 
 	FileInfo::Articles cachedArticles;
@@ -648,7 +670,14 @@ void ArticleWriter::FlushCache()
 	}
 	g_ArticleCache->UnlockContent();
 
-	for (FileInfo::Articles::iterator it = cachedArticles.begin(); it != cachedArticles.end(); it++)
+	if (directWrite)
+	{
+		// write segments in the order of their file positions, adjacent segments at once
+		std::sort(cachedArticles.begin(), cachedArticles.end(), CompareSegmentOffsets);
+	}
+
+	FileInfo::Articles::iterator it = cachedArticles.begin();
+	while (it != cachedArticles.end())
 	{
 		if (m_fileInfo->GetDeleted())
 		{
@@ -656,24 +685,39 @@ void ArticleWriter::FlushCache()
 			break;
 		}
 
-		ArticleInfo* pa = *it;
+		FileInfo::Articles::iterator runEnd = it + 1;
 
-		if (directWrite && !outfile)
+		if (directWrite)
 		{
-			outfile = fopen(m_fileInfo->GetOutputFilename(), FOPEN_RBP);
 			if (!outfile)
+			{
+				outfile = fopen(m_fileInfo->GetOutputFilename(), FOPEN_RBP);
+				if (!outfile)
+				{
+					m_fileInfo->GetNzbInfo()->PrintMessage(Message::mkError,
+						"Could not open file %s: %s", m_fileInfo->GetOutputFilename(),
+						Util::GetLastErrorMessage(errBuf, sizeof(errBuf)));
+					break;
+				}
+				SetWriteBuffer(outfile, 0);
+			}
+
+			while (runEnd != cachedArticles.end() &&
+				(*runEnd)->GetSegmentOffset() == (*(runEnd - 1))->GetSegmentOffset() + (*(runEnd - 1))->GetSegmentSize())
+			{
+				runEnd++;
+			}
+
+			if (!WriteSegments(outfile, &*it, (int)(runEnd - it)))
 			{
 				m_fileInfo->GetNzbInfo()->PrintMessage(Message::mkError,
-					"Could not open file %s: %s", m_fileInfo->GetOutputFilename(),
+					"Could not write file %s: %s", m_fileInfo->GetOutputFilename(),
 					Util::GetLastErrorMessage(errBuf, sizeof(errBuf)));
-				break;
 			}
-			needBufFile = true;
 		}
-
-		if (!directWrite)
+		else
 		{
-			snprintf(destFile, 1024, "%s.tmp", pa->GetResultFilename());
+			snprintf(destFile, 1024, "%s.tmp", (*it)->GetResultFilename());
 			destFile[1024-1] = '\0';
 
 			outfile = fopen(destFile, FOPEN_WB);
@@ -684,32 +728,27 @@ void ArticleWriter::FlushCache()
 					Util::GetLastErrorMessage(errBuf, sizeof(errBuf)));
 				break;
 			}
-			needBufFile = true;
-		}
-
-		if (outfile && needBufFile)
-		{
 			SetWriteBuffer(outfile, 0);
-			needBufFile = false;
-		}
 
-		if (directWrite)
-		{
-			fseek(outfile, pa->GetSegmentOffset(), SEEK_SET);
+			fwrite((*it)->GetSegmentContent(), 1, (*it)->GetSegmentSize(), outfile);
 		}
 
-		fwrite(pa->GetSegmentContent(), 1, pa->GetSegmentSize(), outfile);
-
-		flushedSize += pa->GetSegmentSize();
-		flushedArticles++;
+		for (; it != runEnd; it++)
+		{
+			ArticleInfo* pa = *it;
+			flushedSize += pa->GetSegmentSize();
+			flushedArticles++;
 
-		pa->DiscardSegment();
+			SplitSegment(pa, parBlockSize);
+			pa->DiscardSegment();
+		}
 
 		if (!directWrite)
 		{
 			fclose(outfile);
 			outfile = NULL;
 
+			ArticleInfo* pa = *(runEnd - 1);
 			if (!Util::MoveFile(destFile, pa->GetResultFilename()))
 			{
 				m_fileInfo->GetNzbInfo()->PrintMessage(Message::mkError,
@@ -726,6 +765,15 @@ void ArticleWriter::FlushCache()
 
 	g_ArticleCache->LockContent();
 	m_fileInfo->SetCachedArticles(m_fileInfo->GetCachedArticles() - flushedArticles);
+	for (FileInfo::Articles::iterator it2 = cachedArticles.begin(); it2 != it; it2++)
+	{
+		ArticleInfo* pa = *it2;
+		m_fileInfo->RemoveCachedSegment(pa->GetSegmentOffset(), pa->GetSegmentSize());
+	}
+	if (m_fileInfo->GetCachedArticles() == 0)
+	{
+		m_fileInfo->ClearCachedSegments();
+	}
 	g_ArticleCache->UnlockContent();
 
 	g_ArticleCache->UnlockFlush();
@@ -733,6 +781,97 @@ void ArticleWriter::FlushCache()
 	detail("Saved %i articles (%.2f MB) from cache into disk for %s", flushedArticles, (float)(flushedSize / 1024.0 / 1024.0), m_infoName);
 }
 
+/*
+ * Writes segments following each other in the file, starting at the position of the first
+ * segment. Where available the segments are passed to the OS in large gathering writes.
+ */
+bool ArticleWriter::WriteSegments(FILE* outfile, ArticleInfo** articles, int count)
+{
+	int64 offset = articles[0]->GetSegmentOffset();
+
+#ifdef HAVE_PWRITEV
+	const int MaxWriteVectors = 64;
+	struct iovec vectors[MaxWriteVectors];
+	int fd = fileno(outfile);
+
+	for (int i = 0; i < count; )
+	{
+		int num = std::min(count - i, MaxWriteVectors);
+		for (int k = 0; k < num; k++)
+		{
+			vectors[k].iov_base = (void*)articles[i + k]->GetSegmentContent();
+			vectors[k].iov_len = articles[i + k]->GetSegmentSize();
+		}
+		i += num;
+
+		struct iovec* vec = vectors;
+		while (num > 0)
+		{
+			ssize_t written = pwritev(fd, vec, num, offset);
+			if (written < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (written <= 0)
+			{
+				return false;
+			}
+
+			// short write: skip the written vectors and continue with the rest
+			offset += written;
+			while (num > 0 && (size_t)written >= vec->iov_len)
+			{
+				written -= vec->iov_len;
+				vec++;
+				num--;
+			}
+			if (num > 0)
+			{
+				vec->iov_base = (char*)vec->iov_base + written;
+				vec->iov_len -= written;
+			}
+		}
+	}
+
+	return true;
+#else
+	bool ok = fseek(outfile, offset, SEEK_SET) == 0;
+	for (int i = 0; i < count && ok; i++)
+	{
+		ok = fwrite(articles[i]->GetSegmentContent(), 1, articles[i]->GetSegmentSize(), outfile) ==
+			(size_t)articles[i]->GetSegmentSize();
+	}
+	return ok;
+#endif
+}
+
+/*
+ * Computes the CRCs of the parts of the cached segment before and after each
+ * par-block boundary within the segment. The quick par-verification of damaged
+ * files needs them and would otherwise read these parts from disk.
+ */
+void ArticleWriter::SplitSegment(ArticleInfo* articleInfo, int64 parBlockSize)
+{
+	if (parBlockSize <= 0 || articleInfo->GetSegmentOffset() < 0)
+	{
+		return;
+	}
+
+	int64 segmentOffset = articleInfo->GetSegmentOffset();
+	int segmentSize = articleInfo->GetSegmentSize();
+	uchar* content = (uchar*)articleInfo->GetSegmentContent();
+
+	for (int64 splitOffset = (segmentOffset / parBlockSize + 1) * parBlockSize;
+		 splitOffset < segmentOffset + segmentSize; splitOffset += parBlockSize)
+	{
+		uint32 headSize = (uint32)(splitOffset - segmentOffset);
+		uint32 headCrc = Util::Crc32m(0xFFFFFFFF, content, headSize) ^ 0xFFFFFFFF;
+		uint32 tailCrc = Util::Crc32m(0xFFFFFFFF, content + headSize, segmentSize - headSize) ^ 0xFFFFFFFF;
+		m_fileInfo->GetSegmentSplits()->push_back(SegmentSplit(segmentOffset, segmentSize,
+			splitOffset, headCrc, tailCrc));
+	}
+}
+
 bool ArticleWriter::MoveCompletedFiles(NzbInfo* nzbInfo, const char* oldDestDir)
 {
 	if (nzbInfo->GetCompletedFiles()->empty())
@@ -867,58 +1006,291 @@ bool ArticleWriter::MoveCompletedFiles(NzbInfo* nzbInfo, const char* oldDestDir)
 }
 
 
-ArticleCache::ArticleCache()
+ArticleArena::ArticleArena()
 {
-	m_allocated = 0;
-	m_flushing = false;
-	m_fileInfo = NULL;
+	m_usedSize = 0;
+	m_residentSize = 0;
+	m_limit = 0;
 }
 
-void* ArticleCache::Alloc(int size)
+ArticleArena::~ArticleArena()
 {
-	m_allocMutex.Lock();
+	while (!m_regions.empty())
+	{
+		DeleteRegion(m_regions.begin()->second);
+	}
+}
+
+int ArticleArena::ChunkSize(int size)
+{
+	return std::max((size + ClassStep - 1) / ClassStep, 1) * ClassStep;
+}
+
+/*
+ * With a small limit smaller regions are used, otherwise a few partially
+ * filled regions of different size classes would take all the memory.
+ */
+size_t ArticleArena::ClassRegionSize(int chunkSize)
+{
+	if (!m_limit || m_limit / 8 >= RegionSize)
+	{
+		return RegionSize;
+	}
+
+	return std::max(m_limit / 8 / chunkSize, (size_t)1) * chunkSize;
+}
+
+ArticleArena::Region* ArticleArena::NewRegion(int chunkSize, size_t size)
+{
+	if (!CanGrow(size))
+	{
+		return NULL;
+	}
+
+#ifdef WIN32
+	char* base = (char*)VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+	char* base = (char*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == (char*)MAP_FAILED)
+	{
+		base = NULL;
+	}
+#ifdef MADV_HUGEPAGE
+	if (base && size == RegionSize)
+	{
+		madvise(base, size, MADV_HUGEPAGE);
+	}
+#endif
+#endif
 
-	void* p = NULL;
-	if (m_allocated + size <= (size_t)g_Options->GetArticleCache() * 1024 * 1024)
+	if (!base)
 	{
-		p = malloc(size);
-		if (p)
+		return NULL;
+	}
+
+	Region* region = new Region();
+	region->base = base;
+	region->size = size;
+	region->resident = true;
+	m_residentSize += size;
+	m_regions[base] = region;
+
+	AssignRegion(region, chunkSize);
+
+	return region;
+}
+
+void ArticleArena::DeleteRegion(Region* region)
+{
+#ifdef WIN32
+	VirtualFree(region->base, 0, MEM_RELEASE);
+#else
+	munmap(region->base, region->size);
+#endif
+
+	if (region->resident)
+	{
+		m_residentSize -= region->size;
+	}
+	m_regions.erase(region->base);
+	if (region->chunkSize <= MaxClassSize)
+	{
+		m_classRegions[region->chunkSize / ClassStep - 1].remove(region);
+	}
+	m_spareRegions.remove(region);
+	delete region;
+}
+
+void ArticleArena::AssignRegion(Region* region, int chunkSize)
+{
+	region->chunkSize = chunkSize;
+	region->chunkCount = (int)(region->size / chunkSize);
+	region->freeChunks.clear();
+	for (int i = region->chunkCount - 1; i >= 0; i--)
+	{
+		region->freeChunks.push_back(i);
+	}
+
+	if (chunkSize <= MaxClassSize)
+	{
+		m_classRegions[chunkSize / ClassStep - 1].push_back(region);
+	}
+}
+
+void ArticleArena::DiscardRegion(Region* region)
+{
+	if (!region->resident)
+	{
+		return;
+	}
+
+#ifdef WIN32
+	VirtualAlloc(region->base, region->size, MEM_RESET, PAGE_READWRITE);
+#else
+	madvise(region->base, region->size, MADV_DONTNEED);
+#endif
+
+	region->resident = false;
+	m_residentSize -= region->size;
+}
+
+ArticleArena::Region* ArticleArena::FindRegion(void* p)
+{
+	RegionMap::iterator it = m_regions.upper_bound((char*)p);
+	return it != m_regions.begin() ? (--it)->second : NULL;
+}
+
+void* ArticleArena::Alloc(int size)
+{
+	int chunkSize = ChunkSize(size);
+	Region* region = NULL;
+
+	if (chunkSize > MaxClassSize)
+	{
+		region = NewRegion(chunkSize, chunkSize);
+	}
+	else
+	{
+		RegionList* regionList = &m_classRegions[chunkSize / ClassStep - 1];
+		for (RegionList::iterator it = regionList->begin(); it != regionList->end(); it++)
+		{
+			if (!(*it)->freeChunks.empty())
+			{
+				region = *it;
+				break;
+			}
+		}
+
+		// resident spare regions are at the front of the list
+		for (RegionList::iterator it = m_spareRegions.begin(); !region && it != m_spareRegions.end(); it++)
 		{
-			if (!m_allocated && g_Options->GetSaveQueue() && g_Options->GetServerMode() && g_Options->GetContinuePartial())
+			Region* spare = *it;
+			if (spare->size >= (size_t)chunkSize && (spare->resident || CanGrow(spare->size)))
 			{
-				g_DiskState->WriteCacheFlag();
+				region = spare;
+				m_spareRegions.erase(it);
+				if (!region->resident)
+				{
+					region->resident = true;
+					m_residentSize += region->size;
+				}
+				AssignRegion(region, chunkSize);
+				break;
 			}
-			m_allocated += size;
+		}
+
+		if (!region)
+		{
+			region = NewRegion(chunkSize, ClassRegionSize(chunkSize));
 		}
 	}
-	m_allocMutex.Unlock();
 
-	return p;
+	if (!region)
+	{
+		return NULL;
+	}
+
+	int chunk = region->freeChunks.back();
+	region->freeChunks.pop_back();
+	m_usedSize += chunkSize;
+
+	return region->base + (size_t)chunk * chunkSize;
 }
 
-void* ArticleCache::Realloc(void* buf, int oldSize, int newSize)
+void* ArticleArena::Shrink(void* p, int newSize)
 {
-	m_allocMutex.Lock();
+	Region* region = FindRegion(p);
+	if (ChunkSize(newSize) >= region->chunkSize || region->chunkSize > MaxClassSize)
+	{
+		return p;
+	}
 
-	void* p = realloc(buf, newSize);
-	if (p)
+	void* newp = Alloc(newSize);
+	if (!newp)
 	{
-		m_allocated += newSize - oldSize;
+		return p;
 	}
-	else
+
+	memcpy(newp, p, newSize);
+	Free(p);
+
+	return newp;
+}
+
+void ArticleArena::Free(void* p)
+{
+	Region* region = FindRegion(p);
+	region->freeChunks.push_back((int)(((char*)p - region->base) / region->chunkSize));
+	m_usedSize -= region->chunkSize;
+
+	if ((int)region->freeChunks.size() == region->chunkCount)
 	{
-		p = buf;
+		if (region->chunkSize > MaxClassSize)
+		{
+			DeleteRegion(region);
+		}
+		else
+		{
+			// empty regions are kept for reuse by any size class; only a few of
+			// them remain resident unless the cache is drained completely
+			m_classRegions[region->chunkSize / ClassStep - 1].remove(region);
+			m_spareRegions.push_front(region);
+		}
 	}
+
+	int spareIndex = 0;
+	for (RegionList::iterator it = m_spareRegions.begin(); it != m_spareRegions.end(); it++, spareIndex++)
+	{
+		if (spareIndex >= SpareRegions || m_usedSize == 0)
+		{
+			DiscardRegion(*it);
+		}
+	}
+}
+
+
+ArticleCache::ArticleCache()
+{
+	m_flushing = false;
+	m_fileInfo = NULL;
+}
+
+void* ArticleCache::Alloc(int size)
+{
+	m_allocMutex.Lock();
+
+	// the limit applies to the memory really taken by the arena, including
+	// rounding of chunk sizes and partially filled regions
+	m_arena.SetLimit((size_t)g_Options->GetArticleCache() * 1024 * 1024);
+
+	bool empty = m_arena.GetUsedSize() == 0;
+	void* p = m_arena.Alloc(size);
+	if (p && empty && g_Options->GetSaveQueue() && g_Options->GetServerMode() && g_Options->GetContinuePartial())
+	{
+		g_DiskState->WriteCacheFlag();
+	}
+	m_allocMutex.Unlock();
+
+	return p;
+}
+
+void* ArticleCache::Realloc(void* buf, int oldSize, int newSize)
+{
+	m_allocMutex.Lock();
+	void* p = m_arena.Shrink(buf, newSize);
 	m_allocMutex.Unlock();
 
 	return p;
 }
 
-void ArticleCache::Free(int size)
+void ArticleCache::Free(void* buf, int size)
 {
 	m_allocMutex.Lock();
-	m_allocated -= size;
-	if (!m_allocated && g_Options->GetSaveQueue() && g_Options->GetServerMode() && g_Options->GetContinuePartial())
+	m_arena.Free(buf);
+	if (m_arena.GetUsedSize() == 0 && g_Options->GetSaveQueue() && g_Options->GetServerMode() && g_Options->GetContinuePartial())
 	{
 		g_DiskState->DeleteCacheFlag();
 	}
@@ -944,13 +1316,13 @@ void ArticleCache::Run()
 
 	int resetCounter = 0;
 	bool justFlushed = false;
-	while (!IsStopped() || m_allocated > 0)
+	while (!IsStopped() || GetAllocated() > 0)
 	{
 		if ((justFlushed || resetCounter >= 1000  || IsStopped() ||
-			 (g_Options->GetDirectWrite() && m_allocated >= fillThreshold)) &&
-			m_allocated > 0)
+			 (g_Options->GetDirectWrite() && GetAllocated() >= fillThreshold)) &&
+			GetAllocated() > 0)
 		{
-			justFlushed = CheckFlush(m_allocated >= fillThreshold);
+			justFlushed = CheckFlush(GetAllocated() >= fillThreshold);
 			resetCounter = 0;
 		}
 		else
@@ -961,14 +1333,24 @@ void ArticleCache::Run()
 	}
 }
 
+/*
+ * Chooses the file whose cached segments are written with the fewest seeks: the one
+ * with the longest contiguous runs of segments on average. Unless the cache must be
+ * emptied, files are flushed only when their runs are at least MinRunSize long, so that
+ * writing a run takes longer than seeking to it.
+ */
 bool ArticleCache::CheckFlush(bool flushEverything)
 {
-	debug("Checking cache, Allocated: %i, FlushEverything: %i", m_allocated, (int)flushEverything);
+	debug("Checking cache, Allocated: %i, Arena: %i, FlushEverything: %i", (int)GetAllocated(),
+		(int)m_arena.GetResidentSize(), (int)flushEverything);
 
 	char infoName[1024];
+	FileInfo* bestFile = NULL;
+	int64 bestRunSize = 0;
 
 	DownloadQueue* downloadQueue = DownloadQueue::Lock();
-	for (NzbList::iterator it = downloadQueue->GetQueue()->begin(); it != downloadQueue->GetQueue()->end() && !m_fileInfo; it++)
+	LockContent();
+	for (NzbList::iterator it = downloadQueue->GetQueue()->begin(); it != downloadQueue->GetQueue()->end(); it++)
 	{
 		NzbInfo* nzbInfo = *it;
 		for (FileList::iterator it2 = nzbInfo->GetFileList()->begin(); it2 != nzbInfo->GetFileList()->end(); it2++)
@@ -976,13 +1358,30 @@ bool ArticleCache::CheckFlush(bool flushEverything)
 			FileInfo* fileInfo = *it2;
 			if (fileInfo->GetCachedArticles() > 0 && (fileInfo->GetActiveDownloads() == 0 || flushEverything))
 			{
-				m_fileInfo = fileInfo;
-				snprintf(infoName, 1024, "%s%c%s", m_fileInfo->GetNzbInfo()->GetName(), (int)PATH_SEPARATOR, m_fileInfo->GetFilename());
-				infoName[1024-1] = '\0';
-				break;
+				int64 runSize = fileInfo->GetCachedRunSize();
+				if (runSize > bestRunSize)
+				{
+					bestFile = fileInfo;
+					bestRunSize = runSize;
+				}
 			}
 		}
 	}
+	UnlockContent();
+
+	if (bestFile && !flushEverything && !IsStopped() && !g_Options->GetPauseDownload() &&
+		g_Options->GetDirectWrite() && bestRunSize < MinRunSize)
+	{
+		debug("Postponing flush of %s, average run %i bytes", bestFile->GetFilename(), (int)bestRunSize);
+		bestFile = NULL;
+	}
+
+	if (bestFile)
+	{
+		m_fileInfo = bestFile;
+		snprintf(infoName, 1024, "%s%c%s", m_fileInfo->GetNzbInfo()->GetName(), (int)PATH_SEPARATOR, m_fileInfo->GetFilename());
+		infoName[1024-1] = '\0';
+	}
 	DownloadQueue::Unlock();
 
 	if (m_fileInfo)
@@ -990,6 +1389,7 @@ bool ArticleCache::CheckFlush(bool flushEverything)
 		ArticleWriter* articleWriter = new ArticleWriter();
 		articleWriter->SetFileInfo(m_fileInfo);
 		articleWriter->SetInfoName(infoName);
+
 		articleWriter->FlushCache();
 		delete articleWriter;
 		m_fileInfo = NULL;
@@ -52,6 +52,7 @@ private:
 	void				BuildOutputFilename();
 	bool				IsFileCached();
 	void				SetWriteBuffer(FILE* outFile, int recSize);
+	void				SplitSegment(ArticleInfo* articleInfo, int64 parBlockSize);
 
 protected:
 	virtual void		SetLastUpdateTimeNow() {}
@@ -69,14 +70,81 @@ public:
 	bool				GetDuplicate() { return m_duplicate; }
 	void				CompleteFileParts();
 	static bool			MoveCompletedFiles(NzbInfo* nzbInfo, const char* oldDestDir);
+	static bool			WriteSegments(FILE* outfile, ArticleInfo** articles, int count);
 	void				FlushCache();
 };
 
+/*
+ * Memory for cached articles. Articles are placed into chunks of a few size classes
+ * (steps of 64 KB up to 1 MB) carved from large memory regions, which prevents
+ * fragmentation of the heap. Articles larger than that get regions of their own.
+ * Regions which became empty are kept for reuse and are returned to the OS when
+ * the cache drains. The class isn't thread safe.
+ */
+class ArticleArena
+{
+public:
+	enum
+	{
+		ClassStep = 64 * 1024,
+		MaxClassSize = 1024 * 1024,
+		RegionSize = 8 * 1024 * 1024,
+		SpareRegions = 2
+	};
+
+private:
+	struct Region
+	{
+		char*			base;
+		size_t			size;
+		int				chunkSize;
+		int				chunkCount;
+		std::vector<int> freeChunks;
+		bool			resident;
+	};
+
+	typedef std::map<char*, Region*> RegionMap;
+	typedef std::list<Region*> RegionList;
+
+	RegionMap			m_regions;
+	RegionList			m_classRegions[MaxClassSize / ClassStep];
+	RegionList			m_spareRegions;
+	size_t				m_usedSize;
+	size_t				m_residentSize;
+	size_t				m_limit;
+
+	Region*				NewRegion(int chunkSize, size_t size);
+	size_t				ClassRegionSize(int chunkSize);
+	bool				CanGrow(size_t size) { return !m_limit || m_residentSize + size <= m_limit; }
+	void				DeleteRegion(Region* region);
+	void				AssignRegion(Region* region, int chunkSize);
+	void				DiscardRegion(Region* region);
+	Region*				FindRegion(void* p);
+
+public:
+						ArticleArena();
+						~ArticleArena();
+	static int			ChunkSize(int size);
+	// resident memory is never grown beyond the limit (0 - unlimited)
+	void				SetLimit(size_t limit) { m_limit = limit; }
+	void*				Alloc(int size);
+	void*				Shrink(void* p, int newSize);
+	void				Free(void* p);
+	size_t				GetUsedSize() { return m_usedSize; }
+	size_t				GetResidentSize() { return m_residentSize; }
+};
+
 class ArticleCache : public Thread
 {
+public:
+	enum
+	{
+		MinRunSize = 1024 * 1024	// written in about the time of a hard disk seek (~10 ms at 100 MB/s)
+	};
+
 private:
-	size_t				m_allocated;
 	bool				m_flushing;
+	ArticleArena		m_arena;
 	Mutex				m_allocMutex;
 	Mutex				m_flushMutex;
 	Mutex				m_contentMutex;
@@ -89,13 +157,14 @@ public:
 	virtual void		Run();
 	void*				Alloc(int size);
 	void*				Realloc(void* buf, int oldSize, int newSize);
-	void				Free(int size);
+	void				Free(void* buf, int size);
 	void				LockFlush();
 	void				UnlockFlush();
 	void				LockContent() { m_contentMutex.Lock(); }
 	void				UnlockContent() { m_contentMutex.Unlock(); }
 	bool				GetFlushing() { return m_flushing; }
-	size_t				GetAllocated() { return m_allocated; }
+	size_t				GetAllocated() { return m_arena.GetUsedSize(); }
+	size_t				GetArenaSize() { return m_arena.GetResidentSize(); }
 	bool				FileBusy(FileInfo* fileInfo) { return fileInfo == m_fileInfo; }
 };
 
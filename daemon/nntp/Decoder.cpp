@@ -88,6 +88,15 @@ Decoder::EFormat Decoder::DetectFormat(const char* buffer, int len, bool inBody)
   * YDecoder: fast implementation of yEnc-Decoder
   */
 
+const char* YDecoder::ImplNames[] = { "scalar", "SSE2", "SSSE3", "AVX2", "NEON" };
+
+/*
+ * Decoding routines write the output either to a separate buffer or into
+ * the input buffer itself, in the latter case the output may start before
+ * the input (but not after it).
+ */
+typedef int (*DecodeLineFunc)(const char* buffer, int len, char* output);
+
 YDecoder::YDecoder()
 {
 	Clear();
@@ -104,66 +113,421 @@ void YDecoder::Clear()
 	m_crc = false;
 	m_expectedCRC = 0;
 	m_calculatedCRC = 0xFFFFFFFF;
+	m_crcStream.Reset(0xFFFFFFFF);
 	m_beginPos = 0;
 	m_endPos = 0;
 	m_size = 0;
 	m_endSize = 0;
 	m_crcCheck = false;
+	m_lineStart = true;
+	m_eof = false;
 }
 
-int YDecoder::DecodeBuffer(char* buffer, int len)
+/*
+ * Portable decoding routine. It is also used by SIMD-routines to process
+ * the tail of the buffer and the cases not covered by vector code.
+ * Processes characters in range [iptr, stop); an escape-character at the end
+ * of the range consumes one more character (as long as it's before "end").
+ * Returns false if a zero character was found.
+ */
+static inline bool DecodeYencScalar(const char*& iptr, const char* stop, const char* end, char*& optr)
 {
-	if (m_body && !m_end)
+	while (iptr < stop)
 	{
-		if (!strncmp(buffer, "=yend ", 6))
+		switch (*iptr)
 		{
-			m_end = true;
-			char* pb = strstr(buffer, m_part ? " pcrc32=" : " crc32=");
-			if (pb)
+			case '=':	//escape-sequence
+				iptr++;
+				if (iptr == end)
+				{
+					return true;
+				}
+				*optr = *iptr - 64 - 42;
+				optr++;
+				break;
+			case '\n':	// ignored char
+			case '\r':	// ignored char
+				break;
+			case '\0':
+				return false;
+			default:	// normal char
+				*optr = *iptr - 42;
+				optr++;
+				break;
+		}
+		iptr++;
+	}
+	return true;
+}
+
+static int DecodeYencLineScalar(const char* buffer, int len, char* output)
+{
+	const char* iptr = buffer;
+	char* optr = output;
+	DecodeYencScalar(iptr, buffer + len, buffer + len, optr);
+	return optr - output;
+}
+
+#ifdef HAVE_X86_SIMD
+/*
+ * Blocks of 16 characters are decoded with vector instructions. If a block has
+ * no special characters (escape, CR, LF) it is decoded with a single subtraction.
+ * Otherwise the special characters are removed from the block using a shuffle
+ * which is looked up for each half of block from table "CompactTable".
+ *
+ * Since the output is never longer than the input the decoding is performed in
+ * place. Every block is loaded into register before the output is written,
+ * the write position is always behind the read position.
+ */
+
+// positions of bits set in the index, the rest is filled with 0x80 (=zero in shuffle)
+static uint8 CompactTable[256][8];
+static int CompactCount[256];
+
+class CompactTableInit
+{
+public:
+	CompactTableInit()
+	{
+		for (int mask = 0; mask < 256; mask++)
+		{
+			int cnt = 0;
+			for (int i = 0; i < 8; i++)
 			{
-				m_crc = true;
-				pb += 7 + (int)m_part; //=strlen(" crc32=") or strlen(" pcrc32=")
-				m_expectedCRC = strtoul(pb, NULL, 16);
+				if (mask & (1 << i))
+				{
+					CompactTable[mask][cnt++] = (uint8)i;
+				}
 			}
-			pb = strstr(buffer, " size=");
-			if (pb)
+			CompactCount[mask] = cnt;
+			for (int i = cnt; i < 8; i++)
 			{
-				pb += 6; //=strlen(" size=")
-				m_endSize = (int64)atoll(pb);
+				CompactTable[mask][i] = 0x80;
 			}
-			return 0;
 		}
+	}
+} CompactTableInitInstance;
 
-		char* iptr = buffer;
-		char* optr = buffer;
-		while (true)
+__attribute__((target("sse2")))
+static int DecodeYencLineSse2(const char* buffer, int len, char* output)
+{
+	const char* iptr = buffer;
+	const char* end = buffer + len;
+	char* optr = output;
+
+	const __m128i escChar = _mm_set1_epi8('=');
+	const __m128i crChar = _mm_set1_epi8('\r');
+	const __m128i lfChar = _mm_set1_epi8('\n');
+	const __m128i zeroChar = _mm_setzero_si128();
+	const __m128i offset = _mm_set1_epi8(42);
+
+	while (iptr + 16 <= end)
+	{
+		__m128i data = _mm_loadu_si128((const __m128i*)iptr);
+		__m128i special = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(data, escChar), _mm_cmpeq_epi8(data, zeroChar)),
+			_mm_or_si128(_mm_cmpeq_epi8(data, crChar), _mm_cmpeq_epi8(data, lfChar)));
+		int mask = _mm_movemask_epi8(special);
+		__m128i decoded = _mm_sub_epi8(data, offset);
+
+		if (mask == 0)
+		{
+			_mm_storeu_si128((__m128i*)optr, decoded);
+			iptr += 16;
+			optr += 16;
+			continue;
+		}
+
+		// write out characters preceding the first special character,
+		// the special character itself is processed by scalar code
+		int plain = __builtin_ctz(mask);
+		char tmp[16];
+		_mm_storeu_si128((__m128i*)tmp, decoded);
+		memcpy(optr, tmp, plain);
+		iptr += plain;
+		optr += plain;
+
+		if (!DecodeYencScalar(iptr, iptr + 1, end, optr))
+		{
+			return optr - output;
+		}
+	}
+
+	DecodeYencScalar(iptr, end, end, optr);
+	return optr - output;
+}
+
+/*
+ * Decodes a block of 16 characters containing special characters.
+ * Returns false if the block must be processed by scalar code: this is the
+ * case for zero characters, escape-characters at the end of block (the
+ * escaped character is in the next block) and sequences of escape-characters.
+ * None of these normally occur in a valid yEnc-stream or occur very seldom.
+ */
+__attribute__((target("ssse3")))
+static inline bool DecodeYencBlockSsse3(__m128i data, char*& optr)
+{
+	__m128i escMask = _mm_cmpeq_epi8(data, _mm_set1_epi8('='));
+	int esc = _mm_movemask_epi8(escMask);
+	int zero = _mm_movemask_epi8(_mm_cmpeq_epi8(data, _mm_setzero_si128()));
+	if (zero || (esc & 0x8000) || (esc & (esc << 1)))
+	{
+		return false;
+	}
+
+	int crlf = _mm_movemask_epi8(_mm_or_si128(
+		_mm_cmpeq_epi8(data, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(data, _mm_set1_epi8('\n'))));
+	int escaped = esc << 1;
+	int keep = ~(esc | (crlf & ~escaped)) & 0xFFFF;
+
+	// escaped characters have additional offset of 64
+	__m128i decoded = _mm_sub_epi8(_mm_sub_epi8(data, _mm_set1_epi8(42)),
+		_mm_and_si128(_mm_slli_si128(escMask, 1), _mm_set1_epi8(64)));
+
+	int keepLo = keep & 0xFF;
+	int keepHi = keep >> 8;
+	__m128i shuffle = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)CompactTable[keepLo]),
+		_mm_add_epi8(_mm_loadl_epi64((const __m128i*)CompactTable[keepHi]), _mm_set1_epi8(8)));
+	__m128i compacted = _mm_shuffle_epi8(decoded, shuffle);
+
+	_mm_storel_epi64((__m128i*)optr, compacted);
+	optr += CompactCount[keepLo];
+	_mm_storel_epi64((__m128i*)optr, _mm_unpackhi_epi64(compacted, compacted));
+	optr += CompactCount[keepHi];
+
+	return true;
+}
+
+__attribute__((target("ssse3")))
+static int DecodeYencLineSsse3(const char* buffer, int len, char* output)
+{
+	const char* iptr = buffer;
+	const char* end = buffer + len;
+	char* optr = output;
+
+	const __m128i escChar = _mm_set1_epi8('=');
+	const __m128i crChar = _mm_set1_epi8('\r');
+	const __m128i lfChar = _mm_set1_epi8('\n');
+	const __m128i zeroChar = _mm_setzero_si128();
+	const __m128i offset = _mm_set1_epi8(42);
+
+	while (iptr + 16 <= end)
+	{
+		__m128i data = _mm_loadu_si128((const __m128i*)iptr);
+		__m128i special = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(data, escChar), _mm_cmpeq_epi8(data, zeroChar)),
+			_mm_or_si128(_mm_cmpeq_epi8(data, crChar), _mm_cmpeq_epi8(data, lfChar)));
+
+		if (_mm_movemask_epi8(special) == 0)
+		{
+			_mm_storeu_si128((__m128i*)optr, _mm_sub_epi8(data, offset));
+			iptr += 16;
+			optr += 16;
+		}
+		else if (DecodeYencBlockSsse3(data, optr))
+		{
+			iptr += 16;
+		}
+		else if (!DecodeYencScalar(iptr, iptr + 16, end, optr))
 		{
-			switch (*iptr)
+			return optr - output;
+		}
+	}
+
+	DecodeYencScalar(iptr, end, end, optr);
+	return optr - output;
+}
+
+__attribute__((target("avx2")))
+static inline bool DecodeYencHalfAvx2(__m128i data, uint32 mask, const char*& iptr, char*& optr)
+{
+	if (mask == 0)
+	{
+		_mm_storeu_si128((__m128i*)optr, _mm_sub_epi8(data, _mm_set1_epi8(42)));
+		optr += 16;
+	}
+	else if (!DecodeYencBlockSsse3(data, optr))
+	{
+		return false;
+	}
+	iptr += 16;
+	return true;
+}
+
+__attribute__((target("avx2")))
+static int DecodeYencLineAvx2(const char* buffer, int len, char* output)
+{
+	const char* iptr = buffer;
+	const char* end = buffer + len;
+	char* optr = output;
+
+	const __m256i escChar = _mm256_set1_epi8('=');
+	const __m256i crChar = _mm256_set1_epi8('\r');
+	const __m256i lfChar = _mm256_set1_epi8('\n');
+	const __m256i zeroChar = _mm256_setzero_si256();
+	const __m256i offset = _mm256_set1_epi8(42);
+
+	while (iptr + 32 <= end)
+	{
+		__m256i data = _mm256_loadu_si256((const __m256i*)iptr);
+		__m256i special = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(data, escChar), _mm256_cmpeq_epi8(data, zeroChar)),
+			_mm256_or_si256(_mm256_cmpeq_epi8(data, crChar), _mm256_cmpeq_epi8(data, lfChar)));
+		uint32 mask = (uint32)_mm256_movemask_epi8(special);
+
+		if (mask == 0)
+		{
+			_mm256_storeu_si256((__m256i*)optr, _mm256_sub_epi8(data, offset));
+			iptr += 32;
+			optr += 32;
+			continue;
+		}
+
+		// process each half of the block separately; if the first half needs
+		// scalar processing the second half is reloaded on the next iteration
+		if (!DecodeYencHalfAvx2(_mm256_castsi256_si128(data), mask & 0xFFFF, iptr, optr))
+		{
+			if (!DecodeYencScalar(iptr, iptr + 16, end, optr))
 			{
-				case '=':	//escape-sequence
-					iptr++;
-					*optr = *iptr - 64 - 42;
-					optr++;
-					break;
-				case '\n':	// ignored char
-				case '\r':	// ignored char
-					break;
-				case '\0':
-					goto BreakLoop;
-				default:	// normal char
-					*optr = *iptr - 42;
-					optr++;
-					break;
+				return optr - output;
 			}
-			iptr++;
+			continue;
 		}
-BreakLoop:
 
+		if (!DecodeYencHalfAvx2(_mm256_extracti128_si256(data, 1), mask >> 16, iptr, optr) &&
+			!DecodeYencScalar(iptr, iptr + 16, end, optr))
+		{
+			return optr - output;
+		}
+	}
+
+	DecodeYencScalar(iptr, end, end, optr);
+	return optr - output;
+}
+#endif
+
+#ifdef HAVE_ARM_SIMD
+static int DecodeYencLineNeon(const char* buffer, int len, char* output)
+{
+	const char* iptr = buffer;
+	const char* end = buffer + len;
+	char* optr = output;
+
+	const uint8x16_t escChar = vdupq_n_u8('=');
+	const uint8x16_t crChar = vdupq_n_u8('\r');
+	const uint8x16_t lfChar = vdupq_n_u8('\n');
+	const uint8x16_t zeroChar = vdupq_n_u8(0);
+	const uint8x16_t offset = vdupq_n_u8(42);
+
+	while (iptr + 16 <= end)
+	{
+		uint8x16_t data = vld1q_u8((const uint8*)iptr);
+		uint8x16_t special = vorrq_u8(
+			vorrq_u8(vceqq_u8(data, escChar), vceqq_u8(data, zeroChar)),
+			vorrq_u8(vceqq_u8(data, crChar), vceqq_u8(data, lfChar)));
+
+		if (vmaxvq_u8(special) == 0)
+		{
+			vst1q_u8((uint8*)optr, vsubq_u8(data, offset));
+			iptr += 16;
+			optr += 16;
+		}
+		else if (!DecodeYencScalar(iptr, iptr + 16, end, optr))
+		{
+			return optr - output;
+		}
+	}
+
+	DecodeYencScalar(iptr, end, end, optr);
+	return optr - output;
+}
+#endif
+
+static DecodeLineFunc GetDecodeLineFunc(YDecoder::EImpl impl)
+{
+	switch (impl)
+	{
+#ifdef HAVE_X86_SIMD
+		case YDecoder::yiSse2:
+			return DecodeYencLineSse2;
+		case YDecoder::yiSsse3:
+			return DecodeYencLineSsse3;
+		case YDecoder::yiAvx2:
+			return DecodeYencLineAvx2;
+#endif
+#ifdef HAVE_ARM_SIMD
+		case YDecoder::yiNeon:
+			return DecodeYencLineNeon;
+#endif
+		default:
+			return DecodeYencLineScalar;
+	}
+}
+
+bool YDecoder::IsImplSupported(EImpl impl)
+{
+	switch (impl)
+	{
+		case yiScalar:
+			return true;
+#ifdef HAVE_X86_SIMD
+		case yiSse2:
+			return CpuFeatures::HasSse2();
+		case yiSsse3:
+			return CpuFeatures::HasSsse3();
+		case yiAvx2:
+			return CpuFeatures::HasAvx2();
+#endif
+#ifdef HAVE_ARM_SIMD
+		case yiNeon:
+			return CpuFeatures::HasNeon();
+#endif
+		default:
+			return false;
+	}
+}
+
+YDecoder::EImpl YDecoder::GetBestImpl()
+{
+	const EImpl preferred[] = { yiAvx2, yiSsse3, yiSse2, yiNeon };
+	for (int i = 0; i < (int)(sizeof(preferred) / sizeof(EImpl)); i++)
+	{
+		if (IsImplSupported(preferred[i]))
+		{
+			return preferred[i];
+		}
+	}
+	return yiScalar;
+}
+
+int YDecoder::DecodeLine(char* buffer, int len, EImpl impl)
+{
+	if (!IsImplSupported(impl))
+	{
+		impl = yiScalar;
+	}
+	return GetDecodeLineFunc(impl)(buffer, len, buffer);
+}
+
+int YDecoder::DecodeBuffer(char* buffer, int len)
+{
+	if (m_body && !m_end)
+	{
+		if (!strncmp(buffer, "=yend ", 6))
+		{
+			ProcessEnd(buffer);
+			return 0;
+		}
+
+		static DecodeLineFunc decodeLine = GetDecodeLineFunc(GetBestImpl());
+		len = decodeLine(buffer, len, buffer);
+
+		// the decoded data is still in cache, checksum it right away
 		if (m_crcCheck)
 		{
-			m_calculatedCRC = Util::Crc32m(m_calculatedCRC, (uchar *)buffer, (uint32)(optr - buffer));
+			m_crcStream.Update((uchar *)buffer, (uint32)len);
 		}
-		return optr - buffer;
+		return len;
 	}
 	else
 	{
@@ -217,9 +581,138 @@ BreakLoop:
 	return 0;
 }
 
+void YDecoder::ProcessEnd(const char* buffer)
+{
+	m_end = true;
+	const char* pb = strstr(buffer, m_part ? " pcrc32=" : " crc32=");
+	if (pb)
+	{
+		m_crc = true;
+		pb += 7 + (int)m_part; //=strlen(" crc32=") or strlen(" pcrc32=")
+		m_expectedCRC = strtoul(pb, NULL, 16);
+	}
+	pb = strstr(buffer, " size=");
+	if (pb)
+	{
+		pb += 6; //=strlen(" size=")
+		m_endSize = (int64)atoll(pb);
+	}
+}
+
+int YDecoder::DecodeStream(char* buffer, int len, int* consumed)
+{
+	static DecodeLineFunc decodeLine = GetDecodeLineFunc(GetBestImpl());
+
+	const char* iptr = buffer;
+	const char* end = buffer + len;
+	char* optr = buffer;
+
+	while (iptr < end && !m_eof)
+	{
+		int avail = (int)(end - iptr);
+
+		if (m_lineStart && *iptr == '.')
+		{
+			// end of article or a line starting with "." (marked as "..")
+			if (avail < 2 || (avail < 3 && iptr[1] == '\r'))
+			{
+				break;
+			}
+			if (iptr[1] == '\n' || (iptr[1] == '\r' && iptr[2] == '\n'))
+			{
+				iptr += iptr[1] == '\n' ? 2 : 3;
+				m_eof = true;
+				break;
+			}
+			if (iptr[1] == '.')
+			{
+				iptr++;
+			}
+		}
+
+		bool endLine = m_lineStart && *iptr == '=' && !strncmp(iptr, "=yend ", avail < 6 ? avail : 6);
+		if (endLine && avail < 6)
+		{
+			break;
+		}
+
+		if (m_end || endLine)
+		{
+			// lines after "=yend" are ignored, the "=yend"-line itself is
+			// parsed once it's complete
+			char* eol = (char*)memchr(iptr, '\n', avail);
+			if (!eol)
+			{
+				if (m_end)
+				{
+					iptr = end;
+					m_lineStart = false;
+				}
+				break;
+			}
+			if (!m_end)
+			{
+				*eol = '\0';
+				ProcessEnd(iptr);
+			}
+			iptr = eol + 1;
+			m_lineStart = true;
+			continue;
+		}
+
+		// find the range of lines which can be decoded in one go: it ends
+		// before the next line starting with a special character or at the end of buffer
+		const char* stop = iptr;
+		m_lineStart = false;
+		while (const char* eol = (const char*)memchr(stop, '\n', end - stop))
+		{
+			stop = eol + 1;
+			if (stop == end || *stop == '.' || *stop == '=')
+			{
+				m_lineStart = true;
+				break;
+			}
+		}
+		if (!m_lineStart)
+		{
+			stop = end;
+
+			// an escape-character at the end of buffer must be processed
+			// together with the escaped character from the next portion of data
+			const char* esc = stop;
+			while (esc > iptr && esc[-1] == '=')
+			{
+				esc--;
+			}
+			if ((stop - esc) % 2 == 1)
+			{
+				stop--;
+				if (stop == iptr)
+				{
+					break;
+				}
+			}
+		}
+
+		int decodedLen = decodeLine(iptr, (int)(stop - iptr), optr);
+
+		// the decoded data is still in cache, checksum it right away
+		if (m_crcCheck)
+		{
+			m_crcStream.Update((uchar *)optr, (uint32)decodedLen);
+		}
+
+		optr += decodedLen;
+		iptr = stop;
+	}
+
+	*consumed = (int)(iptr - buffer);
+	return (int)(optr - buffer);
+}
+
 Decoder::EStatus YDecoder::Check()
 {
-	m_calculatedCRC ^= 0xFFFFFFFF;
+	m_calculatedCRC = m_crcStream.Finish() ^ 0xFFFFFFFF;
 
 	debug("Expected crc32=%x", m_expectedCRC);
 	debug("Calculated crc32=%x", m_calculatedCRC);
@@ -26,6 +26,8 @@
 #ifndef DECODER_H
 #define DECODER_H
 
+#include "Util.h"
+
 class Decoder
 {
 public:
@@ -63,6 +65,18 @@ public:
 
 class YDecoder: public Decoder
 {
+public:
+	enum EImpl
+	{
+		yiScalar,
+		yiSse2,
+		yiSsse3,
+		yiAvx2,
+		yiNeon
+	};
+
+	static const char* ImplNames[];
+
 protected:
 	bool					m_begin;
 	bool					m_part;
@@ -71,11 +85,16 @@ protected:
 	bool					m_crc;
 	uint32					m_expectedCRC;
 	uint32					m_calculatedCRC;
+	Crc32Stream				m_crcStream;
 	int64					m_beginPos;
 	int64					m_endPos;
 	int64					m_size;
 	int64					m_endSize;
 	bool					m_crcCheck;
+	bool					m_lineStart;
+	bool					m_eof;
+
+	void					ProcessEnd(const char* buffer);
 
 public:
 							YDecoder();
@@ -88,6 +107,29 @@ public:
 	int64					GetSize() { return m_size; }
 	uint32					GetExpectedCrc() { return m_expectedCRC; }
 	uint32					GetCalculatedCrc() { return m_calculatedCRC; }
+	bool					GetBody() { return m_body; }
+	bool					GetEof() { return m_eof; }
+
+	/*
+	 * Decodes a portion of article body as received from the server, used
+	 * after the header lines were processed line by line via "DecodeBuffer".
+	 * Undoes dot-stuffing, processes the "=yend"-line and detects the end of
+	 * article (see "GetEof"), the data following the end of article isn't processed.
+	 * Decoded data is written at the beginning of the buffer (in place).
+	 * Returns the length of decoded data; "consumed" receives the number of
+	 * processed input bytes, the remaining bytes (incomplete escape sequence
+	 * or line start) must be passed again together with the following data.
+	 */
+	int						DecodeStream(char* buffer, int len, int* consumed);
+
+	/*
+	 * Decodes one line of yEnc-data in place, removing CR/LF-characters.
+	 * Decoding stops at the end of buffer or at the first zero character.
+	 * Returns the length of decoded data.
+	 */
+	static int				DecodeLine(char* buffer, int len, EImpl impl);
+	static bool				IsImplSupported(EImpl impl);
+	static EImpl			GetBestImpl();
 };
 
 class UDecoder: public Decoder
@@ -29,7 +29,7 @@
 
 NewsServer::NewsServer(int id, bool active, const char* name, const char* host, int port,
 	const char* user, const char* pass, bool joinGroup, bool tls,
-	const char* cipher, int maxConnections, int retention, int level, int group)
+	const char* cipher, int maxConnections, int retention, int pipelining, int level, int group)
 {
 	m_id = id;
 	m_stateId = 0;
@@ -46,6 +46,9 @@ NewsServer::NewsServer(int id, bool active, const char* name, const char* host,
 	m_password = strdup(pass ? pass : "");
 	m_cipher = strdup(cipher ? cipher : "");
 	m_retention = retention;
+	// pipelining can't be used together with group joining, which requires
+	// waiting for the response to command "GROUP" before sending article requests
+	m_pipelining = pipelining > 1 && !joinGroup ? pipelining : 1;
 	m_blockTime = 0;
 
 	if (name && strlen(name) > 0)
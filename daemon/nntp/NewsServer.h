@@ -46,13 +46,14 @@ private:
 	bool			m_tls;
 	char*			m_cipher;
 	int				m_retention;
+	int				m_pipelining;
 	time_t			m_blockTime;
 
 public:
 					NewsServer(int id, bool active, const char* name, const char* host, int port,
 						const char* user, const char* pass, bool joinGroup,
 						bool tls, const char* cipher, int maxConnections, int retention,
-						int level, int group);
+						int pipelining, int level, int group);
 					~NewsServer();
 	int				GetId() { return m_id; }
 	int				GetStateId() { return m_stateId; }
@@ -73,6 +74,7 @@ public:
 	bool			GetTls() { return m_tls; }
 	const char*		GetCipher() { return m_cipher; }
 	int				GetRetention() { return m_retention; }
+	int				GetPipelining() { return m_pipelining; }
 	time_t			GetBlockTime() { return m_blockTime; }
 	void			SetBlockTime(time_t blockTime) { m_blockTime = blockTime; }
 };
@@ -38,6 +38,8 @@ NntpConnection::NntpConnection(NewsServer* newsServer) : Connection(newsServer->
 	m_activeGroup = NULL;
 	m_lineBuf = (char*)malloc(CONNECTION_LINEBUFFER_SIZE);
 	m_authError = false;
+	m_nextTicket = 0;
+	m_reading = false;
 	SetCipher(newsServer->GetCipher());
 }
 
@@ -45,6 +47,11 @@ NntpConnection::~NntpConnection()
 {
 	free(m_activeGroup);
 	free(m_lineBuf);
+
+	for (Pipeline::iterator it = m_pipeline.begin(); it != m_pipeline.end(); it++)
+	{
+		free(it->request);
+	}
 }
 
 const char* NntpConnection::Request(const char* req)
@@ -206,7 +213,7 @@ const char* NntpConnection::JoinGroup(const char* grp)
 	return answer;
 }
 
-bool NntpConnection::Connect()
+bool NntpConnection::Open()
 {
 	debug("Opening connection to %s", GetHost());
 
@@ -225,14 +232,14 @@ bool NntpConnection::Connect()
 	if (!answer)
 	{
 		ReportErrorAnswer("Connection to %s (%s) failed: Connection closed by remote host", NULL);
-		Disconnect();
+		Close();
 		return false;
 	}
 
 	if (strncmp(answer, "2", 1))
 	{
 		ReportErrorAnswer("Connection to %s (%s) failed: %s", answer);
-		Disconnect();
+		Close();
 		return false;
 	}
 
@@ -247,20 +254,207 @@ bool NntpConnection::Connect()
 	return true;
 }
 
-bool NntpConnection::Disconnect()
+bool NntpConnection::Close()
 {
 	if (m_status == csConnected)
 	{
-		if (!m_broken)
+		// responses to pipelined requests would be read instead of response to "quit"
+		if (!m_broken && (m_pipeline.empty() || m_pipeline.front().request))
 		{
 			Request("quit\r\n");
 		}
 		free(m_activeGroup);
 		m_activeGroup = NULL;
 	}
+
+	// all pending requests are lost
+	for (Pipeline::iterator it = m_pipeline.begin(); it != m_pipeline.end(); it++)
+	{
+		free(it->request);
+	}
+	m_pipeline.clear();
+	m_reading = false;
+	m_turnCond.NotifyAll();
+
 	return Connection::Disconnect();
 }
 
+bool NntpConnection::Connect()
+{
+	m_pipelineMutex.Lock();
+	bool connected = Open();
+	m_pipelineMutex.Unlock();
+	return connected;
+}
+
+bool NntpConnection::Disconnect()
+{
+	m_pipelineMutex.Lock();
+	bool res = Close();
+	m_pipelineMutex.Unlock();
+	return res;
+}
+
+int NntpConnection::SendRequest(const char* req)
+{
+	m_pipelineMutex.Lock();
+
+	PipelineRequest request;
+	request.ticket = m_nextTicket++;
+	request.request = strdup(req);
+	request.discard = false;
+	m_pipeline.push_back(request);
+
+	m_pipelineMutex.Unlock();
+
+	return request.ticket;
+}
+
+/*
+ * Sends queued requests. Must be called with locked mutex by the thread
+ * reading responses or when no response is being read (to avoid concurrent
+ * access to the socket, which isn't supported by TLS-sockets).
+ */
+void NntpConnection::WriteRequests()
+{
+	for (Pipeline::iterator it = m_pipeline.begin(); it != m_pipeline.end(); it++)
+	{
+		PipelineRequest& request = *it;
+		if (request.request)
+		{
+			WriteLine(request.request);
+			free(request.request);
+			request.request = NULL;
+		}
+	}
+}
+
+/*
+ * Reads and discards the response to the first request in pipeline.
+ * Must be called with locked mutex.
+ */
+void NntpConnection::DiscardResponse()
+{
+	char* answer = ReadLine(m_lineBuf, CONNECTION_LINEBUFFER_SIZE, NULL);
+	if (answer && !strncmp(answer, "22", 2))
+	{
+		// multi-line response (article, head or body)
+		while ((answer = ReadLine(m_lineBuf, CONNECTION_LINEBUFFER_SIZE, NULL)) &&
+			strcmp(answer, ".\r\n") && strcmp(answer, ".\n")) ;
+	}
+
+	if (answer)
+	{
+		m_pipeline.pop_front();
+	}
+	else
+	{
+		m_broken = true;
+		Close();
+	}
+}
+
+/*
+ * Sends queued requests and discards responses nobody waits for anymore
+ * if no response is being read. Must be called with locked mutex.
+ */
+NntpConnection::ETurn NntpConnection::CheckTurn(int ticket)
+{
+	if (!m_reading)
+	{
+		WriteRequests();
+
+		while (!m_pipeline.empty() && m_pipeline.front().discard)
+		{
+			DiscardResponse();
+		}
+	}
+
+	for (Pipeline::iterator it = m_pipeline.begin(); it != m_pipeline.end(); it++)
+	{
+		if (it->ticket == ticket)
+		{
+			return it == m_pipeline.begin() && !m_reading ? ptReady : ptWait;
+		}
+	}
+
+	return ptLost;
+}
+
+NntpConnection::ETurn NntpConnection::WaitTurn(int ticket, int msec)
+{
+	m_pipelineMutex.Lock();
+
+	ETurn turn = CheckTurn(ticket);
+	if (turn == ptWait)
+	{
+		// woken up when the turn moves on or the connection is closed
+		m_turnCond.Wait(&m_pipelineMutex, msec);
+		turn = CheckTurn(ticket);
+	}
+
+	if (turn == ptReady)
+	{
+		m_reading = true;
+	}
+
+	m_pipelineMutex.Unlock();
+
+	return turn;
+}
+
+const char* NntpConnection::ReadResponse()
+{
+	char* answer = ReadLine(m_lineBuf, CONNECTION_LINEBUFFER_SIZE, NULL);
+
+	// authorization can't be performed in the middle of pipeline, the
+	// connection must be reestablished (with authorization on connect)
+	m_authError = answer && !strncmp(answer, "480", 3);
+
+	return answer;
+}
+
+void NntpConnection::FlushRequests()
+{
+	m_pipelineMutex.Lock();
+	WriteRequests();
+	m_pipelineMutex.Unlock();
+}
+
+void NntpConnection::FinishResponse(int ticket)
+{
+	m_pipelineMutex.Lock();
+
+	for (Pipeline::iterator it = m_pipeline.begin(); it != m_pipeline.end(); it++)
+	{
+		PipelineRequest& request = *it;
+		if (request.ticket == ticket)
+		{
+			if (request.request)
+			{
+				// not sent yet
+				free(request.request);
+				m_pipeline.erase(it);
+				m_turnCond.NotifyAll();
+			}
+			else if (it == m_pipeline.begin() && m_reading)
+			{
+				m_pipeline.pop_front();
+				WriteRequests();
+				m_reading = false;
+				m_turnCond.NotifyAll();
+			}
+			else
+			{
+				request.discard = true;
+			}
+			break;
+		}
+	}
+
+	m_pipelineMutex.Unlock();
+}
+
 void NntpConnection::ReportErrorAnswer(const char* msgPrefix, const char* answer)
 {
 	char errStr[1024];
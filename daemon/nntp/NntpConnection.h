@@ -29,20 +29,48 @@
 
 #include "NewsServer.h"
 #include "Connection.h"
+#include "Thread.h"
 
 class NntpConnection : public Connection
 {
+public:
+	enum ETurn
+	{
+		ptWait,
+		ptReady,
+		ptLost
+	};
+
 private:
+	struct PipelineRequest
+	{
+		int				ticket;
+		char*			request;	// NULL after the request was sent
+		bool			discard;
+	};
+
+	typedef std::deque<PipelineRequest>	Pipeline;
+
 	NewsServer*			m_newsServer;
 	char* 				m_activeGroup;
 	char*				m_lineBuf;
 	bool				m_authError;
+	Pipeline			m_pipeline;
+	Mutex				m_pipelineMutex;
+	ConditionVar		m_turnCond;
+	int					m_nextTicket;
+	bool				m_reading;
 
 	void				Clear();
 	void				ReportErrorAnswer(const char* msgPrefix, const char* answer);
 	bool 				Authenticate();
 	bool 				AuthInfoUser(int recur);
 	bool 				AuthInfoPass(int recur);
+	bool				Open();
+	bool				Close();
+	void				WriteRequests();
+	void				DiscardResponse();
+	ETurn				CheckTurn(int ticket);
 
 public:
 						NntpConnection(NewsServer* newsServer);
@@ -54,6 +82,26 @@ public:
 	const char*			JoinGroup(const char* grp);
 	bool				GetAuthError() { return m_authError; }
 
+	/*
+	 * Pipelining: the connection can be shared by several downloads, each
+	 * of them sends its request without waiting for responses to previous
+	 * requests; responses are read in the order of requests.
+	 * "SendRequest" queues the request and returns a ticket for it.
+	 * "WaitTurn" waits (up to given time) until the responses to all previous
+	 * requests were read and it's the turn to read the response to the given
+	 * request via "ReadResponse" (or until the request was lost because the
+	 * connection was closed). While reading the response "FlushRequests" should be
+	 * called regularly to send the requests queued in the meantime.
+	 * "FinishResponse" gives the turn to the next request. If it is called
+	 * before the turn was obtained the response is discarded.
+	 * If the response couldn't be read completely the connection must be closed.
+	 */
+	int					SendRequest(const char* req);
+	ETurn				WaitTurn(int ticket, int msec);
+	const char*			ReadResponse();
+	void				FlushRequests();
+	void				FinishResponse(int ticket);
+
 };
 
 #endif
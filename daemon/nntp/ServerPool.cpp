@@ -31,7 +31,7 @@ static const int CONNECTION_HOLD_SECODNS = 5;
 
 ServerPool::PooledConnection::PooledConnection(NewsServer* server) : NntpConnection(server)
 {
-	m_inUse = false;
+	m_useCount = 0;
 	m_freeTime = 0;
 }
 
@@ -172,7 +172,8 @@ void ServerPool::InitConnections()
 					connections++;
 				}
 
-				m_levels[normLevel] += connections;
+				// with pipelining each connection can be used by several downloads
+				m_levels[normLevel] += connections * newsServer->GetPipelining();
 			}
 		}
 	}
@@ -198,7 +199,7 @@ NntpConnection* ServerPool::GetConnection(int level, NewsServer* wantServer, Ser
 		{
 			PooledConnection* candidateConnection = *it;
 			NewsServer* candidateServer = candidateConnection->GetNewsServer();
-			if (!candidateConnection->GetInUse() && candidateServer->GetActive() &&
+			if (candidateConnection->GetUseCount() < candidateServer->GetPipelining() && candidateServer->GetActive() &&
 				candidateServer->GetNormLevel() == level &&
 				(!wantServer || candidateServer == wantServer ||
 				 (wantServer->GetGroup() > 0 && wantServer->GetGroup() == candidateServer->GetGroup())) &&
@@ -235,12 +236,31 @@ NntpConnection* ServerPool::GetConnection(int level, NewsServer* wantServer, Ser
 
 		if (!candidates.empty())
 		{
+			// With pipelining the connections are shared; prefer connections with
+			// less downloads in order to use all connections in parallel.
+			int minUseCount = candidates[0]->GetUseCount();
+			for (Connections::iterator it = candidates.begin(); it != candidates.end(); it++)
+			{
+				minUseCount = std::min(minUseCount, (*it)->GetUseCount());
+			}
+			for (Connections::iterator it = candidates.begin(); it != candidates.end(); )
+			{
+				if ((*it)->GetUseCount() > minUseCount)
+				{
+					it = candidates.erase(it);
+				}
+				else
+				{
+					it++;
+				}
+			}
+
 			// Peeking a random free connection. This is better than taking the first
 			// available connection because provides better distribution across news servers,
 			// especially when one of servers becomes unavailable or doesn't have requested articles.
 			int randomIndex = rand() % candidates.size();
 			connection = candidates[randomIndex];
-			connection->SetInUse(true);
+			connection->AddUse(1);
 		}
 
 		if (connection)
@@ -263,7 +283,7 @@ void ServerPool::FreeConnection(NntpConnection* connection, bool used)
 
 	m_connectionsMutex.Lock();
 
-	((PooledConnection*)connection)->SetInUse(false);
+	((PooledConnection*)connection)->AddUse(-1);
 	if (used)
 	{
 		((PooledConnection*)connection)->SetFreeTimeNow();
@@ -416,7 +436,7 @@ void ServerPool::LogDebugInfo()
 		info("      %i) %s (%s): Level=%i, NormLevel=%i, InUse:%i", connection->GetNewsServer()->GetId(),
 			connection->GetNewsServer()->GetName(), connection->GetNewsServer()->GetHost(),
 			connection->GetNewsServer()->GetLevel(), connection->GetNewsServer()->GetNormLevel(),
-			(int)connection->GetInUse());
+			connection->GetUseCount());
 	}
 
 	m_connectionsMutex.Unlock();
@@ -38,12 +38,13 @@ private:
 	class PooledConnection : public NntpConnection
 	{
 	private:
-		bool			m_inUse;
+		int				m_useCount;
 		time_t			m_freeTime;
 	public:
 						PooledConnection(NewsServer* server);
-		bool			GetInUse() { return m_inUse; }
-		void			SetInUse(bool inUse) { m_inUse = inUse; }
+		bool			GetInUse() { return m_useCount > 0; }
+		int				GetUseCount() { return m_useCount; }
+		void			AddUse(int delta) { m_useCount += delta; }
 		time_t			GetFreeTime() { return m_freeTime; }
 		void			SetFreeTimeNow() { m_freeTime = ::time(NULL); }
 	};
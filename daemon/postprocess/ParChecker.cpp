@@ -47,30 +47,46 @@ const char* Par2CmdLineErrStr[] = { "OK",
 	"internal error occurred",
 	"out of memory" };
 
-// Sleep interval for synchronisation (microseconds)
-#ifdef WIN32
-// Windows doesn't allow sleep intervals less than one millisecond
-#define SYNC_SLEEP_INTERVAL 1000
-#else
-#define SYNC_SLEEP_INTERVAL 100
-#endif
-
-class RepairThread;
-
-class Repairer : public Par2Repairer
+class Repairer : public Par2Repairer, public ParallelJob
 {
 private:
-	typedef vector<Thread*> Threads;
+	class FileHasher : public ParallelJob
+	{
+	private:
+		Repairer*		m_owner;
+		std::vector<FileHashes*>*	m_files;
+
+	public:
+						FileHasher(Repairer* owner, std::vector<FileHashes*>* files) :
+							m_owner(owner), m_files(files) {}
+		virtual void	Execute(int begin, int end);
+	};
+
+	class RowRunner : public RSRowRunner, public ParallelJob
+	{
+	private:
+		Repairer*		m_owner;
+		int				m_threads;
+		RSRowJob*		m_job;
+
+	public:
+						RowRunner(Repairer* owner, int threads) :
+							m_owner(owner), m_threads(threads), m_job(NULL) {}
+		virtual void	Run(RSRowJob* job, u32 count);
+		virtual void	Execute(int begin, int end);
+	};
 
 	CommandLine		commandLine;
 	ParChecker*		m_owner;
-	Threads			m_threads;
-	bool			m_parallel;
+	int				m_threads;
+	u32				m_inputindex;
+	u32				m_inputcount;
+	size_t			m_blocklength;
 	Mutex			progresslock;
 
 	virtual void	BeginRepair();
-	virtual void	EndRepair();
-	void			RepairBlock(u32 inputindex, u32 outputindex, size_t blocklength);
+	virtual void	Execute(int begin, int end);
+	int				GetMaxThreads();
 
 protected:
 	virtual void	sig_filename(std::string filename) { m_owner->signal_filename(filename); }
@@ -79,33 +95,16 @@ protected:
 
 	virtual bool	ScanDataFile(DiskFile *diskfile, Par2RepairerSourceFile* &sourcefile,
 		MatchType &matchtype, MD5Hash &hashfull, MD5Hash &hash16k, u32 &count);
-	virtual bool	RepairData(u32 inputindex, size_t blocklength);
+	virtual bool	RepairData(u32 inputindex, u32 inputcount, size_t blocklength);
+	virtual void	HashDataFiles(std::vector<FileHashes*>& files);
+	virtual bool	ComputeRSmatrix();
 
 public:
-					Repairer(ParChecker* owner) { m_owner = owner; }
+					Repairer(ParChecker* owner) { m_owner = owner; m_threads = 1; }
 	Result			PreProcess(const char *parFilename);
 	Result			Process(bool dorepair);
 
 	friend class ParChecker;
-	friend class RepairThread;
-};
-
-class RepairThread : public Thread
-{
-private:
-	Repairer*		m_owner;
-	u32				m_inputindex;
-	u32				m_outputindex;
-	size_t			m_blocklength;
-	volatile bool	m_working;
-
-protected:
-	virtual void	Run();
-
-public:
-					RepairThread(Repairer* owner) { this->m_owner = owner; m_working = false; }
-	void			RepairBlock(u32 inputindex, u32 outputindex, size_t blocklength);
-	bool			IsWorking() { return m_working; }
 };
 
 Result Repairer::PreProcess(const char *parFilename)
@@ -141,6 +140,11 @@ Result Repairer::PreProcess(const char *parFilename)
 		}
 	}
 
+	// data files are verified one after another but the hashes of
+	// as many files as there are threads are computed at once;
+	// the hashes may also have been computed during download
+	hashbatchsize = GetMaxThreads();
+
 	return Par2Repairer::PreProcess(commandLine);
 }
 
@@ -182,117 +186,131 @@ bool Repairer::ScanDataFile(DiskFile *diskfile, Par2RepairerSourceFile* &sourcef
 	return Par2Repairer::ScanDataFile(diskfile, sourcefile, matchtype, hashfull, hash16k, count);
 }
 
-void Repairer::BeginRepair()
+int Repairer::GetMaxThreads()
 {
 	int maxThreads = g_Options->GetParThreads() > 0 ? g_Options->GetParThreads() : Util::NumberOfCpuCores();
-	maxThreads = maxThreads > 0 ? maxThreads : 1;
-
-	int threads = maxThreads > (int)missingblockcount ? (int)missingblockcount : maxThreads;
-
-	m_owner->PrintMessage(Message::mkInfo, "Using %i of max %i thread(s) to repair %i block(s) for %s",
-		threads, maxThreads, (int)missingblockcount, m_owner->m_nzbName);
-
-	m_parallel = threads > 1;
+	return maxThreads > 0 ? maxThreads : 1;
+}
 
-	if (m_parallel)
-	{
-		for (int i = 0; i < threads; i++)
+void Repairer::HashDataFiles(std::vector<FileHashes*>& files)
+{
+	// files which are going to be quickly verified don't need the hashes
+	std::vector<FileHashes*> fullFiles;
+	for (std::vector<FileHashes*>::iterator it = files.begin(); it != files.end(); it++)
+	{
+		// the hashes computed in advance are of the files before repair
+		if (!(m_owner->GetParQuick() && (*it)->sourcefile) &&
+			!(m_owner->GetStage() == ParChecker::ptVerifyingSources &&
+			  m_owner->TakeFileHashes(*it, mainpacket->BlockSize())))
 		{
-			RepairThread* repairThread = new RepairThread(this);
-			m_threads.push_back(repairThread);
-			repairThread->SetAutoDestroy(true);
-			repairThread->Start();
+			fullFiles.push_back(*it);
 		}
+	}
 
-#ifdef WIN32
-		timeBeginPeriod(1);
-#endif
+	// with one thread the files are hashed during the verification
+	// to not read them twice
+	if (fullFiles.empty() || GetMaxThreads() == 1)
+	{
+		return;
 	}
+
+	FileHasher hasher(this, &fullFiles);
+	m_owner->m_workerPool.Run(&hasher, (int)fullFiles.size(), (int)fullFiles.size(), 1);
 }
 
-void Repairer::EndRepair()
+void Repairer::FileHasher::Execute(int begin, int end)
 {
-	if (m_parallel)
+	for (int i = begin; i < end; i++)
 	{
-		for (Threads::iterator it = m_threads.begin(); it != m_threads.end(); it++)
-		{
-			RepairThread* repairThread = (RepairThread*)*it;
-			repairThread->Stop();
-		}
-
-#ifdef WIN32
-		timeEndPeriod(1);
-#endif
+		m_owner->ComputeFileHashes((*m_files)[i]);
 	}
 }
 
-bool Repairer::RepairData(u32 inputindex, size_t blocklength)
+bool Repairer::ComputeRSmatrix()
 {
-	if (!m_parallel)
-	{
-		return false;
-	}
+	// the rows of the matrix are eliminated in several threads
+	int maxThreads = GetMaxThreads();
+	RowRunner rowRunner(this, maxThreads);
+	rs.SetRowRunner(maxThreads > 1 ? &rowRunner : NULL);
 
-	for (u32 outputindex = 0; outputindex < missingblockcount; )
-	{
-		bool jobAdded = false;
-		for (Threads::iterator it = m_threads.begin(); it != m_threads.end(); it++)
-		{
-			RepairThread* repairThread = (RepairThread*)*it;
-			if (!repairThread->IsWorking())
-			{
-				repairThread->RepairBlock(inputindex, outputindex, blocklength);
-				outputindex++;
-				jobAdded = true;
-				break;
-			}
-		}
+	int64 start = Util::GetCurrentTicks();
+	bool ok = Par2Repairer::ComputeRSmatrix();
+	int64 elapsed = Util::GetCurrentTicks() - start;
 
-		if (cancelled)
-		{
-			break;
-		}
+	rs.SetRowRunner(NULL);
 
-		if (!jobAdded)
-		{
-			usleep(SYNC_SLEEP_INTERVAL);
-		}
-	}
+	m_owner->PrintMessage(Message::mkInfo, "Computed repair matrix for %i block(s) in %.2f sec for %s",
+		(int)missingblockcount, elapsed / 1000000.0, m_owner->m_nzbName);
+
+	return ok;
+}
+
+void Repairer::RowRunner::Run(RSRowJob* job, u32 count)
+{
+	m_job = job;
+	int grain = std::max(1, (int)count / (m_threads * 4));
+	m_owner->m_owner->m_workerPool.Run(this, (int)count, m_threads, grain);
+}
+
+void Repairer::RowRunner::Execute(int begin, int end)
+{
+	m_job->Execute((u32)begin, (u32)end);
+}
+
+void Repairer::BeginRepair()
+{
+	int maxThreads = GetMaxThreads();
+
+	int threads = maxThreads > (int)missingblockcount ? (int)missingblockcount : maxThreads;
+
+	m_owner->PrintMessage(Message::mkInfo, "Using %i of max %i thread(s) to repair %i block(s) for %s",
+		threads, maxThreads, (int)missingblockcount, m_owner->m_nzbName);
+
+	m_threads = threads;
+}
 
-	// Wait until all m_Threads complete their jobs
-	bool working = true;
-	while (working)
+bool Repairer::RepairData(u32 inputindex, u32 inputcount, size_t blocklength)
+{
+	if (m_threads <= 1)
 	{
-		working = false;
-		for (Threads::iterator it = m_threads.begin(); it != m_threads.end(); it++)
-		{
-			RepairThread* repairThread = (RepairThread*)*it;
-			if (repairThread->IsWorking())
-			{
-				working = true;
-				usleep(SYNC_SLEEP_INTERVAL);
-				break;
-			}
-		}
+		return false;
 	}
 
+	// each thread takes a range of output blocks, several ranges per thread for load balancing
+	m_inputindex = inputindex;
+	m_inputcount = inputcount;
+	m_blocklength = blocklength;
+	int grain = std::max(1, (int)missingblockcount / (m_threads * 4));
+	m_owner->m_workerPool.Run(this, (int)missingblockcount, m_threads, grain);
+
 	return true;
 }
 
-void Repairer::RepairBlock(u32 inputindex, u32 outputindex, size_t blocklength)
+void Repairer::Execute(int begin, int end)
 {
-	// Select the appropriate part of the output buffer
-	void *outbuf = &((u8*)outputbuffer)[chunksize * outputindex];
+	if (cancelled)
+	{
+		return;
+	}
+
+	for (int outputindex = begin; outputindex < end; outputindex += tileoutputs)
+	{
+		u32 outputcount = std::min((u32)(end - outputindex), tileoutputs);
 
-	// Process the data
-	rs.Process(blocklength, inputindex, inputbuffer, outputindex, outbuf);
+		// Select the appropriate part of the output buffer
+		void *outbuf = &((u8*)outputbuffer)[chunksize * outputindex];
+
+		// Process the data
+		rs.ProcessBlocks(m_blocklength, m_inputindex, m_inputcount, inputbuffer, (size_t)chunksize,
+			outputindex, outputcount, outbuf, (size_t)chunksize, tilesize);
+	}
 
 	if (noiselevel > CommandLine::nlQuiet)
 	{
 		// Update a progress indicator
 		progresslock.Lock();
 		u32 oldfraction = (u32)(1000 * progress / totaldata);
-		progress += blocklength;
+		progress += (u64)m_blocklength * m_inputcount * (end - begin);
 		u32 newfraction = (u32)(1000 * progress / totaldata);
 		progresslock.Unlock();
 
@@ -303,30 +321,6 @@ void Repairer::RepairBlock(u32 inputindex, u32 outputindex, size_t blocklength)
 	}
 }
 
-void RepairThread::Run()
-{
-	while (!IsStopped())
-	{
-		if (m_working)
-		{
-			m_owner->RepairBlock(m_inputindex, m_outputindex, m_blocklength);
-			m_working = false;
-		}
-		else
-		{
-			usleep(SYNC_SLEEP_INTERVAL);
-		}
-	}
-}
-
-void RepairThread::RepairBlock(u32 inputindex, u32 outputindex, size_t blocklength)
-{
-	m_inputindex = inputindex;
-	m_outputindex = outputindex;
-	m_blocklength = blocklength;
-	m_working = true;
-}
-
 
 class MissingFilesComparator
 {
@@ -366,6 +360,29 @@ ParChecker::Segment::Segment(bool success, int64 offset, int size, uint32 crc)
 	m_crc = crc;
 }
 
+void ParChecker::Segment::AddSplit(int64 splitOffset, uint32 headCrc, uint32 tailCrc)
+{
+	Split split;
+	split.offset = splitOffset;
+	split.headCrc = headCrc;
+	split.tailCrc = tailCrc;
+	m_splits.push_back(split);
+}
+
+bool ParChecker::Segment::FindSplit(int64 splitOffset, uint32* headCrc, uint32* tailCrc)
+{
+	for (Splits::iterator it = m_splits.begin(); it != m_splits.end(); it++)
+	{
+		if (it->offset == splitOffset)
+		{
+			*headCrc = it->headCrc;
+			*tailCrc = it->tailCrc;
+			return true;
+		}
+	}
+	return false;
+}
+
 
 ParChecker::SegmentList::~SegmentList()
 {
@@ -1654,14 +1671,22 @@ bool ParChecker::SmartCalcFileRangeCrc(FILE* file, int64 start, int64 end, Segme
 {
 	uint32 downloadCrc = 0;
 	bool started = false;
-	for (SegmentList::iterator it = segments->begin(); it != segments->end(); it++)
+	Segment* prevSegment = NULL;
+	for (SegmentList::iterator it = segments->begin(); it != segments->end(); prevSegment = *it, it++)
 	{
 		Segment* segment = *it;
+		uint32 headCrc, tailCrc;
 
 		if (!started && segment->GetOffset() > start)
 		{
-			// read start of range from file
-			if (!DumbCalcFileRangeCrc(file, start, segment->GetOffset() - 1, &downloadCrc))
+			// start of range is the end of previous segment: take its CRC from
+			// the split of the segment or read it from file
+			if (prevSegment && prevSegment->GetOffset() + prevSegment->GetSize() == segment->GetOffset() &&
+				prevSegment->FindSplit(start, &headCrc, &tailCrc))
+			{
+				downloadCrc = tailCrc;
+			}
+			else if (!DumbCalcFileRangeCrc(file, start, segment->GetOffset() - 1, &downloadCrc))
 			{
 				return false;
 			}
@@ -1685,9 +1710,14 @@ bool ParChecker::SmartCalcFileRangeCrc(FILE* file, int64 start, int64 end, Segme
 
 		if (segment->GetOffset() + segment->GetSize() > end)
 		{
-			// read end of range from file
+			// end of range is the start of the segment: take its CRC from
+			// the split of the segment or read it from file
 			uint32 partialCrc = 0;
-			if (!DumbCalcFileRangeCrc(file, segment->GetOffset(), end, &partialCrc))
+			if (segment->FindSplit(end + 1, &headCrc, &tailCrc))
+			{
+				partialCrc = headCrc;
+			}
+			else if (!DumbCalcFileRangeCrc(file, segment->GetOffset(), end, &partialCrc))
 			{
 				return false;
 			}
@@ -61,10 +61,20 @@ public:
 	class Segment
 	{
 	private:
+		struct Split
+		{
+			int64			offset;
+			uint32			headCrc;
+			uint32			tailCrc;
+		};
+
+		typedef std::vector<Split>	Splits;
+
 		bool				m_success;
 		int64				m_offset;
 		int					m_size;
 		uint32				m_crc;
+		Splits				m_splits;
 
 	public:
 							Segment(bool success, int64 offset, int size, uint32 crc);
@@ -72,6 +82,12 @@ public:
 		int64				GetOffset() { return m_offset; }
 		int 				GetSize() { return m_size; }
 		uint32				GetCrc() { return m_crc; }
+		/*
+		 * CRCs of the parts of the segment before and after the file offset "splitOffset"
+		 * (known if the segment was still in memory when it was written)
+		 */
+		void				AddSplit(int64 splitOffset, uint32 headCrc, uint32 tailCrc);
+		bool				FindSplit(int64 splitOffset, uint32* headCrc, uint32* tailCrc);
 	};
 
 	typedef std::deque<Segment*>	SegmentListBase;
@@ -136,6 +152,7 @@ private:
 	bool				m_forceRepair;
 	bool				m_parFull;
 	DupeSourceList		m_dupeSources;
+	WorkerPool			m_workerPool;
 
 	void				Cleanup();
 	EStatus				RunParCheckAll();
@@ -180,6 +197,12 @@ protected:
 	virtual EFileStatus	FindFileCrc(const char* filename, uint32* crc, SegmentList* segments) { return fsUnknown; }
 	virtual void		RequestDupeSources(DupeSourceList* dupeSourceList) {}
 	virtual void		StatDupeSources(DupeSourceList* dupeSourceList) {}
+	/**
+	* Fill the hashes of a data file computed in advance (for example during download)
+	* declared as void* to prevent the including of libpar2-headers into this header-file
+	* FileHashes* fileHashes
+	*/
+	virtual bool		TakeFileHashes(void* fileHashes, int64 blockSize) { return false; }
 	EStage				GetStage() { return m_stage; }
 	const char*			GetProgressLabel() { return m_progressLabel; }
 	int					GetFileProgress() { return m_fileProgress; }
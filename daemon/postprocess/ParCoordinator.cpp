@@ -115,6 +115,21 @@ ParChecker::EFileStatus ParCoordinator::PostParChecker::FindFileCrc(const char*
 			segments->push_back(segment);
 		}
 
+		// the parts of segments at block boundaries computed while the segments were cached
+		SegmentSplits* splits = completedFile->GetSegmentSplits();
+		for (SegmentSplits::iterator it = splits->begin(); it != splits->end(); it++)
+		{
+			for (SegmentList::iterator it2 = segments->begin(); it2 != segments->end(); it2++)
+			{
+				Segment* segment = *it2;
+				if (segment->GetOffset() == it->GetSegmentOffset() && segment->GetSize() == it->GetSegmentSize())
+				{
+					segment->AddSplit(it->GetSplitOffset(), it->GetHeadCrc(), it->GetTailCrc());
+					break;
+				}
+			}
+		}
+
 		delete tmpFileInfo;
 	}
 
@@ -126,6 +141,11 @@ ParChecker::EFileStatus ParCoordinator::PostParChecker::FindFileCrc(const char*
 		ParChecker::fsUnknown;
 }
 
+bool ParCoordinator::PostParChecker::TakeFileHashes(void* fileHashes, int64 blockSize)
+{
+	return m_owner->m_parVerifier.TakeFileHashes(m_postInfo->GetNzbInfo()->GetId(), blockSize, fileHashes);
+}
+
 void ParCoordinator::PostParChecker::RequestDupeSources(DupeSourceList* dupeSourceList)
 {
 	DownloadQueue* downloadQueue = DownloadQueue::Lock();
@@ -279,6 +299,22 @@ void ParCoordinator::Stop()
 			m_parChecker.Kill();
 		}
 	}
+
+	if (m_parVerifier.IsRunning())
+	{
+		m_parVerifier.Stop();
+		int mSecWait = 5000;
+		while (m_parVerifier.IsRunning() && mSecWait > 0)
+		{
+			usleep(50 * 1000);
+			mSecWait -= 50;
+		}
+		if (m_parVerifier.IsRunning())
+		{
+			warn("Terminating par-verifier");
+			m_parVerifier.Kill();
+		}
+	}
 }
 #endif
 
@@ -379,6 +415,76 @@ bool ParCoordinator::AddPar(FileInfo* fileInfo, bool deleted)
 	return sameCollection;
 }
 
+/**
+ * The full par-verification needs to read all files. During download the files
+ * are hashed in background as soon as they are completed so that the par-check
+ * can use the hashes later. The quick par-check uses the CRCs of articles instead
+ * and only needs the par-block size, to compute the CRCs of the parts of the
+ * cached segments divided by the block boundaries (see ArticleWriter::SplitSegment).
+ *
+ * DownloadQueue must be locked prior to call of this function.
+ */
+void ParCoordinator::FileDownloaded(NzbInfo* nzbInfo, FileInfo* fileInfo)
+{
+	if (g_Options->GetParQuick() && fileInfo->GetParFile() && nzbInfo->GetParBlockSize() == 0)
+	{
+		for (CompletedFiles::reverse_iterator it = nzbInfo->GetCompletedFiles()->rbegin(); it != nzbInfo->GetCompletedFiles()->rend(); it++)
+		{
+			CompletedFile* completedFile = *it;
+			if (completedFile->GetId() == fileInfo->GetId() && completedFile->GetStatus() == CompletedFile::cfSuccess)
+			{
+				char fullFilename[1024];
+				snprintf(fullFilename, 1024, "%s%c%s", nzbInfo->GetDestDir(), (int)PATH_SEPARATOR, completedFile->GetFileName());
+				fullFilename[1024-1] = '\0';
+
+				int64 blockSize;
+				if (ParVerifier::ReadBlockSize(fullFilename, &blockSize))
+				{
+					nzbInfo->SetParBlockSize(blockSize);
+				}
+				break;
+			}
+		}
+	}
+
+	if (m_stopped || g_Options->GetParQuick() || !g_Options->GetDecode() ||
+		g_Options->GetParCheck() == Options::pcManual ||
+		(g_Options->GetParCheck() == Options::pcAuto && !fileInfo->GetParFile() &&
+		 nzbInfo->GetFailedSize() - nzbInfo->GetParFailedSize() == 0))
+	{
+		// par-check isn't going to be performed (or quickly) as far as we know now
+		return;
+	}
+
+	for (CompletedFiles::reverse_iterator it = nzbInfo->GetCompletedFiles()->rbegin(); it != nzbInfo->GetCompletedFiles()->rend(); it++)
+	{
+		CompletedFile* completedFile = *it;
+		if (completedFile->GetId() == fileInfo->GetId())
+		{
+			if (completedFile->GetStatus() == CompletedFile::cfFailure)
+			{
+				break;
+			}
+
+			char fullFilename[1024];
+			snprintf(fullFilename, 1024, "%s%c%s", nzbInfo->GetDestDir(), (int)PATH_SEPARATOR, completedFile->GetFileName());
+			fullFilename[1024-1] = '\0';
+
+			if (!m_parVerifier.IsRunning())
+			{
+				m_parVerifier.Start();
+			}
+			m_parVerifier.FileCompleted(nzbInfo->GetId(), fullFilename, fileInfo->GetParFile());
+			break;
+		}
+	}
+}
+
+void ParCoordinator::NzbCompleted(NzbInfo* nzbInfo)
+{
+	m_parVerifier.Discard(nzbInfo->GetId());
+}
+
 void ParCoordinator::ParCheckCompleted()
 {
 	DownloadQueue* downloadQueue = DownloadQueue::Lock();
@@ -512,6 +618,9 @@ bool ParCoordinator::RequestMorePars(NzbInfo* nzbInfo, const char* parFilename,
 		}
 	}
 
+	// save unpaused files, this also lets queue coordinator schedule them for download
+	downloadQueue->Save();
+
 	DownloadQueue::Unlock();
 
 	if (blockFoundOut)
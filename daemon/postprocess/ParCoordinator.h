@@ -32,6 +32,7 @@
 #include "ParChecker.h"
 #include "ParRenamer.h"
 #include "DupeMatcher.h"
+#include "ParVerifier.h"
 #endif
 
 class ParCoordinator
@@ -56,6 +57,7 @@ private:
 		virtual EFileStatus	FindFileCrc(const char* filename, uint32* crc, SegmentList* segments);
 		virtual void	RequestDupeSources(DupeSourceList* dupeSourceList);
 		virtual void	StatDupeSources(DupeSourceList* dupeSourceList);
+		virtual bool	TakeFileHashes(void* fileHashes, int64 blockSize);
 	public:
 		PostInfo*		GetPostInfo() { return m_postInfo; }
 		void			SetPostInfo(PostInfo* postInfo) { m_postInfo = postInfo; }
@@ -119,6 +121,7 @@ private:
 	bool				m_stopped;
 	PostParRenamer		m_parRenamer;
 	EJobKind			m_currentJob;
+	ParVerifier			m_parVerifier;
 
 protected:
 	void				UpdateParCheckProgress();
@@ -136,6 +139,8 @@ public:
 
 #ifndef DISABLE_PARCHECK
 	bool				AddPar(FileInfo* fileInfo, bool deleted);
+	void				FileDownloaded(NzbInfo* nzbInfo, FileInfo* fileInfo);
+	void				NzbCompleted(NzbInfo* nzbInfo);
 	void				FindPars(DownloadQueue* downloadQueue, NzbInfo* nzbInfo, const char* parFilename,
 							Blocks* blocks, bool strictParName, bool exactParName, int* blockFound);
 	void				StartParCheckJob(PostInfo* postInfo);
@@ -0,0 +1,383 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+#include "nzbget.h"
+
+#ifndef DISABLE_PARCHECK
+
+#include "par2cmdline.h"
+#include "par2repairer.h"
+
+#include "ParVerifier.h"
+#include "Log.h"
+#include "Util.h"
+
+ParVerifier::Job::Job(int nzbId, const char* filename, bool parFile)
+{
+	m_nzbId = nzbId;
+	m_filename = strdup(filename);
+	m_parFile = parFile;
+}
+
+ParVerifier::Job::~Job()
+{
+	free(m_filename);
+}
+
+ParVerifier::HashedFile::HashedFile(int64 size, time_t modified, void* fileHashes)
+{
+	m_size = size;
+	m_modified = modified;
+	m_fileHashes = fileHashes;
+}
+
+ParVerifier::HashedFile::~HashedFile()
+{
+	delete (FileHashes*)m_fileHashes;
+}
+
+ParVerifier::NzbHashes::~NzbHashes()
+{
+	for (JobList::iterator it = m_waiting.begin(); it != m_waiting.end(); it++)
+	{
+		delete *it;
+	}
+	for (HashedFiles::iterator it = m_files.begin(); it != m_files.end(); it++)
+	{
+		delete *it;
+	}
+}
+
+ParVerifier::ParVerifier()
+{
+	debug("Creating ParVerifier");
+
+	m_currentNzbId = 0;
+	m_cancelled = false;
+}
+
+ParVerifier::~ParVerifier()
+{
+	debug("Destroying ParVerifier");
+
+	for (JobList::iterator it = m_jobs.begin(); it != m_jobs.end(); it++)
+	{
+		delete *it;
+	}
+	for (NzbList::iterator it = m_nzbs.begin(); it != m_nzbs.end(); it++)
+	{
+		delete *it;
+	}
+}
+
+void ParVerifier::Stop()
+{
+	Thread::Stop();
+	m_cancelled = true;
+
+	m_mutex.Lock();
+	m_jobCond.NotifyAll();
+	m_doneCond.NotifyAll();
+	m_mutex.Unlock();
+}
+
+void ParVerifier::Run()
+{
+	debug("Entering ParVerifier-loop");
+
+	m_mutex.Lock();
+	while (!IsStopped())
+	{
+		if (m_jobs.empty())
+		{
+			m_jobCond.Wait(&m_mutex);
+			continue;
+		}
+
+		Job* job = m_jobs.front();
+		m_jobs.pop_front();
+		m_currentNzbId = job->GetNzbId();
+
+		m_mutex.Unlock();
+		ProcessJob(job);
+		m_mutex.Lock();
+
+		m_currentNzbId = 0;
+		m_doneCond.NotifyAll();
+	}
+	m_mutex.Unlock();
+
+	debug("Exiting ParVerifier-loop");
+}
+
+void ParVerifier::FileCompleted(int nzbId, const char* filename, bool parFile)
+{
+	m_mutex.Lock();
+	m_jobs.push_back(new Job(nzbId, filename, parFile));
+	m_jobCond.NotifyOne();
+	m_mutex.Unlock();
+}
+
+void ParVerifier::Discard(int nzbId)
+{
+	m_mutex.Lock();
+
+	for (JobList::iterator it = m_jobs.begin(); it != m_jobs.end(); )
+	{
+		Job* job = *it;
+		if (job->GetNzbId() == nzbId)
+		{
+			delete job;
+			it = m_jobs.erase(it);
+		}
+		else
+		{
+			it++;
+		}
+	}
+
+	for (NzbList::iterator it = m_nzbs.begin(); it != m_nzbs.end(); it++)
+	{
+		NzbHashes* nzbHashes = *it;
+		if (nzbHashes->GetNzbId() == nzbId)
+		{
+			delete nzbHashes;
+			m_nzbs.erase(it);
+			break;
+		}
+	}
+
+	m_mutex.Unlock();
+}
+
+/*
+ * m_mutex must be locked prior to call of this function.
+ */
+bool ParVerifier::HasPendingJobs(int nzbId)
+{
+	if (m_currentNzbId == nzbId)
+	{
+		return true;
+	}
+
+	for (JobList::iterator it = m_jobs.begin(); it != m_jobs.end(); it++)
+	{
+		if ((*it)->GetNzbId() == nzbId)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * m_mutex must be locked prior to call of this function.
+ */
+ParVerifier::NzbHashes* ParVerifier::FindNzb(int nzbId, bool create)
+{
+	for (NzbList::iterator it = m_nzbs.begin(); it != m_nzbs.end(); it++)
+	{
+		NzbHashes* nzbHashes = *it;
+		if (nzbHashes->GetNzbId() == nzbId)
+		{
+			return nzbHashes;
+		}
+	}
+
+	if (!create)
+	{
+		return NULL;
+	}
+
+	NzbHashes* nzbHashes = new NzbHashes(nzbId);
+	m_nzbs.push_back(nzbHashes);
+	return nzbHashes;
+}
+
+void ParVerifier::ProcessJob(Job* job)
+{
+	if (job->GetParFile())
+	{
+		int64 blockSize = 0;
+		bool found = ReadBlockSize(job->GetFilename(), &blockSize);
+		debug("Par-file %s, block size: %lli", Util::BaseFileName(job->GetFilename()), found ? blockSize : 0);
+
+		m_mutex.Lock();
+		NzbHashes* nzbHashes = FindNzb(job->GetNzbId(), true);
+		if (found && nzbHashes->GetBlockSize() == 0)
+		{
+			// the files completed before the par-file can be hashed now
+			nzbHashes->SetBlockSize(blockSize);
+			m_jobs.insert(m_jobs.end(), nzbHashes->GetWaiting()->begin(), nzbHashes->GetWaiting()->end());
+			nzbHashes->GetWaiting()->clear();
+		}
+		m_mutex.Unlock();
+
+		delete job;
+		return;
+	}
+
+	m_mutex.Lock();
+	int64 blockSize = FindNzb(job->GetNzbId(), true)->GetBlockSize();
+	if (blockSize == 0)
+	{
+		FindNzb(job->GetNzbId(), true)->GetWaiting()->push_back(job);
+		m_mutex.Unlock();
+		return;
+	}
+	m_mutex.Unlock();
+
+	debug("Computing par-hashes for %s", job->GetFilename());
+
+	int64 size = 0;
+	time_t modified = 0;
+	FileHashes* fileHashes = new FileHashes(job->GetFilename(), NULL);
+	bool ok = FileStat(job->GetFilename(), &size, &modified) &&
+		Par2Repairer::ComputeFileHashes(fileHashes, (u64)blockSize, m_cancelled);
+
+	m_mutex.Lock();
+	// the nzb could have been discarded in the meantime
+	NzbHashes* nzbHashes = FindNzb(job->GetNzbId(), false);
+	if (ok && nzbHashes && nzbHashes->GetBlockSize() == blockSize)
+	{
+		nzbHashes->GetFiles()->push_back(new HashedFile(size, modified, fileHashes));
+		fileHashes = NULL;
+	}
+	m_mutex.Unlock();
+
+	delete fileHashes;
+	delete job;
+}
+
+bool ParVerifier::TakeFileHashes(int nzbId, int64 blockSize, void* fileHashes)
+{
+	FileHashes* targetHashes = (FileHashes*)fileHashes;
+
+	int64 size = 0;
+	time_t modified = 0;
+	if (!FileStat(targetHashes->filename.c_str(), &size, &modified))
+	{
+		return false;
+	}
+
+	bool found = false;
+
+	m_mutex.Lock();
+
+	while (IsRunning() && !IsStopped() && HasPendingJobs(nzbId))
+	{
+		m_doneCond.Wait(&m_mutex);
+	}
+
+	NzbHashes* nzbHashes = FindNzb(nzbId, false);
+	if (nzbHashes && nzbHashes->GetBlockSize() == blockSize)
+	{
+		for (HashedFiles::iterator it = nzbHashes->GetFiles()->begin(); it != nzbHashes->GetFiles()->end(); it++)
+		{
+			HashedFile* hashedFile = *it;
+			FileHashes* cachedHashes = (FileHashes*)hashedFile->GetFileHashes();
+			if (hashedFile->GetSize() == size && hashedFile->GetModified() == modified &&
+				!strcmp(Util::BaseFileName(cachedHashes->filename.c_str()), Util::BaseFileName(targetHashes->filename.c_str())))
+			{
+				targetHashes->hashfull = cachedHashes->hashfull;
+				targetHashes->hash16k = cachedHashes->hash16k;
+				targetHashes->blockchecksums.swap(cachedHashes->blockchecksums);
+				targetHashes->blockhashes.swap(cachedHashes->blockhashes);
+				targetHashes->computed = true;
+
+				delete hashedFile;
+				nzbHashes->GetFiles()->erase(it);
+				found = true;
+				break;
+			}
+		}
+	}
+
+	m_mutex.Unlock();
+
+	return found;
+}
+
+/*
+ * Finds the main packet in the par2-file; every par2-file of a set has one.
+ */
+bool ParVerifier::ReadBlockSize(const char* parFilename, int64* blockSize)
+{
+	DiskFile diskFile;
+	if (!diskFile.Open(parFilename))
+	{
+		return false;
+	}
+
+	u64 fileSize = diskFile.FileSize();
+	u64 offset = 0;
+	while (offset + sizeof(PACKET_HEADER) <= fileSize)
+	{
+		PACKET_HEADER header;
+		if (!diskFile.Read(offset, &header, sizeof(PACKET_HEADER)) ||
+			packet_magic != header.magic || header.length < sizeof(PACKET_HEADER) ||
+			header.length % 4 != 0 || offset + header.length > fileSize)
+		{
+			break;
+		}
+
+		if (mainpacket_type == header.type && header.length >= sizeof(MAINPACKET))
+		{
+			leu64 mainBlockSize;
+			if (diskFile.Read(offset + sizeof(PACKET_HEADER), &mainBlockSize, sizeof(mainBlockSize)) &&
+				mainBlockSize > 0 && mainBlockSize % 4 == 0)
+			{
+				*blockSize = (int64)mainBlockSize;
+				return true;
+			}
+			break;
+		}
+
+		offset += header.length;
+	}
+
+	return false;
+}
+
+bool ParVerifier::FileStat(const char* filename, int64* size, time_t* modified)
+{
+#ifdef WIN32
+	struct _stat32i64 buffer;
+	if (_stat32i64(filename, &buffer))
+#else
+	struct stat buffer;
+	if (stat(filename, &buffer))
+#endif
+	{
+		return false;
+	}
+
+	*size = buffer.st_size;
+	*modified = buffer.st_mtime;
+	return true;
+}
+
+#endif
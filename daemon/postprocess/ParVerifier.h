@@ -0,0 +1,133 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+#ifndef PARVERIFIER_H
+#define PARVERIFIER_H
+
+#ifndef DISABLE_PARCHECK
+
+#include "Thread.h"
+
+/*
+ * Computes the par-block hashes of downloaded files in background while
+ * the remaining files of the nzb are still downloading. The block size is
+ * taken from the first par2-file of the nzb, files completed before it are
+ * kept waiting. The par-checker later takes the hashes instead of reading
+ * the files again.
+ */
+class ParVerifier : public Thread
+{
+private:
+	class Job
+	{
+	private:
+		int					m_nzbId;
+		char*				m_filename;
+		bool				m_parFile;
+
+	public:
+							Job(int nzbId, const char* filename, bool parFile);
+							~Job();
+		int					GetNzbId() { return m_nzbId; }
+		const char*			GetFilename() { return m_filename; }
+		bool				GetParFile() { return m_parFile; }
+	};
+
+	typedef std::deque<Job*>	JobList;
+
+	class HashedFile
+	{
+	private:
+		int64				m_size;
+		time_t				m_modified;
+		// declared as void* to prevent the including of libpar2-headers into this header-file
+		void*				m_fileHashes;
+
+	public:
+							HashedFile(int64 size, time_t modified, void* fileHashes);
+							~HashedFile();
+		int64				GetSize() { return m_size; }
+		time_t				GetModified() { return m_modified; }
+		void*				GetFileHashes() { return m_fileHashes; }
+		void				SetFileHashes(void* fileHashes) { m_fileHashes = fileHashes; }
+	};
+
+	typedef std::deque<HashedFile*>	HashedFiles;
+
+	class NzbHashes
+	{
+	private:
+		int					m_nzbId;
+		int64				m_blockSize;
+		JobList				m_waiting;
+		HashedFiles			m_files;
+
+	public:
+							NzbHashes(int nzbId) : m_nzbId(nzbId), m_blockSize(0) {}
+							~NzbHashes();
+		int					GetNzbId() { return m_nzbId; }
+		int64				GetBlockSize() { return m_blockSize; }
+		void				SetBlockSize(int64 blockSize) { m_blockSize = blockSize; }
+		JobList*			GetWaiting() { return &m_waiting; }
+		HashedFiles*		GetFiles() { return &m_files; }
+	};
+
+	typedef std::deque<NzbHashes*>	NzbList;
+
+	JobList				m_jobs;
+	NzbList				m_nzbs;
+	Mutex				m_mutex;
+	ConditionVar		m_jobCond;
+	ConditionVar		m_doneCond;
+	int					m_currentNzbId;
+	bool				m_cancelled;
+
+	NzbHashes*			FindNzb(int nzbId, bool create);
+	bool				HasPendingJobs(int nzbId);
+	void				ProcessJob(Job* job);
+	bool				FileStat(const char* filename, int64* size, time_t* modified);
+
+protected:
+	virtual void		Run();
+
+public:
+						ParVerifier();
+	virtual				~ParVerifier();
+	virtual void		Stop();
+	void				FileCompleted(int nzbId, const char* filename, bool parFile);
+	void				Discard(int nzbId);
+	/*
+	 * Moves the hashes computed for the file (matched by name, size and modification time)
+	 * into "fileHashes"; returns false if there are no hashes for the file or if they
+	 * were computed for another block size. Waits for the files of the nzb which are
+	 * still being hashed.
+	 */
+	bool				TakeFileHashes(int nzbId, int64 blockSize, void* fileHashes);
+	static bool			ReadBlockSize(const char* parFilename, int64* blockSize);
+};
+
+#endif
+
+#endif
@@ -36,6 +36,7 @@
 #include "NzbFile.h"
 #include "QueueScript.h"
 #include "ParParser.h"
+#include "QueueCoordinator.h"
 
 PrePostProcessor::PrePostProcessor()
 {
@@ -145,6 +146,9 @@ void PrePostProcessor::DownloadQueueUpdate(Subject* Caller, void* Aspect)
 		if (queueAspect->action == DownloadQueue::eaFileCompleted && !queueAspect->nzbInfo->GetPostInfo())
 		{
 			g_QueueScriptCoordinator->EnqueueScript(queueAspect->nzbInfo, QueueScriptCoordinator::qeFileDownloaded);
+#ifndef DISABLE_PARCHECK
+			m_parCoordinator.FileDownloaded(queueAspect->nzbInfo, queueAspect->fileInfo);
+#endif
 		}
 
 		if (
@@ -265,6 +269,10 @@ void PrePostProcessor::NzbDeleted(DownloadQueue* downloadQueue, NzbInfo* nzbInfo
 
 void PrePostProcessor::NzbCompleted(DownloadQueue* downloadQueue, NzbInfo* nzbInfo, bool saveQueue)
 {
+#ifndef DISABLE_PARCHECK
+	m_parCoordinator.NzbCompleted(nzbInfo);
+#endif
+
 	bool addToHistory = g_Options->GetKeepHistory() > 0 && !nzbInfo->GetAvoidHistory();
 	if (addToHistory)
 	{
@@ -731,6 +739,7 @@ void PrePostProcessor::UpdatePauseState(bool needPause, const char* reason)
 	}
 	g_Options->SetTempPauseDownload(needPause);
 	m_pauseReason = reason;
+	g_QueueCoordinator->WakeUp();
 }
 
 bool PrePostProcessor::EditList(DownloadQueue* downloadQueue, IdList* idList, DownloadQueue::EEditAction action, int offset, const char* text)
@@ -210,6 +210,540 @@ FILE* StateFile::BeginReadTransaction()
 	return m_file;
 }
 
+/*
+ * Serializes values in little-endian byte order into a memory buffer, which is then
+ * written into a state file at once. Strings are prefixed with their length.
+ */
+class BinaryWriter
+{
+private:
+	std::string		m_data;
+
+public:
+	void			WriteInt32(int value) { WriteUInt32((uint32)value); }
+	void			WriteUInt32(uint32 value);
+	void			WriteInt64(int64 value);
+	void			WriteString(const char* value);
+	bool			WriteToFile(FILE* outfile);
+	size_t			GetSize() { return m_data.size(); }
+};
+
+void BinaryWriter::WriteUInt32(uint32 value)
+{
+	char buf[4] = { (char)(value & 0xFF), (char)((value >> 8) & 0xFF),
+		(char)((value >> 16) & 0xFF), (char)((value >> 24) & 0xFF) };
+	m_data.append(buf, 4);
+}
+
+void BinaryWriter::WriteInt64(int64 value)
+{
+	WriteUInt32((uint32)((uint64)value & 0xFFFFFFFF));
+	WriteUInt32((uint32)((uint64)value >> 32));
+}
+
+void BinaryWriter::WriteString(const char* value)
+{
+	size_t len = value ? strlen(value) : 0;
+	WriteUInt32((uint32)len);
+	m_data.append(value ? value : "", len);
+}
+
+bool BinaryWriter::WriteToFile(FILE* outfile)
+{
+	return fwrite(m_data.data(), 1, m_data.size(), outfile) == m_data.size();
+}
+
+/*
+ * Parses values written by BinaryWriter from a memory buffer. Reading past the end
+ * of buffer sets the error flag and returns zero values.
+ */
+class BinaryReader
+{
+private:
+	const uchar*	m_pos;
+	const uchar*	m_end;
+	bool			m_error;
+
+	bool			Check(size_t size);
+
+public:
+					BinaryReader(const char* buffer, size_t size);
+	int				ReadInt32() { return (int)ReadUInt32(); }
+	uint32			ReadUInt32();
+	int64			ReadInt64();
+	void			ReadString(char* buffer, int bufSize);
+	void			SkipString();
+	bool			GetError() { return m_error; }
+};
+
+BinaryReader::BinaryReader(const char* buffer, size_t size)
+{
+	m_pos = (const uchar*)buffer;
+	m_end = m_pos + size;
+	m_error = false;
+}
+
+bool BinaryReader::Check(size_t size)
+{
+	if (m_error || (size_t)(m_end - m_pos) < size)
+	{
+		m_error = true;
+		return false;
+	}
+	return true;
+}
+
+uint32 BinaryReader::ReadUInt32()
+{
+	if (!Check(4))
+	{
+		return 0;
+	}
+	uint32 value = (uint32)m_pos[0] | ((uint32)m_pos[1] << 8) | ((uint32)m_pos[2] << 16) | ((uint32)m_pos[3] << 24);
+	m_pos += 4;
+	return value;
+}
+
+int64 BinaryReader::ReadInt64()
+{
+	uint32 low = ReadUInt32();
+	uint32 high = ReadUInt32();
+	return (int64)(((uint64)high << 32) | low);
+}
+
+void BinaryReader::ReadString(char* buffer, int bufSize)
+{
+	uint32 len = ReadUInt32();
+	buffer[0] = '\0';
+	if (!Check(len))
+	{
+		return;
+	}
+	int copyLen = len < (uint32)bufSize ? (int)len : bufSize - 1;
+	memcpy(buffer, m_pos, copyLen);
+	buffer[copyLen] = '\0';
+	m_pos += len;
+}
+
+void BinaryReader::SkipString()
+{
+	uint32 len = ReadUInt32();
+	if (Check(len))
+	{
+		m_pos += len;
+	}
+}
+
+/* Reads the rest of state file (after the signature line) into memory */
+static bool ReadBinaryState(FILE* infile, std::vector<char>* buffer)
+{
+	long start = ftell(infile);
+	if (start < 0 || fseek(infile, 0, SEEK_END))
+	{
+		return false;
+	}
+	long end = ftell(infile);
+	if (end < start || fseek(infile, start, SEEK_SET))
+	{
+		return false;
+	}
+
+	buffer->resize(end - start + 1);
+	return fread(&buffer->front(), 1, end - start, infile) == (size_t)(end - start);
+}
+
+class QueueJournal;
+
+/*
+ * Writes a snapshot of the queue state, which was serialized into memory, into the state
+ * file in a separate thread. Once the snapshot is saved, the older journals are deleted.
+ * The thread destroys itself after notifying the journal.
+ */
+class SnapshotWriter : public Thread
+{
+private:
+	QueueJournal*	m_journal;
+	int				m_snapshotId;
+	char*			m_buffer;
+	size_t			m_size;
+
+public:
+					SnapshotWriter(QueueJournal* journal, int snapshotId, char* buffer, size_t size);
+					~SnapshotWriter();
+	virtual void	Run();
+	static bool		WriteSnapshot(int snapshotId, const char* buffer, size_t size);
+};
+
+/*
+ * Instead of rewriting the whole queue state file on every change only the changed
+ * queue and history records are appended to a journal. Changes made during one save
+ * form a transaction, which ends with a commit mark; incomplete transactions are
+ * ignored when the journal is replayed.
+ *
+ * The records are compared with their previously saved versions using checksums of
+ * their serialized texts. Once the journal becomes larger than the state file a new
+ * snapshot is written (compaction) and a new journal is started. Each journal has an
+ * id; the state file stores the id of the first journal which must be replayed on it.
+ */
+class QueueJournal
+{
+public:
+	enum
+	{
+		FormatVersion = 57,
+		MinJournalSize = 1024 * 1024
+	};
+
+private:
+	struct RecordSum
+	{
+		long			size;
+		uint32			hash;
+		uint32			crc;
+	};
+
+	typedef std::map<int, RecordSum> RecordSums;
+
+	RecordSums		m_queueSums;
+	RecordSums		m_historySums;
+	IdList			m_queueOrder;
+	IdList			m_historyOrder;
+	bool			m_ready;
+	int				m_journalId;
+	int64			m_journalSize;
+	int64			m_snapshotSize;
+	FILE*			m_journalFile;
+	bool			m_snapshotRunning;
+	Mutex			m_snapshotMutex;
+	ConditionVar	m_snapshotCond;
+
+	void			CompareRecords(const char* buffer, DiskState::StateRecords* records, RecordSums* sums,
+						IdList* order, char recordCode, char deleteCode, char orderCode, std::string* transaction);
+	void			CloseJournal();
+
+public:
+					QueueJournal();
+					~QueueJournal();
+	static void		JournalFilename(char* filename, int bufSize, int journalId);
+	static void		FindJournals(IdList* journalIds);
+	void			SetJournalId(int journalId) { m_journalId = journalId; }
+	bool			NeedSnapshot();
+	bool			SaveSnapshot(char* buffer, size_t size, DiskState::StateRecords* queueRecords,
+						DiskState::StateRecords* historyRecords);
+	bool			Append(const char* buffer, DiskState::StateRecords* queueRecords,
+						DiskState::StateRecords* historyRecords);
+	void			Discard();
+	void			Wait();
+	void			SnapshotFinished();
+};
+
+
+SnapshotWriter::SnapshotWriter(QueueJournal* journal, int snapshotId, char* buffer, size_t size)
+{
+	m_journal = journal;
+	m_snapshotId = snapshotId;
+	m_buffer = buffer;
+	m_size = size;
+	SetAutoDestroy(true);
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+	free(m_buffer);
+}
+
+void SnapshotWriter::Run()
+{
+	WriteSnapshot(m_snapshotId, m_buffer, m_size);
+	m_journal->SnapshotFinished();
+}
+
+bool SnapshotWriter::WriteSnapshot(int snapshotId, const char* buffer, size_t size)
+{
+	debug("Writing queue snapshot %i", snapshotId);
+
+	StateFile stateFile("queue", QueueJournal::FormatVersion);
+
+	FILE* outfile = stateFile.BeginWriteTransaction();
+	if (!outfile)
+	{
+		return false;
+	}
+
+	fprintf(outfile, "%i\n", snapshotId);
+	fwrite(buffer, 1, size, outfile);
+
+	if (!stateFile.FinishWriteTransaction())
+	{
+		return false;
+	}
+
+	// the changes from older journals are now in the snapshot
+	IdList journalIds;
+	QueueJournal::FindJournals(&journalIds);
+	for (IdList::iterator it = journalIds.begin(); it != journalIds.end() && *it < snapshotId; it++)
+	{
+		char filename[1024];
+		QueueJournal::JournalFilename(filename, 1024, *it);
+		remove(filename);
+	}
+
+	return true;
+}
+
+
+QueueJournal::QueueJournal()
+{
+	m_ready = false;
+	m_journalId = 0;
+	m_journalSize = 0;
+	m_snapshotSize = 0;
+	m_journalFile = NULL;
+	m_snapshotRunning = false;
+}
+
+QueueJournal::~QueueJournal()
+{
+	Wait();
+	CloseJournal();
+}
+
+void QueueJournal::JournalFilename(char* filename, int bufSize, int journalId)
+{
+	snprintf(filename, bufSize, "%squeue.j%i", g_Options->GetQueueDir(), journalId);
+	filename[bufSize-1] = '\0';
+}
+
+void QueueJournal::FindJournals(IdList* journalIds)
+{
+	DirBrowser dir(g_Options->GetQueueDir());
+	while (const char* filename = dir.Next())
+	{
+		int journalId;
+		char tail;
+		if (sscanf(filename, "queue.j%i%c", &journalId, &tail) == 1)
+		{
+			journalIds->push_back(journalId);
+		}
+	}
+
+	std::sort(journalIds->begin(), journalIds->end());
+}
+
+void QueueJournal::Wait()
+{
+	m_snapshotMutex.Lock();
+	while (m_snapshotRunning)
+	{
+		m_snapshotCond.Wait(&m_snapshotMutex);
+	}
+	m_snapshotMutex.Unlock();
+}
+
+void QueueJournal::SnapshotFinished()
+{
+	m_snapshotMutex.Lock();
+	m_snapshotRunning = false;
+	m_snapshotCond.NotifyAll();
+	m_snapshotMutex.Unlock();
+}
+
+void QueueJournal::CloseJournal()
+{
+	if (m_journalFile)
+	{
+		fclose(m_journalFile);
+		m_journalFile = NULL;
+	}
+}
+
+void QueueJournal::Discard()
+{
+	Wait();
+	CloseJournal();
+
+	StateFile stateFile("queue", FormatVersion);
+	stateFile.Discard();
+
+	IdList journalIds;
+	FindJournals(&journalIds);
+	for (IdList::iterator it = journalIds.begin(); it != journalIds.end(); it++)
+	{
+		char filename[1024];
+		JournalFilename(filename, 1024, *it);
+		remove(filename);
+	}
+
+	m_ready = false;
+	m_queueSums.clear();
+	m_historySums.clear();
+	m_queueOrder.clear();
+	m_historyOrder.clear();
+}
+
+bool QueueJournal::NeedSnapshot()
+{
+	m_snapshotMutex.Lock();
+	bool snapshotRunning = m_snapshotRunning;
+	m_snapshotMutex.Unlock();
+
+	return !m_ready ||
+		(m_journalSize > std::max(m_snapshotSize, (int64)MinJournalSize) && !snapshotRunning);
+}
+
+/*
+ * Takes the ownership of the buffer. The first snapshot (when the state on disk is unknown)
+ * is written immediately, all others in background.
+ */
+bool QueueJournal::SaveSnapshot(char* buffer, size_t size, DiskState::StateRecords* queueRecords,
+	DiskState::StateRecords* historyRecords)
+{
+	Wait();
+	CloseJournal();
+
+	CompareRecords(buffer, queueRecords, &m_queueSums, &m_queueOrder, 'N', 'X', 'O', NULL);
+	CompareRecords(buffer, historyRecords, &m_historySums, &m_historyOrder, 'H', 'Y', 'P', NULL);
+
+	m_journalId++;
+	m_journalSize = 0;
+	m_snapshotSize = size;
+
+	if (!m_ready)
+	{
+		m_ready = SnapshotWriter::WriteSnapshot(m_journalId, buffer, size);
+		free(buffer);
+		return m_ready;
+	}
+
+	m_snapshotRunning = true;
+	SnapshotWriter* snapshotWriter = new SnapshotWriter(this, m_journalId, buffer, size);
+	snapshotWriter->Start();
+
+	return true;
+}
+
+bool QueueJournal::Append(const char* buffer, DiskState::StateRecords* queueRecords,
+	DiskState::StateRecords* historyRecords)
+{
+	std::string transaction;
+	CompareRecords(buffer, queueRecords, &m_queueSums, &m_queueOrder, 'N', 'X', 'O', &transaction);
+	CompareRecords(buffer, historyRecords, &m_historySums, &m_historyOrder, 'H', 'Y', 'P', &transaction);
+
+	if (transaction.empty())
+	{
+		return true;
+	}
+
+	transaction.append("C\n");
+
+	char filename[1024];
+	JournalFilename(filename, 1024, m_journalId);
+
+	if (!m_journalFile)
+	{
+		m_journalFile = fopen(filename, FOPEN_WB);
+		if (!m_journalFile)
+		{
+			char errBuf[256];
+			error("Error saving diskstate: Could not create file %s: %s", filename,
+				Util::GetLastErrorMessage(errBuf, sizeof(errBuf)));
+			m_ready = false;
+			return false;
+		}
+		fprintf(m_journalFile, "%s%i\n", FORMATVERSION_SIGNATURE, FormatVersion);
+	}
+
+	bool ok = fwrite(transaction.c_str(), 1, transaction.length(), m_journalFile) == transaction.length() &&
+		fflush(m_journalFile) == 0;
+
+	if (ok && g_Options->GetFlushQueue())
+	{
+		char errBuf[256];
+		if (!Util::FlushFileBuffers(fileno(m_journalFile), errBuf, sizeof(errBuf)))
+		{
+			warn("Could not flush file %s into disk: %s", filename, errBuf);
+		}
+	}
+
+	if (!ok)
+	{
+		char errBuf[256];
+		error("Error saving diskstate: Could not write file %s: %s", filename,
+			Util::GetLastErrorMessage(errBuf, sizeof(errBuf)));
+		// the next save writes a complete snapshot
+		m_ready = false;
+		return false;
+	}
+
+	m_journalSize += transaction.length();
+
+	return true;
+}
+
+/*
+ * Updates the checksums and the order of records. If "transaction" is given the changed
+ * and new records, the deleted records and the new order (if changed) are added to it.
+ */
+void QueueJournal::CompareRecords(const char* buffer, DiskState::StateRecords* records, RecordSums* sums,
+	IdList* order, char recordCode, char deleteCode, char orderCode, std::string* transaction)
+{
+	RecordSums newSums;
+	IdList newOrder;
+	newOrder.reserve(records->size());
+
+	for (DiskState::StateRecords::iterator it = records->begin(); it != records->end(); it++)
+	{
+		DiskState::StateRecord& record = *it;
+		const char* data = buffer + record.offset;
+
+		RecordSum sum;
+		sum.size = record.size;
+		sum.hash = Util::HashBJ96(data, (int)record.size, 0);
+		sum.crc = Util::Crc32m(0xFFFFFFFF, (uchar*)data, (uint32)record.size);
+
+		RecordSums::iterator old = sums->find(record.id);
+		if (transaction && (old == sums->end() || old->second.size != sum.size ||
+			old->second.hash != sum.hash || old->second.crc != sum.crc))
+		{
+			transaction->append(1, recordCode);
+			transaction->append("\n");
+			transaction->append(data, record.size);
+		}
+
+		newSums[record.id] = sum;
+		newOrder.push_back(record.id);
+	}
+
+	if (transaction)
+	{
+		char buf[100];
+
+		for (RecordSums::iterator it = sums->begin(); it != sums->end(); it++)
+		{
+			if (newSums.find(it->first) == newSums.end())
+			{
+				snprintf(buf, 100, "%c %i\n", deleteCode, it->first);
+				transaction->append(buf);
+			}
+		}
+
+		if (newOrder != *order)
+		{
+			snprintf(buf, 100, "%c %i\n", orderCode, (int)newOrder.size());
+			transaction->append(buf);
+			for (IdList::iterator it = newOrder.begin(); it != newOrder.end(); it++)
+			{
+				snprintf(buf, 100, "%i\n", *it);
+				transaction->append(buf);
+			}
+		}
+	}
+
+	sums->swap(newSums);
+	order->swap(newOrder);
+}
+
+
 /*
  * Standard fscanf scans beoynd current line if the next line is empty.
  * This wrapper fixes that.
@@ -230,12 +764,25 @@ int DiskState::fscanf(FILE* infile, const char* format, ...)
 	return res;
 }
 
+DiskState::DiskState()
+{
+	m_journal = new QueueJournal();
+}
+
+DiskState::~DiskState()
+{
+	delete m_journal;
+}
+
 /* Save Download Queue to Disk.
  * The Disk State consists of file "queue", which contains the order of files,
  * and of one diskstate-file for each file in download queue.
  * This function saves file "queue" and files with NZB-info. It does not
  * save file-infos.
  *
+ * Changes are appended to the journal, file "queue" is rewritten only when the journal
+ * grows too large (see class QueueJournal), on Windows on every save.
+ *
  * For safety:
  * - first save to temp-file (queue.new)
  * - then delete queue
@@ -245,36 +792,79 @@ bool DiskState::SaveDownloadQueue(DownloadQueue* downloadQueue)
 {
 	debug("Saving queue to disk");
 
-	StateFile stateFile("queue", 55);
-
 	if (downloadQueue->GetQueue()->empty() &&
 		downloadQueue->GetHistory()->empty())
 	{
-		stateFile.Discard();
+		m_journal->Discard();
 		return true;
 	}
 
+#ifndef WIN32
+	return SaveQueueJournal(downloadQueue);
+#else
+	StateFile stateFile("queue", QueueJournal::FormatVersion);
+
 	FILE* outfile = stateFile.BeginWriteTransaction();
 	if (!outfile)
 	{
 		return false;
 	}
 
-	// save nzb-infos
-	SaveNzbQueue(downloadQueue, outfile);
+	// snapshot id, journals aren't used
+	fprintf(outfile, "%i\n", 0);
+
+	// save nzb-infos
+	SaveNzbQueue(downloadQueue, outfile, NULL);
+
+	// save history
+	SaveHistory(downloadQueue, outfile, NULL);
+
+	// now rename to dest file name
+	return stateFile.FinishWriteTransaction();
+#endif
+}
+
+/*
+ * Serializes the queue into memory and either appends the changes to the journal
+ * or writes a new snapshot.
+ */
+bool DiskState::SaveQueueJournal(DownloadQueue* downloadQueue)
+{
+#ifndef WIN32
+	char* buffer = NULL;
+	size_t size = 0;
+	FILE* outfile = open_memstream(&buffer, &size);
+	if (!outfile)
+	{
+		error("Error saving diskstate: Could not allocate memory for queue");
+		return false;
+	}
+
+	StateRecords queueRecords;
+	StateRecords historyRecords;
+	SaveNzbQueue(downloadQueue, outfile, &queueRecords);
+	SaveHistory(downloadQueue, outfile, &historyRecords);
+	fclose(outfile);
 
-	// save history
-	SaveHistory(downloadQueue, outfile);
+	if (m_journal->NeedSnapshot())
+	{
+		return m_journal->SaveSnapshot(buffer, size, &queueRecords, &historyRecords);
+	}
 
-	// now rename to dest file name
-	return stateFile.FinishWriteTransaction();
+	bool ok = m_journal->Append(buffer, &queueRecords, &historyRecords);
+	free(buffer);
+
+	return ok;
+#else
+	return false;
+#endif
 }
 
 bool DiskState::LoadDownloadQueue(DownloadQueue* downloadQueue, Servers* servers)
 {
 	debug("Loading queue from disk");
 
-	StateFile stateFile("queue", 55);
+	StateFile stateFile("queue", QueueJournal::FormatVersion);
 
 	FILE* infile = stateFile.BeginReadTransaction();
 	if (!infile)
@@ -284,10 +874,16 @@ bool DiskState::LoadDownloadQueue(DownloadQueue* downloadQueue, Servers* servers
 
 	bool ok = false;
 	int formatVersion = stateFile.GetFileVersion();
+	int snapshotId = 0;
 
 	NzbList nzbList(false);
 	NzbList sortList(false);
 
+	if (formatVersion >= 56)
+	{
+		if (fscanf(infile, "%i\n", &snapshotId) != 1) goto error;
+	}
+
 	if (formatVersion < 43)
 	{
 		// load nzb-infos
@@ -324,6 +920,11 @@ bool DiskState::LoadDownloadQueue(DownloadQueue* downloadQueue, Servers* servers
 		if (!LoadHistory(downloadQueue, &nzbList, servers, infile, formatVersion)) goto error;
 	}
 
+	if (formatVersion >= 56)
+	{
+		if (!LoadQueueJournals(downloadQueue, servers, snapshotId)) goto error;
+	}
+
 	if (formatVersion >= 9 && formatVersion < 43)
 	{
 		// load parked file-infos
@@ -407,7 +1008,7 @@ void DiskState::CompleteDupList12(DownloadQueue* downloadQueue, int formatVersio
 	}
 }
 
-void DiskState::SaveNzbQueue(DownloadQueue* downloadQueue, FILE* outfile)
+void DiskState::SaveNzbQueue(DownloadQueue* downloadQueue, FILE* outfile, StateRecords* records)
 {
 	debug("Saving nzb list to disk");
 
@@ -415,7 +1016,15 @@ void DiskState::SaveNzbQueue(DownloadQueue* downloadQueue, FILE* outfile)
 	for (NzbList::iterator it = downloadQueue->GetQueue()->begin(); it != downloadQueue->GetQueue()->end(); it++)
 	{
 		NzbInfo* nzbInfo = *it;
+		StateRecord record;
+		record.id = nzbInfo->GetId();
+		record.offset = ftell(outfile);
 		SaveNzbInfo(nzbInfo, outfile);
+		if (records)
+		{
+			record.size = ftell(outfile) - record.offset;
+			records->push_back(record);
+		}
 	}
 }
 
@@ -489,12 +1098,11 @@ void DiskState::SaveNzbInfo(NzbInfo* nzbInfo, FILE* outfile)
 	fprintf(outfile, "%u,%u,%i,%i,%i,%i,%i\n", High1, Low1, nzbInfo->GetDownloadSec(), nzbInfo->GetPostTotalSec(),
 		nzbInfo->GetParSec(), nzbInfo->GetRepairSec(), nzbInfo->GetUnpackSec());
 
-	fprintf(outfile, "%i\n", (int)nzbInfo->GetCompletedFiles()->size());
-	for (CompletedFiles::iterator it = nzbInfo->GetCompletedFiles()->begin(); it != nzbInfo->GetCompletedFiles()->end(); it++)
+	fprintf(outfile, "%i,%i\n", (int)nzbInfo->GetDetailsUnloaded(), nzbInfo->GetDetailsMaxFileId());
+
+	if (!nzbInfo->GetDetailsUnloaded())
 	{
-		CompletedFile* completedFile = *it;
-		fprintf(outfile, "%i,%i,%u,%s\n", completedFile->GetId(), (int)completedFile->GetStatus(),
-			completedFile->GetCrc(), completedFile->GetFileName());
+		SaveCompletedFiles(nzbInfo, outfile);
 	}
 
 	fprintf(outfile, "%i\n", (int)nzbInfo->GetParameters()->size());
@@ -513,7 +1121,89 @@ void DiskState::SaveNzbInfo(NzbInfo* nzbInfo, FILE* outfile)
 
 	SaveServerStats(nzbInfo->GetServerStats(), outfile);
 
-	// save file-infos
+	if (!nzbInfo->GetDetailsUnloaded())
+	{
+		SaveFileList(nzbInfo, outfile);
+	}
+}
+
+/*
+ * Saves the lists of completed and parked files of a history item into file "n<id>.details".
+ */
+bool DiskState::SaveNzbDetails(NzbInfo* nzbInfo)
+{
+	char filename[100];
+	snprintf(filename, 100, "n%i.details", nzbInfo->GetId());
+	filename[100-1] = '\0';
+
+	StateFile stateFile(filename, QueueJournal::FormatVersion);
+
+	FILE* outfile = stateFile.BeginWriteTransaction();
+	if (!outfile)
+	{
+		return false;
+	}
+
+	SaveCompletedFiles(nzbInfo, outfile);
+	SaveFileList(nzbInfo, outfile);
+
+	return stateFile.FinishWriteTransaction();
+}
+
+/*
+ * Loads the lists of completed and parked files of a history item unloaded by SaveNzbDetails.
+ */
+bool DiskState::LoadNzbDetails(NzbInfo* nzbInfo)
+{
+	if (!nzbInfo->GetDetailsUnloaded())
+	{
+		return true;
+	}
+
+	debug("Loading details for %s", nzbInfo->GetName());
+
+	char filename[100];
+	snprintf(filename, 100, "n%i.details", nzbInfo->GetId());
+	filename[100-1] = '\0';
+
+	StateFile stateFile(filename, QueueJournal::FormatVersion);
+
+	FILE* infile = stateFile.BeginReadTransaction();
+	if (!infile)
+	{
+		return false;
+	}
+
+	int formatVersion = stateFile.GetFileVersion();
+	if (!LoadCompletedFiles(nzbInfo, infile, formatVersion) ||
+		!LoadFileList(nzbInfo, infile, formatVersion))
+	{
+		error("Error reading diskstate for %s", stateFile.GetDestFilename());
+		// discard partially read lists, the item remains unloaded
+		nzbInfo->ClearCompletedFiles();
+		nzbInfo->GetFileList()->Clear();
+		return false;
+	}
+
+	nzbInfo->SetDetailsUnloaded(false, 0);
+	CalcNzbFileStats(nzbInfo, formatVersion);
+
+	return true;
+}
+
+void DiskState::SaveCompletedFiles(NzbInfo* nzbInfo, FILE* outfile)
+{
+	fprintf(outfile, "%i\n", (int)nzbInfo->GetCompletedFiles()->size());
+	for (CompletedFiles::iterator it = nzbInfo->GetCompletedFiles()->begin(); it != nzbInfo->GetCompletedFiles()->end(); it++)
+	{
+		CompletedFile* completedFile = *it;
+		fprintf(outfile, "%i,%i,%u,%s\n", completedFile->GetId(), (int)completedFile->GetStatus(),
+			completedFile->GetCrc(), completedFile->GetFileName());
+	}
+}
+
+void DiskState::SaveFileList(NzbInfo* nzbInfo, FILE* outfile)
+{
 	int size = 0;
 	for (FileList::iterator it = nzbInfo->GetFileList()->begin(); it != nzbInfo->GetFileList()->end(); it++)
 	{
@@ -880,44 +1570,21 @@ bool DiskState::LoadNzbInfo(NzbInfo* nzbInfo, Servers* servers, FILE* infile, in
 		nzbInfo->SetUnpackSec(unpackSec);
 	}
 
-	if (formatVersion >= 4)
+	if (formatVersion >= 57)
 	{
-		int fileCount;
-		if (fscanf(infile, "%i\n", &fileCount) != 1) goto error;
-		for (int i = 0; i < fileCount; i++)
+		int detailsUnloaded, maxFileId;
+		if (fscanf(infile, "%i,%i\n", &detailsUnloaded, &maxFileId) != 2) goto error;
+		if (detailsUnloaded)
 		{
-			if (!fgets(buf, sizeof(buf), infile)) goto error;
-			if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
-
-			int id = 0;
-			char* fileName = buf;
-			int status = 0;
-			uint32 crc = 0;
-
-			if (formatVersion >= 49)
-			{
-				if (formatVersion >= 50)
-				{
-					if (sscanf(buf, "%i,%i,%u", &id, &status, &crc) != 3) goto error;
-					fileName = strchr(buf, ',');
-					if (fileName) fileName = strchr(fileName+1, ',');
-					if (fileName) fileName = strchr(fileName+1, ',');
-				}
-				else
-				{
-					if (sscanf(buf, "%i,%u", &status, &crc) != 2) goto error;
-					fileName = strchr(buf + 2, ',');
-				}
-				if (fileName)
-				{
-					fileName++;
-				}
-			}
-
-			nzbInfo->GetCompletedFiles()->push_back(new CompletedFile(id, fileName, (CompletedFile::EStatus)status, crc));
+			nzbInfo->SetDetailsUnloaded(true, maxFileId);
 		}
 	}
 
+	if (formatVersion >= 4 && !nzbInfo->GetDetailsUnloaded())
+	{
+		if (!LoadCompletedFiles(nzbInfo, infile, formatVersion)) goto error;
+	}
+
 	if (formatVersion >= 6)
 	{
 		int parameterCount;
@@ -982,55 +1649,104 @@ bool DiskState::LoadNzbInfo(NzbInfo* nzbInfo, Servers* servers, FILE* infile, in
 		}
 	}
 
-	if (formatVersion >= 43)
+	if (formatVersion >= 43 && !nzbInfo->GetDetailsUnloaded())
 	{
-		int fileCount;
-		if (fscanf(infile, "%i\n", &fileCount) != 1) goto error;
-		for (int i = 0; i < fileCount; i++)
-		{
-			uint32 id, paused, time = 0;
-			int priority = 0, extraPriority = 0;
+		if (!LoadFileList(nzbInfo, infile, formatVersion)) goto error;
+	}
+
+	return true;
+
+error:
+	error("Error reading nzb info from disk");
+	return false;
+}
 
-			if (formatVersion >= 44)
+bool DiskState::LoadCompletedFiles(NzbInfo* nzbInfo, FILE* infile, int formatVersion)
+{
+	char buf[10240];
+
+	int fileCount;
+	if (fscanf(infile, "%i\n", &fileCount) != 1) return false;
+	for (int i = 0; i < fileCount; i++)
+	{
+		if (!fgets(buf, sizeof(buf), infile)) return false;
+		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
+
+		int id = 0;
+		char* fileName = buf;
+		int status = 0;
+		uint32 crc = 0;
+
+		if (formatVersion >= 49)
+		{
+			if (formatVersion >= 50)
 			{
-				if (fscanf(infile, "%i,%i,%i,%i\n", &id, &paused, &time, &extraPriority) != 4) goto error;
+				if (sscanf(buf, "%i,%i,%u", &id, &status, &crc) != 3) return false;
+				fileName = strchr(buf, ',');
+				if (fileName) fileName = strchr(fileName+1, ',');
+				if (fileName) fileName = strchr(fileName+1, ',');
 			}
 			else
 			{
-				if (fscanf(infile, "%i,%i,%i,%i,%i\n", &id, &paused, &time, &priority, &extraPriority) != 5) goto error;
-				nzbInfo->SetPriority(priority);
+				if (sscanf(buf, "%i,%u", &status, &crc) != 2) return false;
+				fileName = strchr(buf + 2, ',');
 			}
-
-			char fileName[1024];
-			snprintf(fileName, 1024, "%s%i", g_Options->GetQueueDir(), id);
-			fileName[1024-1] = '\0';
-			FileInfo* fileInfo = new FileInfo();
-			bool res = LoadFileInfo(fileInfo, fileName, true, false);
-			if (res)
+			if (fileName)
 			{
-				fileInfo->SetId(id);
-				fileInfo->SetPaused(paused);
-				fileInfo->SetTime(time);
-				fileInfo->SetExtraPriority(extraPriority != 0);
-				fileInfo->SetNzbInfo(nzbInfo);
-				if (formatVersion < 30)
-				{
-					nzbInfo->SetTotalArticles(nzbInfo->GetTotalArticles() + fileInfo->GetTotalArticles());
-				}
-				nzbInfo->GetFileList()->push_back(fileInfo);
+				fileName++;
 			}
-			else
+		}
+
+		nzbInfo->GetCompletedFiles()->push_back(new CompletedFile(id, fileName, (CompletedFile::EStatus)status, crc));
+	}
+
+	return true;
+}
+
+bool DiskState::LoadFileList(NzbInfo* nzbInfo, FILE* infile, int formatVersion)
+{
+	int fileCount;
+	if (fscanf(infile, "%i\n", &fileCount) != 1) return false;
+	for (int i = 0; i < fileCount; i++)
+	{
+		uint32 id, paused, time = 0;
+		int priority = 0, extraPriority = 0;
+
+		if (formatVersion >= 44)
+		{
+			if (fscanf(infile, "%i,%i,%i,%i\n", &id, &paused, &time, &extraPriority) != 4) return false;
+		}
+		else
+		{
+			if (fscanf(infile, "%i,%i,%i,%i,%i\n", &id, &paused, &time, &priority, &extraPriority) != 5) return false;
+			nzbInfo->SetPriority(priority);
+		}
+
+		char fileName[1024];
+		snprintf(fileName, 1024, "%s%i", g_Options->GetQueueDir(), id);
+		fileName[1024-1] = '\0';
+		FileInfo* fileInfo = new FileInfo();
+		bool res = LoadFileInfo(fileInfo, fileName, true, false);
+		if (res)
+		{
+			fileInfo->SetId(id);
+			fileInfo->SetPaused(paused);
+			fileInfo->SetTime(time);
+			fileInfo->SetExtraPriority(extraPriority != 0);
+			fileInfo->SetNzbInfo(nzbInfo);
+			if (formatVersion < 30)
 			{
-				delete fileInfo;
+				nzbInfo->SetTotalArticles(nzbInfo->GetTotalArticles() + fileInfo->GetTotalArticles());
 			}
+			nzbInfo->GetFileList()->push_back(fileInfo);
+		}
+		else
+		{
+			delete fileInfo;
 		}
 	}
 
 	return true;
-
-error:
-	error("Error reading nzb info from disk");
-	return false;
 }
 
 bool DiskState::LoadFileQueue12(NzbList* nzbList, NzbList* sortList, FILE* infile, int formatVersion)
@@ -1119,18 +1835,7 @@ bool DiskState::LoadServerStats(ServerStatList* serverStatList, Servers* servers
 		int serverId, successArticles, failedArticles;
 		if (fscanf(infile, "%i,%i,%i\n", &serverId, &successArticles, &failedArticles) != 3) goto error;
 
-		if (servers)
-		{
-			// find server (id could change if config file was edited)
-			for (Servers::iterator it = servers->begin(); it != servers->end(); it++)
-			{
-				NewsServer* newsServer = *it;
-				if (newsServer->GetStateId() == serverId)
-				{
-					serverStatList->StatOp(newsServer->GetId(), successArticles, failedArticles, ServerStatList::soSet);
-				}
-			}
-		}
+		RestoreServerStat(serverStatList, servers, serverId, successArticles, failedArticles);
 	}
 
 	return true;
@@ -1140,6 +1845,23 @@ error:
 	return false;
 }
 
+void DiskState::RestoreServerStat(ServerStatList* serverStatList, Servers* servers,
+	int serverId, int successArticles, int failedArticles)
+{
+	if (servers)
+	{
+		// find server (id could change if config file was edited)
+		for (Servers::iterator it = servers->begin(); it != servers->end(); it++)
+		{
+			NewsServer* newsServer = *it;
+			if (newsServer->GetStateId() == serverId)
+			{
+				serverStatList->StatOp(newsServer->GetId(), successArticles, failedArticles, ServerStatList::soSet);
+			}
+		}
+	}
+}
+
 bool DiskState::SaveFile(FileInfo* fileInfo)
 {
 	char fileName[1024];
@@ -1152,45 +1874,48 @@ bool DiskState::SaveFileInfo(FileInfo* fileInfo, const char* filename)
 {
 	debug("Saving FileInfo to disk");
 
-	FILE* outfile = fopen(filename, FOPEN_WB);
+	BinaryWriter writer;
+	writer.WriteString(fileInfo->GetSubject());
+	writer.WriteString(fileInfo->GetFilename());
+	writer.WriteInt64(fileInfo->GetSize());
+	writer.WriteInt64(fileInfo->GetMissedSize());
+	writer.WriteInt32((int)fileInfo->GetParFile());
+	writer.WriteInt32(fileInfo->GetTotalArticles());
+	writer.WriteInt32(fileInfo->GetMissedArticles());
 
-	if (!outfile)
+	writer.WriteInt32((int)fileInfo->GetGroups()->size());
+	for (FileInfo::Groups::iterator it = fileInfo->GetGroups()->begin(); it != fileInfo->GetGroups()->end(); it++)
 	{
-		error("Error saving diskstate: could not create file %s", filename);
-		return false;
+		writer.WriteString(*it);
 	}
 
-	fprintf(outfile, "%s%i\n", FORMATVERSION_SIGNATURE, 3);
-
-	fprintf(outfile, "%s\n", fileInfo->GetSubject());
-	fprintf(outfile, "%s\n", fileInfo->GetFilename());
-
-	uint32 High, Low;
-	Util::SplitInt64(fileInfo->GetSize(), &High, &Low);
-	fprintf(outfile, "%u,%u\n", High, Low);
-
-	Util::SplitInt64(fileInfo->GetMissedSize(), &High, &Low);
-	fprintf(outfile, "%u,%u\n", High, Low);
+	writer.WriteInt32((int)fileInfo->GetArticles()->size());
+	for (FileInfo::Articles::iterator it = fileInfo->GetArticles()->begin(); it != fileInfo->GetArticles()->end(); it++)
+	{
+		ArticleInfo* articleInfo = *it;
+		writer.WriteInt32(articleInfo->GetPartNumber());
+		writer.WriteInt32(articleInfo->GetSize());
+		writer.WriteString(articleInfo->GetMessageId());
+	}
 
-	fprintf(outfile, "%i\n", (int)fileInfo->GetParFile());
-	fprintf(outfile, "%i,%i\n", fileInfo->GetTotalArticles(), fileInfo->GetMissedArticles());
+	FILE* outfile = fopen(filename, FOPEN_WB);
 
-	fprintf(outfile, "%i\n", (int)fileInfo->GetGroups()->size());
-	for (FileInfo::Groups::iterator it = fileInfo->GetGroups()->begin(); it != fileInfo->GetGroups()->end(); it++)
+	if (!outfile)
 	{
-		fprintf(outfile, "%s\n", *it);
+		error("Error saving diskstate: could not create file %s", filename);
+		return false;
 	}
 
-	fprintf(outfile, "%i\n", (int)fileInfo->GetArticles()->size());
-	for (FileInfo::Articles::iterator it = fileInfo->GetArticles()->begin(); it != fileInfo->GetArticles()->end(); it++)
+	fprintf(outfile, "%s%i\n", FORMATVERSION_SIGNATURE, 4);
+	bool ok = writer.WriteToFile(outfile);
+	fclose(outfile);
+
+	if (!ok)
 	{
-		ArticleInfo* articleInfo = *it;
-		fprintf(outfile, "%i,%i\n", articleInfo->GetPartNumber(), articleInfo->GetSize());
-		fprintf(outfile, "%s\n", articleInfo->GetMessageId());
+		error("Error saving diskstate: could not write file %s", filename);
 	}
 
-	fclose(outfile);
-	return true;
+	return ok;
 }
 
 bool DiskState::LoadArticles(FileInfo* fileInfo)
@@ -1220,7 +1945,7 @@ bool DiskState::LoadFileInfo(FileInfo* fileInfo, const char * filename, bool fil
 	{
 		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
 		formatVersion = ParseFormatVersion(buf);
-		if (formatVersion > 3)
+		if (formatVersion > 4)
 		{
 			error("Could not load diskstate due to file version mismatch");
 			goto error;
@@ -1231,6 +1956,13 @@ bool DiskState::LoadFileInfo(FileInfo* fileInfo, const char * filename, bool fil
 		goto error;
 	}
 
+	if (formatVersion >= 4)
+	{
+		if (!LoadBinaryFileInfo(fileInfo, infile, fileSummary, articles)) goto error;
+		fclose(infile);
+		return true;
+	}
+
 	if (formatVersion >= 2)
 	{
 		if (!fgets(buf, sizeof(buf), infile)) goto error;
@@ -1317,6 +2049,65 @@ error:
 	return false;
 }
 
+bool DiskState::LoadBinaryFileInfo(FileInfo* fileInfo, FILE* infile, bool fileSummary, bool articles)
+{
+	std::vector<char> data;
+	if (!ReadBinaryState(infile, &data))
+	{
+		return false;
+	}
+
+	BinaryReader reader(&data.front(), data.size() - 1);
+	char buf[1024];
+
+	reader.ReadString(buf, sizeof(buf));
+	if (fileSummary) fileInfo->SetSubject(buf);
+	reader.ReadString(buf, sizeof(buf));
+	if (fileSummary) fileInfo->SetFilename(buf);
+
+	int64 size = reader.ReadInt64();
+	int64 missedSize = reader.ReadInt64();
+	int parFile = reader.ReadInt32();
+	int totalArticles = reader.ReadInt32();
+	int missedArticles = reader.ReadInt32();
+
+	int groupCount = reader.ReadInt32();
+	for (int i = 0; i < groupCount && !reader.GetError(); i++)
+	{
+		reader.ReadString(buf, sizeof(buf));
+		if (fileSummary) fileInfo->GetGroups()->push_back(strdup(buf));
+	}
+
+	if (fileSummary)
+	{
+		fileInfo->SetSize(size);
+		fileInfo->SetMissedSize(missedSize);
+		fileInfo->SetRemainingSize(size - missedSize);
+		fileInfo->SetParFile((bool)parFile);
+		fileInfo->SetTotalArticles(totalArticles);
+		fileInfo->SetMissedArticles(missedArticles);
+	}
+
+	if (articles)
+	{
+		int articleCount = reader.ReadInt32();
+		for (int i = 0; i < articleCount && !reader.GetError(); i++)
+		{
+			int partNumber = reader.ReadInt32();
+			int partSize = reader.ReadInt32();
+			reader.ReadString(buf, sizeof(buf));
+
+			ArticleInfo* articleInfo = new ArticleInfo();
+			articleInfo->SetPartNumber(partNumber);
+			articleInfo->SetSize(partSize);
+			articleInfo->SetMessageId(buf);
+			fileInfo->GetArticles()->push_back(articleInfo);
+		}
+	}
+
+	return !reader.GetError();
+}
+
 bool DiskState::SaveFileState(FileInfo* fileInfo, bool completed)
 {
 	debug("Saving FileState to disk");
@@ -1325,6 +2116,33 @@ bool DiskState::SaveFileState(FileInfo* fileInfo, bool completed)
 	snprintf(filename, 1024, "%s%i%s", g_Options->GetQueueDir(), fileInfo->GetId(), completed ? "c" : "s");
 	filename[1024-1] = '\0';
 
+	BinaryWriter writer;
+	writer.WriteInt32(fileInfo->GetSuccessArticles());
+	writer.WriteInt32(fileInfo->GetFailedArticles());
+	writer.WriteInt64(fileInfo->GetRemainingSize());
+	writer.WriteInt64(fileInfo->GetSuccessSize());
+	writer.WriteInt64(fileInfo->GetFailedSize());
+
+	ServerStatList* serverStatList = fileInfo->GetServerStats();
+	writer.WriteInt32((int)serverStatList->size());
+	for (ServerStatList::iterator it = serverStatList->begin(); it != serverStatList->end(); it++)
+	{
+		ServerStat* serverStat = *it;
+		writer.WriteInt32(serverStat->GetServerId());
+		writer.WriteInt32(serverStat->GetSuccessArticles());
+		writer.WriteInt32(serverStat->GetFailedArticles());
+	}
+
+	writer.WriteInt32((int)fileInfo->GetArticles()->size());
+	for (FileInfo::Articles::iterator it = fileInfo->GetArticles()->begin(); it != fileInfo->GetArticles()->end(); it++)
+	{
+		ArticleInfo* articleInfo = *it;
+		writer.WriteInt32((int)articleInfo->GetStatus());
+		writer.WriteInt64(articleInfo->GetSegmentOffset());
+		writer.WriteInt32(articleInfo->GetSegmentSize());
+		writer.WriteUInt32(articleInfo->GetCrc());
+	}
+
 	FILE* outfile = fopen(filename, FOPEN_WB);
 
 	if (!outfile)
@@ -1333,28 +2151,37 @@ bool DiskState::SaveFileState(FileInfo* fileInfo, bool completed)
 		return false;
 	}
 
-	fprintf(outfile, "%s%i\n", FORMATVERSION_SIGNATURE, 2);
+	fprintf(outfile, "%s%i\n", FORMATVERSION_SIGNATURE, 3);
+	bool ok = writer.WriteToFile(outfile);
+	fclose(outfile);
 
-	fprintf(outfile, "%i,%i\n", fileInfo->GetSuccessArticles(), fileInfo->GetFailedArticles());
+	if (!ok)
+	{
+		error("Error saving diskstate: could not write file %s", filename);
+	}
 
-	uint32 High1, Low1, High2, Low2, High3, Low3;
-	Util::SplitInt64(fileInfo->GetRemainingSize(), &High1, &Low1);
-	Util::SplitInt64(fileInfo->GetSuccessSize(), &High2, &Low2);
-	Util::SplitInt64(fileInfo->GetFailedSize(), &High3, &Low3);
-	fprintf(outfile, "%u,%u,%u,%u,%u,%u\n", High1, Low1, High2, Low2, High3, Low3);
+	return ok;
+}
 
-	SaveServerStats(fileInfo->GetServerStats(), outfile);
+/* Returns status of an article loaded from disk state.
+ * Don't allow all articles be completed or the file will stuck;
+ * such states should never be saved on disk but just in case.
+ */
+ArticleInfo::EStatus LoadedArticleStatus(int statusInt, int completedArticles, int articleCount, bool completed)
+{
+	ArticleInfo::EStatus status = (ArticleInfo::EStatus)statusInt;
 
-	fprintf(outfile, "%i\n", (int)fileInfo->GetArticles()->size());
-	for (FileInfo::Articles::iterator it = fileInfo->GetArticles()->begin(); it != fileInfo->GetArticles()->end(); it++)
+	if (status == ArticleInfo::aiRunning)
 	{
-		ArticleInfo* articleInfo = *it;
-		fprintf(outfile, "%i,%u,%i,%u\n", (int)articleInfo->GetStatus(), (uint32)articleInfo->GetSegmentOffset(),
-			articleInfo->GetSegmentSize(), (uint32)articleInfo->GetCrc());
+		status = ArticleInfo::aiUndefined;
 	}
 
-	fclose(outfile);
-	return true;
+	if (completedArticles == articleCount - 1 && !completed)
+	{
+		status = ArticleInfo::aiUndefined;
+	}
+
+	return status;
 }
 
 bool DiskState::LoadFileState(FileInfo* fileInfo, Servers* servers, bool completed)
@@ -1380,7 +2207,7 @@ bool DiskState::LoadFileState(FileInfo* fileInfo, Servers* servers, bool complet
 	{
 		if (buf[0] != 0) buf[strlen(buf)-1] = 0; // remove traling '\n'
 		formatVersion = ParseFormatVersion(buf);
-		if (formatVersion > 2)
+		if (formatVersion > 3)
 		{
 			error("Could not load diskstate due to file version mismatch");
 			goto error;
@@ -1391,6 +2218,13 @@ bool DiskState::LoadFileState(FileInfo* fileInfo, Servers* servers, bool complet
 		goto error;
 	}
 
+	if (formatVersion >= 3)
+	{
+		if (!LoadBinaryFileState(fileInfo, servers, infile, completed, hasArticles)) goto error;
+		fclose(infile);
+		return true;
+	}
+
 	int successArticles, failedArticles;
 	if (fscanf(infile, "%i,%i\n", &successArticles, &failedArticles) != 2) goto error;
 	fileInfo->SetSuccessArticles(successArticles);
@@ -1399,7 +2233,7 @@ bool DiskState::LoadFileState(FileInfo* fileInfo, Servers* servers, bool complet
 	uint32 High1, Low1, High2, Low2, High3, Low3;
 	if (fscanf(infile, "%u,%u,%u,%u,%u,%u\n", &High1, &Low1, &High2, &Low2, &High3, &Low3) != 6) goto error;
 	fileInfo->SetRemainingSize(Util::JoinInt64(High1, Low1));
-	fileInfo->SetSuccessSize(Util::JoinInt64(High2, Low3));
+	fileInfo->SetSuccessSize(Util::JoinInt64(High2, Low2));
 	fileInfo->SetFailedSize(Util::JoinInt64(High3, Low3));
 
 	if (!LoadServerStats(fileInfo->GetServerStats(), servers, infile)) goto error;
@@ -1433,19 +2267,7 @@ bool DiskState::LoadFileState(FileInfo* fileInfo, Servers* servers, bool complet
 			if (fscanf(infile, "%i\n", &statusInt) != 1) goto error;
 		}
 
-		ArticleInfo::EStatus status = (ArticleInfo::EStatus)statusInt;
-
-		if (status == ArticleInfo::aiRunning)
-		{
-			status = ArticleInfo::aiUndefined;
-		}
-
-		// don't allow all articles be completed or the file will stuck.
-		// such states should never be saved on disk but just in case.
-		if (completedArticles == size - 1 && !completed)
-		{
-			status = ArticleInfo::aiUndefined;
-		}
+		ArticleInfo::EStatus status = LoadedArticleStatus(statusInt, completedArticles, size, completed);
 		if (status != ArticleInfo::aiUndefined)
 		{
 			completedArticles++;
@@ -1465,8 +2287,77 @@ error:
 	return false;
 }
 
+bool DiskState::LoadBinaryFileState(FileInfo* fileInfo, Servers* servers, FILE* infile, bool completed, bool hasArticles)
+{
+	std::vector<char> data;
+	if (!ReadBinaryState(infile, &data))
+	{
+		return false;
+	}
+
+	BinaryReader reader(&data.front(), data.size() - 1);
+
+	fileInfo->SetSuccessArticles(reader.ReadInt32());
+	fileInfo->SetFailedArticles(reader.ReadInt32());
+	fileInfo->SetRemainingSize(reader.ReadInt64());
+	fileInfo->SetSuccessSize(reader.ReadInt64());
+	fileInfo->SetFailedSize(reader.ReadInt64());
+
+	int statCount = reader.ReadInt32();
+	for (int i = 0; i < statCount && !reader.GetError(); i++)
+	{
+		int serverId = reader.ReadInt32();
+		int successArticles = reader.ReadInt32();
+		int failedArticles = reader.ReadInt32();
+		RestoreServerStat(fileInfo->GetServerStats(), servers, serverId, successArticles, failedArticles);
+	}
+
+	int size = reader.ReadInt32();
+	if (reader.GetError() || (hasArticles && size != (int)fileInfo->GetArticles()->size()))
+	{
+		return false;
+	}
+
+	int completedArticles = 0;
+	for (int i = 0; i < size; i++)
+	{
+		int statusInt = reader.ReadInt32();
+		int64 segmentOffset = reader.ReadInt64();
+		int segmentSize = reader.ReadInt32();
+		uint32 crc = reader.ReadUInt32();
+		if (reader.GetError())
+		{
+			return false;
+		}
+
+		if (!hasArticles)
+		{
+			fileInfo->GetArticles()->push_back(new ArticleInfo());
+		}
+		ArticleInfo* pa = fileInfo->GetArticles()->at(i);
+
+		pa->SetSegmentOffset(segmentOffset);
+		pa->SetSegmentSize(segmentSize);
+		pa->SetCrc(crc);
+
+		ArticleInfo::EStatus status = LoadedArticleStatus(statusInt, completedArticles, size, completed);
+		if (status != ArticleInfo::aiUndefined)
+		{
+			completedArticles++;
+		}
+		pa->SetStatus(status);
+	}
+
+	fileInfo->SetCompletedArticles(completedArticles);
+
+	return true;
+}
+
 void DiskState::DiscardFiles(NzbInfo* nzbInfo)
 {
+	// the lists of files are needed to find their state files
+	LoadNzbDetails(nzbInfo);
+
 	for (FileList::iterator it = nzbInfo->GetFileList()->begin(); it != nzbInfo->GetFileList()->end(); it++)
 	{
 		FileInfo* fileInfo = *it;
@@ -1497,6 +2388,10 @@ void DiskState::DiscardFiles(NzbInfo* nzbInfo)
 	snprintf(filename, 1024, "%sn%i.log", g_Options->GetQueueDir(), nzbInfo->GetId());
 	filename[1024-1] = '\0';
 	remove(filename);
+
+	snprintf(filename, 1024, "%sn%i.details", g_Options->GetQueueDir(), nzbInfo->GetId());
+	filename[1024-1] = '\0';
+	remove(filename);
 }
 
 bool DiskState::LoadPostQueue12(DownloadQueue* downloadQueue, NzbList* nzbList, FILE* infile, int formatVersion)
@@ -1506,6 +2401,9 @@ bool DiskState::LoadPostQueue12(DownloadQueue* downloadQueue, NzbList* nzbList,
 	int size;
 	char buf[10240];
 
+	NzbIndex queueIndex;
+	downloadQueue->GetQueue()->BuildIndex(&queueIndex, NULL);
+
 	// load post-infos
 	if (fscanf(infile, "%i\n", &size) != 1) goto error;
 	for (int i = 0; i < size; i++)
@@ -1542,7 +2440,7 @@ bool DiskState::LoadPostQueue12(DownloadQueue* downloadQueue, NzbList* nzbList,
 		}
 		else
 		{
-			nzbInfo = FindNzbInfo(downloadQueue, nzbId);
+			nzbInfo = FindNzbInfo(&queueIndex, nzbId);
 			if (!nzbInfo) goto error;
 		}
 
@@ -1869,7 +2767,7 @@ error:
 	return false;
 }
 
-void DiskState::SaveHistory(DownloadQueue* downloadQueue, FILE* outfile)
+void DiskState::SaveHistory(DownloadQueue* downloadQueue, FILE* outfile, StateRecords* records)
 {
 	debug("Saving history to disk");
 
@@ -1877,20 +2775,32 @@ void DiskState::SaveHistory(DownloadQueue* downloadQueue, FILE* outfile)
 	for (HistoryList::iterator it = downloadQueue->GetHistory()->begin(); it != downloadQueue->GetHistory()->end(); it++)
 	{
 		HistoryInfo* historyInfo = *it;
-
-		fprintf(outfile, "%i,%i,%i\n", historyInfo->GetId(), (int)historyInfo->GetKind(), (int)historyInfo->GetTime());
-
-		if (historyInfo->GetKind() == HistoryInfo::hkNzb || historyInfo->GetKind() == HistoryInfo::hkUrl)
-		{
-			SaveNzbInfo(historyInfo->GetNzbInfo(), outfile);
-		}
-		else if (historyInfo->GetKind() == HistoryInfo::hkDup)
+		StateRecord record;
+		record.id = historyInfo->GetId();
+		record.offset = ftell(outfile);
+		SaveHistoryInfo(historyInfo, outfile);
+		if (records)
 		{
-			SaveDupInfo(historyInfo->GetDupInfo(), outfile);
+			record.size = ftell(outfile) - record.offset;
+			records->push_back(record);
 		}
 	}
 }
 
+void DiskState::SaveHistoryInfo(HistoryInfo* historyInfo, FILE* outfile)
+{
+	fprintf(outfile, "%i,%i,%i\n", historyInfo->GetId(), (int)historyInfo->GetKind(), (int)historyInfo->GetTime());
+
+	if (historyInfo->GetKind() == HistoryInfo::hkNzb || historyInfo->GetKind() == HistoryInfo::hkUrl)
+	{
+		SaveNzbInfo(historyInfo->GetNzbInfo(), outfile);
+	}
+	else if (historyInfo->GetKind() == HistoryInfo::hkDup)
+	{
+		SaveDupInfo(historyInfo->GetDupInfo(), outfile);
+	}
+}
+
 bool DiskState::LoadHistory(DownloadQueue* downloadQueue, NzbList* nzbList, Servers* servers, FILE* infile, int formatVersion)
 {
 	debug("Loading history from disk");
@@ -1899,96 +2809,333 @@ bool DiskState::LoadHistory(DownloadQueue* downloadQueue, NzbList* nzbList, Serv
 	if (fscanf(infile, "%i\n", &size) != 1) goto error;
 	for (int i = 0; i < size; i++)
 	{
-		HistoryInfo* historyInfo = NULL;
-		HistoryInfo::EKind kind = HistoryInfo::hkNzb;
-		int id = 0;
-		int time;
+		HistoryInfo* historyInfo = LoadHistoryInfo(nzbList, servers, infile, formatVersion);
+		if (!historyInfo) goto error;
+		downloadQueue->GetHistory()->push_back(historyInfo);
+	}
+
+	return true;
+
+error:
+	error("Error reading diskstate for history");
+	return false;
+}
+
+HistoryInfo* DiskState::LoadHistoryInfo(NzbList* nzbList, Servers* servers, FILE* infile, int formatVersion)
+{
+	HistoryInfo* historyInfo = NULL;
+	HistoryInfo::EKind kind = HistoryInfo::hkNzb;
+	int id = 0;
+	int time;
+
+	if (formatVersion >= 33)
+	{
+		int kindval = 0;
+		if (fscanf(infile, "%i,%i,%i\n", &id, &kindval, &time) != 3) goto error;
+		kind = (HistoryInfo::EKind)kindval;
+	}
+	else
+	{
+		if (formatVersion >= 24)
+		{
+			if (fscanf(infile, "%i\n", &id) != 1) goto error;
+		}
 
-		if (formatVersion >= 33)
+		if (formatVersion >= 15)
 		{
 			int kindval = 0;
-			if (fscanf(infile, "%i,%i,%i\n", &id, &kindval, &time) != 3) goto error;
+			if (fscanf(infile, "%i\n", &kindval) != 1) goto error;
 			kind = (HistoryInfo::EKind)kindval;
 		}
+	}
+
+	if (kind == HistoryInfo::hkNzb)
+	{
+		NzbInfo* nzbInfo = NULL;
+
+		if (formatVersion < 43)
+		{
+			uint32 nzbIndex;
+			if (fscanf(infile, "%i\n", &nzbIndex) != 1) goto error;
+			nzbInfo = nzbList->at(nzbIndex - 1);
+		}
 		else
 		{
-			if (formatVersion >= 24)
+			nzbInfo = new NzbInfo();
+			if (!LoadNzbInfo(nzbInfo, servers, infile, formatVersion))
 			{
-				if (fscanf(infile, "%i\n", &id) != 1) goto error;
+				delete nzbInfo;
+				goto error;
 			}
+			nzbInfo->LeavePostProcess();
+		}
 
-			if (formatVersion >= 15)
-			{
-				int kindval = 0;
-				if (fscanf(infile, "%i\n", &kindval) != 1) goto error;
-				kind = (HistoryInfo::EKind)kindval;
-			}
+		historyInfo = new HistoryInfo(nzbInfo);
+
+		if (formatVersion < 28 && nzbInfo->GetParStatus() == 0 &&
+			nzbInfo->GetUnpackStatus() == 0 && nzbInfo->GetMoveStatus() == 0)
+		{
+			nzbInfo->SetDeleteStatus(NzbInfo::dsManual);
+		}
+	}
+	else if (kind == HistoryInfo::hkUrl)
+	{
+		NzbInfo* nzbInfo = new NzbInfo();
+		historyInfo = new HistoryInfo(nzbInfo);
+		if (formatVersion >= 46)
+		{
+			if (!LoadNzbInfo(nzbInfo, servers, infile, formatVersion)) goto error;
+		}
+		else
+		{
+			if (!LoadUrlInfo12(nzbInfo, infile, formatVersion)) goto error;
+		}
+	}
+	else if (kind == HistoryInfo::hkDup)
+	{
+		DupInfo* dupInfo = new DupInfo();
+		historyInfo = new HistoryInfo(dupInfo);
+		if (!LoadDupInfo(dupInfo, infile, formatVersion)) goto error;
+		if (formatVersion >= 47)
+		{
+			dupInfo->SetId(id);
 		}
+	}
+	else
+	{
+		goto error;
+	}
+
+	if (formatVersion < 33)
+	{
+		if (fscanf(infile, "%i\n", &time) != 1) goto error;
+	}
+
+	historyInfo->SetTime((time_t)time);
+
+	return historyInfo;
+
+error:
+	delete historyInfo;
+	return NULL;
+}
+
+/*
+ * Record of a journal transaction, applied to the queue when the transaction is complete.
+ */
+struct JournalEntry
+{
+	char			code;
+	int				id;
+	NzbInfo*		nzbInfo;
+	HistoryInfo*	historyInfo;
+	IdList			order;
+};
 
-		if (kind == HistoryInfo::hkNzb)
+typedef std::vector<JournalEntry> JournalEntries;
+
+template <class List, class Item>
+void ReplaceJournalItem(List* list, Item* item)
+{
+	for (typename List::iterator it = list->begin(); it != list->end(); it++)
+	{
+		if ((*it)->GetId() == item->GetId())
 		{
-			NzbInfo* nzbInfo = NULL;
+			delete *it;
+			*it = item;
+			return;
+		}
+	}
+	list->push_back(item);
+}
 
-			if (formatVersion < 43)
-			{
-				uint32 nzbIndex;
-				if (fscanf(infile, "%i\n", &nzbIndex) != 1) goto error;
-				nzbInfo = nzbList->at(nzbIndex - 1);
-			}
-			else
-			{
-				nzbInfo = new NzbInfo();
-				if (!LoadNzbInfo(nzbInfo, servers, infile, formatVersion)) goto error;
-				nzbInfo->LeavePostProcess();
-			}
+template <class List>
+void DeleteJournalItem(List* list, int id)
+{
+	for (typename List::iterator it = list->begin(); it != list->end(); it++)
+	{
+		if ((*it)->GetId() == id)
+		{
+			delete *it;
+			list->erase(it);
+			return;
+		}
+	}
+}
 
-			historyInfo = new HistoryInfo(nzbInfo);
+template <class List, class Item>
+void ReorderJournalItems(List* list, IdList* order, Item*)
+{
+	std::map<int, Item*> items;
+	for (typename List::iterator it = list->begin(); it != list->end(); it++)
+	{
+		items[(*it)->GetId()] = *it;
+	}
 
-			if (formatVersion < 28 && nzbInfo->GetParStatus() == 0 &&
-				nzbInfo->GetUnpackStatus() == 0 && nzbInfo->GetMoveStatus() == 0)
-			{
-				nzbInfo->SetDeleteStatus(NzbInfo::dsManual);
-			}
+	list->clear();
+	for (IdList::iterator it = order->begin(); it != order->end(); it++)
+	{
+		typename std::map<int, Item*>::iterator item = items.find(*it);
+		if (item != items.end())
+		{
+			list->push_back(item->second);
+			items.erase(item);
 		}
-		else if (kind == HistoryInfo::hkUrl)
+	}
+
+	// items missing in the order list (should not happen) remain in the list
+	for (typename std::map<int, Item*>::iterator it = items.begin(); it != items.end(); it++)
+	{
+		list->push_back(it->second);
+	}
+}
+
+bool DiskState::LoadQueueJournals(DownloadQueue* downloadQueue, Servers* servers, int snapshotId)
+{
+	IdList journalIds;
+	QueueJournal::FindJournals(&journalIds);
+
+	int journalId = snapshotId;
+	for (IdList::iterator it = journalIds.begin(); it != journalIds.end(); it++)
+	{
+		char filename[1024];
+		QueueJournal::JournalFilename(filename, 1024, *it);
+
+		if (*it < snapshotId)
 		{
-			NzbInfo* nzbInfo = new NzbInfo();
-			if (formatVersion >= 46)
-			{
-				if (!LoadNzbInfo(nzbInfo, servers, infile, formatVersion)) goto error;
-			}
-			else
+			// left from a compaction interrupted after the snapshot was saved
+			remove(filename);
+			continue;
+		}
+
+		debug("Replaying journal %s", filename);
+
+		FILE* infile = fopen(filename, FOPEN_RB);
+		if (!infile)
+		{
+			char errBuf[256];
+			error("Error reading diskstate: could not open file %s: %s", filename,
+				Util::GetLastErrorMessage(errBuf, sizeof(errBuf)));
+			return false;
+		}
+
+		char signature[128];
+		int formatVersion = fgets(signature, sizeof(signature), infile) ? ParseFormatVersion(signature) : 0;
+		bool ok = formatVersion > 0 && formatVersion <= QueueJournal::FormatVersion &&
+			LoadQueueJournal(downloadQueue, servers, infile, formatVersion);
+		fclose(infile);
+
+		if (!ok)
+		{
+			error("Error reading diskstate: journal %s is damaged", filename);
+			return false;
+		}
+
+		journalId = *it;
+	}
+
+	m_journal->SetJournalId(journalId);
+
+	return true;
+}
+
+bool DiskState::LoadQueueJournal(DownloadQueue* downloadQueue, Servers* servers, FILE* infile, int formatVersion)
+{
+	JournalEntries entries;
+	bool ok = true;
+	char buf[1024];
+
+	while (fgets(buf, sizeof(buf), infile))
+	{
+		JournalEntry entry;
+		entry.code = buf[0];
+		entry.id = 0;
+		entry.nzbInfo = NULL;
+		entry.historyInfo = NULL;
+		int size = 0;
+
+		if (entry.code == 'C')
+		{
+			for (JournalEntries::iterator it = entries.begin(); it != entries.end(); it++)
 			{
-				if (!LoadUrlInfo12(nzbInfo, infile, formatVersion)) goto error;
+				JournalEntry& entry = *it;
+				switch (entry.code)
+				{
+					case 'N':
+						ReplaceJournalItem(downloadQueue->GetQueue(), entry.nzbInfo);
+						break;
+
+					case 'X':
+						DeleteJournalItem(downloadQueue->GetQueue(), entry.id);
+						break;
+
+					case 'O':
+						ReorderJournalItems(downloadQueue->GetQueue(), &entry.order, (NzbInfo*)NULL);
+						break;
+
+					case 'H':
+						ReplaceJournalItem(downloadQueue->GetHistory(), entry.historyInfo);
+						break;
+
+					case 'Y':
+						DeleteJournalItem(downloadQueue->GetHistory(), entry.id);
+						break;
+
+					case 'P':
+						ReorderJournalItems(downloadQueue->GetHistory(), &entry.order, (HistoryInfo*)NULL);
+						break;
+				}
 			}
-			historyInfo = new HistoryInfo(nzbInfo);
+			entries.clear();
+			continue;
+		}
+		else if (entry.code == 'N')
+		{
+			entry.nzbInfo = new NzbInfo();
+			ok = LoadNzbInfo(entry.nzbInfo, servers, infile, formatVersion);
+		}
+		else if (entry.code == 'H')
+		{
+			entry.historyInfo = LoadHistoryInfo(NULL, servers, infile, formatVersion);
+			ok = entry.historyInfo != NULL;
+		}
+		else if (entry.code == 'X' || entry.code == 'Y')
+		{
+			ok = sscanf(buf + 1, "%i", &entry.id) == 1;
 		}
-		else if (kind == HistoryInfo::hkDup)
+		else if (entry.code == 'O' || entry.code == 'P')
 		{
-			DupInfo* dupInfo = new DupInfo();
-			if (!LoadDupInfo(dupInfo, infile, formatVersion)) goto error;
-			if (formatVersion >= 47)
+			ok = sscanf(buf + 1, "%i", &size) == 1;
+			for (int i = 0; i < size && ok; i++)
 			{
-				dupInfo->SetId(id);
+				int id;
+				ok = fscanf(infile, "%i\n", &id) == 1;
+				entry.order.push_back(id);
 			}
-			historyInfo = new HistoryInfo(dupInfo);
 		}
-
-		if (formatVersion < 33)
+		else
 		{
-			if (fscanf(infile, "%i\n", &time) != 1) goto error;
+			ok = false;
 		}
 
-		historyInfo->SetTime((time_t)time);
+		entries.push_back(entry);
 
-		downloadQueue->GetHistory()->push_back(historyInfo);
+		if (!ok)
+		{
+			break;
+		}
 	}
 
-	return true;
+	// the last transaction may be incomplete if the program was interrupted during saving
+	ok = ok || feof(infile);
 
-error:
-	error("Error reading diskstate for history");
-	return false;
+	for (JournalEntries::iterator it = entries.begin(); it != entries.end(); it++)
+	{
+		delete it->nzbInfo;
+		delete it->historyInfo;
+	}
+
+	return ok;
 }
 
 /*
@@ -2012,17 +3159,10 @@ int DiskState::FindNzbInfoIndex(NzbList* nzbList, NzbInfo* nzbInfo)
 /*
 * Find nzb-info by id.
 */
-NzbInfo* DiskState::FindNzbInfo(DownloadQueue* downloadQueue, int id)
+NzbInfo* DiskState::FindNzbInfo(NzbIndex* nzbIndex, int id)
 {
-	for (NzbList::iterator it = downloadQueue->GetQueue()->begin(); it != downloadQueue->GetQueue()->end(); it++)
-	{
-		NzbInfo* nzbInfo = *it;
-		if (nzbInfo->GetId() == id)
-		{
-			return nzbInfo;
-		}
-	}
-	return NULL;
+	NzbIndex::iterator it = nzbIndex->find(id);
+	return it != nzbIndex->end() ? it->second : NULL;
 }
 
 /*
@@ -2032,10 +3172,9 @@ void DiskState::DiscardDownloadQueue()
 {
 	debug("Discarding queue");
 
+	m_journal->Discard();
+
 	char fullFilename[1024];
-	snprintf(fullFilename, 1024, "%s%s", g_Options->GetQueueDir(), "queue");
-	fullFilename[1024-1] = '\0';
-	remove(fullFilename);
 
 	DirBrowser dir(g_Options->GetQueueDir());
 	while (const char* filename = dir.Next())
@@ -2418,6 +3557,9 @@ bool DiskState::LoadAllFileStates(DownloadQueue* downloadQueue, Servers* servers
 
 	bool cacheWasActive = Util::FileExists(cacheFlagFilename);
 
+	FileIndex fileIndex;
+	downloadQueue->GetQueue()->BuildIndex(NULL, &fileIndex);
+
 	DirBrowser dir(g_Options->GetQueueDir());
 	while (const char* filename = dir.Next())
 	{
@@ -2427,18 +3569,12 @@ bool DiskState::LoadAllFileStates(DownloadQueue* downloadQueue, Servers* servers
 		{
 			if (g_Options->GetContinuePartial() && !cacheWasActive)
 			{
-				for (NzbList::iterator it = downloadQueue->GetQueue()->begin(); it != downloadQueue->GetQueue()->end(); it++)
+				FileIndex::iterator it = fileIndex.find(id);
+				if (it != fileIndex.end())
 				{
-					NzbInfo* nzbInfo = *it;
-					for (FileList::iterator it2 = nzbInfo->GetFileList()->begin(); it2 != nzbInfo->GetFileList()->end(); it2++)
-					{
-						FileInfo* fileInfo = *it2;
-						if (fileInfo->GetId() == id)
-						{
-							if (!LoadArticles(fileInfo)) goto error;
-							if (!LoadFileState(fileInfo, servers, false)) goto error;
-						}
-					}
+					FileInfo* fileInfo = it->second;
+					if (!LoadArticles(fileInfo)) goto error;
+					if (!LoadFileState(fileInfo, servers, false)) goto error;
 				}
 			}
 			else
@@ -32,22 +32,48 @@
 #include "StatMeter.h"
 #include "Log.h"
 
+class QueueJournal;
+
 class DiskState
 {
+public:
+	/* Position of one queue or history record in a serialized queue */
+	struct StateRecord
+	{
+		int				id;
+		long			offset;
+		long			size;
+	};
+
+	typedef std::vector<StateRecord> StateRecords;
+
 private:
+	QueueJournal*		m_journal;
+
 	int					fscanf(FILE* infile, const char* format, ...);
 	bool				SaveFileInfo(FileInfo* fileInfo, const char* filename);
 	bool				LoadFileInfo(FileInfo* fileInfo, const char* filename, bool fileSummary, bool articles);
-	void				SaveNzbQueue(DownloadQueue* downloadQueue, FILE* outfile);
+	bool				LoadBinaryFileInfo(FileInfo* fileInfo, FILE* infile, bool fileSummary, bool articles);
+	bool				LoadBinaryFileState(FileInfo* fileInfo, Servers* servers, FILE* infile, bool completed, bool hasArticles);
+	void				SaveNzbQueue(DownloadQueue* downloadQueue, FILE* outfile, StateRecords* records);
 	bool				LoadNzbList(NzbList* nzbList, Servers* servers, FILE* infile, int formatVersion);
 	void				SaveNzbInfo(NzbInfo* nzbInfo, FILE* outfile);
 	bool				LoadNzbInfo(NzbInfo* nzbInfo, Servers* servers, FILE* infile, int formatVersion);
+	void				SaveCompletedFiles(NzbInfo* nzbInfo, FILE* outfile);
+	bool				LoadCompletedFiles(NzbInfo* nzbInfo, FILE* infile, int formatVersion);
+	void				SaveFileList(NzbInfo* nzbInfo, FILE* outfile);
+	bool				LoadFileList(NzbInfo* nzbInfo, FILE* infile, int formatVersion);
 	void				SavePostQueue(DownloadQueue* downloadQueue, FILE* outfile);
 	void				SaveDupInfo(DupInfo* dupInfo, FILE* outfile);
 	bool				LoadDupInfo(DupInfo* dupInfo, FILE* infile, int formatVersion);
-	void				SaveHistory(DownloadQueue* downloadQueue, FILE* outfile);
+	void				SaveHistory(DownloadQueue* downloadQueue, FILE* outfile, StateRecords* records);
 	bool				LoadHistory(DownloadQueue* downloadQueue, NzbList* nzbList, Servers* servers, FILE* infile, int formatVersion);
-	NzbInfo*			FindNzbInfo(DownloadQueue* downloadQueue, int id);
+	void				SaveHistoryInfo(HistoryInfo* historyInfo, FILE* outfile);
+	HistoryInfo*		LoadHistoryInfo(NzbList* nzbList, Servers* servers, FILE* infile, int formatVersion);
+	bool				SaveQueueJournal(DownloadQueue* downloadQueue);
+	bool				LoadQueueJournals(DownloadQueue* downloadQueue, Servers* servers, int snapshotId);
+	bool				LoadQueueJournal(DownloadQueue* downloadQueue, Servers* servers, FILE* infile, int formatVersion);
+	NzbInfo*			FindNzbInfo(NzbIndex* nzbIndex, int id);
 	bool				SaveFeedStatus(Feeds* feeds, FILE* outfile);
 	bool				LoadFeedStatus(Feeds* feeds, FILE* infile, int formatVersion);
 	bool				SaveFeedHistory(FeedHistory* feedHistory, FILE* outfile);
@@ -61,6 +87,8 @@ private:
 	bool				LoadAllFileStates(DownloadQueue* downloadQueue, Servers* servers);
 	void				SaveServerStats(ServerStatList* serverStatList, FILE* outfile);
 	bool				LoadServerStats(ServerStatList* serverStatList, Servers* servers, FILE* infile);
+	void				RestoreServerStat(ServerStatList* serverStatList, Servers* servers,
+							int serverId, int successArticles, int failedArticles);
 	bool				FinishWriteTransaction(const char* newFileName, const char* destFileName);
 
 	// backward compatibility functions (conversions from older formats)
@@ -76,6 +104,8 @@ private:
 	void				CalcCriticalHealth(NzbList* nzbList);
 
 public:
+						DiskState();
+						~DiskState();
 	bool				DownloadQueueExists();
 	bool				SaveDownloadQueue(DownloadQueue* downloadQueue);
 	bool				LoadDownloadQueue(DownloadQueue* downloadQueue, Servers* servers);
@@ -83,6 +113,8 @@ public:
 	bool				SaveFileState(FileInfo* fileInfo, bool completed);
 	bool				LoadFileState(FileInfo* fileInfo, Servers* servers, bool completed);
 	bool				LoadArticles(FileInfo* fileInfo);
+	bool				SaveNzbDetails(NzbInfo* nzbInfo);
+	bool				LoadNzbDetails(NzbInfo* nzbInfo);
 	void				DiscardDownloadQueue();
 	void				DiscardFile(FileInfo* fileInfo, bool deleteData, bool deletePartialState, bool deleteCompletedState);
 	void				DiscardFiles(NzbInfo* nzbInfo);
@@ -328,6 +328,9 @@ NzbInfo::NzbInfo() : m_fileList(true)
 	m_messageCount = 0;
 	m_cachedMessageCount = 0;
 	m_feedId = 0;
+	m_parBlockSize = 0;
+	m_detailsUnloaded = false;
+	m_detailsMaxFileId = 0;
 }
 
 NzbInfo::~NzbInfo()
@@ -385,6 +388,37 @@ void NzbInfo::ClearCompletedFiles()
 	m_completedFiles.clear();
 }
 
+/*
+ * Details of history items (lists of completed and parked files) are kept on disk
+ * and loaded only when needed. The ids of files in the unloaded lists stay reserved.
+ */
+void NzbInfo::SetDetailsUnloaded(bool detailsUnloaded, int maxFileId)
+{
+	m_detailsUnloaded = detailsUnloaded;
+	m_detailsMaxFileId = maxFileId;
+	if (FileInfo::m_idMax < maxFileId)
+	{
+		FileInfo::m_idMax = maxFileId;
+	}
+}
+
+void NzbInfo::UnloadDetails()
+{
+	int maxFileId = 0;
+	for (CompletedFiles::iterator it = m_completedFiles.begin(); it != m_completedFiles.end(); it++)
+	{
+		maxFileId = std::max(maxFileId, (*it)->GetId());
+	}
+	for (FileList::iterator it = m_fileList.begin(); it != m_fileList.end(); it++)
+	{
+		maxFileId = std::max(maxFileId, (*it)->GetId());
+	}
+
+	ClearCompletedFiles();
+	m_fileList.Clear();
+	SetDetailsUnloaded(true, maxFileId);
+}
+
 void NzbInfo::SetDestDir(const char* destDir)
 {
 	free(m_destDir);
@@ -1001,6 +1035,30 @@ NzbInfo* NzbList::Find(int id)
 	return NULL;
 }
 
+/*
+ * Fills id-indices of nzbs and of their files, for lookups of many ids at once.
+ * Either index can be NULL.
+ */
+void NzbList::BuildIndex(NzbIndex* nzbIndex, FileIndex* fileIndex)
+{
+	for (iterator it = begin(); it != end(); it++)
+	{
+		NzbInfo* nzbInfo = *it;
+		if (nzbIndex)
+		{
+			(*nzbIndex)[nzbInfo->GetId()] = nzbInfo;
+		}
+		if (fileIndex)
+		{
+			for (FileList::iterator it2 = nzbInfo->GetFileList()->begin(); it2 != nzbInfo->GetFileList()->end(); it2++)
+			{
+				FileInfo* fileInfo = *it2;
+				(*fileIndex)[fileInfo->GetId()] = fileInfo;
+			}
+		}
+	}
+}
+
 
 ArticleInfo::ArticleInfo()
 {
@@ -1047,9 +1105,8 @@ void ArticleInfo::DiscardSegment()
 {
 	if (m_segmentContent)
 	{
-		free(m_segmentContent);
+		g_ArticleCache->Free(m_segmentContent, m_segmentSize);
 		m_segmentContent = NULL;
-		g_ArticleCache->Free(m_segmentSize);
 	}
 }
 
@@ -1085,6 +1142,7 @@ FileInfo::FileInfo(int id)
 	m_activeDownloads = 0;
 	m_autoDeleted = false;
 	m_cachedArticles = 0;
+	m_cachedSize = 0;
 	m_partialChanged = false;
 	m_id = id ? id : ++m_idGen;
 }
@@ -1116,6 +1174,75 @@ void FileInfo::ClearArticles()
 	m_articles.clear();
 }
 
+/*
+ * Cached segments are tracked as runs of adjacent segments (start offset -> end offset),
+ * which are written into the file at once when the cache is flushed.
+ */
+void FileInfo::AddCachedSegment(int64 offset, int size)
+{
+	int64 start = offset;
+	int64 end = offset + size;
+
+	CachedRuns::iterator next = m_cachedRuns.find(end);
+	if (next != m_cachedRuns.end())
+	{
+		end = next->second;
+		m_cachedRuns.erase(next);
+	}
+
+	CachedRuns::iterator prev = m_cachedRuns.lower_bound(start);
+	if (prev != m_cachedRuns.begin() && (--prev)->second == start)
+	{
+		prev->second = end;
+	}
+	else
+	{
+		m_cachedRuns[start] = end;
+	}
+
+	m_cachedSize += size;
+}
+
+void FileInfo::RemoveCachedSegment(int64 offset, int size)
+{
+	int64 end = offset + size;
+
+	CachedRuns::iterator it = m_cachedRuns.upper_bound(offset);
+	if (it != m_cachedRuns.begin() && size > 0 &&
+		(--it)->first <= offset && it->second >= end)
+	{
+		int64 runEnd = it->second;
+		if (it->first < offset)
+		{
+			it->second = offset;
+		}
+		else
+		{
+			m_cachedRuns.erase(it);
+		}
+		if (end < runEnd)
+		{
+			m_cachedRuns[end] = runEnd;
+		}
+	}
+
+	m_cachedSize -= size;
+}
+
+void FileInfo::ClearCachedSegments()
+{
+	m_cachedRuns.clear();
+	m_cachedSize = 0;
+}
+
+/*
+ * Returns the average size of runs of adjacent cached segments.
+ */
+int64 FileInfo::GetCachedRunSize()
+{
+	return m_cachedRuns.empty() ? 0 : m_cachedSize / (int64)m_cachedRuns.size();
+}
+
 void FileInfo::SetId(int id)
 {
 	m_id = id;
@@ -1405,6 +1532,15 @@ HistoryInfo* HistoryList::Find(int id)
 	return NULL;
 }
 
+void HistoryList::BuildIndex(HistoryIndex* historyIndex)
+{
+	for (iterator it = begin(); it != end(); it++)
+	{
+		HistoryInfo* historyInfo = *it;
+		(*historyIndex)[historyInfo->GetId()] = historyInfo;
+	}
+}
+
 
 DownloadQueue* DownloadQueue::Lock()
 {
@@ -116,11 +116,41 @@ public:
 	void				SetCrc(uint32 crc) { m_crc = crc; }
 };
 
+/*
+ * CRCs of the parts of an article segment before and after a par-block
+ * boundary within the segment. They are computed from the segment content
+ * while it is in the article cache so that the quick par-verification
+ * doesn't need to read these parts back from disk.
+ */
+class SegmentSplit
+{
+private:
+	int64				m_segmentOffset;
+	int					m_segmentSize;
+	int64				m_splitOffset;
+	uint32				m_headCrc;
+	uint32				m_tailCrc;
+
+public:
+						SegmentSplit(int64 segmentOffset, int segmentSize, int64 splitOffset,
+							uint32 headCrc, uint32 tailCrc) :
+							m_segmentOffset(segmentOffset), m_segmentSize(segmentSize),
+							m_splitOffset(splitOffset), m_headCrc(headCrc), m_tailCrc(tailCrc) {}
+	int64				GetSegmentOffset() const { return m_segmentOffset; }
+	int					GetSegmentSize() const { return m_segmentSize; }
+	int64				GetSplitOffset() const { return m_splitOffset; }
+	uint32				GetHeadCrc() const { return m_headCrc; }
+	uint32				GetTailCrc() const { return m_tailCrc; }
+};
+
+typedef std::vector<SegmentSplit>	SegmentSplits;
+
 class FileInfo
 {
 public:
 	typedef std::vector<ArticleInfo*>	Articles;
 	typedef std::vector<char*>			Groups;
+	typedef std::map<int64, int64>		CachedRuns;
 
 private:
 	int					m_id;
@@ -152,12 +182,16 @@ private:
 	int					m_activeDownloads;
 	bool				m_autoDeleted;
 	int					m_cachedArticles;
+	int64				m_cachedSize;
+	CachedRuns			m_cachedRuns;
 	bool				m_partialChanged;
+	SegmentSplits		m_segmentSplits;
 
 	static int			m_idGen;
 	static int			m_idMax;
 
 	friend class CompletedFile;
+	friend class NzbInfo;
 
 public:
 						FileInfo(int id = 0);
@@ -219,9 +253,14 @@ public:
 	void				SetAutoDeleted(bool autoDeleted) { m_autoDeleted = autoDeleted; }
 	int					GetCachedArticles() { return m_cachedArticles; }
 	void				SetCachedArticles(int cachedArticles) { m_cachedArticles = cachedArticles; }
+	void				AddCachedSegment(int64 offset, int size);
+	void				RemoveCachedSegment(int64 offset, int size);
+	void				ClearCachedSegments();
+	int64				GetCachedRunSize();
 	bool				GetPartialChanged() { return m_partialChanged; }
 	void				SetPartialChanged(bool partialChanged) { m_partialChanged = partialChanged; }
 	ServerStatList*		GetServerStats() { return &m_serverStats; }
+	SegmentSplits*		GetSegmentSplits() { return &m_segmentSplits; }
 };
 
 typedef std::deque<FileInfo*> FileListBase;
@@ -237,6 +276,8 @@ public:
 	void				Remove(FileInfo* fileInfo);
 };
 
+typedef std::map<int, FileInfo*> FileIndex;
+
 class CompletedFile
 {
 public:
@@ -253,6 +294,7 @@ private:
 	char*				m_fileName;
 	EStatus				m_status;
 	uint32				m_crc;
+	SegmentSplits		m_segmentSplits;
 
 public:
 						CompletedFile(int id, const char* fileName, EStatus status, uint32 crc);
@@ -262,6 +304,8 @@ public:
 	const char*			GetFileName() { return m_fileName; }
 	EStatus				GetStatus() { return m_status; }
 	uint32				GetCrc() { return m_crc; }
+	// not saved on disk, available only until restart
+	SegmentSplits*		GetSegmentSplits() { return &m_segmentSplits; }
 };
 
 typedef std::deque<CompletedFile*>	CompletedFiles;
@@ -504,6 +548,9 @@ private:
 	int					m_messageCount;
 	int					m_cachedMessageCount;
 	int					m_feedId;
+	int64				m_parBlockSize;
+	bool				m_detailsUnloaded;
+	int					m_detailsMaxFileId;
 
 	static int			m_idGen;
 	static int			m_idMax;
@@ -665,6 +712,12 @@ public:
 	bool				GetParFull() { return m_parFull; }
 	int					GetFeedId() { return m_feedId; }
 	void				SetFeedId(int feedId) { m_feedId = feedId; }
+	int64				GetParBlockSize() { return m_parBlockSize; }
+	void				SetParBlockSize(int64 parBlockSize) { m_parBlockSize = parBlockSize; }
+	bool				GetDetailsUnloaded() { return m_detailsUnloaded; }
+	int					GetDetailsMaxFileId() { return m_detailsMaxFileId; }
+	void				SetDetailsUnloaded(bool detailsUnloaded, int maxFileId);
+	void				UnloadDetails();
 
 	void				CopyFileList(NzbInfo* srcNzbInfo);
 	void				UpdateMinMaxTime();
@@ -684,6 +737,7 @@ public:
 };
 
 typedef std::deque<NzbInfo*> NzbQueueBase;
+typedef std::map<int, NzbInfo*> NzbIndex;
 
 class NzbList : public NzbQueueBase
 {
@@ -696,6 +750,7 @@ public:
 	void				Add(NzbInfo* nzbInfo, bool addTop);
 	void				Remove(NzbInfo* nzbInfo);
 	NzbInfo*			Find(int id);
+	void				BuildIndex(NzbIndex* nzbIndex, FileIndex* fileIndex);
 };
 
 class PostInfo
@@ -861,12 +916,14 @@ public:
 };
 
 typedef std::deque<HistoryInfo*> HistoryListBase;
+typedef std::map<int, HistoryInfo*> HistoryIndex;
 
 class HistoryList : public HistoryListBase
 {
 public:
 						~HistoryList();
 	HistoryInfo*		Find(int id);
+	void				BuildIndex(HistoryIndex* historyIndex);
 };
 
 class DownloadQueue : public Subject
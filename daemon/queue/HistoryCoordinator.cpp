@@ -188,6 +188,14 @@ void HistoryCoordinator::AddToHistory(DownloadQueue* downloadQueue, NzbInfo* nzb
 		nzbInfo->GetFileList()->Clear();
 	}
 
+	if (g_Options->GetSaveQueue() && g_Options->GetServerMode() &&
+		!(nzbInfo->GetCompletedFiles()->empty() && nzbInfo->GetFileList()->empty()) &&
+		g_DiskState->SaveNzbDetails(nzbInfo))
+	{
+		// the lists of files are kept on disk until the item is returned to the queue
+		nzbInfo->UnloadDetails();
+	}
+
 	nzbInfo->PrintMessage(Message::mkInfo, "Collection %s added to history", nzbInfo->GetName());
 }
 
@@ -228,7 +236,7 @@ void HistoryCoordinator::HistoryHide(DownloadQueue* downloadQueue, HistoryInfo*
 	info("Collection %s removed from history", niceName);
 }
 
-void HistoryCoordinator::PrepareEdit(DownloadQueue* downloadQueue, IdList* idList, DownloadQueue::EEditAction action)
+void HistoryCoordinator::PrepareEdit(HistoryIndex* historyIndex, IdList* idList, DownloadQueue::EEditAction action)
 {
 	// First pass: when marking multiple items - mark them bad without performing the mark-logic,
 	// this will later (on second step) avoid moving other items to download queue, if they are marked bad too.
@@ -236,11 +244,10 @@ void HistoryCoordinator::PrepareEdit(DownloadQueue* downloadQueue, IdList* idLis
 	{
 		for (IdList::iterator itId = idList->begin(); itId != idList->end(); itId++)
 		{
-			int id = *itId;
-			HistoryInfo* historyInfo = downloadQueue->GetHistory()->Find(id);
-			if (historyInfo && historyInfo->GetKind() == HistoryInfo::hkNzb)
+			HistoryIndex::iterator indexIt = historyIndex->find(*itId);
+			if (indexIt != historyIndex->end() && indexIt->second->GetKind() == HistoryInfo::hkNzb)
 			{
-				historyInfo->GetNzbInfo()->SetMarkStatus(NzbInfo::ksBad);
+				indexIt->second->GetNzbInfo()->SetMarkStatus(NzbInfo::ksBad);
 			}
 		}
 	}
@@ -249,72 +256,92 @@ void HistoryCoordinator::PrepareEdit(DownloadQueue* downloadQueue, IdList* idLis
 bool HistoryCoordinator::EditList(DownloadQueue* downloadQueue, IdList* idList, DownloadQueue::EEditAction action, int offset, const char* text)
 {
 	bool ok = false;
-	PrepareEdit(downloadQueue, idList, action);
+
+	HistoryIndex historyIndex;
+	downloadQueue->GetHistory()->BuildIndex(&historyIndex);
+
+	PrepareEdit(&historyIndex, idList, action);
 
 	for (IdList::iterator itId = idList->begin(); itId != idList->end(); itId++)
 	{
 		int id = *itId;
-		for (HistoryList::iterator itHistory = downloadQueue->GetHistory()->begin(); itHistory != downloadQueue->GetHistory()->end(); itHistory++)
+		HistoryIndex::iterator indexIt = historyIndex.find(id);
+		if (indexIt == historyIndex.end())
 		{
-			HistoryInfo* historyInfo = *itHistory;
-			if (historyInfo->GetId() == id)
-			{
-				ok = true;
+			continue;
+		}
 
-				switch (action)
-				{
-					case DownloadQueue::eaHistoryDelete:
-					case DownloadQueue::eaHistoryFinalDelete:
-						HistoryDelete(downloadQueue, itHistory, historyInfo, action == DownloadQueue::eaHistoryFinalDelete);
-						break;
-
-					case DownloadQueue::eaHistoryReturn:
-					case DownloadQueue::eaHistoryProcess:
-						HistoryReturn(downloadQueue, itHistory, historyInfo, action == DownloadQueue::eaHistoryProcess);
-						break;
-
-					case DownloadQueue::eaHistoryRedownload:
-						HistoryRedownload(downloadQueue, itHistory, historyInfo, false);
-						break;
-
- 					case DownloadQueue::eaHistorySetParameter:
-						ok = HistorySetParameter(historyInfo, text);
-						break;
-
- 					case DownloadQueue::eaHistorySetCategory:
-						ok = HistorySetCategory(historyInfo, text);
-						break;
-
- 					case DownloadQueue::eaHistorySetName:
-						ok = HistorySetName(historyInfo, text);
-						break;
-
-					case DownloadQueue::eaHistorySetDupeKey:
-					case DownloadQueue::eaHistorySetDupeScore:
-					case DownloadQueue::eaHistorySetDupeMode:
-					case DownloadQueue::eaHistorySetDupeBackup:
-						HistorySetDupeParam(historyInfo, action, text);
-						break;
-
-					case DownloadQueue::eaHistoryMarkBad:
-						g_DupeCoordinator->HistoryMark(downloadQueue, historyInfo, NzbInfo::ksBad);
-						break;
-
-					case DownloadQueue::eaHistoryMarkGood:
-						g_DupeCoordinator->HistoryMark(downloadQueue, historyInfo, NzbInfo::ksGood);
-						break;
-
-					case DownloadQueue::eaHistoryMarkSuccess:
-						g_DupeCoordinator->HistoryMark(downloadQueue, historyInfo, NzbInfo::ksSuccess);
-						break;
-
-					default:
-						// nothing, just to avoid compiler warning
-						break;
-				}
+		HistoryInfo* historyInfo = indexIt->second;
+		HistoryList::iterator itHistory = downloadQueue->GetHistory()->end();
+		ok = true;
+
+		if (action == DownloadQueue::eaHistoryDelete || action == DownloadQueue::eaHistoryFinalDelete ||
+			action == DownloadQueue::eaHistoryReturn || action == DownloadQueue::eaHistoryProcess ||
+			action == DownloadQueue::eaHistoryRedownload)
+		{
+			// the item leaves history or is replaced with a hidden one
+			historyIndex.erase(indexIt);
+			itHistory = std::find(downloadQueue->GetHistory()->begin(), downloadQueue->GetHistory()->end(), historyInfo);
+		}
 
+		switch (action)
+		{
+			case DownloadQueue::eaHistoryDelete:
+			case DownloadQueue::eaHistoryFinalDelete:
+				HistoryDelete(downloadQueue, itHistory, historyInfo, action == DownloadQueue::eaHistoryFinalDelete);
+				break;
+
+			case DownloadQueue::eaHistoryReturn:
+			case DownloadQueue::eaHistoryProcess:
+				HistoryReturn(downloadQueue, itHistory, historyInfo, action == DownloadQueue::eaHistoryProcess);
+				break;
+
+			case DownloadQueue::eaHistoryRedownload:
+				HistoryRedownload(downloadQueue, itHistory, historyInfo, false);
+				break;
+
+			case DownloadQueue::eaHistorySetParameter:
+				ok = HistorySetParameter(historyInfo, text);
+				break;
+
+			case DownloadQueue::eaHistorySetCategory:
+				ok = HistorySetCategory(historyInfo, text);
+				break;
+
+			case DownloadQueue::eaHistorySetName:
+				ok = HistorySetName(historyInfo, text);
+				break;
+
+			case DownloadQueue::eaHistorySetDupeKey:
+			case DownloadQueue::eaHistorySetDupeScore:
+			case DownloadQueue::eaHistorySetDupeMode:
+			case DownloadQueue::eaHistorySetDupeBackup:
+				HistorySetDupeParam(historyInfo, action, text);
+				break;
+
+			case DownloadQueue::eaHistoryMarkBad:
+				g_DupeCoordinator->HistoryMark(downloadQueue, historyInfo, NzbInfo::ksBad);
+				break;
+
+			case DownloadQueue::eaHistoryMarkGood:
+				g_DupeCoordinator->HistoryMark(downloadQueue, historyInfo, NzbInfo::ksGood);
+				break;
+
+			case DownloadQueue::eaHistoryMarkSuccess:
+				g_DupeCoordinator->HistoryMark(downloadQueue, historyInfo, NzbInfo::ksSuccess);
+				break;
+
+			default:
+				// nothing, just to avoid compiler warning
 				break;
-			}
+		}
+
+		if (g_Options->GetDupeCheck() && (action == DownloadQueue::eaHistoryMarkBad ||
+			action == DownloadQueue::eaHistoryMarkGood || action == DownloadQueue::eaHistoryMarkSuccess))
+		{
+			// duplicate handling may have returned or hidden other history items
+			historyIndex.clear();
+			downloadQueue->GetHistory()->BuildIndex(&historyIndex);
 		}
 	}
 
@@ -387,6 +414,12 @@ void HistoryCoordinator::HistoryReturn(DownloadQueue* downloadQueue, HistoryList
 	{
 		nzbInfo = historyInfo->GetNzbInfo();
 
+		if (nzbInfo->GetDetailsUnloaded() && !g_DiskState->LoadNzbDetails(nzbInfo))
+		{
+			error("Could not return %s back from history to download queue: could not load the list of files", niceName);
+			return;
+		}
+
 		// unpark files
 		bool unparked = false;
 		for (FileList::iterator it = nzbInfo->GetFileList()->begin(); it != nzbInfo->GetFileList()->end(); it++)
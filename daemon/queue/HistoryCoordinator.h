@@ -41,7 +41,7 @@ private:
 	bool				HistorySetName(HistoryInfo* historyInfo, const char* text);
 	void				HistoryTransformToDup(DownloadQueue* downloadQueue, HistoryInfo* historyInfo, int rindex);
 	void				SaveQueue(DownloadQueue* downloadQueue);
-	void				PrepareEdit(DownloadQueue* downloadQueue, IdList* idList, DownloadQueue::EEditAction action);
+	void				PrepareEdit(HistoryIndex* historyIndex, IdList* idList, DownloadQueue::EEditAction action);
 
 protected:
 	virtual int			ServiceInterval() { return 600000; }
@@ -38,7 +38,10 @@
 bool QueueCoordinator::CoordinatorDownloadQueue::EditEntry(
 	int ID, EEditAction action, int offset, const char* text)
 {
-	return m_owner->m_queueEditor.EditEntry(&m_owner->m_downloadQueue, ID, action, offset, text);
+	bool ret = m_owner->m_queueEditor.EditEntry(&m_owner->m_downloadQueue, ID, action, offset, text);
+	m_owner->m_scheduler.Invalidate();
+	m_owner->WakeUp();
+	return ret;
 }
 
 bool QueueCoordinator::CoordinatorDownloadQueue::EditList(
@@ -51,11 +54,20 @@ bool QueueCoordinator::CoordinatorDownloadQueue::EditList(
 	{
 		Save();
 	}
+	m_owner->m_scheduler.Invalidate();
+	m_owner->WakeUp();
 	return ret;
 }
 
 void QueueCoordinator::CoordinatorDownloadQueue::Save()
 {
+	// the queue is saved after every change, files must be rescheduled
+	if (!m_keepSchedule)
+	{
+		m_owner->m_scheduler.Invalidate();
+	}
+	m_owner->WakeUp();
+
 	if (m_massEdit)
 	{
 		m_wantSave = true;
@@ -76,6 +88,7 @@ QueueCoordinator::QueueCoordinator()
 
 	m_hasMoreJobs = true;
 	m_serverConfigGeneration = 0;
+	m_wakeUp = false;
 
 	g_Log->RegisterDebuggable(this);
 
@@ -187,7 +200,7 @@ void QueueCoordinator::Run()
 	AdjustDownloadsLimit();
 	bool wasStandBy = true;
 	bool articeDownloadsRunning = false;
-	int resetCounter = 0;
+	int64 lastReset = Util::GetCurrentTicks();
 	g_StatMeter->IntervalCheck();
 
 	while (!IsStopped())
@@ -244,9 +257,15 @@ void QueueCoordinator::Run()
 			}
 		}
 
-		// sleep longer in StandBy
-		int sleepInterval = downloadStarted ? 0 : standBy ? 100 : 5;
-		usleep(sleepInterval * 1000);
+		int sinceReset = (int)((Util::GetCurrentTicks() - lastReset) / 1000);
+
+		// nothing more can be started now, sleep until a connection is freed,
+		// an article is completed or the queue is changed
+		if (!downloadStarted && sinceReset < 1000)
+		{
+			WaitJobs(1000 - sinceReset);
+			sinceReset = (int)((Util::GetCurrentTicks() - lastReset) / 1000);
+		}
 
 		if (!standBy)
 		{
@@ -255,8 +274,7 @@ void QueueCoordinator::Run()
 
 		Util::SetStandByMode(standBy);
 
-		resetCounter += sleepInterval;
-		if (resetCounter >= 1000)
+		if (sinceReset >= 1000)
 		{
 			// this code should not be called too often, once per second is OK
 			g_ServerPool->CloseUnusedConnections();
@@ -265,7 +283,7 @@ void QueueCoordinator::Run()
 			{
 				SavePartialState();
 			}
-			resetCounter = 0;
+			lastReset = Util::GetCurrentTicks();
 			g_StatMeter->IntervalCheck();
 			AdjustDownloadsLimit();
 		}
@@ -279,7 +297,10 @@ void QueueCoordinator::Run()
 		DownloadQueue::Lock();
 		completed = m_activeDownloads.size() == 0;
 		DownloadQueue::Unlock();
-		usleep(100 * 1000);
+		if (!completed)
+		{
+			WaitJobs(100);
+		}
 		ResetHangingDownloads();
 	}
 	debug("QueueCoordinator: Downloads are completed");
@@ -289,6 +310,30 @@ void QueueCoordinator::Run()
 	debug("Exiting QueueCoordinator-loop");
 }
 
+void QueueCoordinator::WaitJobs(int msec)
+{
+	m_waitMutex.Lock();
+	if (!m_wakeUp)
+	{
+		m_waitCond.Wait(&m_waitMutex, msec);
+	}
+	m_wakeUp = false;
+	m_waitMutex.Unlock();
+}
+
+/*
+ * Wakes up the coordinator waiting in "WaitJobs". Must be called when a new
+ * download can possibly be started: a connection was freed, an article was
+ * completed, the queue was changed or the download was resumed.
+ */
+void QueueCoordinator::WakeUp()
+{
+	m_waitMutex.Lock();
+	m_wakeUp = true;
+	m_waitCond.NotifyAll();
+	m_waitMutex.Unlock();
+}
+
 /*
  * Compute maximum number of allowed download threads
 **/
@@ -303,12 +348,13 @@ void QueueCoordinator::AdjustDownloadsLimit()
 	int downloadsLimit = 2;
 
 	// allow one thread per 0-level (main) and 1-level (backup) server connection
+	// and per each pipelined request on these connections
 	for (Servers::iterator it = g_ServerPool->GetServers()->begin(); it != g_ServerPool->GetServers()->end(); it++)
 	{
 		NewsServer* newsServer = *it;
 		if ((newsServer->GetNormLevel() == 0 || newsServer->GetNormLevel() == 1) && newsServer->GetActive())
 		{
-			downloadsLimit += newsServer->GetMaxConnections();
+			downloadsLimit += newsServer->GetMaxConnections() * newsServer->GetPipelining();
 		}
 	}
 
@@ -458,6 +504,7 @@ void QueueCoordinator::CheckDupeFileInfos(NzbInfo* nzbInfo)
 void QueueCoordinator::Stop()
 {
 	Thread::Stop();
+	WakeUp();
 
 	debug("Stopping ArticleDownloads");
 	DownloadQueue::Lock();
@@ -474,101 +521,9 @@ void QueueCoordinator::Stop()
  */
 bool QueueCoordinator::GetNextArticle(DownloadQueue* downloadQueue, FileInfo* &fileInfo, ArticleInfo* &articleInfo)
 {
-	// find an unpaused file with the highest priority, then take the next article from the file.
-	// if the file doesn't have any articles left for download, we store that fact and search again,
-	// ignoring all files which were previously marked as not having any articles.
-
-	// special case: if the file has ExtraPriority-flag set, it has the highest priority and the
-	// Paused-flag is ignored.
-
-	//debug("QueueCoordinator::GetNextArticle()");
-
-	bool ok = false;
-
-	// pCheckedFiles stores
-	bool* checkedFiles = NULL;
-	time_t curDate = time(NULL);
-
-	while (!ok)
-	{
-		fileInfo = NULL;
-		int num = 0;
-		int fileNum = 0;
-
-		for (NzbList::iterator it = downloadQueue->GetQueue()->begin(); it != downloadQueue->GetQueue()->end(); it++)
-		{
-			NzbInfo* nzbInfo = *it;
-			for (FileList::iterator it2 = nzbInfo->GetFileList()->begin(); it2 != nzbInfo->GetFileList()->end(); it2++)
-			{
-				FileInfo* fileInfo1 = *it2;
-				if ((!checkedFiles || !checkedFiles[num]) &&
-					!fileInfo1->GetPaused() && !fileInfo1->GetDeleted() &&
-					(g_Options->GetPropagationDelay() == 0 ||
-					 (int)fileInfo1->GetTime() < (int)curDate - g_Options->GetPropagationDelay()) &&
-					(!g_Options->GetPauseDownload() || nzbInfo->GetForcePriority()) &&
-					(!fileInfo ||
-					 (fileInfo1->GetExtraPriority() == fileInfo->GetExtraPriority() &&
-					  fileInfo1->GetNzbInfo()->GetPriority() > fileInfo->GetNzbInfo()->GetPriority()) ||
-					 (fileInfo1->GetExtraPriority() > fileInfo->GetExtraPriority())))
-				{
-					fileInfo = fileInfo1;
-					fileNum = num;
-				}
-				num++;
-			}
-		}
-
-		if (!fileInfo)
-		{
-			// there are no more files for download
-			break;
-		}
-
-		if (fileInfo->GetArticles()->empty() && g_Options->GetSaveQueue() && g_Options->GetServerMode())
-		{
-			g_DiskState->LoadArticles(fileInfo);
-		}
-
-		// check if the file has any articles left for download
-		for (FileInfo::Articles::iterator at = fileInfo->GetArticles()->begin(); at != fileInfo->GetArticles()->end(); at++)
-		{
-			articleInfo = *at;
-			if (articleInfo->GetStatus() == ArticleInfo::aiUndefined)
-			{
-				ok = true;
-				break;
-			}
-		}
-
-		if (!ok)
-		{
-			// the file doesn't have any articles left for download, we mark the file as such
-			if (!checkedFiles)
-			{
-				int totalFileCount = 0;
-				for (NzbList::iterator it = downloadQueue->GetQueue()->begin(); it != downloadQueue->GetQueue()->end(); it++)
-				{
-					NzbInfo* nzbInfo = *it;
-					totalFileCount += nzbInfo->GetFileList()->size();
-				}
-
-				if (totalFileCount > 0)
-				{
-					int arrSize = sizeof(bool) * totalFileCount;
-					checkedFiles = (bool*)malloc(arrSize);
-					memset(checkedFiles, false, arrSize);
-				}
-			}
-			if (checkedFiles)
-			{
-				checkedFiles[fileNum] = true;
-			}
-		}
-	}
-
-	free(checkedFiles);
-
-	return ok;
+	return m_scheduler.GetNextArticle(downloadQueue->GetQueue(), g_Options->GetPauseDownload(),
+		g_Options->GetPropagationDelay(), g_Options->GetSaveQueue() && g_Options->GetServerMode(),
+		fileInfo, articleInfo);
 }
 
 void QueueCoordinator::StartArticleDownload(FileInfo* fileInfo, ArticleInfo* articleInfo, NntpConnection* connection)
@@ -641,6 +596,7 @@ void QueueCoordinator::ArticleCompleted(ArticleDownloader* articleDownloader)
 	else if (articleDownloader->GetStatus() == ArticleDownloader::adRetry)
 	{
 		articleInfo->SetStatus(ArticleInfo::aiUndefined);
+		m_scheduler.Invalidate();
 		retry = true;
 	}
 
@@ -713,10 +669,15 @@ void QueueCoordinator::ArticleCompleted(ArticleDownloader* articleDownloader)
 	if (deleteFileObj)
 	{
 		DeleteFileInfo(downloadQueue, fileInfo, fileCompleted);
+		// the file was already removed from the schedule
+		m_downloadQueue.m_keepSchedule = true;
 		downloadQueue->Save();
+		m_downloadQueue.m_keepSchedule = false;
 	}
 
 	DownloadQueue::Unlock();
+
+	WakeUp();
 }
 
 void QueueCoordinator::StatFileInfo(FileInfo* fileInfo, bool completed)
@@ -780,6 +741,7 @@ void QueueCoordinator::DeleteFileInfo(DownloadQueue* downloadQueue, FileInfo* fi
 
 	bool fileDeleted = fileInfo->GetDeleted();
 	fileInfo->SetDeleted(true);
+	m_scheduler.FileDeleted(fileInfo);
 
 	StatFileInfo(fileInfo, completed);
 
@@ -808,6 +770,11 @@ void QueueCoordinator::DeleteFileInfo(DownloadQueue* downloadQueue, FileInfo* fi
 		nzbInfo->GetFileList()->Remove(fileInfo);
 		delete fileInfo;
 	}
+	else
+	{
+		// nzb-file was removed together with its remaining files
+		m_scheduler.Invalidate();
+	}
 }
 
 void QueueCoordinator::DiscardDiskFile(FileInfo* fileInfo)
@@ -944,6 +911,7 @@ void QueueCoordinator::ResetHangingDownloads()
 				error("Terminated hanging download %s @ %s", articleDownloader->GetInfoName(),
 					articleDownloader->GetConnectionName());
 				articleInfo->SetStatus(ArticleInfo::aiUndefined);
+				m_scheduler.Invalidate();
 			}
 			else
 			{
@@ -1261,3 +1229,130 @@ bool QueueCoordinator::SplitQueueEntries(DownloadQueue* downloadQueue, FileList*
 	*newNzbInfo = nzbInfo;
 	return true;
 }
+
+bool ArticleScheduler::CompareFiles(const ScheduledFile& file1, const ScheduledFile& file2)
+{
+	return file1.m_extraPriority != file2.m_extraPriority ? file1.m_extraPriority :
+		file1.m_priority > file2.m_priority;
+}
+
+/*
+ * Collects all files available for download and sorts them: files with ExtraPriority-flag
+ * first, then by priority of nzb. Files having the same priority keep their queue order.
+ */
+void ArticleScheduler::Build(NzbList* queue, bool pauseDownload, int propagationDelay, time_t curDate)
+{
+	m_schedule.clear();
+	m_head = 0;
+	m_valid = true;
+	m_pauseDownload = pauseDownload;
+	m_delayedTime = 0;
+
+	for (NzbList::iterator it = queue->begin(); it != queue->end(); it++)
+	{
+		NzbInfo* nzbInfo = *it;
+		if (pauseDownload && !nzbInfo->GetForcePriority())
+		{
+			continue;
+		}
+
+		for (FileList::iterator it2 = nzbInfo->GetFileList()->begin(); it2 != nzbInfo->GetFileList()->end(); it2++)
+		{
+			FileInfo* fileInfo = *it2;
+			if (fileInfo->GetPaused() || fileInfo->GetDeleted())
+			{
+				continue;
+			}
+
+			if (propagationDelay > 0 && (int)fileInfo->GetTime() >= (int)curDate - propagationDelay)
+			{
+				// check the file again when the delay is over
+				time_t availableTime = fileInfo->GetTime() + propagationDelay + 1;
+				if (m_delayedTime == 0 || availableTime < m_delayedTime)
+				{
+					m_delayedTime = availableTime;
+				}
+				continue;
+			}
+
+			ScheduledFile file = { fileInfo, fileInfo->GetExtraPriority(), nzbInfo->GetPriority(), 0 };
+			m_schedule.push_back(file);
+		}
+	}
+
+	std::stable_sort(m_schedule.begin(), m_schedule.end(), CompareFiles);
+}
+
+/*
+ * Finds an unpaused file with the highest priority, then takes the next article from the file.
+ * Files which don't have any articles left for download are skipped until the index is rebuilt.
+ */
+bool ArticleScheduler::GetNextArticle(NzbList* queue, bool pauseDownload, int propagationDelay,
+	bool loadArticles, FileInfo* &fileInfo, ArticleInfo* &articleInfo)
+{
+	time_t curDate = time(NULL);
+
+	if (!m_valid || pauseDownload != m_pauseDownload || (m_delayedTime > 0 && curDate >= m_delayedTime))
+	{
+		Build(queue, pauseDownload, propagationDelay, curDate);
+	}
+
+	for (; m_head < (int)m_schedule.size(); m_head++)
+	{
+		ScheduledFile& file = m_schedule[m_head];
+		if (!file.m_fileInfo || file.m_fileInfo->GetPaused() || file.m_fileInfo->GetDeleted())
+		{
+			continue;
+		}
+
+		FileInfo::Articles* articles = file.m_fileInfo->GetArticles();
+		if (articles->empty() && loadArticles)
+		{
+			g_DiskState->LoadArticles(file.m_fileInfo);
+		}
+
+		for (; file.m_nextArticle < (int)articles->size(); file.m_nextArticle++)
+		{
+			ArticleInfo* article = articles->at(file.m_nextArticle);
+			if (article->GetStatus() == ArticleInfo::aiUndefined)
+			{
+				fileInfo = file.m_fileInfo;
+				articleInfo = article;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Removes the file from index without rebuilding it. A completed file has all its
+ * articles started and therefore is usually located just before the head of index.
+ */
+void ArticleScheduler::FileDeleted(FileInfo* fileInfo)
+{
+	if (!m_valid)
+	{
+		return;
+	}
+
+	int size = (int)m_schedule.size();
+	for (int i = std::min(m_head, size - 1); i >= 0; i--)
+	{
+		if (m_schedule[i].m_fileInfo == fileInfo)
+		{
+			m_schedule[i].m_fileInfo = NULL;
+			return;
+		}
+	}
+
+	for (int i = m_head + 1; i < size; i++)
+	{
+		if (m_schedule[i].m_fileInfo == fileInfo)
+		{
+			m_schedule[i].m_fileInfo = NULL;
+			return;
+		}
+	}
+}
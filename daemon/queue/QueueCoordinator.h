@@ -36,6 +36,44 @@
 #include "QueueEditor.h"
 #include "NntpConnection.h"
 
+/*
+ * Index of files available for download, ordered by priority and by position in
+ * the queue. Each file has a cursor pointing to its next article for download.
+ * Finding the next article therefore doesn't require to scan the whole queue.
+ * The index is rebuilt on the next request after "Invalidate" was called, which
+ * must be done on every change of the queue affecting the order of files or their
+ * availability for download.
+ */
+class ArticleScheduler
+{
+private:
+	struct ScheduledFile
+	{
+		FileInfo*			m_fileInfo;
+		bool				m_extraPriority;
+		int					m_priority;
+		int					m_nextArticle;	// articles before this index are not available for download
+	};
+
+	typedef std::vector<ScheduledFile>	Schedule;
+
+	Schedule				m_schedule;
+	int						m_head;			// files before this index have no articles for download
+	bool					m_valid;
+	bool					m_pauseDownload;
+	time_t					m_delayedTime;	// when the next file held back by propagation delay becomes available
+
+	static bool				CompareFiles(const ScheduledFile& file1, const ScheduledFile& file2);
+	void					Build(NzbList* queue, bool pauseDownload, int propagationDelay, time_t curDate);
+
+public:
+							ArticleScheduler() : m_head(0), m_valid(false), m_pauseDownload(false), m_delayedTime(0) {}
+	bool					GetNextArticle(NzbList* queue, bool pauseDownload, int propagationDelay,
+								bool loadArticles, FileInfo* &fileInfo, ArticleInfo* &articleInfo);
+	void					Invalidate() { m_valid = false; }
+	void					FileDeleted(FileInfo* fileInfo);
+};
+
 class QueueCoordinator : public Thread, public Observer, public Debuggable
 {
 public:
@@ -48,9 +86,10 @@ private:
 		QueueCoordinator*	m_owner;
 		bool				m_massEdit;
 		bool				m_wantSave;
+		bool				m_keepSchedule;
 		friend class QueueCoordinator;
 	public:
-							CoordinatorDownloadQueue(): m_massEdit(false), m_wantSave(false) {}
+							CoordinatorDownloadQueue(): m_massEdit(false), m_wantSave(false), m_keepSchedule(false) {}
 		virtual bool		EditEntry(int ID, EEditAction action, int offset, const char* text);
 		virtual bool		EditList(IdList* idList, NameList* nameList, EMatchMode matchMode, EEditAction action, int offset, const char* text);
 		virtual void		Save();
@@ -60,9 +99,13 @@ private:
 	CoordinatorDownloadQueue	m_downloadQueue;
 	ActiveDownloads				m_activeDownloads;
 	QueueEditor					m_queueEditor;
+	ArticleScheduler			m_scheduler;
 	bool						m_hasMoreJobs;
 	int							m_downloadsLimit;
 	int							m_serverConfigGeneration;
+	Mutex						m_waitMutex;
+	ConditionVar				m_waitCond;
+	bool						m_wakeUp;
 
 	bool					GetNextArticle(DownloadQueue* downloadQueue, FileInfo* &fileInfo, ArticleInfo* &articleInfo);
 	void					StartArticleDownload(FileInfo* fileInfo, ArticleInfo* articleInfo, NntpConnection* connection);
@@ -74,6 +117,7 @@ private:
 	void					AdjustDownloadsLimit();
 	void					Load();
 	void					SavePartialState();
+	void					WaitJobs(int msec);
 
 protected:
 	virtual void			LogDebugInfo();
@@ -84,6 +128,7 @@ public:
 	virtual void			Run();
 	virtual void 			Stop();
 	void					Update(Subject* Caller, void* Aspect);
+	void					WakeUp();
 
 	// editing queue
 	void					AddNzbFileToQueue(NzbFile* nzbFile, NzbInfo* urlInfo, bool addFirst);
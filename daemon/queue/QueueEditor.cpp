@@ -252,23 +252,6 @@ QueueEditor::~QueueEditor()
 	debug("Destroying QueueEditor");
 }
 
-FileInfo* QueueEditor::FindFileInfo(int id)
-{
-	for (NzbList::iterator it = m_downloadQueue->GetQueue()->begin(); it != m_downloadQueue->GetQueue()->end(); it++)
-	{
-		NzbInfo* nzbInfo = *it;
-		for (FileList::iterator it2 = nzbInfo->GetFileList()->begin(); it2 != nzbInfo->GetFileList()->end(); it2++)
-		{
-			FileInfo* fileInfo = *it2;
-			if (fileInfo->GetId() == id)
-			{
-				return fileInfo;
-			}
-		}
-	}
-	return NULL;
-}
-
 /*
  * Set the pause flag of the specific entry in the queue
  */
@@ -526,6 +509,7 @@ void QueueEditor::PrepareList(ItemList* itemList, IdList* idList,
 	}
 
 	itemList->reserve(idList->size());
+	std::set<int> idSet(idList->begin(), idList->end());
 	if ((offset != 0) &&
 		(action == DownloadQueue::eaFileMoveOffset || action == DownloadQueue::eaFileMoveTop || action == DownloadQueue::eaFileMoveBottom))
 	{
@@ -551,8 +535,7 @@ void QueueEditor::PrepareList(ItemList* itemList, IdList* idList,
 			for (int index = start; index != end; index += step)
 			{
 				FileInfo* fileInfo = nzbInfo->GetFileList()->at(index);
-				IdList::iterator it2 = std::find(idList->begin(), idList->end(), fileInfo->GetId());
-				if (it2 != idList->end())
+				if (idSet.find(fileInfo->GetId()) != idSet.end())
 				{
 					int workOffset = offset;
 					int destPos = index + workOffset;
@@ -607,8 +590,7 @@ void QueueEditor::PrepareList(ItemList* itemList, IdList* idList,
 		for (int index = start; index != end; index += step)
 		{
 			NzbInfo* nzbInfo = m_downloadQueue->GetQueue()->at(index);
-			IdList::iterator it2 = std::find(idList->begin(), idList->end(), nzbInfo->GetId());
-			if (it2 != idList->end())
+			if (idSet.find(nzbInfo->GetId()) != idSet.end())
 			{
 				int workOffset = offset;
 				int destPos = index + workOffset;
@@ -641,74 +623,31 @@ void QueueEditor::PrepareList(ItemList* itemList, IdList* idList,
 	}
 	else if (action < DownloadQueue::eaGroupMoveOffset)
 	{
-		// check ID range
-		int maxId = 0;
-		int minId = MAX_ID;
-		for (NzbList::iterator it = m_downloadQueue->GetQueue()->begin(); it != m_downloadQueue->GetQueue()->end(); it++)
-		{
-			NzbInfo* nzbInfo = *it;
-			for (FileList::iterator it2 = nzbInfo->GetFileList()->begin(); it2 != nzbInfo->GetFileList()->end(); it2++)
-			{
-				FileInfo* fileInfo = *it2;
-				int ID = fileInfo->GetId();
-				if (ID > maxId)
-				{
-					maxId = ID;
-				}
-				if (ID < minId)
-				{
-					minId = ID;
-				}
-			}
-		}
+		FileIndex fileIndex;
+		m_downloadQueue->GetQueue()->BuildIndex(NULL, &fileIndex);
 
 		//add IDs to list in order they were transmitted in command
 		for (IdList::iterator it = idList->begin(); it != idList->end(); it++)
 		{
-			int id = *it;
-			if (minId <= id && id <= maxId)
+			FileIndex::iterator fileIt = fileIndex.find(*it);
+			if (fileIt != fileIndex.end())
 			{
-				FileInfo* fileInfo = FindFileInfo(id);
-				if (fileInfo)
-				{
-					itemList->push_back(new EditItem(fileInfo, NULL, offset));
-				}
+				itemList->push_back(new EditItem(fileIt->second, NULL, offset));
 			}
 		}
 	}
 	else
 	{
-		// check ID range
-		int maxId = 0;
-		int minId = MAX_ID;
-		for (NzbList::iterator it = m_downloadQueue->GetQueue()->begin(); it != m_downloadQueue->GetQueue()->end(); it++)
-		{
-			NzbInfo* nzbInfo = *it;
-			int ID = nzbInfo->GetId();
-			if (ID > maxId)
-			{
-				maxId = ID;
-			}
-			if (ID < minId)
-			{
-				minId = ID;
-			}
-		}
+		NzbIndex nzbIndex;
+		m_downloadQueue->GetQueue()->BuildIndex(&nzbIndex, NULL);
 
 		//add IDs to list in order they were transmitted in command
 		for (IdList::iterator it = idList->begin(); it != idList->end(); it++)
 		{
-			int id = *it;
-			if (minId <= id && id <= maxId)
+			NzbIndex::iterator nzbIt = nzbIndex.find(*it);
+			if (nzbIt != nzbIndex.end())
 			{
-				for (NzbList::iterator it2 = m_downloadQueue->GetQueue()->begin(); it2 != m_downloadQueue->GetQueue()->end(); it2++)
-				{
-					NzbInfo* nzbInfo = *it2;
-					if (id == nzbInfo->GetId())
-					{
-						itemList->push_back(new EditItem(NULL, nzbInfo, offset));
-					}
-				}
+				itemList->push_back(new EditItem(NULL, nzbIt->second, offset));
 			}
 		}
 	}
@@ -723,63 +662,79 @@ bool QueueEditor::BuildIdListFromNameList(IdList* idList, NameList* nameList, Do
 	}
 #endif
 
-	std::set<int> uniqueIds;
+	typedef std::vector<std::pair<std::string, int> > NameIdList;
+	typedef std::multimap<std::string, int> NameIndex;
 
-	for (NameList::iterator it = nameList->begin(); it != nameList->end(); it++)
+	// names of files or groups in queue order, formatted only once for all names from the list
+	NameIdList candidates;
+	for (NzbList::iterator it = m_downloadQueue->GetQueue()->begin(); it != m_downloadQueue->GetQueue()->end(); it++)
 	{
-		const char* name = *it;
+		NzbInfo* nzbInfo = *it;
 
-		RegEx *regEx = NULL;
-		if (matchMode == DownloadQueue::mmRegEx)
+		if (action < DownloadQueue::eaGroupMoveOffset)
 		{
-			regEx = new RegEx(name);
-			if (!regEx->IsValid())
+			// file action
+			for (FileList::iterator it2 = nzbInfo->GetFileList()->begin(); it2 != nzbInfo->GetFileList()->end(); it2++)
 			{
-				delete regEx;
-				return false;
+				FileInfo* fileInfo = *it2;
+				char filename[MAX_PATH];
+				snprintf(filename, sizeof(filename) - 1, "%s/%s", fileInfo->GetNzbInfo()->GetName(), Util::BaseFileName(fileInfo->GetFilename()));
+				candidates.push_back(std::make_pair(std::string(filename), fileInfo->GetId()));
 			}
 		}
+		else
+		{
+			// group action
+			candidates.push_back(std::make_pair(std::string(nzbInfo->GetName()), nzbInfo->GetId()));
+		}
+	}
 
+	NameIndex nameIndex;
+	if (matchMode != DownloadQueue::mmRegEx)
+	{
+		for (NameIdList::iterator it = candidates.begin(); it != candidates.end(); it++)
+		{
+			nameIndex.insert(nameIndex.end(), *it);
+		}
+	}
+
+	std::set<int> uniqueIds;
+
+	for (NameList::iterator it = nameList->begin(); it != nameList->end(); it++)
+	{
+		const char* name = *it;
 		bool found = false;
 
-		for (NzbList::iterator it3 = m_downloadQueue->GetQueue()->begin(); it3 != m_downloadQueue->GetQueue()->end(); it3++)
+		if (matchMode == DownloadQueue::mmRegEx)
 		{
-			NzbInfo* nzbInfo = *it3;
+			RegEx regEx(name);
+			if (!regEx.IsValid())
+			{
+				return false;
+			}
 
-			for (FileList::iterator it2 = nzbInfo->GetFileList()->begin(); it2 != nzbInfo->GetFileList()->end(); it2++)
+			for (NameIdList::iterator it2 = candidates.begin(); it2 != candidates.end(); it2++)
 			{
-				FileInfo* fileInfo = *it2;
-				if (action < DownloadQueue::eaGroupMoveOffset)
+				if (regEx.Match(it2->first.c_str()) && uniqueIds.insert(it2->second).second)
 				{
-					// file action
-					char filename[MAX_PATH];
-					snprintf(filename, sizeof(filename) - 1, "%s/%s", fileInfo->GetNzbInfo()->GetName(), Util::BaseFileName(fileInfo->GetFilename()));
-					if (((!regEx && !strcmp(filename, name)) || (regEx && regEx->Match(filename))) &&
-						(uniqueIds.find(fileInfo->GetId()) == uniqueIds.end()))
-					{
-						uniqueIds.insert(fileInfo->GetId());
-						idList->push_back(fileInfo->GetId());
-						found = true;
-					}
+					idList->push_back(it2->second);
+					found = true;
 				}
 			}
-
-			if (action >= DownloadQueue::eaGroupMoveOffset)
+		}
+		else
+		{
+			std::pair<NameIndex::iterator, NameIndex::iterator> range = nameIndex.equal_range(name);
+			for (NameIndex::iterator it2 = range.first; it2 != range.second; it2++)
 			{
-				// group action
-				const char *filename = nzbInfo->GetName();
-				if (((!regEx && !strcmp(filename, name)) || (regEx && regEx->Match(filename))) &&
-					(uniqueIds.find(nzbInfo->GetId()) == uniqueIds.end()))
+				if (uniqueIds.insert(it2->second).second)
 				{
-					uniqueIds.insert(nzbInfo->GetId());
-					idList->push_back(nzbInfo->GetId());
+					idList->push_back(it2->second);
 					found = true;
 				}
 			}
 		}
 
-		delete regEx;
-
 		if (!found && (matchMode == DownloadQueue::mmName))
 		{
 			return false;
@@ -47,7 +47,6 @@ private:
 	DownloadQueue*			m_downloadQueue;
 
 private:
-	FileInfo*				FindFileInfo(int id);
 	bool					InternEditList(ItemList* itemList, IdList* idList, DownloadQueue::EEditAction action, int offset, const char* text);
 	void					PrepareList(ItemList* itemList, IdList* idList, DownloadQueue::EEditAction action, int offset);
 	bool					BuildIdListFromNameList(IdList* idList, NameList* nameList, DownloadQueue::EMatchMode matchMode, DownloadQueue::EEditAction action);
@@ -33,6 +33,7 @@
 #include "DownloadInfo.h"
 #include "Scanner.h"
 #include "StatMeter.h"
+#include "QueueCoordinator.h"
 
 extern void ExitProc();
 extern void Reload();
@@ -331,6 +332,7 @@ void PauseUnpauseBinCommand::Execute()
 	{
 		case rpDownload:
 			g_Options->SetPauseDownload(ntohl(PauseUnpauseRequest.m_pause));
+			g_QueueCoordinator->WakeUp();
 			break;
 
 		case rpPostProcess:
@@ -37,6 +37,7 @@
 #include "DiskState.h"
 #include "ScriptConfig.h"
 #include "QueueScript.h"
+#include "QueueCoordinator.h"
 
 extern void ExitProc();
 extern void Reload();
@@ -1144,6 +1145,7 @@ void PauseUnpauseXmlCommand::Execute()
 	{
 		case paDownload:
 			g_Options->SetPauseDownload(m_pause);
+			g_QueueCoordinator->WakeUp();
 			break;
 
 		case paPostProcess:
@@ -1257,6 +1259,7 @@ void StatusXmlCommand::Execute()
 		"<member><name>ArticleCacheLo</name><value><i4>%u</i4></value></member>\n"
 		"<member><name>ArticleCacheHi</name><value><i4>%u</i4></value></member>\n"
 		"<member><name>ArticleCacheMB</name><value><i4>%i</i4></value></member>\n"
+		"<member><name>ArticleCacheArenaMB</name><value><i4>%i</i4></value></member>\n"
 		"<member><name>DownloadRate</name><value><i4>%i</i4></value></member>\n"
 		"<member><name>AverageDownloadRate</name><value><i4>%i</i4></value></member>\n"
 		"<member><name>DownloadLimit</name><value><i4>%i</i4></value></member>\n"
@@ -1299,6 +1302,7 @@ void StatusXmlCommand::Execute()
 		"\"ArticleCacheLo\" : %u,\n"
 		"\"ArticleCacheHi\" : %u,\n"
 		"\"ArticleCacheMB\" : %i,\n"
+		"\"ArticleCacheArenaMB\" : %i,\n"
 		"\"DownloadRate\" : %i,\n"
 		"\"AverageDownloadRate\" : %i,\n"
 		"\"DownloadLimit\" : %i,\n"
@@ -1364,6 +1368,7 @@ void StatusXmlCommand::Execute()
 	uint32 articleCacheHi, articleCacheLo;
 	Util::SplitInt64(articleCache, &articleCacheHi, &articleCacheLo);
 	int articleCacheMBytes = (int)(articleCache / 1024 / 1024);
+	int articleCacheArenaMBytes = (int)(g_ArticleCache->GetArenaSize() / 1024 / 1024);
 
 	int downloadRate = (int)(g_StatMeter->CalcCurrentDownloadSpeed());
 	int downloadLimit = (int)(g_Options->GetDownloadRate());
@@ -1392,7 +1397,7 @@ void StatusXmlCommand::Execute()
 	AppendFmtResponse(IsJson() ? JSON_STATUS_START : XML_STATUS_START,
 		remainingSizeLo, remainingSizeHi, remainingMBytes, forcedSizeLo,
 		forcedSizeHi, forcedMBytes, downloadedSizeLo, downloadedSizeHi,
-		downloadedMBytes, articleCacheLo, articleCacheHi, articleCacheMBytes,
+		downloadedMBytes, articleCacheLo, articleCacheHi, articleCacheMBytes, articleCacheArenaMBytes,
 		downloadRate, averageDownloadRate, downloadLimit, threadCount,
 		postJobCount, postJobCount, urlCount, upTimeSec, downloadTimeSec,
 		BoolToStr(downloadPaused), BoolToStr(downloadPaused), BoolToStr(downloadPaused),
@@ -3543,7 +3548,7 @@ void TestServerXmlCommand::Execute()
 		return;
 	}
 
-	NewsServer server(0, true, "test server", host, port, username, password, false, encryption, cipher, 1, 0, 0, 0);
+	NewsServer server(0, true, "test server", host, port, username, password, false, encryption, cipher, 1, 0, 1, 0, 0);
 	TestConnection* connection = new TestConnection(&server, this);
 	connection->SetTimeout(timeout == 0 ? g_Options->GetArticleTimeout() : timeout);
 	connection->SetSuppressErrors(false);
@@ -30,6 +30,46 @@
 int Thread::m_threadCount = 1; // take the main program thread into account
 Mutex* Thread::m_mutexThread;
 
+#ifndef WIN32
+/*
+ * Threads are started very often (one thread per article), creating and
+ * destroying of OS-threads is expensive. An OS-thread which has finished
+ * running a thread-object is therefore kept idle for a while and is reused
+ * for the next started thread-object. Idle OS-threads are kept separately
+ * per stack size because thread-objects may request smaller stacks.
+ */
+static const int THREAD_IDLE_TIMEOUT = 10; // seconds
+
+struct IdlePool
+{
+	int						idle;
+	std::deque<Thread*>		pending;
+	pthread_cond_t			cond;
+};
+
+typedef std::map<int, IdlePool*> IdlePools;
+
+static pthread_mutex_t g_IdleMutex = PTHREAD_MUTEX_INITIALIZER;
+static IdlePools g_IdlePools;
+static int g_OsThreadCount = 0;
+
+/* Must be called with locked g_IdleMutex */
+static IdlePool* GetIdlePool(int stackSize)
+{
+	IdlePools::iterator it = g_IdlePools.find(stackSize);
+	if (it != g_IdlePools.end())
+	{
+		return it->second;
+	}
+
+	IdlePool* pool = new IdlePool();
+	pool->idle = 0;
+	pthread_cond_init(&pool->cond, NULL);
+	g_IdlePools[stackSize] = pool;
+	return pool;
+}
+#endif
+
 
 Mutex::Mutex()
 {
@@ -79,6 +119,96 @@ void Mutex::Unlock()
 }
 
 
+ConditionVar::ConditionVar()
+{
+#ifdef WIN32
+	// condition variables are not available on Windows XP, they are
+	// emulated with a semaphore and a counter of waiting threads
+	m_condObj = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+	m_waiters = 0;
+#else
+	m_condObj = (pthread_cond_t*)malloc(sizeof(pthread_cond_t));
+	pthread_cond_init((pthread_cond_t*)m_condObj, NULL);
+#endif
+}
+
+ConditionVar::~ConditionVar()
+{
+#ifdef WIN32
+	CloseHandle((HANDLE)m_condObj);
+#else
+	pthread_cond_destroy((pthread_cond_t*)m_condObj);
+	free(m_condObj);
+#endif
+}
+
+void ConditionVar::Wait(Mutex* mutex)
+{
+#ifdef WIN32
+	Wait(mutex, -1);
+#else
+	pthread_cond_wait((pthread_cond_t*)m_condObj, (pthread_mutex_t*)mutex->m_mutexObj);
+#endif
+}
+
+bool ConditionVar::Wait(Mutex* mutex, int msec)
+{
+#ifdef WIN32
+	m_waiters++;
+	mutex->Unlock();
+	bool signalled = WaitForSingleObject((HANDLE)m_condObj, msec < 0 ? INFINITE : msec) == WAIT_OBJECT_0;
+	mutex->Lock();
+	if (!signalled)
+	{
+		// a notification could arrive after the timeout but before the mutex was relocked
+		signalled = WaitForSingleObject((HANDLE)m_condObj, 0) == WAIT_OBJECT_0;
+		if (!signalled)
+		{
+			m_waiters--;
+		}
+	}
+	return signalled;
+#else
+	struct timespec timeout;
+	clock_gettime(CLOCK_REALTIME, &timeout);
+	timeout.tv_sec += msec / 1000;
+	timeout.tv_nsec += (long)(msec % 1000) * 1000000;
+	if (timeout.tv_nsec >= 1000000000)
+	{
+		timeout.tv_sec++;
+		timeout.tv_nsec -= 1000000000;
+	}
+	return pthread_cond_timedwait((pthread_cond_t*)m_condObj, (pthread_mutex_t*)mutex->m_mutexObj, &timeout) == 0;
+#endif
+}
+
+void ConditionVar::NotifyOne()
+{
+#ifdef WIN32
+	if (m_waiters > 0)
+	{
+		m_waiters--;
+		ReleaseSemaphore((HANDLE)m_condObj, 1, NULL);
+	}
+#else
+	pthread_cond_signal((pthread_cond_t*)m_condObj);
+#endif
+}
+
+void ConditionVar::NotifyAll()
+{
+#ifdef WIN32
+	if (m_waiters > 0)
+	{
+		ReleaseSemaphore((HANDLE)m_condObj, m_waiters, NULL);
+		m_waiters = 0;
+	}
+#else
+	pthread_cond_broadcast((pthread_cond_t*)m_condObj);
+#endif
+}
+
+
 void Thread::Init()
 {
 	debug("Initializing global thread data");
@@ -106,6 +236,9 @@ Thread::Thread()
 	m_running = false;
 	m_stopped = false;
 	m_autoDestroy = false;
+	m_stackSize = 0;
+	m_bound = false;
+	m_killed = false;
 }
 
 Thread::~Thread()
@@ -133,15 +266,41 @@ void Thread::Start()
 	m_mutexThread->Lock();
 
 #ifdef WIN32
-	m_threadObj = (HANDLE)_beginthread(Thread::thread_handler, 0, (void *)this);
+	m_threadObj = (HANDLE)_beginthread(Thread::thread_handler, m_stackSize, (void *)this);
 	m_running = m_threadObj != NULL;
 #else
-	pthread_attr_t m_attr;
-	pthread_attr_init(&m_attr);
-	pthread_attr_setdetachstate(&m_attr, PTHREAD_CREATE_DETACHED);
-	pthread_attr_setinheritsched(&m_attr , PTHREAD_INHERIT_SCHED);
-	m_running = !pthread_create((pthread_t*)m_threadObj, &m_attr, Thread::thread_handler, (void *) this);
-	pthread_attr_destroy(&m_attr);
+	m_killed = false;
+
+	// pass the thread-object to an idle OS-thread if there is one
+	pthread_mutex_lock(&g_IdleMutex);
+	IdlePool* pool = GetIdlePool(m_stackSize);
+	bool reused = pool->idle > (int)pool->pending.size();
+	if (reused)
+	{
+		m_bound = false;
+		pool->pending.push_back(this);
+		pthread_cond_signal(&pool->cond);
+	}
+	pthread_mutex_unlock(&g_IdleMutex);
+
+	if (!reused)
+	{
+		pthread_attr_t m_attr;
+		pthread_attr_init(&m_attr);
+		pthread_attr_setdetachstate(&m_attr, PTHREAD_CREATE_DETACHED);
+		pthread_attr_setinheritsched(&m_attr , PTHREAD_INHERIT_SCHED);
+		if (m_stackSize > 0)
+		{
+			pthread_attr_setstacksize(&m_attr, std::max(m_stackSize, (int)PTHREAD_STACK_MIN));
+		}
+		m_running = !pthread_create((pthread_t*)m_threadObj, &m_attr, Thread::thread_handler, (void *) this);
+		pthread_attr_destroy(&m_attr);
+
+		pthread_mutex_lock(&g_IdleMutex);
+		m_bound = m_running;
+		g_OsThreadCount += m_running ? 1 : 0;
+		pthread_mutex_unlock(&g_IdleMutex);
+	}
 #endif
 
 	m_mutexThread->Unlock();
@@ -169,14 +328,39 @@ bool Thread::Kill()
 
 #ifdef WIN32
 	bool terminated = TerminateThread((HANDLE)m_threadObj, 0) != 0;
-#else
-	bool terminated = pthread_cancel(*(pthread_t*)m_threadObj) == 0;
-#endif
-
 	if (terminated)
 	{
 		m_threadCount--;
 	}
+#else
+	// the OS-thread is cancelled only while it runs this thread-object,
+	// otherwise it may be idle or run another thread-object already
+	bool terminated = false;
+	pthread_mutex_lock(&g_IdleMutex);
+	if (m_bound && !m_killed)
+	{
+		// the OS-thread exits, either cancelled in "Run" or right after it (see "thread_handler")
+		terminated = m_killed = pthread_cancel(*(pthread_t*)m_threadObj) == 0;
+		if (terminated)
+		{
+			m_threadCount--;
+			g_OsThreadCount--;
+		}
+	}
+	else if (!m_bound)
+	{
+		// not yet picked up by an idle OS-thread
+		IdlePool* pool = GetIdlePool(m_stackSize);
+		std::deque<Thread*>::iterator it = std::find(pool->pending.begin(), pool->pending.end(), this);
+		if (it != pool->pending.end())
+		{
+			pool->pending.erase(it);
+			terminated = true;
+		}
+	}
+	pthread_mutex_unlock(&g_IdleMutex);
+#endif
+
 	m_mutexThread->Unlock();
 	return terminated;
 }
@@ -187,29 +371,97 @@ void __cdecl Thread::thread_handler(void* object)
 void* Thread::thread_handler(void* object)
 #endif
 {
-	m_mutexThread->Lock();
-	m_threadCount++;
-	m_mutexThread->Unlock();
+	Thread* thread = (Thread*)object;
 
-	debug("Entering Thread-func");
+#ifndef WIN32
+	// the OS-thread can be cancelled (see "Kill") only while running a thread-object
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+	int stackSize = thread->m_stackSize;
+#endif
 
-	Thread* thread = (Thread*)object;
+	while (thread)
+	{
+		m_mutexThread->Lock();
+		m_threadCount++;
+		m_mutexThread->Unlock();
 
-	thread->Run();
+		debug("Entering Thread-func");
 
-	debug("Thread-func exited");
+#ifdef WIN32
+		thread->Run();
+#else
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+		thread->Run();
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+#endif
 
-	thread->m_running = false;
+		debug("Thread-func exited");
 
-	if (thread->m_autoDestroy)
-	{
-		debug("Autodestroying Thread-object");
-		delete thread;
-	}
+		bool autoDestroy = thread->m_autoDestroy;
 
-	m_mutexThread->Lock();
-	m_threadCount--;
-	m_mutexThread->Unlock();
+#ifdef WIN32
+		thread->m_running = false;
+#else
+		pthread_mutex_lock(&g_IdleMutex);
+		bool killed = thread->m_killed;
+		thread->m_bound = false;
+		IdlePool* pool = GetIdlePool(stackSize);
+		if (!killed)
+		{
+			// counted as idle already now so that a thread-object started
+			// as soon as this one is reported as finished reuses the OS-thread
+			pool->idle++;
+			thread->m_running = false;
+		}
+		pthread_mutex_unlock(&g_IdleMutex);
+
+		if (killed)
+		{
+			// killed just after "Run" has returned: the thread-object now belongs
+			// to the killer and the pending cancellation ends the OS-thread
+			return NULL;
+		}
+#endif
+
+		if (autoDestroy)
+		{
+			debug("Autodestroying Thread-object");
+			delete thread;
+		}
+
+		m_mutexThread->Lock();
+		m_threadCount--;
+		m_mutexThread->Unlock();
+
+		thread = NULL;
+
+#ifndef WIN32
+		// wait for the next thread-object to run
+		pthread_mutex_lock(&g_IdleMutex);
+
+		struct timespec timeout;
+		clock_gettime(CLOCK_REALTIME, &timeout);
+		timeout.tv_sec += THREAD_IDLE_TIMEOUT;
+
+		while (pool->pending.empty() &&
+			pthread_cond_timedwait(&pool->cond, &g_IdleMutex, &timeout) == 0) ;
+
+		if (!pool->pending.empty())
+		{
+			thread = pool->pending.front();
+			pool->pending.pop_front();
+			*((pthread_t*)thread->m_threadObj) = pthread_self();
+			thread->m_bound = true;
+		}
+		else
+		{
+			g_OsThreadCount--;
+		}
+
+		pool->idle--;
+		pthread_mutex_unlock(&g_IdleMutex);
+#endif
+	}
 
 #ifndef WIN32
 	return NULL;
@@ -223,3 +475,139 @@ int Thread::GetThreadCount()
 	m_mutexThread->Unlock();
 	return threadCount;
 }
+
+int Thread::GetOsThreadCount()
+{
+#ifdef WIN32
+	// each running thread-object has its own OS-thread
+	return GetThreadCount() - 1;
+#else
+	pthread_mutex_lock(&g_IdleMutex);
+	int osThreadCount = g_OsThreadCount;
+	pthread_mutex_unlock(&g_IdleMutex);
+	return osThreadCount;
+#endif
+}
+
+
+WorkerPool::WorkerPool()
+{
+	m_workers = 0;
+	m_stopping = false;
+	m_job = NULL;
+	m_generation = 0;
+	m_wanted = 0;
+	m_joined = 0;
+	m_finished = 0;
+	m_count = 0;
+	m_grain = 1;
+	m_next = 0;
+}
+
+WorkerPool::~WorkerPool()
+{
+	m_mutex.Lock();
+	m_stopping = true;
+	m_jobCond.NotifyAll();
+	while (m_workers > 0)
+	{
+		m_doneCond.Wait(&m_mutex);
+	}
+	m_mutex.Unlock();
+}
+
+void WorkerPool::Run(ParallelJob* job, int count, int threads, int grain)
+{
+	grain = grain > 0 ? grain : 1;
+	int helpers = std::min(threads, (count + grain - 1) / grain) - 1;
+	if (helpers <= 0)
+	{
+		if (count > 0)
+		{
+			job->Execute(0, count);
+		}
+		return;
+	}
+
+	m_runMutex.Lock();
+
+	m_mutex.Lock();
+	for (; m_workers < helpers; m_workers++)
+	{
+		Worker* worker = new Worker(this);
+		worker->SetAutoDestroy(true);
+		worker->Start();
+	}
+	m_job = job;
+	m_count = count;
+	m_grain = grain;
+	m_next = 0;
+	m_generation++;
+	m_wanted = helpers;
+	m_joined = 0;
+	m_finished = 0;
+	m_jobCond.NotifyAll();
+	m_mutex.Unlock();
+
+	Work();
+
+	// barrier: wait until all helpers have left the job
+	m_mutex.Lock();
+	while (m_finished < m_wanted)
+	{
+		m_doneCond.Wait(&m_mutex);
+	}
+	m_job = NULL;
+	m_mutex.Unlock();
+
+	m_runMutex.Unlock();
+}
+
+void WorkerPool::Work()
+{
+	while (true)
+	{
+#ifdef WIN32
+		int begin = InterlockedExchangeAdd((volatile LONG*)&m_next, m_grain);
+#else
+		int begin = __sync_fetch_and_add(&m_next, m_grain);
+#endif
+		if (begin >= m_count)
+		{
+			break;
+		}
+		m_job->Execute(begin, std::min(begin + m_grain, m_count));
+	}
+}
+
+void WorkerPool::WorkerLoop()
+{
+	int lastGeneration = 0;
+
+	m_mutex.Lock();
+	while (!m_stopping)
+	{
+		if (m_job && m_generation != lastGeneration && m_joined < m_wanted)
+		{
+			lastGeneration = m_generation;
+			m_joined++;
+			m_mutex.Unlock();
+
+			Work();
+
+			m_mutex.Lock();
+			m_finished++;
+			if (m_finished == m_wanted)
+			{
+				m_doneCond.NotifyAll();
+			}
+			continue;
+		}
+
+		m_jobCond.Wait(&m_mutex);
+	}
+
+	m_workers--;
+	m_doneCond.NotifyAll();
+	m_mutex.Unlock();
+}
@@ -32,6 +32,8 @@ class Mutex
 private:
 	void*					m_mutexObj;
 
+	friend class ConditionVar;
+
 public:
 							Mutex();
 							~Mutex();
@@ -39,6 +41,30 @@ public:
 	void					Unlock();
 };
 
+/*
+ * Condition variable to wait for events signalled by other threads.
+ * The associated mutex must be locked when calling "Wait"; notifications
+ * should be sent with the same mutex locked.
+ * Spurious wakeups are possible, the waiting thread must recheck its condition.
+ */
+class ConditionVar
+{
+private:
+	void*					m_condObj;
+#ifdef WIN32
+	int						m_waiters;
+#endif
+
+public:
+							ConditionVar();
+							~ConditionVar();
+	void					Wait(Mutex* mutex);
+	// returns false on timeout
+	bool					Wait(Mutex* mutex, int msec);
+	void					NotifyOne();
+	void					NotifyAll();
+};
+
 class Thread
 {
 private:
@@ -48,6 +74,9 @@ private:
 	bool 					m_running;
 	bool					m_stopped;
 	bool					m_autoDestroy;
+	int						m_stackSize;
+	bool					m_bound;
+	bool					m_killed;
 
 #ifdef WIN32
 	static void __cdecl 	thread_handler(void* object);
@@ -71,10 +100,74 @@ public:
 	void 					SetRunning(bool onOff) { m_running = onOff; }
 	bool					GetAutoDestroy() { return m_autoDestroy; }
 	void					SetAutoDestroy(bool autoDestroy) { m_autoDestroy = autoDestroy; }
+	// stack size in bytes for the OS-thread, 0 for system default; must be set before "Start"
+	void					SetStackSize(int stackSize) { m_stackSize = stackSize; }
 	static int				GetThreadCount();
+	// number of OS-threads started for thread-objects (running or idle)
+	static int				GetOsThreadCount();
 
 protected:
 	virtual void 			Run() {}; // Virtual function - override in derivatives
 };
 
+/*
+ * Job executed by WorkerPool. The work is split into items identified by
+ * indices; "Execute" is called for ranges of items from multiple threads
+ * at the same time.
+ */
+class ParallelJob
+{
+public:
+	virtual					~ParallelJob() {}
+	virtual void			Execute(int begin, int end) = 0;
+};
+
+/*
+ * Pool of worker threads for CPU-intensive jobs. The workers are started
+ * on first use and wait for the next job when idle. The items of a job are
+ * taken in ranges from a shared atomic counter by the workers and by the
+ * calling thread, so threads finishing earlier take over the remaining
+ * ranges. "Run" returns after all participating threads have finished.
+ * Jobs are executed one after another; the pool can be used by multiple
+ * threads but not recursively from within a job.
+ */
+class WorkerPool
+{
+private:
+	class Worker : public Thread
+	{
+	private:
+		WorkerPool*			m_owner;
+	protected:
+		virtual void		Run() { m_owner->WorkerLoop(); }
+	public:
+							Worker(WorkerPool* owner) : m_owner(owner) {}
+	};
+
+	Mutex					m_runMutex;
+	Mutex					m_mutex;
+	ConditionVar			m_jobCond;
+	ConditionVar			m_doneCond;
+	int						m_workers;
+	bool					m_stopping;
+	ParallelJob*			m_job;
+	int						m_generation;
+	int						m_wanted;
+	int						m_joined;
+	int						m_finished;
+	int						m_count;
+	int						m_grain;
+	volatile int			m_next;
+
+	void					WorkerLoop();
+	void					Work();
+
+public:
+							WorkerPool();
+							~WorkerPool();
+	// executes items [0, count) using up to "threads" threads (including the calling thread),
+	// each thread takes "grain" items at once
+	void					Run(ParallelJob* job, int count, int threads, int grain);
+};
+
 #endif
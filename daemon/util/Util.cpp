@@ -1468,9 +1468,9 @@ static uint32 crc32_tab[] = {
  *				reached. the crc32-checksum will be
  *				the result.
  */
-uint32 Util::Crc32m(uint32 startCrc, uchar *block, uint32 length)
+static uint32 Crc32mTable(uint32 startCrc, uchar *block, uint32 length)
 {
-	register uint32 crc = startCrc;
+	uint32 crc = startCrc;
 	for (uint32 i = 0; i < length; i++)
 	{
 		crc = ((crc >> 8) & 0x00FFFFFF) ^ crc32_tab[(crc ^ *block++) & 0xFF];
@@ -1478,11 +1478,6 @@ uint32 Util::Crc32m(uint32 startCrc, uchar *block, uint32 length)
 	return crc;
 }
 
-uint32 Util::Crc32(uchar *block, uint32 length)
-{
-	return Util::Crc32m(0xFFFFFFFF, block, length) ^ 0xFFFFFFFF;
-}
-
 /* From zlib/crc32.c (http://www.zlib.net/)
  * Copyright (C) 1995-2006, 2010, 2011, 2012 Mark Adler
  */
@@ -1511,52 +1506,381 @@ void gf2_matrix_square(uint32 *square, uint32 *mat)
 		square[n] = gf2_matrix_times(mat, mat[n]);
 }
 
-uint32 Util::Crc32Combine(uint32 crc1, uint32 crc2, uint32 len2)
+// tables for slicing-by-8 algorithm, the first table is "crc32_tab"
+static uint32 crc32_slice[8][256];
+
+// operators for appending of 2^n zero bytes to crc, used by "Crc32Combine"
+static uint32 crc32_zeros[32][GF2_DIM];
+
+class Crc32TablesInit
 {
-	int n;
-	uint32 row;
-	uint32 even[GF2_DIM];    /* even-power-of-two zeros operator */
-	uint32 odd[GF2_DIM];     /* odd-power-of-two zeros operator */
+public:
+	Crc32TablesInit()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			crc32_slice[0][i] = crc32_tab[i];
+		}
+		for (int k = 1; k < 8; k++)
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				uint32 prev = crc32_slice[k - 1][i];
+				crc32_slice[k][i] = (prev >> 8) ^ crc32_tab[prev & 0xFF];
+			}
+		}
 
-	/* degenerate case (also disallow negative lengths) */
-	if (len2 <= 0)
-		return crc1;
+		uint32 even[GF2_DIM];    /* even-power-of-two zeros operator */
+		uint32 odd[GF2_DIM];     /* odd-power-of-two zeros operator */
+
+		/* put operator for one zero bit in odd */
+		odd[0] = 0xedb88320UL;          /* CRC-32 polynomial */
+		uint32 row = 1;
+		for (int n = 1; n < GF2_DIM; n++) {
+			odd[n] = row;
+			row <<= 1;
+		}
+
+		/* put operator for two zero bits in even */
+		gf2_matrix_square(even, odd);
 
-	/* put operator for one zero bit in odd */
-	odd[0] = 0xedb88320UL;          /* CRC-32 polynomial */
-	row = 1;
-	for (n = 1; n < GF2_DIM; n++) {
-		odd[n] = row;
-		row <<= 1;
+		/* put operator for four zero bits in odd */
+		gf2_matrix_square(odd, even);
+
+		/* operator for one zero byte, then squared for each next power of two */
+		gf2_matrix_square(crc32_zeros[0], odd);
+		for (int n = 1; n < 32; n++)
+		{
+			gf2_matrix_square(crc32_zeros[n], crc32_zeros[n - 1]);
+		}
 	}
+} Crc32TablesInitInstance;
 
-	/* put operator for two zero bits in even */
-	gf2_matrix_square(even, odd);
+/*
+ * Slicing-by-8 algorithm: processes eight bytes per step using
+ * eight lookup tables instead of one lookup per byte.
+ */
+static uint32 Crc32mSlice8(uint32 startCrc, uchar *block, uint32 length)
+{
+	uint32 crc = startCrc;
 
-	/* put operator for four zero bits in odd */
-	gf2_matrix_square(odd, even);
+	while (length >= 8)
+	{
+		uint32 one = (block[0] | (block[1] << 8) | (block[2] << 16) | ((uint32)block[3] << 24)) ^ crc;
+		uint32 two = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32)block[7] << 24);
+		crc = crc32_slice[7][one & 0xFF] ^
+			crc32_slice[6][(one >> 8) & 0xFF] ^
+			crc32_slice[5][(one >> 16) & 0xFF] ^
+			crc32_slice[4][one >> 24] ^
+			crc32_slice[3][two & 0xFF] ^
+			crc32_slice[2][(two >> 8) & 0xFF] ^
+			crc32_slice[1][(two >> 16) & 0xFF] ^
+			crc32_slice[0][two >> 24];
+		block += 8;
+		length -= 8;
+	}
 
-	/* apply len2 zeros to crc1 (first square will put the operator for one
-	   zero byte, eight zero bits, in even) */
-	do {
-		/* apply zeros operator for this bit of len2 */
-		gf2_matrix_square(even, odd);
-		if (len2 & 1)
-			crc1 = gf2_matrix_times(even, crc1);
-		len2 >>= 1;
+	return Crc32mTable(crc, block, length);
+}
 
-		/* if no more bits set, then done */
-		if (len2 == 0)
-			break;
+#ifdef HAVE_X86_SIMD
+/*
+ * Folding of 64 byte blocks with carry-less multiplication, see Intel paper
+ * "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+ * Based on crc32_simd.c from Chromium's zlib
+ * Copyright 2017 The Chromium Authors. All rights reserved.
+ *
+ * Four independent lanes are folded in parallel and then folded together.
+ * The folding is split into steps to allow incremental calculation in
+ * class "Crc32Stream", which keeps the lanes between calls.
+ */
+struct Crc32FoldState
+{
+	__m128i x1, x2, x3, x4;
+};
 
-		/* another iteration of the loop with odd and even swapped */
-		gf2_matrix_square(odd, even);
-		if (len2 & 1)
-			crc1 = gf2_matrix_times(odd, crc1);
-		len2 >>= 1;
+__attribute__((target("pclmul,sse2")))
+static inline void Crc32FoldInit(Crc32FoldState* state, uint32 crc, const uchar *block)
+{
+	state->x1 = _mm_loadu_si128((__m128i*)(block + 0x00));
+	state->x2 = _mm_loadu_si128((__m128i*)(block + 0x10));
+	state->x3 = _mm_loadu_si128((__m128i*)(block + 0x20));
+	state->x4 = _mm_loadu_si128((__m128i*)(block + 0x30));
+
+	state->x1 = _mm_xor_si128(state->x1, _mm_cvtsi32_si128(crc));
+}
+
+// parallel fold blocks of 64, length must be a multiple of 64
+__attribute__((target("pclmul,sse2")))
+static inline void Crc32Fold(Crc32FoldState* state, const uchar *block, uint32 length)
+{
+	// constants for the bit-reflected domain
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+	x0 = k1k2;
+	x1 = state->x1;
+	x2 = state->x2;
+	x3 = state->x3;
+	x4 = state->x4;
+
+	while (length >= 64)
+	{
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+		y5 = _mm_loadu_si128((__m128i*)(block + 0x00));
+		y6 = _mm_loadu_si128((__m128i*)(block + 0x10));
+		y7 = _mm_loadu_si128((__m128i*)(block + 0x20));
+		y8 = _mm_loadu_si128((__m128i*)(block + 0x30));
+
+		x1 = _mm_xor_si128(x1, x5);
+		x2 = _mm_xor_si128(x2, x6);
+		x3 = _mm_xor_si128(x3, x7);
+		x4 = _mm_xor_si128(x4, x8);
+
+		x1 = _mm_xor_si128(x1, y5);
+		x2 = _mm_xor_si128(x2, y6);
+		x3 = _mm_xor_si128(x3, y7);
+		x4 = _mm_xor_si128(x4, y8);
+
+		block += 64;
+		length -= 64;
+	}
 
-		/* if no more bits set, then done */
-	} while (len2 != 0);
+	state->x1 = x1;
+	state->x2 = x2;
+	state->x3 = x3;
+	state->x4 = x4;
+}
+
+// fold lanes together and with remaining data, length must be a multiple of 16
+__attribute__((target("pclmul,sse2")))
+static inline uint32 Crc32FoldReduce(Crc32FoldState* state, const uchar *block, uint32 length)
+{
+	// constants for the bit-reflected domain
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+	const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+
+	__m128i x0, x1, x2, x3, x5;
+
+	// fold into 128 bits
+	x0 = k3k4;
+	x1 = state->x1;
+
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(x1, state->x2);
+	x1 = _mm_xor_si128(x1, x5);
+
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(x1, state->x3);
+	x1 = _mm_xor_si128(x1, x5);
+
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(x1, state->x4);
+	x1 = _mm_xor_si128(x1, x5);
+
+	// single fold blocks of 16
+	while (length >= 16)
+	{
+		x2 = _mm_loadu_si128((__m128i*)block);
+
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(x1, x2);
+		x1 = _mm_xor_si128(x1, x5);
+
+		block += 16;
+		length -= 16;
+	}
+
+	// fold 128 bits to 64 bits
+	x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+	x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+	x1 = _mm_srli_si128(x1, 8);
+	x1 = _mm_xor_si128(x1, x2);
+
+	x0 = k5k0;
+
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, x3);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// Barrett reduction to 32 bits
+	x0 = poly;
+
+	x2 = _mm_and_si128(x1, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+	x2 = _mm_and_si128(x2, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return (uint32)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+
+// length must be at least 64 and a multiple of 16
+__attribute__((target("pclmul,sse2")))
+static uint32 Crc32FoldPclmul(uint32 crc, uchar *block, uint32 length)
+{
+	Crc32FoldState state;
+	Crc32FoldInit(&state, crc, block);
+	uint32 foldLength = (length - 64) & ~63;
+	Crc32Fold(&state, block + 64, foldLength);
+	return Crc32FoldReduce(&state, block + 64 + foldLength, length - 64 - foldLength);
+}
+
+static uint32 Crc32mPclmul(uint32 startCrc, uchar *block, uint32 length)
+{
+	uint32 crc = startCrc;
+	if (length >= 64)
+	{
+		uint32 foldLength = length & ~15;
+		crc = Crc32FoldPclmul(crc, block, foldLength);
+		block += foldLength;
+		length -= foldLength;
+	}
+	return Crc32mSlice8(crc, block, length);
+}
+#endif
+
+#ifdef HAVE_ARM_SIMD
+__attribute__((target("+crc")))
+static uint32 Crc32mArm(uint32 startCrc, uchar *block, uint32 length)
+{
+	uint32 crc = startCrc;
+
+	while (length > 0 && ((size_t)block & 7))
+	{
+		crc = __crc32b(crc, *block++);
+		length--;
+	}
+
+	while (length >= 8)
+	{
+		uint64 data;
+		memcpy(&data, block, 8);
+		crc = __crc32d(crc, data);
+		block += 8;
+		length -= 8;
+	}
+
+	while (length > 0)
+	{
+		crc = __crc32b(crc, *block++);
+		length--;
+	}
+
+	return crc;
+}
+#endif
+
+typedef uint32 (*Crc32Func)(uint32 startCrc, uchar *block, uint32 length);
+
+const char* Util::Crc32ImplNames[] = { "table", "slice-by-8", "PCLMUL", "ARMv8-CRC32" };
+
+static Crc32Func GetCrc32Func(Util::ECrc32Impl impl)
+{
+	switch (impl)
+	{
+		case Util::ciSlice8:
+			return Crc32mSlice8;
+#ifdef HAVE_X86_SIMD
+		case Util::ciPclmul:
+			return Crc32mPclmul;
+#endif
+#ifdef HAVE_ARM_SIMD
+		case Util::ciArmCrc32:
+			return Crc32mArm;
+#endif
+		default:
+			return Crc32mTable;
+	}
+}
+
+bool Util::IsCrc32ImplSupported(ECrc32Impl impl)
+{
+	switch (impl)
+	{
+		case ciTable:
+		case ciSlice8:
+			return true;
+#ifdef HAVE_X86_SIMD
+		case ciPclmul:
+			return CpuFeatures::HasPclmul() && CpuFeatures::HasSse2();
+#endif
+#ifdef HAVE_ARM_SIMD
+		case ciArmCrc32:
+			return CpuFeatures::HasArmCrc32();
+#endif
+		default:
+			return false;
+	}
+}
+
+Util::ECrc32Impl Util::GetBestCrc32Impl()
+{
+	const ECrc32Impl preferred[] = { ciPclmul, ciArmCrc32 };
+	for (int i = 0; i < (int)(sizeof(preferred) / sizeof(ECrc32Impl)); i++)
+	{
+		if (IsCrc32ImplSupported(preferred[i]))
+		{
+			return preferred[i];
+		}
+	}
+	return ciSlice8;
+}
+
+uint32 Util::Crc32m(uint32 startCrc, uchar *block, uint32 length)
+{
+	static Crc32Func crc32m = GetCrc32Func(GetBestCrc32Impl());
+	return crc32m(startCrc, block, length);
+}
+
+uint32 Util::Crc32m(uint32 startCrc, uchar *block, uint32 length, ECrc32Impl impl)
+{
+	if (!IsCrc32ImplSupported(impl))
+	{
+		impl = ciTable;
+	}
+	return GetCrc32Func(impl)(startCrc, block, length);
+}
+
+uint32 Util::Crc32(uchar *block, uint32 length)
+{
+	return Util::Crc32m(0xFFFFFFFF, block, length) ^ 0xFFFFFFFF;
+}
+
+/*
+ * Combines two CRCs as in "crc32_combine" from zlib but uses precalculated
+ * operators instead of calculating them on each call.
+ */
+uint32 Util::Crc32Combine(uint32 crc1, uint32 crc2, uint32 len2)
+{
+	/* degenerate case */
+	if (len2 == 0)
+		return crc1;
+
+	/* apply len2 zeros to crc1 */
+	for (int n = 0; len2 != 0; n++, len2 >>= 1)
+	{
+		if (len2 & 1)
+		{
+			crc1 = gf2_matrix_times(crc32_zeros[n], crc1);
+		}
+	}
 
 	/* return combined crc */
 	crc1 ^= crc2;
@@ -1564,6 +1888,121 @@ uint32 Util::Crc32Combine(uint32 crc1, uint32 crc2, uint32 len2)
 	return crc1;
 }
 
+Crc32Stream::Crc32Stream()
+{
+	Reset(0xFFFFFFFF);
+}
+
+void Crc32Stream::Reset(uint32 startCrc)
+{
+	m_crc = startCrc;
+	m_pendingLen = 0;
+	m_folding = false;
+	m_pclmul = Util::GetBestCrc32Impl() == Util::ciPclmul;
+}
+
+void Crc32Stream::Update(const uchar* block, uint32 length)
+{
+#ifdef HAVE_X86_SIMD
+	if (m_pclmul)
+	{
+		UpdateFolding(block, length);
+		return;
+	}
+#endif
+
+	m_crc = Util::Crc32m(m_crc, (uchar*)block, length);
+}
+
+uint32 Crc32Stream::Finish()
+{
+#ifdef HAVE_X86_SIMD
+	if (m_pclmul)
+	{
+		return FinishFolding();
+	}
+#endif
+
+	return m_crc;
+}
+
+#ifdef HAVE_X86_SIMD
+/*
+ * Data is collected in blocks of 64 bytes, full blocks are folded into the
+ * lanes stored in "m_state". The reduction of lanes into the final crc
+ * is performed only once in "Finish".
+ */
+void Crc32Stream::UpdateFolding(const uchar* block, uint32 length)
+{
+	Crc32FoldState state;
+	if (m_folding)
+	{
+		memcpy(&state, m_state, sizeof(state));
+	}
+
+	if (m_pendingLen > 0)
+	{
+		uint32 len = length < (uint32)(64 - m_pendingLen) ? length : 64 - m_pendingLen;
+		memcpy(m_pending + m_pendingLen, block, len);
+		m_pendingLen += len;
+		block += len;
+		length -= len;
+
+		if (m_pendingLen < 64)
+		{
+			return;
+		}
+
+		if (m_folding)
+		{
+			Crc32Fold(&state, m_pending, 64);
+		}
+		else
+		{
+			Crc32FoldInit(&state, m_crc, m_pending);
+			m_folding = true;
+		}
+		m_pendingLen = 0;
+	}
+
+	if (!m_folding && length >= 64)
+	{
+		Crc32FoldInit(&state, m_crc, block);
+		m_folding = true;
+		block += 64;
+		length -= 64;
+	}
+
+	if (m_folding)
+	{
+		uint32 foldLength = length & ~63;
+		Crc32Fold(&state, block, foldLength);
+		block += foldLength;
+		length -= foldLength;
+		memcpy(m_state, &state, sizeof(state));
+	}
+
+	memcpy(m_pending, block, length);
+	m_pendingLen = length;
+}
+
+uint32 Crc32Stream::FinishFolding()
+{
+	uint32 crc = m_crc;
+	uint32 tailPos = 0;
+
+	if (m_folding)
+	{
+		Crc32FoldState state;
+		memcpy(&state, m_state, sizeof(state));
+		tailPos = m_pendingLen & ~15;
+		crc = Crc32FoldReduce(&state, m_pending, tailPos);
+	}
+
+	return Util::Crc32m(crc, m_pending + tailPos, m_pendingLen - tailPos, Util::ciSlice8);
+}
+#endif
+
 int Util::NumberOfCpuCores()
 {
 #ifdef WIN32
@@ -1576,6 +2015,68 @@ int Util::NumberOfCpuCores()
 	return -1;
 }
 
+CpuFeatures::CpuFeatures()
+{
+	m_sse2 = false;
+	m_ssse3 = false;
+	m_sse41 = false;
+	m_pclmul = false;
+	m_avx2 = false;
+	m_avx512bw = false;
+	m_gfni = false;
+	m_neon = false;
+	m_armCrc32 = false;
+
+#ifdef HAVE_X86_SIMD
+	uint32 eax, ebx, ecx, edx;
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+	{
+		m_sse2 = (edx & bit_SSE2) != 0;
+		m_ssse3 = (ecx & bit_SSSE3) != 0;
+		m_sse41 = (ecx & bit_SSE4_1) != 0;
+		m_pclmul = (ecx & bit_PCLMUL) != 0;
+
+		// AVX registers can be used only if the OS saves them on context switch
+		bool osAvx = false;
+		bool osAvx512 = false;
+		if ((ecx & bit_OSXSAVE) && (ecx & bit_AVX))
+		{
+			uint32 xcr0, xcr0hi;
+			__asm__ ("xgetbv" : "=a" (xcr0), "=d" (xcr0hi) : "c" (0));
+			osAvx = (xcr0 & 6) == 6;
+			// opmask and upper ZMM registers
+			osAvx512 = (xcr0 & 0xE6) == 0xE6;
+		}
+
+		if (osAvx && __get_cpuid_max(0, NULL) >= 7)
+		{
+			__cpuid_count(7, 0, eax, ebx, ecx, edx);
+			m_avx2 = (ebx & bit_AVX2) != 0;
+			m_avx512bw = osAvx512 && (ebx & bit_AVX512F) && (ebx & bit_AVX512BW);
+#ifdef bit_GFNI
+			m_gfni = (ecx & bit_GFNI) != 0;
+#endif
+		}
+	}
+#endif
+
+#ifdef HAVE_ARM_SIMD
+	// NEON is a mandatory part of ARMv8
+	m_neon = true;
+#if defined(__ARM_FEATURE_CRC32)
+	m_armCrc32 = true;
+#elif defined(__linux__) && defined(HWCAP_CRC32)
+	m_armCrc32 = (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#endif
+#endif
+}
+
+CpuFeatures* CpuFeatures::Instance()
+{
+	static CpuFeatures instance;
+	return &instance;
+}
+
 bool Util::FlushFileBuffers(int fileDescriptor, char* errBuf, int bufSize)
 {
 #ifdef WIN32
@@ -174,16 +174,94 @@ public:
 
 	static void Init();
 
+	enum ECrc32Impl
+	{
+		ciTable,
+		ciSlice8,
+		ciPclmul,
+		ciArmCrc32
+	};
+
+	static const char* Crc32ImplNames[];
+
 	static uint32 Crc32(uchar *block, uint32 length);
 	static uint32 Crc32m(uint32 startCrc, uchar *block, uint32 length);
 	static uint32 Crc32Combine(uint32 crc1, uint32 crc2, uint32 len2);
 
+	/*
+	 * Calculate CRC32 using given implementation (for tests and benchmarks);
+	 * falls back to portable code if the implementation isn't supported by CPU.
+	 */
+	static uint32 Crc32m(uint32 startCrc, uchar *block, uint32 length, ECrc32Impl impl);
+	static bool IsCrc32ImplSupported(ECrc32Impl impl);
+	static ECrc32Impl GetBestCrc32Impl();
+
 	/*
 	 * Returns number of available CPU cores or -1 if it could not be determined
 	 */
 	static int NumberOfCpuCores();
 };
 
+/*
+ * Incremental CRC32 calculation for data arriving in pieces, such as the
+ * decoded lines of an article. With PCLMUL the folding state is kept between
+ * calls and the reduction into the final value is performed once in "Finish".
+ * Start value and result have the same meaning as in "Util::Crc32m".
+ */
+class Crc32Stream
+{
+private:
+	uint32				m_crc;
+	bool				m_pclmul;
+	bool				m_folding;
+	uchar				m_state[64];
+	uchar				m_pending[64];
+	int					m_pendingLen;
+
+#ifdef HAVE_X86_SIMD
+	void				UpdateFolding(const uchar* block, uint32 length);
+	uint32				FinishFolding();
+#endif
+
+public:
+						Crc32Stream();
+	void				Reset(uint32 startCrc);
+	void				Update(const uchar* block, uint32 length);
+	uint32				Finish();
+};
+
+/*
+ * Detects instruction set extensions of the CPU the program is running on.
+ * Used to select SIMD-optimized routines at runtime.
+ */
+class CpuFeatures
+{
+private:
+	bool				m_sse2;
+	bool				m_ssse3;
+	bool				m_sse41;
+	bool				m_pclmul;
+	bool				m_avx2;
+	bool				m_avx512bw;
+	bool				m_gfni;
+	bool				m_neon;
+	bool				m_armCrc32;
+
+						CpuFeatures();
+	static CpuFeatures*	Instance();
+
+public:
+	static bool			HasSse2() { return Instance()->m_sse2; }
+	static bool			HasSsse3() { return Instance()->m_ssse3; }
+	static bool			HasSse41() { return Instance()->m_sse41; }
+	static bool			HasPclmul() { return Instance()->m_pclmul; }
+	static bool			HasAvx2() { return Instance()->m_avx2; }
+	static bool			HasAvx512bw() { return Instance()->m_avx512bw; }
+	static bool			HasGfni() { return Instance()->m_gfni; }
+	static bool			HasNeon() { return Instance()->m_neon; }
+	static bool			HasArmCrc32() { return Instance()->m_armCrc32; }
+};
+
 class WebUtil
 {
 public:
@@ -29,6 +29,7 @@
 #include "Util.h"
 #include "FeedCoordinator.h"
 #include "StatMeter.h"
+#include "QueueCoordinator.h"
 #include "WinConsole.h"
 #include "WinService.h"
 #include "resource.h"
@@ -308,6 +309,7 @@ LRESULT WinConsole::TrayWndProc(HWND hwndWin, UINT uMsg, WPARAM wParam, LPARAM l
 				g_Options->SetPausePostProcess(g_Options->GetPauseDownload());
 				g_Options->SetPauseScan(g_Options->GetPauseDownload());
 				g_Options->SetResumeTime(0);
+				g_QueueCoordinator->WakeUp();
 				UpdateTrayIcon();
 			}
 			else if (lParam == WM_LBUTTONDBLCLK && m_doubleClick)
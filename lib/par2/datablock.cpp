@@ -77,6 +77,16 @@ bool DataBlock::ReadData(u64    position, // Position within the block
   return true;
 }
 
+void DataBlock::PrefetchData(u64 position, size_t size)
+{
+  assert(diskfile != 0);
+
+  if (length > position) 
+  {
+    diskfile->Prefetch(offset + position, (size_t)min((u64)size, length - position));
+  }
+}
+
 // Write some data at a specified position within a datablock
 // from memory to disk
 
@@ -63,6 +63,9 @@ public:
   // Read some of the data from disk into memory.
   bool ReadData(u64 position, size_t size, void *buffer);
 
+  // Start reading of the data in the background (see DiskFile::Prefetch)
+  void PrefetchData(u64 position, size_t size);
+
   // Write some of the data from memory to disk
   bool WriteData(u64 position, size_t size, const void *buffer, size_t &wrote);
 
@@ -20,6 +20,10 @@
 #include "nzbget.h"
 #include "par2cmdline.h"
 
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
 #ifdef _MSC_VER
 #ifdef _DEBUG
 #undef THIS_FILE
@@ -247,6 +251,19 @@ bool DiskFile::Read(u64 _offset, void *buffer, size_t length)
   return true;
 }
 
+void DiskFile::Prefetch(u64 _offset, size_t length)
+{
+}
+
+const void* DiskFile::Map(void)
+{
+  return 0;
+}
+
+void DiskFile::Unmap(const void *mapping)
+{
+}
+
 void DiskFile::Close(void)
 {
   if (hFile != INVALID_HANDLE_VALUE)
@@ -345,22 +362,17 @@ list<string>* DiskFile::FindFiles(string path, string wildcard)
 #else // !WIN32
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#ifdef HAVE_FSEEKO
-# define OffsetType off_t
+#if _FILE_OFFSET_BITS == 64 || defined(HAVE_FSEEKO)
 # define MaxOffset ((off_t)0x7fffffffffffffffULL)
-# define fseek fseeko
 #else
-# if _FILE_OFFSET_BITS == 64
-#  define OffsetType unsigned long long
-#  define MaxOffset 0x7fffffffffffffffULL
-# else
-#  define OffsetType long
-#  define MaxOffset 0x7fffffffUL
-# endif
+# define MaxOffset 0x7fffffffUL
 #endif
 
-#define LengthType unsigned int
-#define MaxLength 0xffffffffUL
+#define OffsetType off_t
+
+// The data is read and written with positional I/O directly from and to
+// the buffers of the caller (no stdio buffering and no seeking); large
+// requests may be transferred in several parts.
 
 DiskFile::DiskFile(void)
 {
@@ -368,56 +380,46 @@ DiskFile::DiskFile(void)
   filesize = 0;
   offset = 0;
 
-  file = 0;
+  file = -1;
 
   exists = false;
 }
 
 DiskFile::~DiskFile(void)
 {
-  if (file != 0)
-    fclose(file);
+  if (file != -1)
+    close(file);
 }
 
 // Create new file on disk and make sure that there is enough
 // space on disk for it.
 bool DiskFile::Create(string _filename, u64 _filesize)
 {
-  assert(file == 0);
+  assert(file == -1);
 
   filename = _filename;
   filesize = _filesize;
 
-  file = fopen(_filename.c_str(), "wb");
-  if (file == 0)
+  if (_filesize > (u64)MaxOffset)
   {
-    cerr << "Could not create: " << _filename << endl;
-
+    cerr << "Requested file size for " << _filename << " is too large." << endl;
     return false;
   }
 
-  if (_filesize > (u64)MaxOffset)
+  file = open(_filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+  if (file == -1)
   {
-    cerr << "Requested file size for " << _filename << " is too large." << endl;
+    cerr << "Could not create: " << _filename << endl;
+
     return false;
   }
 
   if (_filesize > 0)
   {
-    if (fseek(file, (OffsetType)_filesize-1, SEEK_SET))
-    {
-      fclose(file);
-      file = 0;
-      ::remove(filename.c_str());
-      
-      cerr << "Could not set end of file: " << _filename << endl;
-      return false;
-    }
-
-    if (1 != fwrite(&_filesize, 1, 1, file))
+    if (ftruncate(file, (OffsetType)_filesize))
     {
-      fclose(file);
-      file = 0;
+      close(file);
+      file = -1;
       ::remove(filename.c_str());
       
       cerr << "Could not set end of file: " << _filename << endl;
@@ -435,38 +437,31 @@ bool DiskFile::Create(string _filename, u64 _filesize)
 
 bool DiskFile::Write(u64 _offset, const void *buffer, size_t length)
 {
-  assert(file != 0);
+  assert(file != -1);
 
-  if (offset != _offset)
+  if (_offset > (u64)MaxOffset || length > (u64)MaxOffset - _offset)
   {
-    if (_offset > (u64)MaxOffset)
-    {
-      cerr << "Could not write " << (u64)length << " bytes to " << filename << " at offset " << _offset << endl;
-      return false;
-    }
+    cerr << "Could not write " << (u64)length << " bytes to " << filename << " at offset " << _offset << endl;
+    return false;
+  }
 
+  size_t done = 0;
+  while (done < length)
+  {
+    ssize_t wrote = pwrite(file, &((const u8*)buffer)[done], length - done, (OffsetType)(_offset + done));
+    if (wrote < 0 && errno == EINTR)
+      continue;
 
-    if (fseek(file, (OffsetType)_offset, SEEK_SET))
+    if (wrote <= 0)
     {
       cerr << "Could not write " << (u64)length << " bytes to " << filename << " at offset " << _offset << endl;
       return false;
     }
-    offset = _offset;
-  }
-
-  if (length > MaxLength)
-  {
-    cerr << "Could not write " << (u64)length << " bytes to " << filename << " at offset " << _offset << endl;
-    return false;
-  }
 
-  if (1 != fwrite(buffer, (LengthType)length, 1, file))
-  {
-    cerr << "Could not write " << (u64)length << " bytes to " << filename << " at offset " << _offset << endl;
-    return false;
+    done += wrote;
   }
 
-  offset += length;
+  offset = _offset + length;
 
   if (filesize < offset)
   {
@@ -480,7 +475,7 @@ bool DiskFile::Write(u64 _offset, const void *buffer, size_t length)
 
 bool DiskFile::Open(string _filename, u64 _filesize)
 {
-  assert(file == 0);
+  assert(file == -1);
 
   filename = _filename;
   filesize = _filesize;
@@ -491,8 +486,8 @@ bool DiskFile::Open(string _filename, u64 _filesize)
     return false;
   }
 
-  file = fopen(filename.c_str(), "rb");
-  if (file == 0)
+  file = open(filename.c_str(), O_RDONLY);
+  if (file == -1)
   {
     return false;
   }
@@ -507,48 +502,86 @@ bool DiskFile::Open(string _filename, u64 _filesize)
 
 bool DiskFile::Read(u64 _offset, void *buffer, size_t length)
 {
-  assert(file != 0);
+  assert(file != -1);
 
-  if (offset != _offset)
+  if (_offset > (u64)MaxOffset || length > (u64)MaxOffset - _offset)
   {
-    if (_offset > (u64)MaxOffset)
-    {
-      cerr << "Could not read " << (u64)length << " bytes from " << filename << " at offset " << _offset << endl;
-      return false;
-    }
+    cerr << "Could not read " << (u64)length << " bytes from " << filename << " at offset " << _offset << endl;
+    return false;
+  }
 
+  size_t done = 0;
+  while (done < length)
+  {
+    ssize_t got = pread(file, &((u8*)buffer)[done], length - done, (OffsetType)(_offset + done));
+    if (got < 0 && errno == EINTR)
+      continue;
 
-    if (fseek(file, (OffsetType)_offset, SEEK_SET))
+    // A short file is an error as with fread
+    if (got <= 0)
     {
       cerr << "Could not read " << (u64)length << " bytes from " << filename << " at offset " << _offset << endl;
       return false;
     }
-    offset = _offset;
-  }
 
-  if (length > MaxLength)
-  {
-    cerr << "Could not read " << (u64)length << " bytes from " << filename << " at offset " << _offset << endl;
-    return false;
-  }
-
-  if (1 != fread(buffer, (LengthType)length, 1, file))
-  {
-    cerr << "Could not read " << (u64)length << " bytes from " << filename << " at offset " << _offset << endl;
-    return false;
+    done += got;
   }
 
-  offset += length;
+  offset = _offset + length;
 
   return true;
 }
 
+// Ask the system to read the data in the background; the file doesn't need
+// to be open, the data is kept in the system cache until it is read.
+
+void DiskFile::Prefetch(u64 _offset, size_t length)
+{
+#ifdef POSIX_FADV_WILLNEED
+  if (_offset > (u64)MaxOffset || length > (u64)MaxOffset - _offset)
+    return;
+
+  int fd = file != -1 ? file : open(filename.c_str(), O_RDONLY);
+  if (fd == -1)
+    return;
+
+  posix_fadvise(fd, (OffsetType)_offset, (OffsetType)length, POSIX_FADV_WILLNEED);
+
+  if (fd != file)
+    close(fd);
+#endif
+}
+
+const void* DiskFile::Map(void)
+{
+  assert(file != -1);
+
+  // Don't use up the address space of 32-bit systems
+  if (filesize == 0 || filesize > (sizeof(void*) < 8 ? (u64)256*1024*1024 : (u64)MaxOffset))
+    return 0;
+
+  void *mapping = mmap(0, (size_t)filesize, PROT_READ, MAP_SHARED, file, 0);
+  if (mapping == MAP_FAILED)
+    return 0;
+
+#ifdef MADV_SEQUENTIAL
+  madvise(mapping, (size_t)filesize, MADV_SEQUENTIAL);
+#endif
+
+  return mapping;
+}
+
+void DiskFile::Unmap(const void *mapping)
+{
+  munmap((void*)mapping, (size_t)filesize);
+}
+
 void DiskFile::Close(void)
 {
-  if (file != 0)
+  if (file != -1)
   {
-    fclose(file);
-    file = 0;
+    close(file);
+    file = -1;
   }
 }
 
@@ -739,7 +772,7 @@ bool DiskFile::Delete(void)
 #ifdef WIN32
   assert(hFile == INVALID_HANDLE_VALUE);
 #else
-  assert(file == 0);
+  assert(file == -1);
 #endif
 
   if (filename.size() > 0 && 0 == unlink(filename.c_str()))
@@ -907,7 +940,7 @@ bool DiskFile::Rename(string _filename)
 #ifdef WIN32
   assert(hFile == INVALID_HANDLE_VALUE);
 #else
-  assert(file == 0);
+  assert(file == -1);
 #endif
 
   if (::rename(filename.c_str(), _filename.c_str()) == 0)
@@ -44,12 +44,19 @@ public:
 #ifdef WIN32
   bool IsOpen(void) const {return hFile != INVALID_HANDLE_VALUE;}
 #else
-  bool IsOpen(void) const {return file != 0;}
+  bool IsOpen(void) const {return file != -1;}
 #endif
 
   // Read some data from the file
   bool Read(u64 offset, void *buffer, size_t length);
 
+  // Start reading of data which is going to be read soon (the file may be closed)
+  void Prefetch(u64 offset, size_t length);
+
+  // Map the whole open file into memory for reading (returns 0 if not possible)
+  const void* Map(void);
+  void Unmap(const void *mapping);
+
   // Close the file
   void Close(void);
 
@@ -90,7 +97,7 @@ protected:
 #ifdef WIN32
   HANDLE hFile;
 #else
-  FILE *file;
+  int    file;
 #endif
 
   // Current offset within the file
@@ -33,21 +33,27 @@ static char THIS_FILE[]=__FILE__;
 FileCheckSummer::FileCheckSummer(DiskFile   *_diskfile,
                                  u64         _blocksize,
                                  const u32 (&_windowtable)[256],
-                                 u32         _windowmask)
+                                 u32         _windowmask,
+                                 const FileHashes *_hashes)
 : diskfile(_diskfile)
 , blocksize(_blocksize)
 , windowtable(_windowtable)
 , windowmask(_windowmask)
+, hashes(_hashes != 0 && _hashes->computed ? _hashes : 0)
 {
-  buffer = new char[(size_t)blocksize*2];
-
   filesize = diskfile->FileSize();
 
+  // Files smaller than a block are read into the buffer
+  mapping = filesize > blocksize ? (const char*)diskfile->Map() : 0;
+  buffer = mapping ? 0 : new char[(size_t)blocksize*2];
+
   currentoffset = 0;
 }
 
 FileCheckSummer::~FileCheckSummer(void)
 {
+  if (mapping)
+    diskfile->Unmap(mapping);
   delete [] buffer;
 }
 
@@ -56,15 +62,27 @@ bool FileCheckSummer::Start(void)
 {
   currentoffset = readoffset = 0;
 
-  tailpointer = outpointer = buffer;
-  inpointer = &buffer[blocksize];
+  if (mapping)
+  {
+    outpointer = mapping;
+    inpointer = &mapping[blocksize];
+  }
+  else
+  {
+    tailpointer = buffer;
+    outpointer = buffer;
+    inpointer = &buffer[blocksize];
+  }
 
   // Fill the buffer with new data
   if (!Fill())
     return false;
 
   // Compute the checksum for the block
-  checksum = ~0 ^ CRCUpdateBlock(~0, (size_t)blocksize, buffer);
+  if (HaveBlockHashes())
+    checksum = hashes->blockchecksums[(size_t)(currentoffset / blocksize)];
+  else
+    checksum = ShortChecksum(BlockLength());
 
   return true;
 }
@@ -92,13 +110,34 @@ bool FileCheckSummer::Jump(u64 distance)
   if (currentoffset >= filesize)
   {
     currentoffset = filesize;
-    tailpointer = outpointer = buffer;
-    memset(buffer, 0, (size_t)blocksize);
+    if (!mapping)
+    {
+      tailpointer = buffer;
+      outpointer = buffer;
+      memset(buffer, 0, (size_t)blocksize);
+    }
     checksum = 0;
 
     return true;
   }
 
+  // In a mapped file the window is simply moved
+  if (mapping)
+  {
+    outpointer += distance;
+    inpointer += distance;
+
+    if (!Fill())
+      return false;
+
+    if (HaveBlockHashes())
+      checksum = hashes->blockchecksums[(size_t)(currentoffset / blocksize)];
+    else
+      checksum = ShortChecksum(BlockLength());
+
+    return true;
+  }
+
   // Move past the data being discarded
   outpointer += distance;
   assert(outpointer <= tailpointer);
@@ -123,7 +162,10 @@ bool FileCheckSummer::Jump(u64 distance)
     return false;
 
   // Compute the checksum for the block
-  checksum = ~0 ^ CRCUpdateBlock(~0, (size_t)blocksize, buffer);
+  if (HaveBlockHashes())
+    checksum = hashes->blockchecksums[(size_t)(currentoffset / blocksize)];
+  else
+    checksum = ~0 ^ CRCUpdateBlock(~0, (size_t)blocksize, buffer);
 
   return true;
 }
@@ -136,6 +178,18 @@ bool FileCheckSummer::Fill(void)
   if (readoffset >= filesize)
     return true;
 
+  // The data of a mapped file is only hashed, up to the end of the next window
+  if (mapping)
+  {
+    u64 end = min(filesize, currentoffset + 2*blocksize);
+    if (end > readoffset)
+    {
+      UpdateHashes(readoffset, &mapping[readoffset], (size_t)(end - readoffset));
+      readoffset = end;
+    }
+    return true;
+  }
+
   // How much data can we read into the buffer
   size_t want = (size_t)min(filesize-readoffset, (u64)(&buffer[2*blocksize]-tailpointer));
 
@@ -164,6 +218,10 @@ bool FileCheckSummer::Fill(void)
 // Update the full file hash and the 16k hash using the new data
 void FileCheckSummer::UpdateHashes(u64 offset, const void *buffer, size_t length)
 {
+  // Have the hashes been computed already
+  if (hashes != 0)
+    return;
+
   // Are we already beyond the first 16k
   if (offset >= 16384)
   {
@@ -194,6 +252,13 @@ void FileCheckSummer::UpdateHashes(u64 offset, const void *buffer, size_t length
 // Return the full file hash and the 16k file hash
 void FileCheckSummer::GetFileHashes(MD5Hash &hashfull, MD5Hash &hash16k) const
 {
+  if (hashes != 0)
+  {
+    hashfull = hashes->hashfull;
+    hash16k = hashes->hash16k;
+    return;
+  }
+
   // Compute the hash of the first 16k
   MD5Context context = context16k;
   context.Final(hash16k);
@@ -215,6 +280,13 @@ void FileCheckSummer::GetFileHashes(MD5Hash &hashfull, MD5Hash &hash16k) const
 // Compute and return the current hash
 MD5Hash FileCheckSummer::Hash(void)
 {
+  if (HaveBlockHashes())
+    return hashes->blockhashes[(size_t)(currentoffset / blocksize)];
+
+  // The mapping ends with the file, the rest of the last block is padded with zeros
+  if (mapping && ShortBlock())
+    return ShortHash(BlockLength());
+
   MD5Context context;
   context.Update(outpointer, (size_t)blocksize);
 
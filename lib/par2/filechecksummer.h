@@ -32,6 +32,35 @@
 // block of data is expected to start. Whilst the file is being scanned
 // the object also computes the MD5 Hash of the whole file and of
 // the first 16k of the file for later tests.
+//
+// If the file can be mapped into memory the window points directly into
+// the mapping: jumping to the next block then costs only the computation
+// of its checksum and no buffers need to be allocated and refilled.
+
+// The FileHashes object holds those values which the FileCheckSummer
+// computes while scanning a data file but which do not depend on the
+// outcome of the scan: the MD5 Hash of the whole file and of the first
+// 16k, and the CRC and MD5 Hash of the block at each block aligned offset.
+// They can be computed in advance for several files at the same time (see
+// Par2Repairer::HashDataFiles), the scan then only has to compute values
+// for blocks which are not block aligned.
+
+class FileHashes
+{
+public:
+  FileHashes(string _filename, Par2RepairerSourceFile *_sourcefile)
+  : filename(_filename), sourcefile(_sourcefile), computed(false) {}
+
+public:
+  string                  filename;
+  Par2RepairerSourceFile *sourcefile;     // The source file which is being verified or 0 for extra files
+
+  bool                    computed;       // Whether the values below have been computed
+  MD5Hash                 hashfull;
+  MD5Hash                 hash16k;
+  vector<u32>             blockchecksums;
+  vector<MD5Hash>         blockhashes;
+};
 
 class FileCheckSummer
 {
@@ -39,7 +68,8 @@ public:
   FileCheckSummer(DiskFile   *diskfile,
                   u64         blocksize,
                   const u32 (&windowtable)[256],
-                  u32         windowmask);
+                  u32         windowmask,
+                  const FileHashes *hashes = 0);
   ~FileCheckSummer(void);
 
   // Start reading the file at the beginning
@@ -83,9 +113,10 @@ protected:
   u64         filesize;
 
   u64         currentoffset; // file offset for current window position
-  char       *buffer;        // buffer for reading from the file
-  char       *outpointer;    // position in buffer of scan window
-  char       *inpointer;     // &outpointer[blocksize];
+  const char *mapping;       // the whole file mapped into memory or 0
+  char       *buffer;        // buffer for reading from the file (if not mapped)
+  const char *outpointer;    // position in buffer of scan window
+  const char *inpointer;     // &outpointer[blocksize];
   char       *tailpointer;   // after last valid data in buffer
 
   // File offset for next read
@@ -98,7 +129,13 @@ protected:
   MD5Context  contextfull;
   MD5Context  context16k;
 
+  // Values computed in advance (may be 0)
+  const FileHashes *hashes;
+
 protected:
+  // Is there a precomputed value for the current window position
+  bool HaveBlockHashes(void) const;
+
   //void ComputeCurrentCRC(void);
   void UpdateHashes(u64 offset, const void *buffer, size_t length);
 
@@ -113,6 +150,13 @@ inline u32 FileCheckSummer::Checksum(void) const
   return checksum;
 }
 
+inline bool FileCheckSummer::HaveBlockHashes(void) const
+{
+  return hashes != 0 &&
+         currentoffset % blocksize == 0 &&
+         currentoffset / blocksize < hashes->blockchecksums.size();
+}
+
 // Return the current block length
 
 inline u64 FileCheckSummer::BlockLength(void) const
@@ -144,20 +188,30 @@ inline bool FileCheckSummer::Step(void)
   if (++currentoffset >= filesize)
   {
     currentoffset = filesize;
-    tailpointer = outpointer = buffer;
-    memset(buffer, 0, (size_t)blocksize);
+    if (!mapping)
+    {
+      tailpointer = buffer;
+      outpointer = buffer;
+      memset(buffer, 0, (size_t)blocksize);
+    }
     checksum = 0;
 
     return true;
   }
 
-  // Get the incoming and outgoing characters
-  char inch = *inpointer++;
+  // Get the incoming and outgoing characters (beyond the end
+  // of a mapped file the window is padded with zeros)
+  char inch = !mapping || inpointer < &mapping[filesize] ? *inpointer : 0;
   char outch = *outpointer++;
+  inpointer++;
 
   // Update the checksum
   checksum = windowmask ^ CRCSlideChar(windowmask ^ checksum, inch, outch, windowtable);
 
+  // The window always slides further in the mapped file
+  if (mapping)
+    return readoffset >= currentoffset + blocksize || Fill();
+
   // Can the window slide further
   if (outpointer < &buffer[blocksize])
     return true;
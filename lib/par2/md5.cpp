@@ -19,6 +19,7 @@
 
 #include "nzbget.h"
 #include "par2cmdline.h"
+#include "Util.h"
 
 #ifdef _MSC_VER
 #ifdef _DEBUG
@@ -350,3 +351,440 @@ string MD5Context::print(void) const
   return buffer;
 }
 
+
+// Build the final padded 64 byte blocks of each lane: the bytes after the
+// last whole block, the 0x80 terminator and the bit count. Returns the size
+// of the padded data (64 or 128 bytes).
+static size_t BuildTails(const u8 * const *data, unsigned int lanes, size_t length, u8 (*tails)[128])
+{
+  size_t done = length & ~(size_t)63;
+  size_t remainder = length - done;
+  size_t tailsize = remainder < 56 ? 64 : 128;
+  u64 bits = (u64)length << 3;
+
+  for (unsigned int lane=0; lane<lanes; lane++)
+  {
+    u8 *tail = tails[lane];
+    memcpy(tail, data[lane] + done, remainder);
+    tail[remainder] = 0x80;
+    memset(tail + remainder + 1, 0, tailsize - 8 - remainder - 1);
+    for (int i=0; i<8; i++)
+    {
+      tail[tailsize - 8 + i] = (u8)((bits >> (8*i)) & 0xFF);
+    }
+  }
+
+  return tailsize;
+}
+
+// Convert the states of the lanes (all "a" words first, then all "b" words, ...)
+// to little endian hash values
+static void StoreHashes(const u32 *state, unsigned int lanes, MD5Hash *hashes)
+{
+  for (unsigned int lane=0; lane<lanes; lane++)
+  {
+    for (int i=0; i<4; i++)
+    {
+      u32 value = state[i*lanes + lane];
+      hashes[lane].hash[4*i+3] = (u8)((value >> 24) & 0xFF);
+      hashes[lane].hash[4*i+2] = (u8)((value >> 16) & 0xFF);
+      hashes[lane].hash[4*i+1] = (u8)((value >>  8) & 0xFF);
+      hashes[lane].hash[4*i+0] = (u8)((value >>  0) & 0xFF);
+    }
+  }
+}
+
+#ifdef HAVE_X86_SIMD
+
+// The rounds are shared by all vector implementations, each of them defines
+// the primitive operations before expanding VROUNDS. The 64 byte blocks of
+// the lanes are transposed so that m[k] holds word k of every lane.
+
+#define VROUND(f,w,x,y,z,k,s,ti)   w = VADD(x, VROL(VADD(VADD(w, f(x,y,z)), VADD(m[k], VSET1(ti))), s))
+
+#define VROUNDS \
+  VROUND(VF1, a, b, c, d,  0,  7, 0xd76aa478); \
+  VROUND(VF1, d, a, b, c,  1, 12, 0xe8c7b756); \
+  VROUND(VF1, c, d, a, b,  2, 17, 0x242070db); \
+  VROUND(VF1, b, c, d, a,  3, 22, 0xc1bdceee); \
+  VROUND(VF1, a, b, c, d,  4,  7, 0xf57c0faf); \
+  VROUND(VF1, d, a, b, c,  5, 12, 0x4787c62a); \
+  VROUND(VF1, c, d, a, b,  6, 17, 0xa8304613); \
+  VROUND(VF1, b, c, d, a,  7, 22, 0xfd469501); \
+  VROUND(VF1, a, b, c, d,  8,  7, 0x698098d8); \
+  VROUND(VF1, d, a, b, c,  9, 12, 0x8b44f7af); \
+  VROUND(VF1, c, d, a, b, 10, 17, 0xffff5bb1); \
+  VROUND(VF1, b, c, d, a, 11, 22, 0x895cd7be); \
+  VROUND(VF1, a, b, c, d, 12,  7, 0x6b901122); \
+  VROUND(VF1, d, a, b, c, 13, 12, 0xfd987193); \
+  VROUND(VF1, c, d, a, b, 14, 17, 0xa679438e); \
+  VROUND(VF1, b, c, d, a, 15, 22, 0x49b40821); \
+  VROUND(VF2, a, b, c, d,  1,  5, 0xf61e2562); \
+  VROUND(VF2, d, a, b, c,  6,  9, 0xc040b340); \
+  VROUND(VF2, c, d, a, b, 11, 14, 0x265e5a51); \
+  VROUND(VF2, b, c, d, a,  0, 20, 0xe9b6c7aa); \
+  VROUND(VF2, a, b, c, d,  5,  5, 0xd62f105d); \
+  VROUND(VF2, d, a, b, c, 10,  9, 0x02441453); \
+  VROUND(VF2, c, d, a, b, 15, 14, 0xd8a1e681); \
+  VROUND(VF2, b, c, d, a,  4, 20, 0xe7d3fbc8); \
+  VROUND(VF2, a, b, c, d,  9,  5, 0x21e1cde6); \
+  VROUND(VF2, d, a, b, c, 14,  9, 0xc33707d6); \
+  VROUND(VF2, c, d, a, b,  3, 14, 0xf4d50d87); \
+  VROUND(VF2, b, c, d, a,  8, 20, 0x455a14ed); \
+  VROUND(VF2, a, b, c, d, 13,  5, 0xa9e3e905); \
+  VROUND(VF2, d, a, b, c,  2,  9, 0xfcefa3f8); \
+  VROUND(VF2, c, d, a, b,  7, 14, 0x676f02d9); \
+  VROUND(VF2, b, c, d, a, 12, 20, 0x8d2a4c8a); \
+  VROUND(VF3, a, b, c, d,  5,  4, 0xfffa3942); \
+  VROUND(VF3, d, a, b, c,  8, 11, 0x8771f681); \
+  VROUND(VF3, c, d, a, b, 11, 16, 0x6d9d6122); \
+  VROUND(VF3, b, c, d, a, 14, 23, 0xfde5380c); \
+  VROUND(VF3, a, b, c, d,  1,  4, 0xa4beea44); \
+  VROUND(VF3, d, a, b, c,  4, 11, 0x4bdecfa9); \
+  VROUND(VF3, c, d, a, b,  7, 16, 0xf6bb4b60); \
+  VROUND(VF3, b, c, d, a, 10, 23, 0xbebfbc70); \
+  VROUND(VF3, a, b, c, d, 13,  4, 0x289b7ec6); \
+  VROUND(VF3, d, a, b, c,  0, 11, 0xeaa127fa); \
+  VROUND(VF3, c, d, a, b,  3, 16, 0xd4ef3085); \
+  VROUND(VF3, b, c, d, a,  6, 23, 0x04881d05); \
+  VROUND(VF3, a, b, c, d,  9,  4, 0xd9d4d039); \
+  VROUND(VF3, d, a, b, c, 12, 11, 0xe6db99e5); \
+  VROUND(VF3, c, d, a, b, 15, 16, 0x1fa27cf8); \
+  VROUND(VF3, b, c, d, a,  2, 23, 0xc4ac5665); \
+  VROUND(VF4, a, b, c, d,  0,  6, 0xf4292244); \
+  VROUND(VF4, d, a, b, c,  7, 10, 0x432aff97); \
+  VROUND(VF4, c, d, a, b, 14, 15, 0xab9423a7); \
+  VROUND(VF4, b, c, d, a,  5, 21, 0xfc93a039); \
+  VROUND(VF4, a, b, c, d, 12,  6, 0x655b59c3); \
+  VROUND(VF4, d, a, b, c,  3, 10, 0x8f0ccc92); \
+  VROUND(VF4, c, d, a, b, 10, 15, 0xffeff47d); \
+  VROUND(VF4, b, c, d, a,  1, 21, 0x85845dd1); \
+  VROUND(VF4, a, b, c, d,  8,  6, 0x6fa87e4f); \
+  VROUND(VF4, d, a, b, c, 15, 10, 0xfe2ce6e0); \
+  VROUND(VF4, c, d, a, b,  6, 15, 0xa3014314); \
+  VROUND(VF4, b, c, d, a, 13, 21, 0x4e0811a1); \
+  VROUND(VF4, a, b, c, d,  4,  6, 0xf7537e82); \
+  VROUND(VF4, d, a, b, c, 11, 10, 0xbd3af235); \
+  VROUND(VF4, c, d, a, b,  2, 15, 0x2ad7d2bb); \
+  VROUND(VF4, b, c, d, a,  9, 21, 0xeb86d391);
+
+// Process the whole blocks of the data and then the padded tails
+#define VBLOCKS(lanes, vtype, load, store) \
+  u8 tails[lanes][128]; \
+  size_t blocks = (length >> 6) + (BuildTails(data, lanes, length, tails) >> 6); \
+  vtype a0 = VSET1(0x67452301); \
+  vtype b0 = VSET1(0xefcdab89); \
+  vtype c0 = VSET1(0x98badcfe); \
+  vtype d0 = VSET1(0x10325476); \
+  for (size_t n=0; n<blocks; n++) \
+  { \
+    const u8 *p[lanes]; \
+    for (unsigned int lane=0; lane<lanes; lane++) \
+    { \
+      p[lane] = n < (length >> 6) ? data[lane] + (n << 6) : tails[lane] + ((n - (length >> 6)) << 6); \
+    } \
+    vtype m[16]; \
+    load; \
+    vtype a = a0; \
+    vtype b = b0; \
+    vtype c = c0; \
+    vtype d = d0; \
+    VROUNDS \
+    a0 = VADD(a0, a); \
+    b0 = VADD(b0, b); \
+    c0 = VADD(c0, c); \
+    d0 = VADD(d0, d); \
+  } \
+  u32 state[4*lanes]; \
+  store(state + 0*lanes, a0); \
+  store(state + 1*lanes, b0); \
+  store(state + 2*lanes, c0); \
+  store(state + 3*lanes, d0); \
+  StoreHashes(state, lanes, hashes);
+
+#define VF1(x,y,z)   VXOR(z, VAND(x, VXOR(y, z)))
+#define VF2(x,y,z)   VXOR(y, VAND(z, VXOR(x, y)))
+#define VF3(x,y,z)   VXOR(VXOR(x, y), z)
+#define VF4(x,y,z)   VXOR(y, VOR(x, VXOR(z, VSET1(0xffffffff))))
+
+#define VSET1(x)     _mm_set1_epi32((int)(x))
+#define VADD(x,y)    _mm_add_epi32(x, y)
+#define VXOR(x,y)    _mm_xor_si128(x, y)
+#define VAND(x,y)    _mm_and_si128(x, y)
+#define VOR(x,y)     _mm_or_si128(x, y)
+#define VROL(x,s)    _mm_or_si128(_mm_slli_epi32(x, s), _mm_srli_epi32(x, 32-(s)))
+
+__attribute__((target("sse2")))
+static inline void LoadSse2(const u8 * const *p, __m128i *m)
+{
+  for (int i=0; i<4; i++)
+  {
+    __m128i r0 = _mm_loadu_si128((const __m128i*)(p[0] + 16*i));
+    __m128i r1 = _mm_loadu_si128((const __m128i*)(p[1] + 16*i));
+    __m128i r2 = _mm_loadu_si128((const __m128i*)(p[2] + 16*i));
+    __m128i r3 = _mm_loadu_si128((const __m128i*)(p[3] + 16*i));
+
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t2 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+    m[4*i+0] = _mm_unpacklo_epi64(t0, t2);
+    m[4*i+1] = _mm_unpackhi_epi64(t0, t2);
+    m[4*i+2] = _mm_unpacklo_epi64(t1, t3);
+    m[4*i+3] = _mm_unpackhi_epi64(t1, t3);
+  }
+}
+
+#define StoreSse2(dst, x)   _mm_storeu_si128((__m128i*)(dst), x)
+
+__attribute__((target("sse2")))
+static void HashLanesSse2(const u8 * const *data, size_t length, MD5Hash *hashes)
+{
+  VBLOCKS(4, __m128i, LoadSse2(p, m), StoreSse2)
+}
+
+#undef VSET1
+#undef VADD
+#undef VXOR
+#undef VAND
+#undef VOR
+#undef VROL
+
+#define VSET1(x)     _mm256_set1_epi32((int)(x))
+#define VADD(x,y)    _mm256_add_epi32(x, y)
+#define VXOR(x,y)    _mm256_xor_si256(x, y)
+#define VAND(x,y)    _mm256_and_si256(x, y)
+#define VOR(x,y)     _mm256_or_si256(x, y)
+#define VROL(x,s)    _mm256_or_si256(_mm256_slli_epi32(x, s), _mm256_srli_epi32(x, 32-(s)))
+
+__attribute__((target("avx2")))
+static inline void LoadAvx2(const u8 * const *p, __m256i *m)
+{
+  for (int i=0; i<2; i++)
+  {
+    __m256i t[8];
+    for (int j=0; j<4; j++)
+    {
+      __m256i r0 = _mm256_loadu_si256((const __m256i*)(p[2*j] + 32*i));
+      __m256i r1 = _mm256_loadu_si256((const __m256i*)(p[2*j+1] + 32*i));
+      t[2*j] = _mm256_unpacklo_epi32(r0, r1);
+      t[2*j+1] = _mm256_unpackhi_epi32(r0, r1);
+    }
+
+    // u[j] holds the words j and 4+j of the lanes 0-3, u[4+j] of the lanes 4-7
+    __m256i u[8];
+    for (int j=0; j<2; j++)
+    {
+      u[4*j+0] = _mm256_unpacklo_epi64(t[4*j+0], t[4*j+2]);
+      u[4*j+1] = _mm256_unpackhi_epi64(t[4*j+0], t[4*j+2]);
+      u[4*j+2] = _mm256_unpacklo_epi64(t[4*j+1], t[4*j+3]);
+      u[4*j+3] = _mm256_unpackhi_epi64(t[4*j+1], t[4*j+3]);
+    }
+
+    for (int j=0; j<4; j++)
+    {
+      m[8*i+j] = _mm256_permute2x128_si256(u[j], u[4+j], 0x20);
+      m[8*i+4+j] = _mm256_permute2x128_si256(u[j], u[4+j], 0x31);
+    }
+  }
+}
+
+#define StoreAvx2(dst, x)   _mm256_storeu_si256((__m256i*)(dst), x)
+
+__attribute__((target("avx2")))
+static void HashLanesAvx2(const u8 * const *data, size_t length, MD5Hash *hashes)
+{
+  VBLOCKS(8, __m256i, LoadAvx2(p, m), StoreAvx2)
+}
+
+#undef VSET1
+#undef VADD
+#undef VXOR
+#undef VAND
+#undef VOR
+#undef VROL
+#undef VF1
+#undef VF2
+#undef VF3
+#undef VF4
+
+// AVX-512 has rotates and ternary logic for the round functions.
+// The zero-masked forms of rotates, unpacks and shuffles are used with a full
+// mask: GCC implements the unmasked forms by merging into an undefined vector,
+// which produces false "may be used uninitialized" warnings.
+#define VF1(x,y,z)   _mm512_ternarylogic_epi32(x, y, z, 0xca)
+#define VF2(x,y,z)   _mm512_ternarylogic_epi32(z, x, y, 0xca)
+#define VF3(x,y,z)   _mm512_ternarylogic_epi32(x, y, z, 0x96)
+#define VF4(x,y,z)   _mm512_ternarylogic_epi32(x, y, z, 0x39)
+
+#define VSET1(x)     _mm512_set1_epi32((int)(x))
+#define VADD(x,y)    _mm512_add_epi32(x, y)
+#define VROL(x,s)    _mm512_maskz_rol_epi32(0xffff, x, s)
+
+__attribute__((target("avx512f")))
+static inline void LoadAvx512(const u8 * const *p, __m512i *m)
+{
+  __m512i t[16];
+  for (int j=0; j<8; j++)
+  {
+    __m512i r0 = _mm512_loadu_si512((const void*)p[2*j]);
+    __m512i r1 = _mm512_loadu_si512((const void*)p[2*j+1]);
+    t[2*j] = _mm512_maskz_unpacklo_epi32(0xffff, r0, r1);
+    t[2*j+1] = _mm512_maskz_unpackhi_epi32(0xffff, r0, r1);
+  }
+
+  // Within each 128-bit part k, u[4*g+j] holds word 4*k+j of the lanes 4*g..4*g+3
+  __m512i u[16];
+  for (int g=0; g<4; g++)
+  {
+    u[4*g+0] = _mm512_maskz_unpacklo_epi64(0xff, t[4*g+0], t[4*g+2]);
+    u[4*g+1] = _mm512_maskz_unpackhi_epi64(0xff, t[4*g+0], t[4*g+2]);
+    u[4*g+2] = _mm512_maskz_unpacklo_epi64(0xff, t[4*g+1], t[4*g+3]);
+    u[4*g+3] = _mm512_maskz_unpackhi_epi64(0xff, t[4*g+1], t[4*g+3]);
+  }
+
+  for (int j=0; j<4; j++)
+  {
+    __m512i v0 = _mm512_maskz_shuffle_i32x4(0xffff, u[j], u[4+j], 0x88);
+    __m512i w0 = _mm512_maskz_shuffle_i32x4(0xffff, u[j], u[4+j], 0xdd);
+    __m512i v1 = _mm512_maskz_shuffle_i32x4(0xffff, u[8+j], u[12+j], 0x88);
+    __m512i w1 = _mm512_maskz_shuffle_i32x4(0xffff, u[8+j], u[12+j], 0xdd);
+
+    m[j] = _mm512_maskz_shuffle_i32x4(0xffff, v0, v1, 0x88);
+    m[8+j] = _mm512_maskz_shuffle_i32x4(0xffff, v0, v1, 0xdd);
+    m[4+j] = _mm512_maskz_shuffle_i32x4(0xffff, w0, w1, 0x88);
+    m[12+j] = _mm512_maskz_shuffle_i32x4(0xffff, w0, w1, 0xdd);
+  }
+}
+
+#define StoreAvx512(dst, x)   _mm512_storeu_si512((void*)(dst), x)
+
+__attribute__((target("avx512f")))
+static void HashLanesAvx512(const u8 * const *data, size_t length, MD5Hash *hashes)
+{
+  VBLOCKS(16, __m512i, LoadAvx512(p, m), StoreAvx512)
+}
+
+#undef VSET1
+#undef VADD
+#undef VROL
+#undef VF1
+#undef VF2
+#undef VF3
+#undef VF4
+
+#endif /* HAVE_X86_SIMD */
+
+const char *MD5Lanes::ImplNames[] = { "scalar", "SSE2", "AVX2", "AVX-512" };
+
+bool MD5Lanes::IsSupported(Impl impl)
+{
+  switch (impl)
+  {
+  case eScalar:
+    return true;
+#ifdef HAVE_X86_SIMD
+  case eSse2:
+    return CpuFeatures::HasSse2();
+  case eAvx2:
+    return CpuFeatures::HasAvx2();
+  case eAvx512:
+    return CpuFeatures::HasAvx512bw();
+#endif
+  default:
+    return false;
+  }
+}
+
+MD5Lanes::Impl MD5Lanes::BestImpl(void)
+{
+  const Impl preferred[] = { eAvx512, eAvx2, eSse2 };
+  for (unsigned int i=0; i<sizeof(preferred)/sizeof(Impl); i++)
+  {
+    if (IsSupported(preferred[i]))
+    {
+      return preferred[i];
+    }
+  }
+  return eScalar;
+}
+
+unsigned int MD5Lanes::Lanes(Impl impl)
+{
+  switch (impl)
+  {
+  case eSse2:
+    return 4;
+  case eAvx2:
+    return 8;
+  case eAvx512:
+    return 16;
+  default:
+    return 1;
+  }
+}
+
+void MD5Lanes::Hash(Impl impl, const void *buffer, size_t stride, size_t length, size_t count, MD5Hash *hashes)
+{
+  const u8 *current = (const u8*)buffer;
+
+#ifndef HAVE_X86_SIMD
+  impl = eScalar;
+#endif
+
+  while (count > 0)
+  {
+    // The remaining blocks are given to the narrowest implementation
+    // which takes all of them, unused lanes repeat the last block
+    Impl use = impl;
+    while (use > eSse2 && Lanes((Impl)(use - 1)) >= count)
+    {
+      use = (Impl)(use - 1);
+    }
+    if (count == 1)
+    {
+      use = eScalar;
+    }
+
+    unsigned int lanes = Lanes(use);
+    unsigned int used = lanes < count ? lanes : (unsigned int)count;
+
+    if (use == eScalar)
+    {
+      MD5Context context;
+      context.Update(current, length);
+      context.Final(hashes[0]);
+    }
+#ifdef HAVE_X86_SIMD
+    else
+    {
+      const u8 *data[16];
+      MD5Hash results[16];
+      for (unsigned int lane=0; lane<lanes; lane++)
+      {
+        data[lane] = current + (lane < used ? lane : used - 1) * stride;
+      }
+
+      switch (use)
+      {
+      case eSse2:
+        HashLanesSse2(data, length, results);
+        break;
+      case eAvx2:
+        HashLanesAvx2(data, length, results);
+        break;
+      default:
+        HashLanesAvx512(data, length, results);
+        break;
+      }
+
+      memcpy(hashes, results, used * sizeof(MD5Hash));
+    }
+#endif
+
+    current += used * stride;
+    hashes += used;
+    count -= used;
+  }
+}
@@ -111,6 +111,39 @@ protected:
   u64 bytes;
 };
 
+// The MD5Lanes object computes the MD5 Hash values of several independent
+// blocks of data of the same length at once, one block per vector lane.
+// The best implementation for the CPU is chosen at runtime.
+
+class MD5Lanes
+{
+public:
+  enum Impl
+  {
+    eScalar,
+    eSse2,
+    eAvx2,
+    eAvx512
+  };
+
+  static const char *ImplNames[];
+
+  static bool IsSupported(Impl impl);
+  static Impl BestImpl(void);
+
+  // Number of blocks processed together
+  static unsigned int Lanes(Impl impl);
+
+  // Compute the hashes of "count" blocks of "length" bytes each,
+  // block i starts at "buffer + i * stride"
+  static void Hash(Impl impl,
+                   const void *buffer,
+                   size_t stride,
+                   size_t length,
+                   size_t count,
+                   MD5Hash *hashes);
+};
+
 // Compare hash values
 
 inline bool MD5Hash::operator==(const MD5Hash &other) const
@@ -50,6 +50,14 @@ Par2Repairer::Par2Repairer(void)
   inputbuffer = 0;
   outputbuffer = 0;
 
+  hashbatchsize = 0;
+  currenthashes = 0;
+
+  inputsperpass = 1;
+  tileinputs = 8;
+  tileoutputs = 16;
+  tilesize = 65536;
+
   noiselevel = CommandLine::nlNormal;
   headers = new ParHeaders;
   alreadyloaded = false;
@@ -62,6 +70,8 @@ Par2Repairer::~Par2Repairer(void)
   delete [] (u8*)inputbuffer;
   delete [] (u8*)outputbuffer;
 
+  ClearFileHashes();
+
   map<u32,RecoveryPacket*>::iterator rp = recoverypacketmap.begin();
   while (rp != recoverypacketmap.end())
   {
@@ -1287,9 +1297,31 @@ bool Par2Repairer::VerifySourceFiles(void)
       // Remember that we have processed this file
       bool success = diskFileMap.Insert(diskfile);
       assert(success); (void)success;
+
+      // Compute the hashes of this and the next files at once
+      if (hashbatchsize > 0 && FindFileHashes(filename) == 0)
+      {
+        ClearFileHashes();
+
+        for (vector<Par2RepairerSourceFile*>::iterator next = sf;
+             next != sortedfiles.end() && hashedfiles.size() < hashbatchsize;
+             ++next)
+        {
+          string nextfilename = (*next)->TargetFileName();
+          if (DiskFile::FileExists(nextfilename))
+          {
+            hashedfiles.push_back(new FileHashes(nextfilename, *next));
+          }
+        }
+
+        HashDataFiles(hashedfiles);
+      }
+
       // Do the actual verification
+      currenthashes = FindFileHashes(filename);
       if (!VerifyDataFile(diskfile, sourcefile))
         finalresult = false;
+      currenthashes = 0;
 
       // We have finished with the file for now
       diskfile->Close();
@@ -1316,6 +1348,8 @@ bool Par2Repairer::VerifySourceFiles(void)
     ++sf;
   }
 
+  ClearFileHashes();
+
   return finalresult;
 }
 
@@ -1350,8 +1384,33 @@ bool Par2Repairer::VerifyExtraFiles(const list<CommandLine::ExtraFile> &extrafil
         bool success = diskFileMap.Insert(diskfile);
         assert(success); (void)success;
 
+        // Compute the hashes of this and the next files at once
+        if (hashbatchsize > 0 && FindFileHashes(filename) == 0)
+        {
+          ClearFileHashes();
+
+          for (ExtraFileIterator next=i; next!=extrafiles.end() && hashedfiles.size() < hashbatchsize; ++next)
+          {
+            string nextfilename = next->FileName();
+            if (string::npos == nextfilename.find(".par2") &&
+                string::npos == nextfilename.find(".PAR2"))
+            {
+              nextfilename = DiskFile::GetCanonicalPathname(nextfilename);
+              if ((nextfilename == filename || diskFileMap.Find(nextfilename) == 0) &&
+                  DiskFile::FileExists(nextfilename))
+              {
+                hashedfiles.push_back(new FileHashes(nextfilename, 0));
+              }
+            }
+          }
+
+          HashDataFiles(hashedfiles);
+        }
+
         // Do the actual verification
+        currenthashes = FindFileHashes(filename);
         VerifyDataFile(diskfile, 0);
+        currenthashes = 0;
         // Ignore errors
 
         // We have finished with the file for now
@@ -1363,9 +1422,107 @@ bool Par2Repairer::VerifyExtraFiles(const list<CommandLine::ExtraFile> &extrafil
     }
   }
 
+  ClearFileHashes();
+
   return true;
 }
 
+void Par2Repairer::HashDataFiles(vector<FileHashes*> &files)
+{
+  for (vector<FileHashes*>::iterator fh = files.begin(); fh != files.end() && !cancelled; ++fh)
+  {
+    ComputeFileHashes(*fh);
+  }
+}
+
+bool Par2Repairer::ComputeFileHashes(FileHashes *filehashes, u64 blocksize, const bool &cancelled)
+{
+  DiskFile diskfile;
+  if (!diskfile.Open(filehashes->filename))
+    return false;
+
+  u64 filesize = diskfile.FileSize();
+  size_t blockcount = (size_t)((filesize + blocksize - 1) / blocksize);
+  filehashes->blockchecksums.reserve(blockcount);
+  filehashes->blockhashes.reserve(blockcount);
+
+  // Several blocks are read at once and their MD5 hashes are computed
+  // together in vector lanes; the buffer is limited to 16 MB
+  static const MD5Lanes::Impl impl = MD5Lanes::BestImpl();
+  size_t groupsize = (size_t)max((u64)1, min((u64)MD5Lanes::Lanes(impl), 16*1024*1024 / blocksize));
+
+  u8 *buffer = new u8[groupsize * (size_t)blocksize];
+  MD5Hash hashes[16];
+
+  MD5Context contextfull;
+  MD5Context context16k;
+
+  bool success = true;
+  for (u64 offset = 0; offset < filesize; offset += groupsize * blocksize)
+  {
+    size_t length = (size_t)min(groupsize * blocksize, filesize-offset);
+
+    if (cancelled || !diskfile.Read(offset, buffer, length))
+    {
+      success = false;
+      break;
+    }
+
+    // The hashes of the whole file and of the first 16k
+    if (offset < 16384)
+    {
+      context16k.Update(buffer, (size_t)min((u64)length, 16384-offset));
+    }
+    contextfull.Update(buffer, length);
+
+    // The CRC and hash of the blocks; a short block is padded with zeros
+    size_t count = (size_t)((length + blocksize - 1) / blocksize);
+    memset(buffer + length, 0, count * (size_t)blocksize - length);
+
+    for (size_t i = 0; i < count; i++)
+    {
+      u32 checksum = CRCUpdateBlock(~0, (size_t)blocksize, buffer + i * (size_t)blocksize);
+      filehashes->blockchecksums.push_back(~0 ^ checksum);
+    }
+
+    MD5Lanes::Hash(impl, buffer, (size_t)blocksize, (size_t)blocksize, count, hashes);
+    filehashes->blockhashes.insert(filehashes->blockhashes.end(), hashes, hashes + count);
+  }
+
+  delete [] buffer;
+  diskfile.Close();
+
+  if (success)
+  {
+    context16k.Final(filehashes->hash16k);
+    contextfull.Final(filehashes->hashfull);
+    filehashes->computed = true;
+  }
+
+  return success;
+}
+
+FileHashes* Par2Repairer::FindFileHashes(string filename)
+{
+  for (vector<FileHashes*>::iterator fh = hashedfiles.begin(); fh != hashedfiles.end(); ++fh)
+  {
+    if ((*fh)->filename == filename)
+      return *fh;
+  }
+
+  return 0;
+}
+
+void Par2Repairer::ClearFileHashes(void)
+{
+  for (vector<FileHashes*>::iterator fh = hashedfiles.begin(); fh != hashedfiles.end(); ++fh)
+  {
+    delete *fh;
+  }
+
+  hashedfiles.clear();
+}
+
 // Attempt to match the data in the DiskFile with the source file
 bool Par2Repairer::VerifyDataFile(DiskFile *diskfile, Par2RepairerSourceFile *sourcefile)
 {
@@ -1575,7 +1732,8 @@ bool Par2Repairer::ScanDataFile(DiskFile                *diskfile,    // [in]
   }
 
   // Create the checksummer for the file and start reading from it
-  FileCheckSummer filechecksummer(diskfile, blocksize, windowtable, windowmask);
+  FileCheckSummer filechecksummer(diskfile, blocksize, windowtable, windowmask,
+                                  currenthashes != 0 && currenthashes->filename == diskfile->FileName() ? currenthashes : 0);
   if (!filechecksummer.Start())
     return false;
 
@@ -2244,19 +2402,27 @@ bool Par2Repairer::ComputeRSmatrix(void)
 // Allocate memory buffers for reading and writing data to disk.
 bool Par2Repairer::AllocateBuffers(size_t memorylimit)
 {
+  // Several input blocks are read at once to be processed together,
+  // but not so many that the data must be processed in more chunks
+  inputsperpass = max((u32)1, min(tileinputs, (u32)inputblocks.size()));
+
   // Would single pass processing use too much memory
   if (blocksize * missingblockcount > memorylimit)
   {
+    inputsperpass = max((u32)1, min(inputsperpass, missingblockcount / 8));
+
     // Pick a size that is small enough
-    chunksize = ~3 & (memorylimit / missingblockcount);
+    chunksize = ~3 & (memorylimit / (missingblockcount + inputsperpass));
   }
   else
   {
     chunksize = (size_t)blocksize;
+
+    inputsperpass = max((u32)1, min(inputsperpass, (u32)((memorylimit - blocksize * missingblockcount) / blocksize)));
   }
 
   // Allocate the two buffers
-  inputbuffer = new u8[(size_t)chunksize];
+  inputbuffer = new u8[(size_t)chunksize * inputsperpass];
   outputbuffer = new u8[(size_t)chunksize * missingblockcount];
 
   if (inputbuffer == NULL || outputbuffer == NULL)
@@ -2285,63 +2451,85 @@ bool Par2Repairer::ProcessData(u64 blockoffset, size_t blocklength)
   // Are there any blocks which need to be reconstructed
   if (missingblockcount > 0)
   {
-    // For each input block
-    while (inputblock != inputblocks.end())       
+    // For each group of input blocks
+    while (inputblock != inputblocks.end())
     {
-      // Are we reading from a new file?
-      if (lastopenfile != (*inputblock)->GetDiskFile())
+      u32 inputcount = 0;
+
+      // Read as many input blocks as are processed together
+      while (inputblock != inputblocks.end() && inputcount < inputsperpass)
       {
-        // Close the last file
-        if (lastopenfile != NULL)
+        // Are we reading from a new file?
+        if (lastopenfile != (*inputblock)->GetDiskFile())
         {
-          lastopenfile->Close();
-        }
+          // Close the last file
+          if (lastopenfile != NULL)
+          {
+            lastopenfile->Close();
+          }
 
-        // Open the new file
-        lastopenfile = (*inputblock)->GetDiskFile();
-        if (!lastopenfile->Open())
-        {
-          return false;
+          // Open the new file
+          lastopenfile = (*inputblock)->GetDiskFile();
+          if (!lastopenfile->Open())
+          {
+            return false;
+          }
         }
-      }
 
-      // Read data from the current input block
-      if (!(*inputblock)->ReadData(blockoffset, blocklength, inputbuffer))
-        return false;
+        // Select the appropriate part of the input buffer
+        void *inbuf = &((u8*)inputbuffer)[chunksize * inputcount];
 
-      // Have we reached the last source data block
-      if (copyblock != copyblocks.end())
-      {
-        // Does this block need to be copied to the target file
-        if ((*copyblock)->IsSet())
+        // Read data from the current input block
+        if (!(*inputblock)->ReadData(blockoffset, blocklength, inbuf))
+          return false;
+
+        // Have we reached the last source data block
+        if (copyblock != copyblocks.end())
         {
-          size_t wrote;
+          // Does this block need to be copied to the target file
+          if ((*copyblock)->IsSet())
+          {
+            size_t wrote;
 
-          // Write the block back to disk in the new target file
-          if (!(*copyblock)->WriteData(blockoffset, blocklength, inputbuffer, wrote))
-            return false;
+            // Write the block back to disk in the new target file
+            if (!(*copyblock)->WriteData(blockoffset, blocklength, inbuf, wrote))
+              return false;
 
-          totalwritten += wrote;
+            totalwritten += wrote;
+          }
+          ++copyblock;
         }
-        ++copyblock;
+
+        ++inputblock;
+        ++inputcount;
+      }
+
+      // Let the system read the next input blocks while these are processed
+      vector<DataBlock*>::iterator nextblock = inputblock;
+      for (u32 nextcount = 0; nextblock != inputblocks.end() && nextcount < inputsperpass; ++nextblock, ++nextcount)
+      {
+        (*nextblock)->PrefetchData(blockoffset, blocklength);
       }
 
-      if (!RepairData(inputindex, blocklength))
+      if (!RepairData(inputindex, inputcount, blocklength))
       {
-      // For each output block
-      for (u32 outputindex=0; outputindex<missingblockcount; outputindex++)
+      // For each group of output blocks
+      for (u32 outputindex=0; outputindex<missingblockcount; outputindex+=tileoutputs)
       {
+        u32 outputcount = min(tileoutputs, missingblockcount-outputindex);
+
         // Select the appropriate part of the output buffer
         void *outbuf = &((u8*)outputbuffer)[chunksize * outputindex];
 
         // Process the data
-        rs.Process(blocklength, inputindex, inputbuffer, outputindex, outbuf);
+        rs.ProcessBlocks(blocklength, inputindex, inputcount, inputbuffer, (size_t)chunksize,
+          outputindex, outputcount, outbuf, (size_t)chunksize, tilesize);
 
         if (noiselevel > CommandLine::nlQuiet)
         {
           // Update a progress indicator
           u32 oldfraction = (u32)(1000 * progress / totaldata);
-          progress += blocklength;
+          progress += (u64)blocklength * inputcount * outputcount;
           u32 newfraction = (u32)(1000 * progress / totaldata);
 
           if (oldfraction != newfraction)
@@ -2363,8 +2551,7 @@ bool Par2Repairer::ProcessData(u64 blockoffset, size_t blocklength)
         break;
       }
 
-      ++inputblock;
-      ++inputindex;
+      inputindex += inputcount;
     }
   }
   else
@@ -31,6 +31,10 @@ public:
   Result PreProcess(const CommandLine &commandline);
   Result Process(const CommandLine &commandline, bool dorepair);
 
+  // Compute the hashes of a data file for the given block size; this doesn't
+  // need the par-set to be loaded and can be done before the verification.
+  static bool ComputeFileHashes(FileHashes *filehashes, u64 blocksize, const bool &cancelled);
+
 protected:
   // Steps in verifying and repairing files:
 
@@ -81,6 +85,14 @@ protected:
   // Attempt to match the data in the DiskFile with the source file
   bool VerifyDataFile(DiskFile *diskfile, Par2RepairerSourceFile *sourcefile);
 
+  // Compute the hashes of a data file in advance of its verification. The
+  // file is only read, so this can be done for several files at the same time.
+  bool ComputeFileHashes(FileHashes *filehashes) { return ComputeFileHashes(filehashes, blocksize, cancelled); }
+
+  // Find the hashes computed in advance for a file and free them
+  FileHashes* FindFileHashes(string filename);
+  void ClearFileHashes(void);
+
   // Perform a sliding window scan of the DiskFile looking for blocks of data that 
   // might belong to any of the source files (for which a verification packet was
   // available). If a block of data might be from more than one source file, prefer
@@ -109,7 +121,7 @@ protected:
   // Work out which data blocks are available, which need to be copied
   // directly to the output, and which need to be recreated, and compute
   // the appropriate Reed Solomon matrix.
-  bool ComputeRSmatrix(void);
+  virtual bool ComputeRSmatrix(void);
 
   // Allocate memory buffers for reading and writing data to disk.
   bool AllocateBuffers(size_t memorylimit);
@@ -129,14 +141,19 @@ protected:
   virtual void sig_headers(ParHeaders* headers) {}
   virtual void sig_done(std::string filename, int available, int total) {}
 
+  // Compute the hashes of the next "hashbatchsize" data files before they are
+  // verified one after another (the default routine hashes them one by one)
+  virtual void HashDataFiles(vector<FileHashes*> &files);
+
   // Repair started
   virtual void BeginRepair() {}
 
   // Repair ended
   virtual void EndRepair() {}
 
-  // Repair chunk of data (returns "true" if repaired or "false" if default repair-routine should be used)
-  virtual bool RepairData(u32 inputindex, size_t blocklength) { return false; }
+  // Repair chunk of data of "inputcount" input blocks starting with "inputindex"
+  // (returns "true" if repaired or "false" if default repair-routine should be used)
+  virtual bool RepairData(u32 inputindex, u32 inputcount, size_t blocklength) { return false; }
 
 protected:
   ParHeaders* headers;                                 // Headers
@@ -175,6 +192,10 @@ protected:
   VerificationHashTable           verificationhashtable;   // Hash table for block verification
   list<Par2RepairerSourceFile*>   unverifiablesourcefiles; // Files that are not block verifiable
 
+  u32                             hashbatchsize;           // How many files are hashed in advance (0 - none)
+  vector<FileHashes*>             hashedfiles;             // The files hashed in advance
+  FileHashes                     *currenthashes;           // Hashes for the file being scanned
+
   u32                       completefilecount;       // How many files are fully verified
   u32                       renamedfilecount;        // How many files are verified but have the wrong name
   u32                       damagedfilecount;        // How many files exist but are damaged
@@ -186,9 +207,14 @@ protected:
 
   ReedSolomon<Galois16>     rs;                      // The Reed Solomon matrix.
 
-  void                     *inputbuffer;             // Buffer for reading DataBlocks (chunksize)
+  void                     *inputbuffer;             // Buffer for reading DataBlocks (chunksize * inputsperpass)
   void                     *outputbuffer;            // Buffer for writing DataBlocks (chunksize * missingblockcount)
 
+  u32                       inputsperpass;           // How many input blocks are read before they are processed
+  u32                       tileinputs;              // Max. number of input blocks processed together
+  u32                       tileoutputs;             // Number of output blocks processed together
+  size_t                    tilesize;                // How much of a block is processed at once (see ReedSolomon::ProcessBlocks)
+
   u64                       progress;                // How much data has been processed.
   u64                       totaldata;               // Total amount of data to be processed.
   u64                       totalsize;               // Total data size
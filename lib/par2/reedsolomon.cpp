@@ -19,6 +19,7 @@
 
 #include "nzbget.h"
 #include "par2cmdline.h"
+#include "Util.h"
 
 #ifdef _MSC_VER
 #ifdef _DEBUG
@@ -182,6 +183,17 @@ template <> bool ReedSolomon<Galois8>::Process(size_t size, u32 inputindex, cons
   return eSuccess;
 }
 
+template <> void ReedSolomon<Galois8>::MultiplyAddRow(Galois8 factor, const Galois8 *src, Galois8 *dst, unsigned int count)
+{
+  for (unsigned int col=0; col<count; col++)
+  {
+    if (src[col] != 0)
+    {
+      dst[col] -= src[col] * factor;
+    }
+  }
+}
+
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////
@@ -268,6 +280,346 @@ template <> bool ReedSolomon<Galois16>::SetInput(u32 count)
   return true;
 }
 
+// Multiplication by a constant is linear over GF(2): the product of the
+// factor with a 16-bit value is the sum of the products with its four
+// nibbles. The vector kernels look up these partial products with byte
+// shuffles; tables[0..3] hold the low bytes and tables[4..7] the high
+// bytes of the products for the nibbles at bit positions 0, 4, 8 and 12.
+
+static void BuildNibbleTables(Galois16 factor, u8 tables[8][16])
+{
+  for (unsigned int pos=0; pos<4; pos++)
+  {
+    // The products with the four bits of the nibble, the products with
+    // all nibble values are sums of these
+    u16 bits[4];
+    for (unsigned int bit=0; bit<4; bit++)
+    {
+      bits[bit] = factor * Galois16((u16)(1 << (pos*4 + bit)));
+    }
+
+    for (unsigned int nibble=0; nibble<16; nibble++)
+    {
+      u16 product = 0;
+      for (unsigned int bit=0; bit<4; bit++)
+      {
+        if (nibble & (1 << bit))
+          product ^= bits[bit];
+      }
+      tables[pos][nibble] = (u8)(product & 0xff);
+      tables[pos+4][nibble] = (u8)(product >> 8);
+    }
+  }
+}
+
+#ifdef HAVE_X86_SIMD
+
+// The low and high bytes of the values are separated with saturating packs
+// so that each shuffle covers one byte per value; unpacking the results
+// restores the original order (per 128-bit lane for the wider vectors).
+
+__attribute__((target("ssse3")))
+static size_t MultiplyAddSsse3(Galois16 factor, const u8 *src, u8 *dst, size_t size)
+{
+  u8 tables[8][16];
+  BuildNibbleTables(factor, tables);
+
+  __m128i tl0 = _mm_loadu_si128((const __m128i*)tables[0]);
+  __m128i tl1 = _mm_loadu_si128((const __m128i*)tables[1]);
+  __m128i tl2 = _mm_loadu_si128((const __m128i*)tables[2]);
+  __m128i tl3 = _mm_loadu_si128((const __m128i*)tables[3]);
+  __m128i th0 = _mm_loadu_si128((const __m128i*)tables[4]);
+  __m128i th1 = _mm_loadu_si128((const __m128i*)tables[5]);
+  __m128i th2 = _mm_loadu_si128((const __m128i*)tables[6]);
+  __m128i th3 = _mm_loadu_si128((const __m128i*)tables[7]);
+  const __m128i nibbles = _mm_set1_epi8(0x0f);
+  const __m128i lowbytes = _mm_set1_epi16(0x00ff);
+
+  size_t count = size & ~(size_t)31;
+  for (size_t i=0; i<count; i+=32)
+  {
+    __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 16));
+    __m128i lo = _mm_packus_epi16(_mm_and_si128(a, lowbytes), _mm_and_si128(b, lowbytes));
+    __m128i hi = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+
+    __m128i n0 = _mm_and_si128(lo, nibbles);
+    __m128i n1 = _mm_and_si128(_mm_srli_epi16(lo, 4), nibbles);
+    __m128i n2 = _mm_and_si128(hi, nibbles);
+    __m128i n3 = _mm_and_si128(_mm_srli_epi16(hi, 4), nibbles);
+
+    __m128i rl = _mm_xor_si128(_mm_xor_si128(_mm_shuffle_epi8(tl0, n0), _mm_shuffle_epi8(tl1, n1)),
+                               _mm_xor_si128(_mm_shuffle_epi8(tl2, n2), _mm_shuffle_epi8(tl3, n3)));
+    __m128i rh = _mm_xor_si128(_mm_xor_si128(_mm_shuffle_epi8(th0, n0), _mm_shuffle_epi8(th1, n1)),
+                               _mm_xor_si128(_mm_shuffle_epi8(th2, n2), _mm_shuffle_epi8(th3, n3)));
+
+    __m128i *d = (__m128i*)(dst + i);
+    _mm_storeu_si128(d, _mm_xor_si128(_mm_loadu_si128(d), _mm_unpacklo_epi8(rl, rh)));
+    _mm_storeu_si128(d + 1, _mm_xor_si128(_mm_loadu_si128(d + 1), _mm_unpackhi_epi8(rl, rh)));
+  }
+
+  return count;
+}
+
+__attribute__((target("avx2")))
+static size_t MultiplyAddAvx2(Galois16 factor, const u8 *src, u8 *dst, size_t size)
+{
+  u8 tables[8][16];
+  BuildNibbleTables(factor, tables);
+
+  __m256i tl0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)tables[0]));
+  __m256i tl1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)tables[1]));
+  __m256i tl2 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)tables[2]));
+  __m256i tl3 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)tables[3]));
+  __m256i th0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)tables[4]));
+  __m256i th1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)tables[5]));
+  __m256i th2 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)tables[6]));
+  __m256i th3 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)tables[7]));
+  const __m256i nibbles = _mm256_set1_epi8(0x0f);
+  const __m256i lowbytes = _mm256_set1_epi16(0x00ff);
+
+  size_t count = size & ~(size_t)63;
+  for (size_t i=0; i<count; i+=64)
+  {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 32));
+    __m256i lo = _mm256_packus_epi16(_mm256_and_si256(a, lowbytes), _mm256_and_si256(b, lowbytes));
+    __m256i hi = _mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+
+    __m256i n0 = _mm256_and_si256(lo, nibbles);
+    __m256i n1 = _mm256_and_si256(_mm256_srli_epi16(lo, 4), nibbles);
+    __m256i n2 = _mm256_and_si256(hi, nibbles);
+    __m256i n3 = _mm256_and_si256(_mm256_srli_epi16(hi, 4), nibbles);
+
+    __m256i rl = _mm256_xor_si256(_mm256_xor_si256(_mm256_shuffle_epi8(tl0, n0), _mm256_shuffle_epi8(tl1, n1)),
+                                  _mm256_xor_si256(_mm256_shuffle_epi8(tl2, n2), _mm256_shuffle_epi8(tl3, n3)));
+    __m256i rh = _mm256_xor_si256(_mm256_xor_si256(_mm256_shuffle_epi8(th0, n0), _mm256_shuffle_epi8(th1, n1)),
+                                  _mm256_xor_si256(_mm256_shuffle_epi8(th2, n2), _mm256_shuffle_epi8(th3, n3)));
+
+    __m256i *d = (__m256i*)(dst + i);
+    _mm256_storeu_si256(d, _mm256_xor_si256(_mm256_loadu_si256(d), _mm256_unpacklo_epi8(rl, rh)));
+    _mm256_storeu_si256(d + 1, _mm256_xor_si256(_mm256_loadu_si256(d + 1), _mm256_unpackhi_epi8(rl, rh)));
+  }
+
+  return count;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t MultiplyAddAvx512(Galois16 factor, const u8 *src, u8 *dst, size_t size)
+{
+  u8 tables[8][16];
+  BuildNibbleTables(factor, tables);
+
+  // zero-masked broadcasts with a full mask: the unmasked forms merge into an
+  // undefined vector and give false "used uninitialized" warnings with GCC
+  __m512i tl0 = _mm512_maskz_broadcast_i32x4(0xffff, _mm_loadu_si128((const __m128i*)tables[0]));
+  __m512i tl1 = _mm512_maskz_broadcast_i32x4(0xffff, _mm_loadu_si128((const __m128i*)tables[1]));
+  __m512i tl2 = _mm512_maskz_broadcast_i32x4(0xffff, _mm_loadu_si128((const __m128i*)tables[2]));
+  __m512i tl3 = _mm512_maskz_broadcast_i32x4(0xffff, _mm_loadu_si128((const __m128i*)tables[3]));
+  __m512i th0 = _mm512_maskz_broadcast_i32x4(0xffff, _mm_loadu_si128((const __m128i*)tables[4]));
+  __m512i th1 = _mm512_maskz_broadcast_i32x4(0xffff, _mm_loadu_si128((const __m128i*)tables[5]));
+  __m512i th2 = _mm512_maskz_broadcast_i32x4(0xffff, _mm_loadu_si128((const __m128i*)tables[6]));
+  __m512i th3 = _mm512_maskz_broadcast_i32x4(0xffff, _mm_loadu_si128((const __m128i*)tables[7]));
+  const __m512i nibbles = _mm512_set1_epi8(0x0f);
+  const __m512i lowbytes = _mm512_set1_epi16(0x00ff);
+
+  size_t count = size & ~(size_t)127;
+  for (size_t i=0; i<count; i+=128)
+  {
+    __m512i a = _mm512_loadu_si512((const void*)(src + i));
+    __m512i b = _mm512_loadu_si512((const void*)(src + i + 64));
+    __m512i lo = _mm512_packus_epi16(_mm512_and_si512(a, lowbytes), _mm512_and_si512(b, lowbytes));
+    __m512i hi = _mm512_packus_epi16(_mm512_srli_epi16(a, 8), _mm512_srli_epi16(b, 8));
+
+    __m512i n0 = _mm512_and_si512(lo, nibbles);
+    __m512i n1 = _mm512_and_si512(_mm512_srli_epi16(lo, 4), nibbles);
+    __m512i n2 = _mm512_and_si512(hi, nibbles);
+    __m512i n3 = _mm512_and_si512(_mm512_srli_epi16(hi, 4), nibbles);
+
+    __m512i rl = _mm512_xor_si512(_mm512_xor_si512(_mm512_shuffle_epi8(tl0, n0), _mm512_shuffle_epi8(tl1, n1)),
+                                  _mm512_xor_si512(_mm512_shuffle_epi8(tl2, n2), _mm512_shuffle_epi8(tl3, n3)));
+    __m512i rh = _mm512_xor_si512(_mm512_xor_si512(_mm512_shuffle_epi8(th0, n0), _mm512_shuffle_epi8(th1, n1)),
+                                  _mm512_xor_si512(_mm512_shuffle_epi8(th2, n2), _mm512_shuffle_epi8(th3, n3)));
+
+    u8 *d = dst + i;
+    _mm512_storeu_si512((void*)d, _mm512_xor_si512(_mm512_loadu_si512((const void*)d), _mm512_unpacklo_epi8(rl, rh)));
+    _mm512_storeu_si512((void*)(d + 64), _mm512_xor_si512(_mm512_loadu_si512((const void*)(d + 64)), _mm512_unpackhi_epi8(rl, rh)));
+  }
+
+  return count;
+}
+
+#ifdef bit_GFNI
+// GF2P8AFFINEQB multiplies each byte by an 8x8 bit matrix. Multiplication
+// by the factor is a 16x16 bit matrix, it is applied as four 8x8 blocks:
+// (low byte, high byte) of the input to (low byte, high byte) of the output.
+// Row i of a block (the byte 7-i of the qword) selects the input bits which
+// contribute to output bit i.
+
+static u64 AffineMatrix(const u16 *columns, unsigned int outshift)
+{
+  u64 matrix = 0;
+  for (unsigned int i=0; i<8; i++)
+  {
+    u64 row = 0;
+    for (unsigned int j=0; j<8; j++)
+    {
+      row |= (u64)((columns[j] >> (outshift + i)) & 1) << j;
+    }
+    matrix |= row << ((7 - i) * 8);
+  }
+  return matrix;
+}
+
+__attribute__((target("avx2,gfni")))
+static size_t MultiplyAddGfni(Galois16 factor, const u8 *src, u8 *dst, size_t size)
+{
+  // Products of the factor with the 16 unit vectors
+  u16 columns[16];
+  for (unsigned int j=0; j<16; j++)
+  {
+    columns[j] = factor * Galois16((u16)(1 << j));
+  }
+
+  const __m256i mll = _mm256_set1_epi64x((long long)AffineMatrix(&columns[0], 0));
+  const __m256i mhl = _mm256_set1_epi64x((long long)AffineMatrix(&columns[8], 0));
+  const __m256i mlh = _mm256_set1_epi64x((long long)AffineMatrix(&columns[0], 8));
+  const __m256i mhh = _mm256_set1_epi64x((long long)AffineMatrix(&columns[8], 8));
+  const __m256i lowbytes = _mm256_set1_epi16(0x00ff);
+
+  size_t count = size & ~(size_t)63;
+  for (size_t i=0; i<count; i+=64)
+  {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 32));
+    __m256i lo = _mm256_packus_epi16(_mm256_and_si256(a, lowbytes), _mm256_and_si256(b, lowbytes));
+    __m256i hi = _mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+
+    __m256i rl = _mm256_xor_si256(_mm256_gf2p8affine_epi64_epi8(lo, mll, 0),
+                                  _mm256_gf2p8affine_epi64_epi8(hi, mhl, 0));
+    __m256i rh = _mm256_xor_si256(_mm256_gf2p8affine_epi64_epi8(lo, mlh, 0),
+                                  _mm256_gf2p8affine_epi64_epi8(hi, mhh, 0));
+
+    __m256i *d = (__m256i*)(dst + i);
+    _mm256_storeu_si256(d, _mm256_xor_si256(_mm256_loadu_si256(d), _mm256_unpacklo_epi8(rl, rh)));
+    _mm256_storeu_si256(d + 1, _mm256_xor_si256(_mm256_loadu_si256(d + 1), _mm256_unpackhi_epi8(rl, rh)));
+  }
+
+  return count;
+}
+#endif /* bit_GFNI */
+
+#endif /* HAVE_X86_SIMD */
+
+#if defined(HAVE_ARM_SIMD) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+static size_t MultiplyAddNeon(Galois16 factor, const u8 *src, u8 *dst, size_t size)
+{
+  u8 tables[8][16];
+  BuildNibbleTables(factor, tables);
+
+  uint8x16_t tl0 = vld1q_u8(tables[0]);
+  uint8x16_t tl1 = vld1q_u8(tables[1]);
+  uint8x16_t tl2 = vld1q_u8(tables[2]);
+  uint8x16_t tl3 = vld1q_u8(tables[3]);
+  uint8x16_t th0 = vld1q_u8(tables[4]);
+  uint8x16_t th1 = vld1q_u8(tables[5]);
+  uint8x16_t th2 = vld1q_u8(tables[6]);
+  uint8x16_t th3 = vld1q_u8(tables[7]);
+  const uint8x16_t nibbles = vdupq_n_u8(0x0f);
+
+  size_t count = size & ~(size_t)31;
+  for (size_t i=0; i<count; i+=32)
+  {
+    // De-interleaving load: val[0] gets the low bytes, val[1] the high bytes
+    uint8x16x2_t s = vld2q_u8(src + i);
+
+    uint8x16_t n0 = vandq_u8(s.val[0], nibbles);
+    uint8x16_t n1 = vshrq_n_u8(s.val[0], 4);
+    uint8x16_t n2 = vandq_u8(s.val[1], nibbles);
+    uint8x16_t n3 = vshrq_n_u8(s.val[1], 4);
+
+    uint8x16x2_t d = vld2q_u8(dst + i);
+    d.val[0] = veorq_u8(d.val[0], veorq_u8(veorq_u8(vqtbl1q_u8(tl0, n0), vqtbl1q_u8(tl1, n1)),
+                                           veorq_u8(vqtbl1q_u8(tl2, n2), vqtbl1q_u8(tl3, n3))));
+    d.val[1] = veorq_u8(d.val[1], veorq_u8(veorq_u8(vqtbl1q_u8(th0, n0), vqtbl1q_u8(th1, n1)),
+                                           veorq_u8(vqtbl1q_u8(th2, n2), vqtbl1q_u8(th3, n3))));
+    vst2q_u8(dst + i, d);
+  }
+
+  return count;
+}
+#endif
+
+const char *Galois16Vector::ImplNames[] = { "table", "SSSE3", "AVX2", "AVX-512", "GFNI", "NEON" };
+
+bool Galois16Vector::IsSupported(Impl impl)
+{
+  switch (impl)
+  {
+  case eTable:
+    return true;
+#ifdef HAVE_X86_SIMD
+  case eSsse3:
+    return CpuFeatures::HasSsse3();
+  case eAvx2:
+    return CpuFeatures::HasAvx2();
+  case eAvx512:
+    return CpuFeatures::HasAvx512bw();
+#ifdef bit_GFNI
+  case eGfni:
+    return CpuFeatures::HasGfni() && CpuFeatures::HasAvx2();
+#endif
+#endif
+#if defined(HAVE_ARM_SIMD) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  case eNeon:
+    return CpuFeatures::HasNeon();
+#endif
+  default:
+    return false;
+  }
+}
+
+Galois16Vector::Impl Galois16Vector::BestImpl(void)
+{
+  const Impl preferred[] = { eAvx512, eGfni, eAvx2, eSsse3, eNeon };
+  for (unsigned int i=0; i<sizeof(preferred)/sizeof(Impl); i++)
+  {
+    if (IsSupported(preferred[i]))
+    {
+      return preferred[i];
+    }
+  }
+  return eTable;
+}
+
+size_t Galois16Vector::MultiplyAdd(Impl impl, Galois16 factor, const void *inputbuffer, void *outputbuffer, size_t size)
+{
+  const u8 *src = (const u8*)inputbuffer;
+  u8 *dst = (u8*)outputbuffer;
+
+  switch (impl)
+  {
+#ifdef HAVE_X86_SIMD
+  case eSsse3:
+    return MultiplyAddSsse3(factor, src, dst, size);
+  case eAvx2:
+    return MultiplyAddAvx2(factor, src, dst, size);
+  case eAvx512:
+    return MultiplyAddAvx512(factor, src, dst, size);
+#ifdef bit_GFNI
+  case eGfni:
+    return MultiplyAddGfni(factor, src, dst, size);
+#endif
+#endif
+#if defined(HAVE_ARM_SIMD) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  case eNeon:
+    return MultiplyAddNeon(factor, src, dst, size);
+#endif
+  default:
+    return 0;
+  }
+}
+
 template <> bool ReedSolomon<Galois16>::Process(size_t size, u32 inputindex, const void *inputbuffer, u32 outputindex, void *outputbuffer)
 {
   // Look up the appropriate element in the RS matrix
@@ -277,6 +629,16 @@ template <> bool ReedSolomon<Galois16>::Process(size_t size, u32 inputindex, con
   if (factor == 0)
     return eSuccess;
 
+  // Process as much of the data as possible with vector instructions
+  static const Galois16Vector::Impl impl = Galois16Vector::BestImpl();
+  size_t done = Galois16Vector::MultiplyAdd(impl, factor, inputbuffer, outputbuffer, size);
+  if (done == size)
+    return eSuccess;
+
+  inputbuffer = &((const u8*)inputbuffer)[done];
+  outputbuffer = &((u8*)outputbuffer)[done];
+  size -= done;
+
 #ifdef LONGMULTIPLY
   // The 8-bit long multiplication tables
   Galois16 *table = glmt->tables;
@@ -370,3 +732,18 @@ template <> bool ReedSolomon<Galois16>::Process(size_t size, u32 inputindex, con
   return eSuccess;
 }
 
+template <> void ReedSolomon<Galois16>::MultiplyAddRow(Galois16 factor, const Galois16 *src, Galois16 *dst, unsigned int count)
+{
+  // In GF(2^16) subtraction is the same as addition, the rows are
+  // therefore processed like data blocks, with vector instructions
+  static const Galois16Vector::Impl impl = Galois16Vector::BestImpl();
+  unsigned int col = (unsigned int)(Galois16Vector::MultiplyAdd(impl, factor, src, dst, count * sizeof(Galois16)) / sizeof(Galois16));
+
+  for (; col<count; col++)
+  {
+    if (src[col] != 0)
+    {
+      dst[col] -= src[col] * factor;
+    }
+  }
+}
@@ -38,6 +38,58 @@ public:
   u16 exponent;
 };
 
+// The Galois16Vector object multiplies a block of 16-bit Galois values by
+// a constant factor and adds the result to an output block using vector
+// instructions. The best implementation for the CPU is chosen at runtime.
+// Only whole vectors are processed, the remaining bytes at the end of the
+// block are left to the table driven code in ReedSolomon::Process.
+
+class Galois16Vector
+{
+public:
+  enum Impl
+  {
+    eTable,
+    eSsse3,
+    eAvx2,
+    eAvx512,
+    eGfni,
+    eNeon
+  };
+
+  static const char *ImplNames[];
+
+  static bool IsSupported(Impl impl);
+  static Impl BestImpl(void);
+
+  // Returns the number of bytes processed
+  static size_t MultiplyAdd(Impl impl,
+                            Galois16 factor,
+                            const void *inputbuffer,
+                            void *outputbuffer,
+                            size_t size);
+};
+
+// During the Gaussian elimination the pivot row is subtracted from every
+// other row of the matrices. The rows are independent of each other: if an
+// RSRowRunner is set, each pivot step is passed to it as an RSRowJob and the
+// runner executes the ranges of rows (possibly in several threads) and
+// returns when all rows are done.
+
+class RSRowJob
+{
+public:
+  virtual ~RSRowJob(void) {}
+  virtual void Execute(u32 begin, u32 end) = 0;
+};
+
+class RSRowRunner
+{
+public:
+  virtual ~RSRowRunner(void) {}
+  virtual void Run(RSRowJob *job, u32 count) = 0;
+};
+
 template<class g>
 class ReedSolomon
 {
@@ -58,6 +110,9 @@ public:
   // Compute the RS Matrix
   bool Compute(CommandLine::NoiseLevel noiselevel);
 
+  // Set the runner used to eliminate the rows of the matrix (0 = sequential)
+  void SetRowRunner(RSRowRunner *runner) { rowrunner = runner; }
+
   // Process a block of data
   bool Process(size_t size,             // The size of the block of data
                u32 inputindex,          // The column in the RS matrix
@@ -65,6 +120,21 @@ public:
                u32 outputindex,         // The row in the RS matrix
                void *outputbuffer);     // Buffer containing output data
 
+  // Process several input blocks into several output blocks. The blocks
+  // are processed in tiles of "tilesize" bytes: the input data of a tile
+  // stays in the cache while all output blocks are computed from it and
+  // each output tile stays in the cache while all inputs are added to it.
+  void ProcessBlocks(size_t size,             // The size of each block of data
+                     u32 inputindex,          // The column of the first input block
+                     u32 inputcount,          // The number of input blocks
+                     const void *inputbuffer, // Buffer containing input data
+                     size_t inputstride,      // Distance between input blocks in the buffer
+                     u32 outputindex,         // The row of the first output block
+                     u32 outputcount,         // The number of output blocks
+                     void *outputbuffer,      // Buffer containing output data
+                     size_t outputstride,     // Distance between output blocks in the buffer
+                     size_t tilesize);        // Size of a tile, multiple of 4
+
 protected:
   // Perform Gaussian Elimination
   bool GaussElim(CommandLine::NoiseLevel noiselevel,
@@ -74,6 +144,30 @@ protected:
                  G *rightmatrix, 
                  unsigned int datamissing);
 
+  // Subtract the row "src" multiplied by "factor" from the row "dst"
+  void MultiplyAddRow(G factor, const G *src, G *dst, unsigned int count);
+
+  // One pivot step of the Gaussian elimination
+  class EliminationJob : public RSRowJob
+  {
+  public:
+    EliminationJob(ReedSolomon<g> *_rs, unsigned int _row, unsigned int _rows, unsigned int _leftcols, G *_leftmatrix, G *_rightmatrix)
+      : rs(_rs), row(_row), rows(_rows), leftcols(_leftcols), leftmatrix(_leftmatrix), rightmatrix(_rightmatrix) {}
+    virtual void Execute(u32 begin, u32 end);
+
+  protected:
+    ReedSolomon<g> *rs;
+    unsigned int row;
+    unsigned int rows;
+    unsigned int leftcols;
+    G *leftmatrix;
+    G *rightmatrix;
+  };
+
+  // A pivot step is passed to the row runner only if it updates
+  // at least that many matrix elements
+  enum { MinParallelElements = 256 * 1024 };
+
 protected:
   u32 inputcount;        // Total number of input blocks
 
@@ -95,6 +189,8 @@ protected:
 
   G *leftmatrix;    // The main matrix
 
+  RSRowRunner *rowrunner; // Eliminates the rows during Gaussian elimination
+
   // When the matrices are initialised: values of the form base ^ exponent are
   // stored (where the base values are obtained from database[] and the exponent
   // values are obtained from outputrows[]).
@@ -126,6 +222,8 @@ inline ReedSolomon<g>::ReedSolomon(void)
 
   leftmatrix = 0;
 
+  rowrunner = 0;
+
 #ifdef LONGMULTIPLY
   glmt = new GaloisLongMultiplyTable<g>;
 #endif
@@ -148,6 +246,30 @@ inline ReedSolomon<g>::~ReedSolomon(void)
 
 u32 gcd(u32 a, u32 b);
 
+template<class g>
+inline void ReedSolomon<g>::ProcessBlocks(size_t size,
+                                          u32 inputindex, u32 inputcount, const void *inputbuffer, size_t inputstride,
+                                          u32 outputindex, u32 outputcount, void *outputbuffer, size_t outputstride,
+                                          size_t tilesize)
+{
+  for (size_t offset=0; offset<size; offset+=tilesize)
+  {
+    size_t length = min(tilesize, size-offset);
+
+    for (u32 output=0; output<outputcount; output++)
+    {
+      void *outbuf = &((u8*)outputbuffer)[outputstride * output + offset];
+
+      for (u32 input=0; input<inputcount; input++)
+      {
+        const void *inbuf = &((const u8*)inputbuffer)[inputstride * input + offset];
+
+        Process(length, inputindex + input, inbuf, outputindex + output, outbuf);
+      }
+    }
+  }
+}
+
 // Record whether the recovery block with the specified
 // exponent values is present or missing.
 template<class g>
@@ -417,63 +539,25 @@ inline bool ReedSolomon<g>::GaussElim(CommandLine::NoiseLevel noiselevel, unsign
       }
     }
 
-    // For every other row in the matrix
-    for (unsigned int row2=0; row2<rows; row2++)
+    if (noiselevel > CommandLine::nlQuiet)
     {
-      if (noiselevel > CommandLine::nlQuiet)
+      int newprogress = row * 1000 / datamissing;
+      if (progress != newprogress)
       {
-        int newprogress = (row*rows+row2) * 1000 / (datamissing*rows);
-        if (progress != newprogress)
-        {
-          progress = newprogress;
-          cout << "Solving: " << progress/10 << '.' << progress%10 << "%\r" << flush;
-        }
+        progress = newprogress;
+        cout << "Solving: " << progress/10 << '.' << progress%10 << "%\r" << flush;
       }
+    }
 
-      if (row != row2)
-      {
-        // Get the scaling factor for this row.
-        G scalevalue = rightmatrix[row2 * rows + row];
-
-        if (scalevalue == 1)
-        {
-          // If the scaling factor happens to be 1, just subtract rows
-          for (unsigned int col=0; col<leftcols; col++)
-          {
-            if (leftmatrix[row * leftcols + col] != 0)
-            {
-              leftmatrix[row2 * leftcols + col] -= leftmatrix[row * leftcols + col];
-            }
-          }
-
-          for (unsigned int col=row; col<rows; col++)
-          {
-            if (rightmatrix[row * rows + col] != 0)
-            {
-              rightmatrix[row2 * rows + col] -= rightmatrix[row * rows + col];
-            }
-          }
-        }
-        else if (scalevalue != 0)
-        {
-          // If the scaling factor is not 0, then compute accordingly.
-          for (unsigned int col=0; col<leftcols; col++)
-          {
-            if (leftmatrix[row * leftcols + col] != 0)
-            {
-              leftmatrix[row2 * leftcols + col] -= leftmatrix[row * leftcols + col] * scalevalue;
-            }
-          }
-
-          for (unsigned int col=row; col<rows; col++)
-          {
-            if (rightmatrix[row * rows + col] != 0)
-            {
-              rightmatrix[row2 * rows + col] -= rightmatrix[row * rows + col] * scalevalue;
-            }
-          }
-        }
-      }
+    // Subtract the pivot row from every other row in the matrix
+    EliminationJob job(this, row, rows, leftcols, leftmatrix, rightmatrix);
+    if (rowrunner && (u64)rows * (leftcols + rows - row) >= MinParallelElements)
+    {
+      rowrunner->Run(&job, rows);
+    }
+    else
+    {
+      job.Execute(0, rows);
     }
   }
   if (noiselevel > CommandLine::nlQuiet)
@@ -506,5 +590,24 @@ inline bool ReedSolomon<g>::GaussElim(CommandLine::NoiseLevel noiselevel, unsign
   return true;
 }
 
+template<class g>
+inline void ReedSolomon<g>::EliminationJob::Execute(u32 begin, u32 end)
+{
+  for (unsigned int row2=begin; row2<end; row2++)
+  {
+    if (row2 == row)
+      continue;
+
+    // Get the scaling factor for this row.
+    G scalevalue = rightmatrix[row2 * rows + row];
+
+    // If the scaling factor is not 0, then compute accordingly.
+    if (scalevalue != 0)
+    {
+      rs->MultiplyAddRow(scalevalue, &leftmatrix[row * leftcols], &leftmatrix[row2 * leftcols], leftcols);
+      rs->MultiplyAddRow(scalevalue, &rightmatrix[row * rows + row], &rightmatrix[row2 * rows + row], rows - row);
+    }
+  }
+}
 
 #endif // __REEDSOLOMON_H__
@@ -40,7 +40,7 @@ protected:
 	virtual void		AddNewsServer(int id, bool active, const char* name, const char* host,
 							int port, const char* user, const char* pass, bool joinGroup,
 							bool tls, const char* cipher, int maxConnections, int retention,
-							int level, int group)
+							int pipelining, int level, int group)
 	{
 		m_newsServers++;
 	}
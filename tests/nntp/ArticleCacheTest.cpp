@@ -0,0 +1,215 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "ArticleWriter.h"
+#include "Options.h"
+#include "Util.h"
+#include "TestUtil.h"
+
+TEST_CASE("Article arena: size classes", "[ArticleCache][Quick]")
+{
+	REQUIRE(ArticleArena::ChunkSize(0) == ArticleArena::ClassStep);
+	REQUIRE(ArticleArena::ChunkSize(1) == ArticleArena::ClassStep);
+	REQUIRE(ArticleArena::ChunkSize(64 * 1024) == 64 * 1024);
+	REQUIRE(ArticleArena::ChunkSize(700000) == 704 * 1024);
+	REQUIRE(ArticleArena::ChunkSize(3000000) == 2944 * 1024);
+}
+
+TEST_CASE("Article arena: allocation and reuse", "[ArticleCache][Quick]")
+{
+	ArticleArena arena;
+	std::vector<char*> chunks;
+
+	// fill more than one region with articles of the same size class
+	int count = ArticleArena::RegionSize / (704 * 1024) + 1;
+	for (int i = 0; i < count; i++)
+	{
+		char* p = (char*)arena.Alloc(700000);
+		REQUIRE(p != NULL);
+		memset(p, i, 700000);
+		chunks.push_back(p);
+	}
+
+	REQUIRE(arena.GetUsedSize() == (size_t)count * 704 * 1024);
+	REQUIRE(arena.GetResidentSize() == 2 * ArticleArena::RegionSize);
+
+	for (int i = 0; i < count; i++)
+	{
+		REQUIRE(chunks[i][0] == (char)i);
+		REQUIRE(chunks[i][700000 - 1] == (char)i);
+	}
+
+	// a freed chunk is given to the next article of the same size class
+	arena.Free(chunks[3]);
+	char* p = (char*)arena.Alloc(690000);
+	REQUIRE((void*)p == (void*)chunks[3]);
+	chunks[3] = p;
+
+	// shrinking moves the article into a smaller size class
+	char* small = (char*)arena.Shrink(chunks[4], 100000);
+	REQUIRE((void*)small != (void*)chunks[4]);
+	REQUIRE(small[0] == 4);
+	REQUIRE(small[100000 - 1] == 4);
+	REQUIRE(arena.GetResidentSize() == 3 * ArticleArena::RegionSize);
+	chunks[4] = small;
+
+	// shrinking within the same size class keeps the article in place
+	REQUIRE(arena.Shrink(chunks[5], 690000) == (void*)chunks[5]);
+
+	// large articles get their own regions, returned to the OS immediately
+	char* large = (char*)arena.Alloc(3000000);
+	REQUIRE(large != NULL);
+	large[3000000 - 1] = 1;
+	REQUIRE(arena.GetResidentSize() == 3 * ArticleArena::RegionSize + 2944 * 1024);
+	arena.Free(large);
+	REQUIRE(arena.GetResidentSize() == 3 * ArticleArena::RegionSize);
+
+	for (int i = 0; i < count; i++)
+	{
+		arena.Free(chunks[i]);
+	}
+
+	// drained cache keeps no memory resident
+	REQUIRE(arena.GetUsedSize() == 0);
+	REQUIRE(arena.GetResidentSize() == 0);
+
+	// discarded regions are reused for other size classes
+	p = (char*)arena.Alloc(200000);
+	REQUIRE(p != NULL);
+	memset(p, 1, 200000);
+	REQUIRE(arena.GetResidentSize() == ArticleArena::RegionSize);
+	arena.Free(p);
+}
+
+TEST_CASE("Article arena: memory limit", "[ArticleCache][Quick]")
+{
+	const size_t limit = 10 * 1024 * 1024;
+	ArticleArena arena;
+	arena.SetLimit(limit);
+	std::vector<void*> chunks;
+
+	// regions are made smaller so that the limit isn't taken by a few of them
+	void* p;
+	while ((p = arena.Alloc(700000)) != NULL)
+	{
+		chunks.push_back(p);
+	}
+	REQUIRE(chunks.size() == limit / (704 * 1024));
+	REQUIRE(arena.GetResidentSize() <= limit);
+
+	// a new region for another size class would exceed the limit
+	REQUIRE(arena.Alloc(60000) == NULL);
+
+	// an emptied region is reused by other size classes
+	arena.Free(chunks.back());
+	chunks.pop_back();
+	p = arena.Alloc(60000);
+	REQUIRE(p != NULL);
+	REQUIRE(arena.GetResidentSize() <= limit);
+	chunks.push_back(p);
+
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		arena.Free(chunks[i]);
+	}
+	REQUIRE(arena.GetResidentSize() == 0);
+}
+
+TEST_CASE("Article cache: runs of cached segments", "[ArticleCache][Quick]")
+{
+	FileInfo fileInfo;
+	REQUIRE(fileInfo.GetCachedRunSize() == 0);
+
+	// segments arrive out of order and are joined into runs
+	fileInfo.AddCachedSegment(2000, 1000);
+	fileInfo.AddCachedSegment(0, 1000);
+	REQUIRE(fileInfo.GetCachedRunSize() == 1000);
+	fileInfo.AddCachedSegment(1000, 1000);
+	REQUIRE(fileInfo.GetCachedRunSize() == 3000);
+	fileInfo.AddCachedSegment(5000, 1000);
+	REQUIRE(fileInfo.GetCachedRunSize() == 2000);
+
+	// a segment removed from the middle splits the run
+	fileInfo.RemoveCachedSegment(1000, 1000);
+	REQUIRE(fileInfo.GetCachedRunSize() == 1000);
+	fileInfo.RemoveCachedSegment(0, 1000);
+	fileInfo.RemoveCachedSegment(2000, 1000);
+	REQUIRE(fileInfo.GetCachedRunSize() == 1000);
+
+	fileInfo.ClearCachedSegments();
+	REQUIRE(fileInfo.GetCachedRunSize() == 0);
+}
+
+TEST_CASE("Article cache: writing runs of segments", "[ArticleCache][Quick]")
+{
+	Options::CmdOptList cmdOpts;
+	Options options(&cmdOpts, NULL);
+	ArticleCache articleCache;
+	g_ArticleCache = &articleCache;
+	TestUtil::PrepareWorkingDir("ArticleCache");
+
+	// more segments than are passed to the OS in one gathering write
+	const int count = 150;
+	const int size = 1000;
+	std::vector<ArticleInfo*> articles;
+	for (int i = 0; i < count; i++)
+	{
+		char* content = (char*)articleCache.Alloc(size);
+		REQUIRE(content != NULL);
+		memset(content, 'a' + i % 26, size);
+		ArticleInfo* articleInfo = new ArticleInfo();
+		articleInfo->AttachSegment(content, 100 + i * size, size);
+		articles.push_back(articleInfo);
+	}
+
+	std::string filename = TestUtil::WorkingDir() + "/segments.out";
+	FILE* outfile = fopen(filename.c_str(), FOPEN_WB);
+	REQUIRE(outfile != NULL);
+	REQUIRE(ArticleWriter::WriteSegments(outfile, &articles[0], count));
+	fclose(outfile);
+
+	REQUIRE(Util::FileSize(filename.c_str()) == 100 + count * size);
+
+	char* buffer;
+	int length;
+	REQUIRE(Util::LoadFileIntoBuffer(filename.c_str(), &buffer, &length));
+	for (int i = 0; i < count; i++)
+	{
+		REQUIRE(buffer[100 + i * size] == 'a' + i % 26);
+		REQUIRE(buffer[100 + i * size + size - 1] == 'a' + i % 26);
+	}
+	free(buffer);
+
+	for (int i = 0; i < count; i++)
+	{
+		delete articles[i];
+	}
+	REQUIRE(articleCache.GetAllocated() == 0);
+	g_ArticleCache = NULL;
+}
@@ -0,0 +1,380 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "Decoder.h"
+#include "Util.h"
+
+// Encodes data into yEnc-lines of given length terminated with CR/LF
+static std::string YEncode(const std::string& data, int lineLen)
+{
+	std::string result;
+	int col = 0;
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		char ch = (char)(data[i] + 42);
+		if (ch == '\0' || ch == '\n' || ch == '\r' || ch == '=')
+		{
+			result += '=';
+			ch += 64;
+			col++;
+		}
+		result += ch;
+		col++;
+		if (col >= lineLen)
+		{
+			result += "\r\n";
+			col = 0;
+		}
+	}
+	result += "\r\n";
+	return result;
+}
+
+static std::string RandomData(int len)
+{
+	std::string data;
+	for (int i = 0; i < len; i++)
+	{
+		data += (char)(rand() % 256);
+	}
+	return data;
+}
+
+// Random mix of characters with high density of special yEnc-characters
+static std::string RandomLine(int len)
+{
+	const char special[] = { '=', '=', '\r', '\n', '\0', 'A' };
+	std::string line;
+	for (int i = 0; i < len; i++)
+	{
+		line += rand() % 4 == 0 ? special[rand() % sizeof(special)] : (char)(rand() % 256);
+	}
+	return line;
+}
+
+static std::string DecodeLine(const std::string& line, YDecoder::EImpl impl)
+{
+	std::vector<char> buf(line.begin(), line.end());
+	buf.push_back('\0');
+	int len = YDecoder::DecodeLine(&buf[0], (int)line.size(), impl);
+	return std::string(&buf[0], len);
+}
+
+TEST_CASE("yEnc-decoder: round trip", "[Decoder][Quick]")
+{
+	srand(1);
+	for (int impl = YDecoder::yiScalar; impl <= YDecoder::yiNeon; impl++)
+	{
+		if (!YDecoder::IsImplSupported((YDecoder::EImpl)impl))
+		{
+			continue;
+		}
+
+		INFO("Implementation " << YDecoder::ImplNames[impl]);
+		for (int lineLen = 1; lineLen <= 130; lineLen++)
+		{
+			std::string data = RandomData(1000);
+			std::string encoded = YEncode(data, lineLen);
+			REQUIRE(DecodeLine(encoded, (YDecoder::EImpl)impl) == data);
+		}
+	}
+}
+
+TEST_CASE("yEnc-decoder: SIMD and scalar routines produce same result", "[Decoder][Quick]")
+{
+	srand(2);
+	for (int i = 0; i < 5000; i++)
+	{
+		std::string line = RandomLine(rand() % 200);
+		std::string expected = DecodeLine(line, YDecoder::yiScalar);
+
+		for (int impl = YDecoder::yiSse2; impl <= YDecoder::yiNeon; impl++)
+		{
+			if (YDecoder::IsImplSupported((YDecoder::EImpl)impl))
+			{
+				INFO("Implementation " << YDecoder::ImplNames[impl]);
+				REQUIRE(DecodeLine(line, (YDecoder::EImpl)impl) == expected);
+			}
+		}
+	}
+}
+
+TEST_CASE("yEnc-decoder: article", "[Decoder][Quick]")
+{
+	srand(3);
+	std::string data = RandomData(5000);
+	std::string encoded = YEncode(data, 128);
+	uint32 crc = Util::Crc32((uchar*)data.c_str(), (uint32)data.size());
+
+	char header[1024];
+	snprintf(header, sizeof(header), "=ybegin part=1 line=128 size=5000 name=test.bin\r\n");
+	char trailer[1024];
+	snprintf(trailer, sizeof(trailer), "=yend size=5000 part=1 pcrc32=%08x\r\n", crc);
+
+	YDecoder decoder;
+	decoder.SetCrcCheck(true);
+
+	std::string decoded;
+	char line[1024];
+	strcpy(line, header);
+	REQUIRE(decoder.DecodeBuffer(line, strlen(line)) == 0);
+	strcpy(line, "=ypart begin=1 end=5000\r\n");
+	REQUIRE(decoder.DecodeBuffer(line, strlen(line)) == 0);
+
+	for (size_t pos = 0; pos < encoded.size(); )
+	{
+		size_t eol = encoded.find("\r\n", pos) + 2;
+		int len = (int)(eol - pos);
+		memcpy(line, encoded.c_str() + pos, len);
+		line[len] = '\0';
+		int decodedLen = decoder.DecodeBuffer(line, len);
+		decoded.append(line, decodedLen);
+		pos = eol;
+	}
+
+	strcpy(line, trailer);
+	REQUIRE(decoder.DecodeBuffer(line, strlen(line)) == 0);
+
+	REQUIRE(decoded == data);
+	REQUIRE(decoder.Check() == Decoder::dsFinished);
+	REQUIRE(decoder.GetBegin() == 1);
+	REQUIRE(decoder.GetEnd() == 5000);
+	REQUIRE(decoder.GetCalculatedCrc() == crc);
+	REQUIRE(strcmp(decoder.GetArticleFilename(), "test.bin") == 0);
+}
+
+// Marks lines starting with "." as ".." as required by NNTP
+static std::string DotStuff(const std::string& text)
+{
+	std::string result;
+	bool lineStart = true;
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		if (lineStart && text[i] == '.')
+		{
+			result += '.';
+		}
+		result += text[i];
+		lineStart = text[i] == '\n';
+	}
+	return result;
+}
+
+// Feeds the article body to the decoder in chunks of random size, the same
+// way as ArticleDownloader does it when reading from connection
+static std::string DecodeStream(YDecoder& decoder, const std::string& body, int maxChunk, size_t* consumedTotal)
+{
+	std::string decoded;
+	std::vector<char> buf;
+	size_t pos = 0;
+	while (!decoder.GetEof() && pos < body.size())
+	{
+		int chunk = 1 + rand() % maxChunk;
+		size_t len = std::min(body.size() - pos, (size_t)chunk);
+		buf.insert(buf.end(), body.begin() + pos, body.begin() + pos + len);
+		pos += len;
+		buf.push_back('\0');
+
+		int consumed = 0;
+		int decodedLen = decoder.DecodeStream(&buf[0], (int)buf.size() - 1, &consumed);
+		decoded.append(&buf[0], decodedLen);
+		buf.erase(buf.begin(), buf.begin() + consumed);
+		buf.pop_back();
+		*consumedTotal = pos - buf.size();
+	}
+	return decoded;
+}
+
+TEST_CASE("yEnc-decoder: stream", "[Decoder][Quick]")
+{
+	srand(5);
+	for (int round = 0; round < 200; round++)
+	{
+		// data with high density of characters which become special after encoding
+		// ("." for dot-stuffing, escaped characters)
+		std::string data;
+		int size = 1 + rand() % 3000;
+		const char special[] = { 4, 19, (char)214, (char)224, (char)227, 'y' - 42 };
+		for (int i = 0; i < size; i++)
+		{
+			data += rand() % 3 == 0 ? special[rand() % sizeof(special)] : (char)(rand() % 256);
+		}
+		uint32 crc = Util::Crc32((uchar*)data.c_str(), (uint32)data.size());
+
+		char trailer[1024];
+		snprintf(trailer, sizeof(trailer), "=yend size=%i part=1 pcrc32=%08x\r\n", size, crc);
+		std::string body = DotStuff(YEncode(data, 1 + rand() % 130) + trailer) + ".\r\n";
+		std::string following = "222 0 <next@article> body\r\n";
+
+		YDecoder decoder;
+		decoder.SetCrcCheck(true);
+		char line[1024];
+		snprintf(line, sizeof(line), "=ybegin part=1 line=128 size=%i name=test.bin\r\n", size);
+		decoder.DecodeBuffer(line, strlen(line));
+		snprintf(line, sizeof(line), "=ypart begin=1 end=%i\r\n", size);
+		decoder.DecodeBuffer(line, strlen(line));
+		REQUIRE(decoder.GetBody());
+
+		size_t consumed = 0;
+		std::string decoded = DecodeStream(decoder, body + following, 1 + rand() % 300, &consumed);
+
+		REQUIRE(decoded == data);
+		REQUIRE(decoder.GetEof());
+		REQUIRE(consumed == body.size());
+		REQUIRE(decoder.Check() == Decoder::dsFinished);
+		REQUIRE(decoder.GetCalculatedCrc() == crc);
+	}
+}
+
+TEST_CASE("yEnc-decoder: benchmark", "[Decoder][Benchmark][.]")
+{
+	srand(4);
+	std::string data = RandomData(750000);
+	std::string encoded = YEncode(data, 128);
+
+	std::vector<std::string> lines;
+	for (size_t pos = 0; pos < encoded.size(); )
+	{
+		size_t eol = encoded.find("\r\n", pos) + 2;
+		lines.push_back(encoded.substr(pos, eol - pos));
+		pos = eol;
+	}
+
+	const int rounds = 200;
+	char line[1024];
+
+	for (int impl = YDecoder::yiScalar; impl <= YDecoder::yiNeon; impl++)
+	{
+		if (!YDecoder::IsImplSupported((YDecoder::EImpl)impl))
+		{
+			continue;
+		}
+
+		for (int crcMode = 0; crcMode < 3; crcMode++)
+		{
+			int64 start = Util::GetCurrentTicks();
+			for (int i = 0; i < rounds; i++)
+			{
+				uint32 crc = 0xFFFFFFFF;
+				Crc32Stream crcStream;
+				for (size_t k = 0; k < lines.size(); k++)
+				{
+					int len = (int)lines[k].size();
+					memcpy(line, lines[k].c_str(), len + 1);
+					len = YDecoder::DecodeLine(line, len, (YDecoder::EImpl)impl);
+					if (crcMode == 1)
+					{
+						crc = Util::Crc32m(crc, (uchar*)line, len);
+					}
+					else if (crcMode == 2)
+					{
+						crcStream.Update((uchar*)line, len);
+					}
+				}
+			}
+			int64 elapsed = Util::GetCurrentTicks() - start;
+
+			printf("Decoder %-6s %-12s: %.2f GB/s\n", YDecoder::ImplNames[impl],
+				crcMode == 0 ? "no crc" : crcMode == 1 ? "crc per line" : "crc stream",
+				(double)encoded.size() * rounds / (elapsed > 0 ? elapsed : 1) / 1000);
+		}
+	}
+}
+
+TEST_CASE("yEnc-decoder: stream benchmark", "[Decoder][Benchmark][.]")
+{
+	srand(6);
+	std::string data = RandomData(750000);
+	std::string body = DotStuff(YEncode(data, 128) + "=yend size=750000 part=1\r\n") + ".\r\n";
+	const int rounds = 200;
+	const int blockSize = 64 * 1024;
+	std::vector<char> buf(blockSize + 1);
+
+	for (int mode = 0; mode < 2; mode++)
+	{
+		int64 start = Util::GetCurrentTicks();
+		for (int i = 0; i < rounds; i++)
+		{
+			YDecoder decoder;
+			decoder.SetCrcCheck(true);
+			char line[1024];
+			strcpy(line, "=ybegin part=1 line=128 size=750000 name=test.bin\r\n");
+			decoder.DecodeBuffer(line, strlen(line));
+			strcpy(line, "=ypart begin=1 end=750000\r\n");
+			decoder.DecodeBuffer(line, strlen(line));
+
+			if (mode == 0)
+			{
+				// line by line as with Connection::ReadLine
+				for (size_t pos = 0; pos < body.size(); )
+				{
+					size_t eol = body.find('\n', pos) + 1;
+					int len = (int)(eol - pos);
+					memcpy(line, body.c_str() + pos, len);
+					line[len] = '\0';
+					pos = eol;
+					if (!strcmp(line, ".\r\n"))
+					{
+						break;
+					}
+					char* p = line;
+					if (!strncmp(p, "..", 2))
+					{
+						p++;
+						len--;
+					}
+					decoder.DecodeBuffer(p, len);
+				}
+			}
+			else
+			{
+				// block-wise as with Connection::ReadBlock
+				int avail = 0;
+				for (size_t pos = 0; pos < body.size() && !decoder.GetEof(); )
+				{
+					int len = (int)std::min(body.size() - pos, (size_t)(blockSize - avail));
+					memcpy(&buf[avail], body.c_str() + pos, len);
+					pos += len;
+					avail += len;
+					buf[avail] = '\0';
+					int consumed = 0;
+					decoder.DecodeStream(&buf[0], avail, &consumed);
+					memmove(&buf[0], &buf[consumed], avail - consumed);
+					avail -= consumed;
+				}
+			}
+
+			REQUIRE(decoder.Check() == Decoder::dsFinished);
+		}
+		int64 elapsed = Util::GetCurrentTicks() - start;
+
+		printf("Decoder %-12s: %.2f GB/s\n", mode == 0 ? "line by line" : "stream",
+			(double)body.size() * rounds / (elapsed > 0 ? elapsed : 1) / 1000);
+	}
+}
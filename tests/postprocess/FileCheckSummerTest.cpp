@@ -0,0 +1,76 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "par2cmdline.h"
+#include "TestUtil.h"
+
+TEST_CASE("File checksummer: short last block of mapped file", "[Par][FileCheckSummer][Quick]")
+{
+	TestUtil::PrepareWorkingDir("FileCheckSummer");
+
+	// the last block ends within the last page of the mapping, far before the block size
+	const u64 blockSize = 64 * 1024;
+	const size_t tailSize = 100;
+	std::vector<char> data((size_t)blockSize + tailSize);
+	srand(5);
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		data[i] = (char)rand();
+	}
+
+	std::string filename = TestUtil::WorkingDir() + "/testfile.dat";
+	FILE* outfile = fopen(filename.c_str(), FOPEN_WB);
+	REQUIRE(outfile != NULL);
+	REQUIRE(fwrite(&data[0], 1, data.size(), outfile) == data.size());
+	fclose(outfile);
+
+	std::vector<char> lastBlock((size_t)blockSize, 0);
+	memcpy(&lastBlock[0], &data[(size_t)blockSize], tailSize);
+	MD5Context context;
+	context.Update(&lastBlock[0], (size_t)blockSize);
+	MD5Hash expected;
+	context.Final(expected);
+
+	u32 windowTable[256];
+	GenerateWindowTable(blockSize, windowTable);
+	u32 windowMask = ComputeWindowMask(blockSize);
+
+	DiskFile diskFile;
+	REQUIRE(diskFile.Open(filename));
+	{
+		FileCheckSummer checkSummer(&diskFile, blockSize, windowTable, windowMask);
+		REQUIRE(checkSummer.Start());
+		REQUIRE(checkSummer.Jump(blockSize));
+		REQUIRE(checkSummer.ShortBlock());
+		REQUIRE(checkSummer.BlockLength() == tailSize);
+		REQUIRE(checkSummer.Hash() == expected);
+	}
+	diskFile.Close();
+}
@@ -0,0 +1,118 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "par2cmdline.h"
+#include "Util.h"
+
+static MD5Hash ReferenceHash(const u8* buffer, size_t length)
+{
+	MD5Context context;
+	context.Update(buffer, length);
+	MD5Hash hash;
+	context.Final(hash);
+	return hash;
+}
+
+TEST_CASE("MD5 lanes produce same hashes as MD5 context", "[MD5][Quick]")
+{
+	srand(7);
+
+	const size_t stride = 5000;
+	const size_t maxCount = 37;
+	std::vector<u8> buffer(stride * maxCount);
+	for (size_t i = 0; i < buffer.size(); i++)
+	{
+		buffer[i] = (u8)rand();
+	}
+
+	// lengths around the padding boundaries of the last MD5 block
+	const size_t lengths[] = { 0, 1, 55, 56, 63, 64, 65, 119, 120, 128, 1000, 4999 };
+	const size_t counts[] = { 1, 2, 3, 4, 5, 9, 16, 17, 31, maxCount };
+
+	for (int impl = MD5Lanes::eScalar; impl <= MD5Lanes::eAvx512; impl++)
+	{
+		if (!MD5Lanes::IsSupported((MD5Lanes::Impl)impl))
+		{
+			continue;
+		}
+
+		INFO("Implementation " << MD5Lanes::ImplNames[impl]);
+
+		for (size_t l = 0; l < sizeof(lengths) / sizeof(size_t); l++)
+		{
+			for (size_t c = 0; c < sizeof(counts) / sizeof(size_t); c++)
+			{
+				INFO("Length " << lengths[l] << ", count " << counts[c]);
+
+				std::vector<MD5Hash> hashes(counts[c]);
+				MD5Lanes::Hash((MD5Lanes::Impl)impl, &buffer[0], stride, lengths[l], counts[c], &hashes[0]);
+
+				for (size_t i = 0; i < counts[c]; i++)
+				{
+					REQUIRE(hashes[i] == ReferenceHash(&buffer[i * stride], lengths[l]));
+				}
+			}
+		}
+	}
+}
+
+TEST_CASE("MD5 lanes benchmark", "[MD5][Benchmark][.]")
+{
+	srand(7);
+
+	// typical block size of par2-sets
+	const size_t blocksize = 768 * 1024;
+	const size_t count = 16;
+	std::vector<u8> buffer(blocksize * count);
+	for (size_t i = 0; i < buffer.size(); i++)
+	{
+		buffer[i] = (u8)rand();
+	}
+
+	const int rounds = 50;
+	std::vector<MD5Hash> hashes(count);
+
+	for (int impl = MD5Lanes::eScalar; impl <= MD5Lanes::eAvx512; impl++)
+	{
+		if (!MD5Lanes::IsSupported((MD5Lanes::Impl)impl))
+		{
+			continue;
+		}
+
+		int64 start = Util::GetCurrentTicks();
+		for (int i = 0; i < rounds; i++)
+		{
+			MD5Lanes::Hash((MD5Lanes::Impl)impl, &buffer[0], blocksize, blocksize, count, &hashes[0]);
+		}
+		int64 elapsed = Util::GetCurrentTicks() - start;
+
+		printf("MD5 %-8s: %.0f MB/s\n", MD5Lanes::ImplNames[impl],
+			(double)blocksize * count * rounds / (elapsed > 0 ? elapsed : 1));
+	}
+}
@@ -29,23 +29,50 @@
 
 #include "Options.h"
 #include "ParChecker.h"
+#include "ParVerifier.h"
 #include "TestUtil.h"
 
 class ParCheckerMock: public ParChecker
 {
 private:
+	ParVerifier*	m_parVerifier;
+	int				m_takenHashes;
+	std::string		m_segmentedFile;
+	std::string		m_downloadedContent;
+	int				m_segmentSize;
+	int				m_failedSegment;
+	int				m_splitBlockSize;
+	std::vector<std::string>	m_messages;
 	uint32	CalcFileCrc(const char* filename);
+	void			BuildSegments(SegmentList* segments);
 protected:
 	virtual bool	RequestMorePars(int blockNeeded, int* blockFound) { return false; }
 	virtual EFileStatus	FindFileCrc(const char* filename, uint32* crc, SegmentList* segments);
+	virtual bool	TakeFileHashes(void* fileHashes, int64 blockSize);
+	virtual void	PrintMessage(Message::EKind kind, const char* format, ...);
 public:
 					ParCheckerMock();
 	void			Execute();
 	void			CorruptFile(const char* filename, int offset);
+	void			InsertByte(const char* filename, int offset);
+	void			SetParVerifier(ParVerifier* parVerifier) { m_parVerifier = parVerifier; }
+	int				GetTakenHashes() { return m_takenHashes; }
+	/*
+	 * Reports the file as downloaded in segments of "segmentSize" with one failed segment
+	 * (its data is destroyed); the CRCs of the parts of the segments at the block boundaries
+	 * are passed along if "splitBlockSize" is not 0 (as if the segments were cached)
+	 */
+	void			DownloadInSegments(const char* filename, int segmentSize, int failedSegment, int splitBlockSize);
+	bool			HasMessage(const char* text);
 };
 
 ParCheckerMock::ParCheckerMock()
 {
+	m_parVerifier = NULL;
+	m_takenHashes = 0;
+	m_segmentSize = 0;
+	m_failedSegment = 0;
+	m_splitBlockSize = 0;
 	TestUtil::PrepareWorkingDir("parchecker");
 	SetDestDir(TestUtil::WorkingDir().c_str());
 }
@@ -76,8 +103,102 @@ void ParCheckerMock::CorruptFile(const char* filename, int offset)
 	fclose(file);
 }
 
+void ParCheckerMock::InsertByte(const char* filename, int offset)
+{
+	std::string fullfilename(TestUtil::WorkingDir() + "/" + filename);
+
+	std::ifstream in(fullfilename.c_str(), std::ios::binary);
+	std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	in.close();
+	REQUIRE(content.length() > (size_t)offset);
+
+	content.insert(offset, 1, 'x');
+
+	std::ofstream out(fullfilename.c_str(), std::ios::binary | std::ios::trunc);
+	out.write(content.data(), content.length());
+	out.close();
+	REQUIRE(out.good());
+}
+
+void ParCheckerMock::DownloadInSegments(const char* filename, int segmentSize, int failedSegment, int splitBlockSize)
+{
+	std::string fullfilename(TestUtil::WorkingDir() + "/" + filename);
+
+	std::ifstream in(fullfilename.c_str(), std::ios::binary);
+	m_downloadedContent.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	in.close();
+
+	m_segmentedFile = filename;
+	m_segmentSize = segmentSize;
+	m_failedSegment = failedSegment;
+	m_splitBlockSize = splitBlockSize;
+
+	for (int offset = failedSegment * segmentSize; offset < (failedSegment + 1) * segmentSize; offset += 100)
+	{
+		CorruptFile(filename, offset);
+	}
+}
+
+void ParCheckerMock::BuildSegments(SegmentList* segments)
+{
+	uchar* content = (uchar*)m_downloadedContent.data();
+	int fileSize = (int)m_downloadedContent.length();
+
+	for (int i = 0; i * m_segmentSize < fileSize; i++)
+	{
+		int offset = i * m_segmentSize;
+		int size = std::min(m_segmentSize, fileSize - offset);
+		Segment* segment = new Segment(i != m_failedSegment, offset, size,
+			Util::Crc32m(0xFFFFFFFF, content + offset, size) ^ 0xFFFFFFFF);
+		segments->push_back(segment);
+
+		if (m_splitBlockSize == 0)
+		{
+			continue;
+		}
+
+		for (int split = (offset / m_splitBlockSize + 1) * m_splitBlockSize;
+			 split < offset + size; split += m_splitBlockSize)
+		{
+			segment->AddSplit(split,
+				Util::Crc32m(0xFFFFFFFF, content + offset, split - offset) ^ 0xFFFFFFFF,
+				Util::Crc32m(0xFFFFFFFF, content + split, offset + size - split) ^ 0xFFFFFFFF);
+		}
+	}
+}
+
+void ParCheckerMock::PrintMessage(Message::EKind kind, const char* format, ...)
+{
+	char text[1024];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(text, 1024, format, args);
+	va_end(args);
+	text[1024-1] = '\0';
+	m_messages.push_back(text);
+}
+
+bool ParCheckerMock::HasMessage(const char* text)
+{
+	for (std::vector<std::string>::iterator it = m_messages.begin(); it != m_messages.end(); it++)
+	{
+		if (it->find(text) != std::string::npos)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
 ParCheckerMock::EFileStatus ParCheckerMock::FindFileCrc(const char* filename, uint32* crc, SegmentList* segments)
 {
+	if (m_segmentedFile == filename)
+	{
+		*crc = 0;
+		BuildSegments(segments);
+		return ParChecker::fsPartial;
+	}
+
 	std::ifstream sm((TestUtil::WorkingDir() + "/crc.txt").c_str());
 	std::string smfilename, smcrc;
 	while (!sm.eof())
@@ -93,6 +214,16 @@ ParCheckerMock::EFileStatus ParCheckerMock::FindFileCrc(const char* filename, ui
 	return ParChecker::fsUnknown;
 }
 
+bool ParCheckerMock::TakeFileHashes(void* fileHashes, int64 blockSize)
+{
+	if (m_parVerifier && m_parVerifier->TakeFileHashes(1, blockSize, fileHashes))
+	{
+		m_takenHashes++;
+		return true;
+	}
+	return false;
+}
+
 uint32 ParCheckerMock::CalcFileCrc(const char* filename)
 {
 	FILE* infile = fopen(filename, FOPEN_RB);
@@ -159,6 +290,86 @@ TEST_CASE("Par-checker: repair successful", "[Par][ParChecker][Slow][TestData]")
 	REQUIRE(parChecker.GetParFull() == true);
 }
 
+TEST_CASE("Par-checker: repair of shifted data", "[Par][ParChecker][Slow][TestData]")
+{
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back("ParRepair=yes");
+	cmdOpts.push_back("BrokenLog=no");
+	Options options(&cmdOpts, NULL);
+
+	// the blocks after the inserted byte are found by sliding the scan window
+	ParCheckerMock parChecker;
+	parChecker.InsertByte("testfile.dat", 20000);
+	parChecker.Execute();
+
+	REQUIRE(parChecker.GetStatus() == ParChecker::psRepaired);
+}
+
+TEST_CASE("Par-checker: repair successful in multiple threads", "[Par][ParChecker][Slow][TestData]")
+{
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back("ParRepair=yes");
+	cmdOpts.push_back("BrokenLog=no");
+	cmdOpts.push_back("ParThreads=3");
+	Options options(&cmdOpts, NULL);
+
+	ParCheckerMock parChecker;
+	parChecker.CorruptFile("testfile.dat", 20000);
+	parChecker.CorruptFile("testfile.dat", 50000);
+	parChecker.CorruptFile("testfile.dat", 80000);
+	parChecker.Execute();
+
+	REQUIRE(parChecker.GetStatus() == ParChecker::psRepaired);
+	REQUIRE(parChecker.GetParFull() == true);
+}
+
+TEST_CASE("Par-checker: verification in multiple threads", "[Par][ParChecker][Slow][TestData]")
+{
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back("ParRepair=yes");
+	cmdOpts.push_back("BrokenLog=no");
+	cmdOpts.push_back("ParThreads=3");
+	Options options(&cmdOpts, NULL);
+
+	ParCheckerMock parChecker;
+	parChecker.CorruptFile("testfile.dat", 20000);
+	parChecker.CorruptFile("testfile.nfo", 100);
+	parChecker.Execute();
+
+	REQUIRE(parChecker.GetStatus() == ParChecker::psRepaired);
+	REQUIRE(parChecker.GetParFull() == true);
+}
+
+TEST_CASE("Par-checker: using hashes computed during download", "[Par][ParChecker][Slow][TestData]")
+{
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back("ParRepair=yes");
+	cmdOpts.push_back("BrokenLog=no");
+	Options options(&cmdOpts, NULL);
+
+	ParCheckerMock parChecker;
+	parChecker.CorruptFile("testfile.dat", 20000);
+
+	// the data file completes before the par-file and has to wait for the block size
+	ParVerifier parVerifier;
+	parVerifier.Start();
+	parVerifier.FileCompleted(1, (TestUtil::WorkingDir() + "/testfile.dat").c_str(), false);
+	parVerifier.FileCompleted(1, (TestUtil::WorkingDir() + "/testfile.par2").c_str(), true);
+	parVerifier.FileCompleted(1, (TestUtil::WorkingDir() + "/testfile.nfo").c_str(), false);
+
+	parChecker.SetParVerifier(&parVerifier);
+	parChecker.Execute();
+
+	parVerifier.Stop();
+	while (parVerifier.IsRunning())
+	{
+		usleep(10*1000);
+	}
+
+	REQUIRE(parChecker.GetStatus() == ParChecker::psRepaired);
+	REQUIRE(parChecker.GetTakenHashes() == 2);
+}
+
 TEST_CASE("Par-checker: repair failed", "[Par][ParChecker][Slow][TestData]")
 {
 	Options::CmdOptList cmdOpts;
@@ -210,6 +421,39 @@ TEST_CASE("Par-checker: quick verification repair successful", "[Par][ParChecker
 	REQUIRE(parChecker.GetParFull() == false);
 }
 
+TEST_CASE("Par-checker: quick verification using cached segment parts", "[Par][ParChecker][Slow][TestData]")
+{
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back("ParRepair=no");
+	cmdOpts.push_back("BrokenLog=no");
+	Options options(&cmdOpts, NULL);
+
+	ParCheckerMock parChecker;
+	parChecker.SetParQuick(true);
+
+	// the part of segment 24 before the block boundary is read from disk unless
+	// its CRC is known; the byte changed on disk shows whether it was read
+	SECTION("Parts known")
+	{
+		parChecker.DownloadInSegments("testfile.dat", 2000, 25, 636);
+		parChecker.CorruptFile("testfile.dat", 48005);
+		parChecker.Execute();
+
+		REQUIRE(parChecker.HasMessage("Quickly verified damaged file testfile.dat"));
+	}
+
+	SECTION("Parts read from disk")
+	{
+		parChecker.DownloadInSegments("testfile.dat", 2000, 25, 0);
+		parChecker.CorruptFile("testfile.dat", 48005);
+		parChecker.Execute();
+
+		REQUIRE(parChecker.HasMessage("Quick verification failed for damaged file testfile.dat"));
+	}
+
+	REQUIRE(parChecker.GetStatus() == ParChecker::psRepairPossible);
+}
+
 TEST_CASE("Par-checker: quick full verification repair successful", "[Par][ParChecker][Slow][TestData]")
 {
 	Options::CmdOptList cmdOpts;
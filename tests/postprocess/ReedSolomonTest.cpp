@@ -0,0 +1,337 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "par2cmdline.h"
+#include "Thread.h"
+#include "Util.h"
+
+// Reference implementation using the log/antilog tables of Galois16
+static void MultiplyAddReference(Galois16 factor, const u16* input, u16* output, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		output[i] = output[i] ^ (factor * Galois16(input[i]));
+	}
+}
+
+TEST_CASE("Galois16 vector routines produce same result as tables", "[ReedSolomon][Quick]")
+{
+	srand(5);
+
+	// odd length to leave a tail for the table driven code
+	const size_t count = 1000 + 6;
+	std::vector<u16> input(count);
+	std::vector<u16> initial(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		input[i] = (u16)(rand() & 0xFFFF);
+		initial[i] = (u16)(rand() & 0xFFFF);
+	}
+
+	const u16 factors[] = { 1, 2, 0x100B, 0x8000, 0xFFFF, 12345, (u16)(rand() & 0xFFFF) };
+
+	for (int impl = Galois16Vector::eSsse3; impl <= Galois16Vector::eNeon; impl++)
+	{
+		if (!Galois16Vector::IsSupported((Galois16Vector::Impl)impl))
+		{
+			continue;
+		}
+
+		INFO("Implementation " << Galois16Vector::ImplNames[impl]);
+
+		for (size_t f = 0; f < sizeof(factors) / sizeof(u16); f++)
+		{
+			std::vector<u16> expected = initial;
+			MultiplyAddReference(factors[f], &input[0], &expected[0], count);
+
+			std::vector<u16> output = initial;
+			size_t done = Galois16Vector::MultiplyAdd((Galois16Vector::Impl)impl, factors[f],
+				&input[0], &output[0], count * sizeof(u16));
+			REQUIRE(done > 0);
+			REQUIRE(done <= count * sizeof(u16));
+			MultiplyAddReference(factors[f], &input[done / sizeof(u16)],
+				&output[done / sizeof(u16)], count - done / sizeof(u16));
+
+			REQUIRE(output == expected);
+		}
+	}
+}
+
+TEST_CASE("Galois16 vector routines benchmark", "[ReedSolomon][Benchmark][.]")
+{
+	srand(5);
+
+	// typical block size of par2-sets
+	const size_t size = 768 * 1024;
+	std::vector<u8> input(size);
+	std::vector<u8> output(size);
+	for (size_t i = 0; i < size; i++)
+	{
+		input[i] = (u8)rand();
+	}
+
+	const int rounds = 1000;
+
+	for (int impl = Galois16Vector::eTable; impl <= Galois16Vector::eNeon; impl++)
+	{
+		if (!Galois16Vector::IsSupported((Galois16Vector::Impl)impl))
+		{
+			continue;
+		}
+
+		int64 start = Util::GetCurrentTicks();
+		for (int i = 0; i < rounds; i++)
+		{
+			Galois16 factor = (u16)(i * 7919 + 1);
+			if (impl == Galois16Vector::eTable)
+			{
+				MultiplyAddReference(factor, (u16*)&input[0], (u16*)&output[0], size / sizeof(u16));
+			}
+			else
+			{
+				Galois16Vector::MultiplyAdd((Galois16Vector::Impl)impl, factor, &input[0], &output[0], size);
+			}
+		}
+		int64 elapsed = Util::GetCurrentTicks() - start;
+
+		printf("Galois16 %-8s: %.0f MB/s\n",
+			impl == Galois16Vector::eTable ? "log/exp" : Galois16Vector::ImplNames[impl],
+			(double)size * rounds / (elapsed > 0 ? elapsed : 1));
+	}
+}
+
+// Synthetic damage pattern: "missing" of "count" source blocks are lost, evenly distributed
+static std::vector<bool> DamagePattern(u32 count, u32 missing)
+{
+	std::vector<bool> present(count, true);
+	for (u32 i = 0; i < missing; i++)
+	{
+		present[i * count / missing] = false;
+	}
+	return present;
+}
+
+TEST_CASE("Reed-Solomon repair in tiles", "[ReedSolomon][Quick]")
+{
+	srand(6);
+
+	const u32 count = 40;
+	const u32 missing = 7;
+	const size_t blocksize = 10000;
+
+	std::vector<u8> source(count * blocksize);
+	for (size_t i = 0; i < source.size(); i++)
+	{
+		source[i] = (u8)rand();
+	}
+
+	// create recovery blocks
+	std::vector<u8> recovery(missing * blocksize);
+	{
+		ReedSolomon<Galois16> rs;
+		rs.SetInput(count);
+		rs.SetOutput(false, 0, missing - 1);
+		REQUIRE(rs.Compute(CommandLine::nlSilent));
+		rs.ProcessBlocks(blocksize, 0, count, &source[0], blocksize, 0, missing, &recovery[0], blocksize, blocksize);
+	}
+
+	// input blocks for repair: the remaining source blocks followed by recovery blocks
+	std::vector<bool> present = DamagePattern(count, missing);
+	std::vector<u8> input;
+	for (u32 i = 0; i < count; i++)
+	{
+		if (present[i])
+		{
+			input.insert(input.end(), source.begin() + i * blocksize, source.begin() + (i + 1) * blocksize);
+		}
+	}
+	input.insert(input.end(), recovery.begin(), recovery.end());
+
+	ReedSolomon<Galois16> rs;
+	rs.SetInput(present);
+	rs.SetOutput(true, 0, missing - 1);
+	REQUIRE(rs.Compute(CommandLine::nlSilent));
+
+	const u32 inputsPerPass[] = { 1, 3, count };
+	const size_t tileSizes[] = { 1024, 4000, blocksize };
+
+	for (size_t k = 0; k < sizeof(inputsPerPass) / sizeof(u32); k++)
+	{
+		for (size_t t = 0; t < sizeof(tileSizes) / sizeof(size_t); t++)
+		{
+			INFO("Inputs " << inputsPerPass[k] << ", tile size " << tileSizes[t]);
+
+			std::vector<u8> output(missing * blocksize);
+			for (u32 inputindex = 0; inputindex < count; inputindex += inputsPerPass[k])
+			{
+				u32 inputcount = std::min(inputsPerPass[k], count - inputindex);
+				for (u32 outputindex = 0; outputindex < missing; outputindex += 2)
+				{
+					rs.ProcessBlocks(blocksize, inputindex, inputcount, &input[inputindex * blocksize], blocksize,
+						outputindex, std::min((u32)2, missing - outputindex), &output[outputindex * blocksize],
+						blocksize, tileSizes[t]);
+				}
+			}
+
+			for (u32 i = 0, outputindex = 0; i < count; i++)
+			{
+				if (!present[i])
+				{
+					REQUIRE(memcmp(&output[outputindex * blocksize], &source[i * blocksize], blocksize) == 0);
+					outputindex++;
+				}
+			}
+		}
+	}
+}
+
+TEST_CASE("Reed-Solomon repair benchmark", "[ReedSolomon][Benchmark][.]")
+{
+	srand(6);
+
+	const u32 count = 100;
+	const size_t blocksize = 1024 * 1024;
+
+	std::vector<u8> input(count * blocksize);
+	for (size_t i = 0; i < input.size(); i++)
+	{
+		input[i] = (u8)rand();
+	}
+
+	const u32 missingCounts[] = { 2, 10, 40 };
+	const u32 tileInputs[] = { 1, 4, 8, 16 };
+	const size_t tileSizes[] = { 16 * 1024, 64 * 1024, 256 * 1024, blocksize };
+
+	for (size_t m = 0; m < sizeof(missingCounts) / sizeof(u32); m++)
+	{
+		u32 missing = missingCounts[m];
+
+		ReedSolomon<Galois16> rs;
+		rs.SetInput(DamagePattern(count, missing));
+		rs.SetOutput(true, 0, missing - 1);
+		REQUIRE(rs.Compute(CommandLine::nlSilent));
+
+		std::vector<u8> output(missing * blocksize);
+
+		for (size_t k = 0; k < sizeof(tileInputs) / sizeof(u32); k++)
+		{
+			for (size_t t = 0; t < sizeof(tileSizes) / sizeof(size_t); t++)
+			{
+				int64 start = Util::GetCurrentTicks();
+				for (u32 inputindex = 0; inputindex < count; inputindex += tileInputs[k])
+				{
+					u32 inputcount = std::min(tileInputs[k], count - inputindex);
+					for (u32 outputindex = 0; outputindex < missing; outputindex += 16)
+					{
+						rs.ProcessBlocks(blocksize, inputindex, inputcount, &input[inputindex * blocksize], blocksize,
+							outputindex, std::min((u32)16, missing - outputindex), &output[outputindex * blocksize],
+							blocksize, tileSizes[t]);
+					}
+				}
+				int64 elapsed = Util::GetCurrentTicks() - start;
+
+				// speed of recovery: amount of source data processed per second
+				printf("Repair %3i of %i blocks, %2i inputs, %7i bytes tiles: %.0f MB/s\n",
+					missing, count, tileInputs[k], (int)tileSizes[t],
+					(double)count * blocksize / (elapsed > 0 ? elapsed : 1));
+			}
+		}
+	}
+}
+
+// Eliminates the rows of the matrix in the threads of a worker pool
+class PoolRowRunner : public RSRowRunner, public ParallelJob
+{
+private:
+	WorkerPool		m_workerPool;
+	int				m_threads;
+	RSRowJob*		m_job;
+
+public:
+					PoolRowRunner(int threads) : m_threads(threads), m_job(NULL) {}
+	virtual void	Run(RSRowJob* job, u32 count)
+	{
+		m_job = job;
+		m_workerPool.Run(this, (int)count, m_threads, std::max(1, (int)count / (m_threads * 4)));
+	}
+	virtual void	Execute(int begin, int end) { m_job->Execute((u32)begin, (u32)end); }
+};
+
+class MatrixReedSolomon : public ReedSolomon<Galois16>
+{
+public:
+	std::vector<Galois16> Matrix() { return std::vector<Galois16>(leftmatrix, leftmatrix + outputcount * inputcount); }
+};
+
+TEST_CASE("Reed-Solomon matrix solved in several threads", "[ReedSolomon][Quick]")
+{
+	// large enough for the pivot steps to be passed to the row runner
+	const u32 count = 2000;
+	const u32 missing = 150;
+
+	MatrixReedSolomon sequential;
+	sequential.SetInput(DamagePattern(count, missing));
+	sequential.SetOutput(true, 0, missing - 1);
+	REQUIRE(sequential.Compute(CommandLine::nlSilent));
+
+	PoolRowRunner rowRunner(4);
+	MatrixReedSolomon parallel;
+	parallel.SetRowRunner(&rowRunner);
+	parallel.SetInput(DamagePattern(count, missing));
+	parallel.SetOutput(true, 0, missing - 1);
+	REQUIRE(parallel.Compute(CommandLine::nlSilent));
+
+	REQUIRE(parallel.Matrix() == sequential.Matrix());
+}
+
+TEST_CASE("Reed-Solomon matrix benchmark", "[ReedSolomon][Benchmark][.]")
+{
+	const u32 count = 5000;
+	const u32 missingCounts[] = { 100, 500, 1000 };
+	const int threadCounts[] = { 1, 2, 4, 8 };
+
+	for (size_t m = 0; m < sizeof(missingCounts) / sizeof(u32); m++)
+	{
+		for (size_t t = 0; t < sizeof(threadCounts) / sizeof(int); t++)
+		{
+			PoolRowRunner rowRunner(threadCounts[t]);
+			ReedSolomon<Galois16> rs;
+			rs.SetRowRunner(threadCounts[t] > 1 ? &rowRunner : NULL);
+			rs.SetInput(DamagePattern(count, missingCounts[m]));
+			rs.SetOutput(true, 0, missingCounts[m] - 1);
+
+			int64 start = Util::GetCurrentTicks();
+			REQUIRE(rs.Compute(CommandLine::nlSilent));
+			int64 elapsed = Util::GetCurrentTicks() - start;
+
+			printf("Matrix for %4i of %i blocks, %i thread(s): %.3f sec\n",
+				missingCounts[m], count, threadCounts[t], elapsed / 1000000.0);
+		}
+	}
+}
@@ -0,0 +1,175 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "QueueCoordinator.h"
+#include "Util.h"
+#include "TestQueue.h"
+
+// takes next article and marks it as running, the same way as QueueCoordinator does
+static FileInfo* StartNext(ArticleScheduler* scheduler, NzbList* queue, bool pauseDownload = false)
+{
+	FileInfo* fileInfo = NULL;
+	ArticleInfo* articleInfo = NULL;
+	if (!scheduler->GetNextArticle(queue, pauseDownload, 0, false, fileInfo, articleInfo))
+	{
+		return NULL;
+	}
+	articleInfo->SetStatus(ArticleInfo::aiRunning);
+	return fileInfo;
+}
+
+TEST_CASE("Article scheduler", "[ArticleScheduler][Quick]")
+{
+	DownloadQueueMock downloadQueue;
+	NzbList* queue = downloadQueue.GetQueue();
+	NzbInfo* nzb1 = downloadQueue.AddNzb("nzb1", 2, 2);
+	NzbInfo* nzb2 = downloadQueue.AddNzb("nzb2", 2, 2);
+	NzbInfo* nzb3 = downloadQueue.AddNzb("nzb3", 1, 2);
+	nzb2->SetPriority(100);
+	FileInfo* fileA = nzb1->GetFileList()->at(0);
+	FileInfo* fileB = nzb1->GetFileList()->at(1);
+	FileInfo* fileC = nzb2->GetFileList()->at(0);
+	FileInfo* fileD = nzb2->GetFileList()->at(1);
+	FileInfo* fileE = nzb3->GetFileList()->at(0);
+	fileE->SetExtraPriority(true);
+
+	ArticleScheduler scheduler;
+
+	SECTION("order by extra priority, priority and position in queue")
+	{
+		FileInfo* expected[] = { fileE, fileE, fileC, fileC, fileD, fileD, fileA, fileA, fileB, fileB };
+		for (int i = 0; i < 10; i++)
+		{
+			REQUIRE(StartNext(&scheduler, queue) == expected[i]);
+		}
+		REQUIRE(StartNext(&scheduler, queue) == NULL);
+	}
+
+	SECTION("queue changes")
+	{
+		REQUIRE(StartNext(&scheduler, queue) == fileE);
+
+		fileE->SetPaused(true);
+		fileC->SetPaused(true);
+		scheduler.Invalidate();
+		REQUIRE(StartNext(&scheduler, queue) == fileD);
+
+		nzb1->SetPriority(200);
+		scheduler.Invalidate();
+		REQUIRE(StartNext(&scheduler, queue) == fileA);
+
+		// article download failed and must be retried
+		fileA->GetArticles()->at(0)->SetStatus(ArticleInfo::aiUndefined);
+		scheduler.Invalidate();
+		REQUIRE(StartNext(&scheduler, queue) == fileA);
+		REQUIRE(StartNext(&scheduler, queue) == fileA);
+		REQUIRE(StartNext(&scheduler, queue) == fileB);
+
+		// deleted files are removed from index without rebuilding it
+		scheduler.FileDeleted(fileB);
+		nzb1->GetFileList()->Remove(fileB);
+		delete fileB;
+		REQUIRE(StartNext(&scheduler, queue) == fileD);
+	}
+
+	SECTION("paused download")
+	{
+		REQUIRE(StartNext(&scheduler, queue, true) == NULL);
+		nzb1->SetPriority(NzbInfo::FORCE_PRIORITY);
+		scheduler.Invalidate();
+		REQUIRE(StartNext(&scheduler, queue, true) == fileA);
+		REQUIRE(StartNext(&scheduler, queue, false) == fileE);
+	}
+}
+
+TEST_CASE("Article scheduler: benchmark", "[ArticleScheduler][Benchmark][.]")
+{
+	// 100000 files in 500 nzbs
+	const int nzbCount = 500;
+	const int fileCount = 200;
+	const int articleCount = 5;
+	const int priorities[] = { -100, 0, 0, 50, 100 };
+
+	DownloadQueueMock downloadQueue;
+	NzbList* queue = downloadQueue.GetQueue();
+	srand(8);
+	for (int i = 0; i < nzbCount; i++)
+	{
+		NzbInfo* nzbInfo = downloadQueue.AddNzb("nzb", fileCount, articleCount);
+		nzbInfo->SetPriority(priorities[rand() % 5]);
+		for (FileList::iterator it = nzbInfo->GetFileList()->begin(); it != nzbInfo->GetFileList()->end(); it++)
+		{
+			FileInfo* fileInfo = *it;
+			fileInfo->SetPaused(fileInfo->GetId() % 5 == 0);
+		}
+	}
+
+	// full scan of the queue for every article as it was done before the index
+	const int scanRounds = 1000;
+	int64 start = Util::GetCurrentTicks();
+	for (int i = 0; i < scanRounds; i++)
+	{
+		FileInfo* fileInfo = NULL;
+		for (NzbList::iterator it = queue->begin(); it != queue->end(); it++)
+		{
+			NzbInfo* nzbInfo = *it;
+			for (FileList::iterator it2 = nzbInfo->GetFileList()->begin(); it2 != nzbInfo->GetFileList()->end(); it2++)
+			{
+				FileInfo* fileInfo1 = *it2;
+				if (!fileInfo1->GetPaused() && !fileInfo1->GetDeleted() &&
+					(!fileInfo ||
+					 (fileInfo1->GetExtraPriority() == fileInfo->GetExtraPriority() &&
+					  fileInfo1->GetNzbInfo()->GetPriority() > fileInfo->GetNzbInfo()->GetPriority()) ||
+					 (fileInfo1->GetExtraPriority() > fileInfo->GetExtraPriority())))
+				{
+					fileInfo = fileInfo1;
+				}
+			}
+		}
+		REQUIRE(fileInfo != NULL);
+	}
+	int64 elapsed = Util::GetCurrentTicks() - start;
+	printf("Queue scan: %.2f us per article\n", (double)elapsed / scanRounds);
+
+	ArticleScheduler scheduler;
+	int articles = 0;
+	start = Util::GetCurrentTicks();
+	while (StartNext(&scheduler, queue))
+	{
+		articles++;
+		if (articles % 50000 == 0)
+		{
+			// queue edit
+			scheduler.Invalidate();
+		}
+	}
+	elapsed = Util::GetCurrentTicks() - start;
+	REQUIRE(articles == nzbCount * fileCount * 4 / 5 * articleCount);
+	printf("Scheduler: %.2f us per article (%i articles)\n", (double)elapsed / articles, articles);
+}
@@ -0,0 +1,450 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "DiskState.h"
+#include "Options.h"
+#include "Util.h"
+#include "TestUtil.h"
+#include "TestQueue.h"
+
+static bool QueueFileExists(const char* filename)
+{
+	return Util::FileExists((TestUtil::WorkingDir() + "/" + filename).c_str());
+}
+
+static int64 QueueFileSize(const char* filename)
+{
+	return Util::FileSize((TestUtil::WorkingDir() + "/" + filename).c_str());
+}
+
+static std::string LoadQueueNames()
+{
+	DownloadQueueMock downloadQueue;
+	DiskState diskState;
+	Servers servers;
+	REQUIRE(diskState.LoadDownloadQueue(&downloadQueue, &servers));
+	return downloadQueue.QueueNames() + "|" + downloadQueue.HistoryNames();
+}
+
+TEST_CASE("Disk state: queue journal", "[DiskState][Quick]")
+{
+	TestUtil::PrepareWorkingDir("nzbfile");
+
+	std::string queueDirOption = "QueueDir=" + TestUtil::WorkingDir() + "/";
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back(queueDirOption.c_str());
+	cmdOpts.push_back("FlushQueue=no");
+	Options options(&cmdOpts, NULL);
+
+	{
+		DownloadQueueMock downloadQueue;
+		downloadQueue.AddNzb("nzb1");
+		downloadQueue.AddNzb("nzb2");
+		downloadQueue.AddNzb("nzb3");
+		downloadQueue.AddHistory("hist1");
+
+		DiskState diskState;
+
+		// the first save writes a snapshot
+		REQUIRE(diskState.SaveDownloadQueue(&downloadQueue));
+		REQUIRE(QueueFileExists("queue"));
+		REQUIRE_FALSE(QueueFileExists("queue.j1"));
+		REQUIRE(LoadQueueNames() == "nzb1,nzb2,nzb3|hist1");
+
+		// changes go into the journal
+		downloadQueue.GetQueue()->at(1)->SetName("nzb2-renamed");
+		NzbInfo* nzbInfo = downloadQueue.GetQueue()->at(2);
+		downloadQueue.GetQueue()->erase(downloadQueue.GetQueue()->begin() + 2);
+		downloadQueue.GetHistory()->push_front(new HistoryInfo(nzbInfo));
+		std::swap(downloadQueue.GetQueue()->at(0), downloadQueue.GetQueue()->at(1));
+		downloadQueue.AddNzb("nzb4");
+		REQUIRE(diskState.SaveDownloadQueue(&downloadQueue));
+		REQUIRE(QueueFileExists("queue.j1"));
+
+		// nothing written without changes
+		int64 journalSize = QueueFileSize("queue.j1");
+		REQUIRE(diskState.SaveDownloadQueue(&downloadQueue));
+		REQUIRE(QueueFileSize("queue.j1") == journalSize);
+
+		delete downloadQueue.GetHistory()->back();
+		downloadQueue.GetHistory()->pop_back();
+		REQUIRE(diskState.SaveDownloadQueue(&downloadQueue));
+		REQUIRE(QueueFileSize("queue.j1") > journalSize);
+	}
+
+	REQUIRE(LoadQueueNames() == "nzb2-renamed,nzb1,nzb4|nzb3");
+
+	// incomplete transaction at the end of journal is ignored
+	FILE* journal = fopen((TestUtil::WorkingDir() + "/queue.j1").c_str(), FOPEN_AB);
+	fprintf(journal, "X 1\nN\n25\n");
+	fclose(journal);
+
+	REQUIRE(LoadQueueNames() == "nzb2-renamed,nzb1,nzb4|nzb3");
+}
+
+TEST_CASE("Disk state: queue journal compaction", "[DiskState][Quick]")
+{
+	TestUtil::PrepareWorkingDir("nzbfile");
+
+	std::string queueDirOption = "QueueDir=" + TestUtil::WorkingDir() + "/";
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back(queueDirOption.c_str());
+	cmdOpts.push_back("FlushQueue=no");
+	Options options(&cmdOpts, NULL);
+
+	char name[100];
+
+	{
+		DownloadQueueMock downloadQueue;
+		downloadQueue.AddNzb("nzb1");
+		downloadQueue.AddNzb("nzb2");
+
+		DiskState diskState;
+		REQUIRE(diskState.SaveDownloadQueue(&downloadQueue));
+
+		for (int i = 0; !QueueFileExists("queue.j2"); i++)
+		{
+			REQUIRE(i < 100000);
+			snprintf(name, 100, "nzb2-%i", i);
+			downloadQueue.GetQueue()->at(1)->SetName(name);
+			REQUIRE(diskState.SaveDownloadQueue(&downloadQueue));
+		}
+	}
+
+	// after the snapshot is written the older journal is deleted
+	REQUIRE_FALSE(QueueFileExists("queue.j1"));
+	REQUIRE(LoadQueueNames() == std::string("nzb1,") + name + "|");
+
+	{
+		// the queue loaded from snapshot and journal is saved into a new snapshot
+		DownloadQueueMock downloadQueue;
+		DiskState diskState;
+		Servers servers;
+		REQUIRE(diskState.LoadDownloadQueue(&downloadQueue, &servers));
+		std::string names = downloadQueue.QueueNames();
+		REQUIRE(diskState.SaveDownloadQueue(&downloadQueue));
+		REQUIRE_FALSE(QueueFileExists("queue.j2"));
+		REQUIRE(LoadQueueNames() == names + "|");
+
+		// empty queue has no state files
+		downloadQueue.GetQueue()->Clear();
+		REQUIRE(diskState.SaveDownloadQueue(&downloadQueue));
+		REQUIRE_FALSE(QueueFileExists("queue"));
+	}
+}
+
+TEST_CASE("Disk state: binary file state", "[DiskState][Quick]")
+{
+	TestUtil::PrepareWorkingDir("nzbfile");
+
+	std::string queueDirOption = "QueueDir=" + TestUtil::WorkingDir() + "/";
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back(queueDirOption.c_str());
+	Options options(&cmdOpts, NULL);
+
+	DiskState diskState;
+	Servers servers;
+
+	FileInfo fileInfo;
+	fileInfo.SetSubject("subject");
+	fileInfo.SetFilename("file.rar");
+	fileInfo.SetSize(5000000000LL);
+	fileInfo.SetSuccessSize(4000000000LL);
+	fileInfo.SetSuccessArticles(2);
+	fileInfo.SetFailedArticles(1);
+	fileInfo.GetGroups()->push_back(strdup("alt.binaries.test"));
+
+	char messageId[100];
+	for (int i = 1; i <= 4; i++)
+	{
+		ArticleInfo* articleInfo = new ArticleInfo();
+		articleInfo->SetPartNumber(i);
+		articleInfo->SetSize(700000 + i);
+		snprintf(messageId, 100, "part%i@test", i);
+		articleInfo->SetMessageId(messageId);
+		articleInfo->SetStatus(i < 3 ? ArticleInfo::aiFinished : i == 3 ? ArticleInfo::aiFailed : ArticleInfo::aiRunning);
+		articleInfo->SetSegmentOffset(4500000000LL + i);
+		articleInfo->SetSegmentSize(680000 + i);
+		articleInfo->SetCrc(0xF0000000 + i);
+		fileInfo.GetArticles()->push_back(articleInfo);
+	}
+
+	REQUIRE(diskState.SaveFile(&fileInfo));
+	REQUIRE(diskState.SaveFileState(&fileInfo, false));
+
+	FileInfo loadedInfo(fileInfo.GetId());
+	REQUIRE(diskState.LoadArticles(&loadedInfo));
+	REQUIRE(loadedInfo.GetArticles()->size() == 4);
+	REQUIRE(loadedInfo.GetArticles()->at(3)->GetPartNumber() == 4);
+	REQUIRE(loadedInfo.GetArticles()->at(3)->GetSize() == 700004);
+	REQUIRE(std::string(loadedInfo.GetArticles()->at(3)->GetMessageId()) == "part4@test");
+
+	REQUIRE(diskState.LoadFileState(&loadedInfo, &servers, false));
+	REQUIRE(loadedInfo.GetSuccessArticles() == 2);
+	REQUIRE(loadedInfo.GetFailedArticles() == 1);
+	REQUIRE(loadedInfo.GetSuccessSize() == 4000000000LL);
+	REQUIRE(loadedInfo.GetCompletedArticles() == 3);
+	ArticleInfo* articleInfo = loadedInfo.GetArticles()->at(2);
+	REQUIRE(articleInfo->GetStatus() == ArticleInfo::aiFailed);
+	REQUIRE(articleInfo->GetSegmentOffset() == 4500000003LL);
+	REQUIRE(articleInfo->GetSegmentSize() == 680003);
+	REQUIRE(articleInfo->GetCrc() == 0xF0000003);
+	REQUIRE(loadedInfo.GetArticles()->at(3)->GetStatus() == ArticleInfo::aiUndefined);
+
+	// truncated files are rejected
+	char stateFilename[1024];
+	snprintf(stateFilename, 1024, "%s/%is", TestUtil::WorkingDir().c_str(), fileInfo.GetId());
+	char* buffer;
+	int bufferLength;
+	REQUIRE(Util::LoadFileIntoBuffer(stateFilename, &buffer, &bufferLength));
+	REQUIRE(Util::SaveBufferIntoFile(stateFilename, buffer, bufferLength - 10));
+	free(buffer);
+	FileInfo truncatedInfo(fileInfo.GetId());
+	REQUIRE_FALSE(diskState.LoadFileState(&truncatedInfo, &servers, false));
+}
+
+TEST_CASE("Disk state: text file state", "[DiskState][Quick]")
+{
+	TestUtil::PrepareWorkingDir("nzbfile");
+
+	std::string queueDirOption = "QueueDir=" + TestUtil::WorkingDir() + "/";
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back(queueDirOption.c_str());
+	Options options(&cmdOpts, NULL);
+
+	DiskState diskState;
+	Servers servers;
+	FileInfo fileInfo;
+
+	// files in text formats are still loaded
+	char filename[1024];
+	snprintf(filename, 1024, "%s/%i", TestUtil::WorkingDir().c_str(), fileInfo.GetId());
+	FILE* outfile = fopen(filename, FOPEN_WB);
+	fprintf(outfile, "nzbget diskstate file version 3\nsubject\nfile.rar\n0,1400000\n0,0\n0\n2,0\n"
+		"1\nalt.binaries.test\n2\n1,700000\npart1@test\n2,700000\npart2@test\n");
+	fclose(outfile);
+
+	snprintf(filename, 1024, "%s/%is", TestUtil::WorkingDir().c_str(), fileInfo.GetId());
+	outfile = fopen(filename, FOPEN_WB);
+	fprintf(outfile, "nzbget diskstate file version 2\n1,0\n0,700000,1,500000,0,0\n0\n2\n"
+		"2,0,680000,12345\n0,0,0,0\n");
+	fclose(outfile);
+
+	REQUIRE(diskState.LoadArticles(&fileInfo));
+	REQUIRE(fileInfo.GetArticles()->size() == 2);
+	REQUIRE(std::string(fileInfo.GetArticles()->at(1)->GetMessageId()) == "part2@test");
+
+	REQUIRE(diskState.LoadFileState(&fileInfo, &servers, false));
+	REQUIRE(fileInfo.GetSuccessArticles() == 1);
+	REQUIRE(fileInfo.GetSuccessSize() == 4295467296LL);
+	REQUIRE(fileInfo.GetCompletedArticles() == 1);
+	REQUIRE(fileInfo.GetArticles()->at(0)->GetStatus() == ArticleInfo::aiFinished);
+	REQUIRE(fileInfo.GetArticles()->at(0)->GetCrc() == 12345);
+
+	// and converted into binary format on next save
+	REQUIRE(diskState.SaveFileState(&fileInfo, false));
+	FileInfo loadedInfo(fileInfo.GetId());
+	REQUIRE(diskState.LoadFileState(&loadedInfo, &servers, false));
+	REQUIRE(loadedInfo.GetArticles()->at(0)->GetSegmentSize() == 680000);
+}
+
+TEST_CASE("Disk state: history details", "[DiskState][Quick]")
+{
+	TestUtil::PrepareWorkingDir("nzbfile");
+
+	std::string queueDirOption = "QueueDir=" + TestUtil::WorkingDir() + "/";
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back(queueDirOption.c_str());
+	cmdOpts.push_back("FlushQueue=no");
+	Options options(&cmdOpts, NULL);
+
+	char detailsFilename[100];
+
+	{
+		DownloadQueueMock downloadQueue;
+		downloadQueue.AddHistory("hist1");
+		NzbInfo* nzbInfo = downloadQueue.GetHistory()->front()->GetNzbInfo();
+		nzbInfo->GetCompletedFiles()->push_back(new CompletedFile(7, "file1.rar", CompletedFile::cfSuccess, 1));
+		nzbInfo->GetCompletedFiles()->push_back(new CompletedFile(12, "file2.rar", CompletedFile::cfFailure, 2));
+		FileInfo* fileInfo = new FileInfo(9);
+		fileInfo->SetFilename("file3.rar");
+		fileInfo->SetNzbInfo(nzbInfo);
+		nzbInfo->GetFileList()->push_back(fileInfo);
+		nzbInfo->SetParkedFileCount(1);
+		snprintf(detailsFilename, 100, "n%i.details", nzbInfo->GetId());
+
+		DiskState diskState;
+		REQUIRE(diskState.SaveFile(fileInfo));
+
+		// the lists of files are moved from memory into the details file
+		// when the item is added to history
+		REQUIRE(diskState.SaveNzbDetails(nzbInfo));
+		REQUIRE(QueueFileExists(detailsFilename));
+		REQUIRE(nzbInfo->GetCompletedFiles()->size() == 2);
+		nzbInfo->UnloadDetails();
+		REQUIRE(nzbInfo->GetDetailsUnloaded());
+		REQUIRE(nzbInfo->GetCompletedFiles()->empty());
+		REQUIRE(nzbInfo->GetFileList()->empty());
+
+		REQUIRE(diskState.SaveDownloadQueue(&downloadQueue));
+	}
+
+	FileInfo::ResetGenId(false);
+
+	DownloadQueueMock downloadQueue;
+	DiskState diskState;
+	Servers servers;
+	REQUIRE(diskState.LoadDownloadQueue(&downloadQueue, &servers));
+	REQUIRE(downloadQueue.HistoryNames() == "hist1");
+
+	NzbInfo* nzbInfo = downloadQueue.GetHistory()->front()->GetNzbInfo();
+	REQUIRE(nzbInfo->GetDetailsUnloaded());
+	REQUIRE(nzbInfo->GetCompletedFiles()->empty());
+	REQUIRE(nzbInfo->GetParkedFileCount() == 1);
+
+	// ids of files in unloaded lists are not reused
+	REQUIRE(FileInfo().GetId() == 13);
+
+	// the item remains unloaded if the details file can't be read
+	std::string detailsPath = TestUtil::WorkingDir() + "/" + detailsFilename;
+	REQUIRE(Util::MoveFile(detailsPath.c_str(), (detailsPath + ".bak").c_str()));
+	REQUIRE_FALSE(diskState.LoadNzbDetails(nzbInfo));
+	REQUIRE(nzbInfo->GetDetailsUnloaded());
+	REQUIRE(nzbInfo->GetCompletedFiles()->empty());
+	REQUIRE(Util::MoveFile((detailsPath + ".bak").c_str(), detailsPath.c_str()));
+
+	REQUIRE(diskState.LoadNzbDetails(nzbInfo));
+	REQUIRE_FALSE(nzbInfo->GetDetailsUnloaded());
+	REQUIRE(nzbInfo->GetCompletedFiles()->size() == 2);
+	REQUIRE(std::string(nzbInfo->GetCompletedFiles()->at(1)->GetFileName()) == "file2.rar");
+	REQUIRE(nzbInfo->GetCompletedFiles()->at(1)->GetStatus() == CompletedFile::cfFailure);
+	REQUIRE(nzbInfo->GetFileList()->size() == 1);
+	REQUIRE(nzbInfo->GetFileList()->at(0)->GetId() == 9);
+	REQUIRE(std::string(nzbInfo->GetFileList()->at(0)->GetFilename()) == "file3.rar");
+
+	diskState.DiscardFiles(nzbInfo);
+	REQUIRE_FALSE(QueueFileExists(detailsFilename));
+}
+
+/* Saves a queue with files having article lists; every second file has a partial state */
+static void SaveGeneratedQueue(int nzbCount, int fileCount, int articleCount)
+{
+	DownloadQueueMock downloadQueue;
+	DiskState diskState;
+
+	for (int i = 0; i < nzbCount; i++)
+	{
+		NzbInfo* nzbInfo = downloadQueue.AddNzb("nzb", fileCount, articleCount);
+		for (int j = 0; j < fileCount; j++)
+		{
+			FileInfo* fileInfo = nzbInfo->GetFileList()->at(j);
+			REQUIRE(diskState.SaveFile(fileInfo));
+			if (j % 2 == 1)
+			{
+				fileInfo->GetArticles()->at(0)->SetStatus(ArticleInfo::aiFinished);
+				fileInfo->SetSuccessArticles(fileInfo->GetId());
+				REQUIRE(diskState.SaveFileState(fileInfo, false));
+			}
+			fileInfo->ClearArticles();
+		}
+	}
+
+	REQUIRE(diskState.SaveDownloadQueue(&downloadQueue));
+}
+
+/* Checks that partial states were loaded into their files */
+static void CheckPartialStates(DownloadQueue* downloadQueue)
+{
+	for (NzbList::iterator it = downloadQueue->GetQueue()->begin(); it != downloadQueue->GetQueue()->end(); it++)
+	{
+		NzbInfo* nzbInfo = *it;
+		for (int j = 0; j < (int)nzbInfo->GetFileList()->size(); j++)
+		{
+			FileInfo* fileInfo = nzbInfo->GetFileList()->at(j);
+			REQUIRE(fileInfo->GetArticles()->empty() == (j % 2 == 0));
+			REQUIRE(fileInfo->GetSuccessArticles() == (j % 2 == 1 ? fileInfo->GetId() : 0));
+		}
+	}
+}
+
+TEST_CASE("Disk state: partial file states", "[DiskState][Quick]")
+{
+	TestUtil::PrepareWorkingDir("nzbfile");
+
+	std::string queueDirOption = "QueueDir=" + TestUtil::WorkingDir() + "/";
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back(queueDirOption.c_str());
+	cmdOpts.push_back("FlushQueue=no");
+	cmdOpts.push_back("ContinuePartial=yes");
+	Options options(&cmdOpts, NULL);
+
+	SaveGeneratedQueue(3, 4, 2);
+
+	DownloadQueueMock downloadQueue;
+	DiskState diskState;
+	Servers servers;
+	REQUIRE(diskState.LoadDownloadQueue(&downloadQueue, &servers));
+	REQUIRE(downloadQueue.GetQueue()->size() == 3);
+	REQUIRE(downloadQueue.GetQueue()->at(2)->GetFileList()->size() == 4);
+	CheckPartialStates(&downloadQueue);
+
+	FileInfo* fileInfo = downloadQueue.GetQueue()->at(1)->GetFileList()->at(3);
+	char messageId[100];
+	snprintf(messageId, 100, "part2.file%i@test", fileInfo->GetId());
+	REQUIRE(std::string(fileInfo->GetArticles()->at(1)->GetMessageId()) == messageId);
+}
+
+TEST_CASE("Disk state: loading large queue benchmark", "[DiskState][Benchmark][.]")
+{
+	TestUtil::PrepareWorkingDir("nzbfile");
+
+	std::string queueDirOption = "QueueDir=" + TestUtil::WorkingDir() + "/";
+	Options::CmdOptList cmdOpts;
+	cmdOpts.push_back(queueDirOption.c_str());
+	cmdOpts.push_back("FlushQueue=no");
+	cmdOpts.push_back("ContinuePartial=yes");
+	Options options(&cmdOpts, NULL);
+
+	// 30000 files in 300 nzbs, half of files have partial states
+	const int nzbCount = 300;
+	const int fileCount = 100;
+	const int articleCount = 20;
+	SaveGeneratedQueue(nzbCount, fileCount, articleCount);
+
+	DownloadQueueMock downloadQueue;
+	DiskState diskState;
+	Servers servers;
+	int64 start = Util::GetCurrentTicks();
+	REQUIRE(diskState.LoadDownloadQueue(&downloadQueue, &servers));
+	int64 elapsed = Util::GetCurrentTicks() - start;
+	printf("Loading queue with %i files: %.1f ms\n", nzbCount * fileCount, elapsed / 1000.0);
+
+	REQUIRE(downloadQueue.GetQueue()->size() == nzbCount);
+	CheckPartialStates(&downloadQueue);
+}
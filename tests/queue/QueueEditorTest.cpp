@@ -0,0 +1,175 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "QueueEditor.h"
+#include "HistoryCoordinator.h"
+#include "Service.h"
+#include "Options.h"
+#include "Util.h"
+#include "TestQueue.h"
+
+/* Edit commands for history items are passed by queue editor to the global history coordinator */
+class EditEnvironment
+{
+public:
+	ServiceCoordinator	m_serviceCoordinator;
+	HistoryCoordinator*	m_historyCoordinator;
+
+						EditEnvironment();
+						~EditEnvironment();
+};
+
+EditEnvironment::EditEnvironment()
+{
+	g_ServiceCoordinator = &m_serviceCoordinator;
+	m_historyCoordinator = new HistoryCoordinator();
+	g_HistoryCoordinator = m_historyCoordinator;
+}
+
+EditEnvironment::~EditEnvironment()
+{
+	g_HistoryCoordinator = NULL;
+	delete m_historyCoordinator;
+	g_ServiceCoordinator = NULL;
+}
+
+TEST_CASE("Queue editor: lists of ids", "[QueueEditor][Quick]")
+{
+	Options::CmdOptList cmdOpts;
+	Options options(&cmdOpts, NULL);
+	EditEnvironment environment;
+	DownloadQueueMock downloadQueue;
+	QueueEditor queueEditor;
+
+	downloadQueue.Generate(5, 4, 5);
+	NzbList* queue = downloadQueue.GetQueue();
+	HistoryList* history = downloadQueue.GetHistory();
+
+	IdList idList;
+	idList.push_back(queue->at(3)->GetId());
+	idList.push_back(queue->at(1)->GetId());
+	idList.push_back(999999);
+	REQUIRE(queueEditor.EditList(&downloadQueue, &idList, NULL, DownloadQueue::mmId, DownloadQueue::eaGroupMoveTop, 0, NULL));
+	REQUIRE(std::string(queue->at(0)->GetName()) == "nzb1");
+	REQUIRE(std::string(queue->at(1)->GetName()) == "nzb3");
+	REQUIRE(std::string(queue->at(2)->GetName()) == "nzb0");
+
+	idList.clear();
+	idList.push_back(queue->at(2)->GetFileList()->at(3)->GetId());
+	idList.push_back(queue->at(2)->GetFileList()->at(2)->GetId());
+	REQUIRE(queueEditor.EditList(&downloadQueue, &idList, NULL, DownloadQueue::mmId, DownloadQueue::eaFileMoveOffset, -1, NULL));
+	REQUIRE(std::string(queue->at(2)->GetFileList()->at(1)->GetFilename()) == "file2.rar");
+	REQUIRE(std::string(queue->at(2)->GetFileList()->at(2)->GetFilename()) == "file3.rar");
+	REQUIRE(std::string(queue->at(2)->GetFileList()->at(3)->GetFilename()) == "file1.rar");
+
+	NameList nameList;
+	nameList.push_back((char*)"nzb4/file0.rar");
+	nameList.push_back((char*)"nzb0/file3.rar");
+	REQUIRE(queueEditor.EditList(&downloadQueue, NULL, &nameList, DownloadQueue::mmName, DownloadQueue::eaFilePause, 0, NULL));
+	REQUIRE(queue->at(4)->GetFileList()->at(0)->GetPaused());
+	REQUIRE(queue->at(2)->GetFileList()->at(2)->GetPaused());
+	REQUIRE_FALSE(queue->at(2)->GetFileList()->at(3)->GetPaused());
+
+	nameList.push_back((char*)"nzb4/missing.rar");
+	REQUIRE_FALSE(queueEditor.EditList(&downloadQueue, NULL, &nameList, DownloadQueue::mmName, DownloadQueue::eaFileResume, 0, NULL));
+
+	idList.clear();
+	idList.push_back(history->at(4)->GetId());
+	idList.push_back(history->at(0)->GetId());
+	REQUIRE(queueEditor.EditList(&downloadQueue, &idList, NULL, DownloadQueue::mmId, DownloadQueue::eaHistorySetDupeScore, 0, "10"));
+	REQUIRE(history->at(0)->GetNzbInfo()->GetDupeScore() == 10);
+	REQUIRE(history->at(1)->GetNzbInfo()->GetDupeScore() == 0);
+	REQUIRE(history->at(4)->GetNzbInfo()->GetDupeScore() == 10);
+
+	// deleted items are not edited again if listed twice
+	idList.push_back(history->at(2)->GetId());
+	idList.push_back(history->at(4)->GetId());
+	REQUIRE(queueEditor.EditList(&downloadQueue, &idList, NULL, DownloadQueue::mmId, DownloadQueue::eaHistoryFinalDelete, 0, NULL));
+	REQUIRE(history->size() == 2);
+	REQUIRE(std::string(history->at(0)->GetNzbInfo()->GetName()) == "hist1");
+	REQUIRE(std::string(history->at(1)->GetNzbInfo()->GetName()) == "hist3");
+}
+
+TEST_CASE("Queue editor: bulk edit benchmark", "[QueueEditor][Benchmark][.]")
+{
+	Options::CmdOptList cmdOpts;
+	Options options(&cmdOpts, NULL);
+	EditEnvironment environment;
+	DownloadQueueMock downloadQueue;
+	QueueEditor queueEditor;
+
+	// 50000 files in 1000 nzbs and 20000 history items, every second item is edited
+	const int nzbCount = 1000;
+	const int fileCount = 50;
+	const int historyCount = 20000;
+	downloadQueue.Generate(nzbCount, fileCount, historyCount);
+
+	IdList fileIds;
+	NameList nzbNames;
+	for (int i = 0; i < nzbCount; i += 2)
+	{
+		NzbInfo* nzbInfo = downloadQueue.GetQueue()->at(i);
+		nzbNames.push_back((char*)nzbInfo->GetName());
+		for (int j = 0; j < fileCount; j += 2)
+		{
+			fileIds.push_back(nzbInfo->GetFileList()->at(j)->GetId());
+		}
+	}
+
+	IdList historyIds;
+	for (int i = 0; i < historyCount; i += 2)
+	{
+		historyIds.push_back(downloadQueue.GetHistory()->at(i)->GetId());
+	}
+
+	int64 start = Util::GetCurrentTicks();
+	REQUIRE(queueEditor.EditList(&downloadQueue, &fileIds, NULL, DownloadQueue::mmId, DownloadQueue::eaFilePause, 0, NULL));
+	printf("Pausing %i files: %.1f ms\n", (int)fileIds.size(), (Util::GetCurrentTicks() - start) / 1000.0);
+
+	start = Util::GetCurrentTicks();
+	REQUIRE(queueEditor.EditList(&downloadQueue, &fileIds, NULL, DownloadQueue::mmId, DownloadQueue::eaFileMoveTop, 0, NULL));
+	printf("Moving %i files: %.1f ms\n", (int)fileIds.size(), (Util::GetCurrentTicks() - start) / 1000.0);
+
+	start = Util::GetCurrentTicks();
+	REQUIRE(queueEditor.EditList(&downloadQueue, NULL, &nzbNames, DownloadQueue::mmName, DownloadQueue::eaGroupSetPriority, 0, "100"));
+	printf("Setting priority for %i nzbs by name: %.1f ms\n", (int)nzbNames.size(), (Util::GetCurrentTicks() - start) / 1000.0);
+
+	start = Util::GetCurrentTicks();
+	REQUIRE(queueEditor.EditList(&downloadQueue, &historyIds, NULL, DownloadQueue::mmId, DownloadQueue::eaHistorySetDupeScore, 0, "10"));
+	printf("Editing %i history items: %.1f ms\n", (int)historyIds.size(), (Util::GetCurrentTicks() - start) / 1000.0);
+
+	start = Util::GetCurrentTicks();
+	REQUIRE(queueEditor.EditList(&downloadQueue, &historyIds, NULL, DownloadQueue::mmId, DownloadQueue::eaHistoryFinalDelete, 0, NULL));
+	printf("Deleting %i history items: %.1f ms\n", (int)historyIds.size(), (Util::GetCurrentTicks() - start) / 1000.0);
+
+	REQUIRE(downloadQueue.GetQueue()->at(0)->GetPriority() == 100);
+	REQUIRE(downloadQueue.GetQueue()->at(1)->GetPriority() == 0);
+	REQUIRE(downloadQueue.GetQueue()->at(0)->GetFileList()->at(0)->GetPaused());
+	REQUIRE(downloadQueue.GetHistory()->size() == historyCount / 2);
+}
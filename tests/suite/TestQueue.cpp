@@ -0,0 +1,106 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+
+#include "nzbget.h"
+
+#include "TestQueue.h"
+
+NzbInfo* DownloadQueueMock::AddNzb(const char* name, int fileCount, int articleCount)
+{
+	char buf[100];
+
+	NzbInfo* nzbInfo = new NzbInfo();
+	nzbInfo->SetName(name);
+	GetQueue()->push_back(nzbInfo);
+
+	for (int i = 0; i < fileCount; i++)
+	{
+		FileInfo* fileInfo = new FileInfo();
+		fileInfo->SetNzbInfo(nzbInfo);
+		snprintf(buf, 100, "file%i.rar", i);
+		fileInfo->SetFilename(buf);
+		fileInfo->SetSubject(buf);
+		nzbInfo->GetFileList()->push_back(fileInfo);
+
+		for (int k = 0; k < articleCount; k++)
+		{
+			ArticleInfo* articleInfo = new ArticleInfo();
+			articleInfo->SetPartNumber(k + 1);
+			snprintf(buf, 100, "part%i.file%i@test", k + 1, fileInfo->GetId());
+			articleInfo->SetMessageId(buf);
+			fileInfo->GetArticles()->push_back(articleInfo);
+		}
+	}
+
+	return nzbInfo;
+}
+
+void DownloadQueueMock::AddHistory(const char* name)
+{
+	NzbInfo* nzbInfo = new NzbInfo();
+	nzbInfo->SetName(name);
+	GetHistory()->push_front(new HistoryInfo(nzbInfo));
+}
+
+/* Fills queue with nzbs named "nzb<index>" and history with nzbs named "hist<index>" */
+void DownloadQueueMock::Generate(int nzbCount, int fileCount, int historyCount)
+{
+	char name[100];
+
+	for (int i = 0; i < nzbCount; i++)
+	{
+		snprintf(name, 100, "nzb%i", i);
+		AddNzb(name, fileCount);
+	}
+
+	for (int i = 0; i < historyCount; i++)
+	{
+		snprintf(name, 100, "hist%i", i);
+		NzbInfo* nzbInfo = new NzbInfo();
+		nzbInfo->SetName(name);
+		GetHistory()->push_back(new HistoryInfo(nzbInfo));
+	}
+}
+
+std::string DownloadQueueMock::QueueNames()
+{
+	std::string names;
+	for (NzbList::iterator it = GetQueue()->begin(); it != GetQueue()->end(); it++)
+	{
+		names += std::string(names.empty() ? "" : ",") + (*it)->GetName();
+	}
+	return names;
+}
+
+std::string DownloadQueueMock::HistoryNames()
+{
+	std::string names;
+	for (HistoryList::iterator it = GetHistory()->begin(); it != GetHistory()->end(); it++)
+	{
+		names += std::string(names.empty() ? "" : ",") + (*it)->GetNzbInfo()->GetName();
+	}
+	return names;
+}
@@ -0,0 +1,51 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+
+#ifndef TESTQUEUE_H
+#define TESTQUEUE_H
+
+#include "DownloadInfo.h"
+
+/*
+ * Download queue for tests, which doesn't edit or save itself. Generated nzbs
+ * have files "file<index>.rar" with articles "part<number>.file<file-id>@test".
+ */
+class DownloadQueueMock : public DownloadQueue
+{
+public:
+						DownloadQueueMock() { Init(this); }
+						~DownloadQueueMock() { Final(); }
+	virtual bool		EditEntry(int ID, EEditAction action, int offset, const char* text) { return false; }
+	virtual bool		EditList(IdList* idList, NameList* nameList, EMatchMode matchMode, EEditAction action, int offset, const char* text) { return false; }
+	virtual void		Save() {}
+	NzbInfo*			AddNzb(const char* name, int fileCount = 0, int articleCount = 0);
+	void				AddHistory(const char* name);
+	void				Generate(int nzbCount, int fileCount, int historyCount);
+	std::string			QueueNames();
+	std::string			HistoryNames();
+};
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ *  This file is part of nzbget
+ *
+ *  Copyright (C) 2015 Andrey Prygunkov <hugbug@users.sourceforge.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * $Revision$
+ * $Date$
+ *
+ */
+
+
+#include "nzbget.h"
+
+#include "catch.h"
+
+#include "Thread.h"
+
+class CountJob : public ParallelJob
+{
+public:
+	std::vector<int>	m_counts;
+	virtual void		Execute(int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			m_counts[i]++;
+		}
+	}
+};
+
+TEST_CASE("WorkerPool", "[Thread][Quick]")
+{
+	WorkerPool pool;
+	CountJob job;
+
+	// pool is reused for many jobs, with different number of threads and range sizes
+	for (int round = 0; round < 1000; round++)
+	{
+		int count = round % 97;
+		job.m_counts.assign(count, 0);
+		pool.Run(&job, count, 1 + round % 5, 1 + round % 3);
+		REQUIRE(std::count(job.m_counts.begin(), job.m_counts.end(), 1) == count);
+	}
+}
+
+class FinishingThread : public Thread
+{
+public:
+	int					m_runs;
+						FinishingThread() : m_runs(0) {}
+	virtual void		Run() { m_runs++; }
+	void				Wait() { while (IsRunning()) usleep(1000); }
+};
+
+TEST_CASE("Thread reuse", "[Thread][Quick]")
+{
+	FinishingThread thread;
+	thread.SetStackSize(256 * 1024);
+	thread.Start();
+	thread.Wait();
+	int osThreadCount = Thread::GetOsThreadCount();
+
+	// restarted thread-objects run in the same OS-thread
+	for (int i = 0; i < 100; i++)
+	{
+		thread.Start();
+		thread.Wait();
+	}
+
+	REQUIRE(thread.m_runs == 101);
+	REQUIRE(Thread::GetOsThreadCount() <= osThreadCount);
+}
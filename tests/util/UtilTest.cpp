@@ -75,3 +75,110 @@ TEST_CASE("WebUtil: URLEncode", "[Util][Quick]")
 
 	free(testString);
 }
+
+TEST_CASE("Util: Crc32", "[Util][Quick]")
+{
+	const char* text = "The quick brown fox jumps over the lazy dog";
+	REQUIRE(Util::Crc32((uchar*)text, strlen(text)) == 0x414FA339);
+
+	std::vector<uchar> data(10000);
+	srand(1);
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		data[i] = (uchar)(rand() % 256);
+	}
+
+	for (int impl = Util::ciTable; impl <= Util::ciArmCrc32; impl++)
+	{
+		if (!Util::IsCrc32ImplSupported((Util::ECrc32Impl)impl))
+		{
+			continue;
+		}
+
+		INFO("Implementation " << Util::Crc32ImplNames[impl]);
+		for (int i = 0; i < 1000; i++)
+		{
+			uint32 offset = rand() % 100;
+			uint32 len = i < 300 ? i : rand() % (data.size() - offset);
+			uint32 expected = Util::Crc32m(0xFFFFFFFF, &data[offset], len, Util::ciTable);
+			REQUIRE(Util::Crc32m(0xFFFFFFFF, &data[offset], len, (Util::ECrc32Impl)impl) == expected);
+		}
+	}
+}
+
+TEST_CASE("Util: Crc32Combine", "[Util][Quick]")
+{
+	std::vector<uchar> data(100000);
+	srand(2);
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		data[i] = (uchar)(rand() % 256);
+	}
+
+	uint32 expected = Util::Crc32(&data[0], data.size());
+
+	for (int i = 0; i < 100; i++)
+	{
+		uint32 split = rand() % data.size();
+		uint32 crc1 = Util::Crc32(&data[0], split);
+		uint32 crc2 = Util::Crc32(&data[split], data.size() - split);
+		REQUIRE(Util::Crc32Combine(crc1, crc2, data.size() - split) == expected);
+	}
+}
+
+TEST_CASE("Util: Crc32Stream", "[Util][Quick]")
+{
+	std::vector<uchar> data(20000);
+	srand(3);
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		data[i] = (uchar)(rand() % 256);
+	}
+
+	for (int i = 0; i < 200; i++)
+	{
+		uint32 len = i < 100 ? i * 3 : rand() % data.size();
+		uint32 expected = Util::Crc32m(0xFFFFFFFF, &data[0], len, Util::ciTable);
+
+		Crc32Stream crcStream;
+		for (uint32 pos = 0; pos < len; )
+		{
+			uint32 piece = rand() % 200;
+			piece = pos + piece > len ? len - pos : piece;
+			crcStream.Update(&data[pos], piece);
+			pos += piece;
+		}
+
+		REQUIRE(crcStream.Finish() == expected);
+	}
+}
+
+TEST_CASE("Util: Crc32 benchmark", "[Util][Benchmark][.]")
+{
+	const uint32 bufSize = 1024 * 1024;
+	const int rounds = 500;
+	std::vector<uchar> data(bufSize);
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		data[i] = (uchar)i;
+	}
+
+	for (int impl = Util::ciTable; impl <= Util::ciArmCrc32; impl++)
+	{
+		if (!Util::IsCrc32ImplSupported((Util::ECrc32Impl)impl))
+		{
+			continue;
+		}
+
+		uint32 crc = 0xFFFFFFFF;
+		int64 start = Util::GetCurrentTicks();
+		for (int i = 0; i < rounds; i++)
+		{
+			crc = Util::Crc32m(crc, &data[0], bufSize, (Util::ECrc32Impl)impl);
+		}
+		int64 elapsed = Util::GetCurrentTicks() - start;
+
+		printf("Crc32 %-12s: %.2f GB/s (crc %08x)\n", Util::Crc32ImplNames[impl],
+			(double)bufSize * rounds / (elapsed > 0 ? elapsed : 1) / 1000, crc);
+	}
+}